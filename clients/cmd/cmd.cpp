@@ -25,6 +25,7 @@
 #include "../../common/utils/HexFile.h"
 #include "../../common/utils/FormatableString.h"
 #include "../../common/utils/BootloaderInterface.h"
+#include "../../common/utils/MultiBootloaderInterface.h"
 #include "../../transport/dashel_plugins/dashel-plugins.h"
 #include <iostream>
 #include <fstream>
@@ -32,6 +33,7 @@
 #include <iterator>
 #include <cassert>
 #include <cstring>
+#include <cstdlib>
 #include <memory>
 
 namespace Aseba 
@@ -46,7 +48,8 @@ namespace Aseba
 		stream << "* usermsg: user message [type] [word0] ... [wordN]\n";
 		stream << "* rdpage : bootloader read page [dest] [page number]\n";
 		stream << "* rdpageusb : bootloader read page usb [dest] [page number]\n";
-		stream << "* whex : write hex file [dest] [file name] [reset]\n";
+		stream << "* whex : write hex file [dest] [file name] [reset] [diff] [cache file name], diff leaves up-to-date pages, cache remembers them between runs and goes stale if the node is flashed by another tool, such as thymioupgrader\n";
+		stream << "* whexmulti : write hex file to several nodes at once [dest,...,dest] [file name] [reset] [skip] [cache file name], skip leaves up-to-date pages, cache as for whex\n";
 		stream << "* rhex : read hex file [source] [file name]\n";
 		stream << "* eb: exit from bootloader, go back into user mode [dest]\n";
 		stream << "* sb: switch into bootloader: reboot node, then enter bootloader for a while [dest]\n";
@@ -161,6 +164,11 @@ namespace Aseba
 			cout << "Failure" << endl;
 		}
 		
+		virtual void writePageUnchanged(unsigned pageNumber)
+		{
+			cout << "Page " << pageNumber << " up to date" << endl;
+		}
+		
 		virtual void writeHexStart(const string &fileName, bool reset, bool simple)
 		{
 			cout << "Flashing " << fileName << endl;
@@ -192,6 +200,89 @@ namespace Aseba
 		}
 	};
 	
+	class CmdMultiBootloaderInterface:public MultiBootloaderInterface
+	{
+	public:
+		CmdMultiBootloaderInterface(bool reset, bool skipUnchanged):
+			MultiBootloaderInterface(reset, skipUnchanged)
+		{}
+	
+	protected:
+		// reporting function
+		virtual void nodeGotDescription(Stream* stream, unsigned dest, unsigned pagesCount)
+		{
+			cout << "Node " << dest << " in bootloader, about to write " << pagesCount << " pages" << endl;
+		}
+		
+		virtual void nodePageDone(Stream* stream, unsigned dest, unsigned pageNumber, bool written)
+		{
+			cout << "Node " << dest << ": page " << pageNumber << (written ? " written" : " up to date") << endl;
+		}
+		
+		virtual void nodeDone(Stream* stream, unsigned dest, bool success, const string& reason)
+		{
+			if (success)
+				cout << "Node " << dest << ": write completed" << endl;
+			else
+				cerr << "Node " << dest << ": " << reason << endl;
+		}
+	};
+	
+	//! Write an hex file to several nodes on target at once, return the number of arguments eaten (not counting the command itself)
+	int writeHexMulti(const char *target, int argc, char *argv[])
+	{
+		// first arg is the list of dests, second is file name
+		if (argc < 3)
+			errorMissingArgument(argv[0]);
+		int argEaten = 2;
+		
+		bool reset = false;
+		bool skip = false;
+		const char *cacheFileName = 0;
+		for (int i = 3; i < argc; ++i)
+		{
+			if (!strcmp(argv[i], "reset"))
+				reset = true;
+			else if (!strcmp(argv[i], "skip"))
+				skip = true;
+			else if (!strcmp(argv[i], "cache") && i + 1 < argc)
+				cacheFileName = argv[++i];
+			else
+				break;
+			argEaten = i;
+		}
+		
+		PageChecksumCache cache;
+		CmdMultiBootloaderInterface bootloader(reset, skip);
+		if (cacheFileName)
+		{
+			cache.load(cacheFileName);
+			bootloader.setChecksumCache(&cache);
+		}
+		Stream* stream = bootloader.connect(target);
+		for (char *dest = strtok(argv[1], ","); dest; dest = strtok(0, ","))
+			bootloader.addNode(stream, atoi(dest));
+		
+		try
+		{
+			const MultiBootloaderInterface::Statistics statistics(bootloader.writeHex(argv[2]));
+			const double seconds(double(statistics.duration.value) / 1000.);
+			cout << "Flashed " << statistics.nodesFlashed << " nodes in " << seconds << " s: ";
+			cout << statistics.pagesWritten << " pages written, " << statistics.pagesSkipped << " up to date, ";
+			cout << (seconds > 0 ? double(statistics.bytesWritten + statistics.bytesRead) / 1024. / seconds : 0) << " kB/s" << endl;
+			if (cacheFileName && !cache.save(cacheFileName))
+				errorOpenFile(cacheFileName);
+			if (statistics.nodesFailed)
+				errorBootloader(FormatableString("%0 nodes failed").arg(statistics.nodesFailed));
+		}
+		catch (HexFile::Error &e)
+		{
+			errorHexFile(e.toString());
+		}
+		
+		return argEaten;
+	}
+	
 	//! Process a command, return the number of arguments eaten (not counting the command itself)
 	int processCommand(Stream* stream, int argc, char *argv[])
 	{
@@ -264,22 +355,39 @@ namespace Aseba
 		else if (strcmp(cmd, "whex") == 0)
 		{
 			bool reset = 0;
+			bool diff = 0;
+			const char *cacheFileName = 0;
 			// first arg is dest, second is file name
 			if (argc < 3)
 				errorMissingArgument(argv[0]);
 			argEaten = 2;
 			
-			if (argc > 3 && !strcmp(argv[3], "reset")) 
+			for (int i = 3; i < argc; ++i)
 			{
-				reset = 1;
-				argEaten = 3;
+				if (!strcmp(argv[i], "reset"))
+					reset = 1;
+				else if (!strcmp(argv[i], "diff"))
+					diff = 1;
+				else if (!strcmp(argv[i], "cache") && i + 1 < argc)
+					cacheFileName = argv[++i];
+				else
+					break;
+				argEaten = i;
 			}
 
 			// try to write hex file
 			try
 			{
+				PageChecksumCache cache;
 				CmdBootloaderInterface bootloader(stream, atoi(argv[1]));
-				bootloader.writeHex(argv[2], reset, false);
+				if (cacheFileName)
+				{
+					cache.load(cacheFileName);
+					bootloader.setChecksumCache(&cache);
+				}
+				bootloader.writeHex(argv[2], reset, false, diff);
+				if (cacheFileName && !cache.save(cacheFileName))
+					errorOpenFile(cacheFileName);
 			}
 			catch (HexFile::Error &e)
 			{
@@ -426,6 +534,22 @@ int main(int argc, char *argv[])
 			Aseba::dumpVersion(std::cout);
 			return 0;
 		}
+		else if (strcmp(arg, "whexmulti") == 0)
+		{
+			// the sessions need their own hub to receive from all nodes at once
+			try
+			{
+				argCounter += Aseba::writeHexMulti(target, argc - argCounter, &argv[argCounter]);
+			}
+			catch (Dashel::DashelException e)
+			{
+				Aseba::errorServerDisconnected();
+			}
+			catch (Aseba::BootloaderInterface::Error e)
+			{
+				Aseba::errorBootloader(e.what());
+			}
+		}
 		else
 		{
 			Dashel::Hub client;
@@ -1,11 +1,16 @@
 #include <dashel/dashel.h>
 #include "../../common/msg/msg.h"
 #include "../../common/utils/utils.h"
+#include "../../common/utils/RingSeries.h"
 #include "../../transport/dashel_plugins/dashel-plugins.h"
 #include <cmath>
 #include <QtGui>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
 #include <cassert>
 #include <fstream>
+#include <sstream>
 #include <iostream>
 
 #ifdef _MSC_VER
@@ -31,15 +36,15 @@ class EventDataWrapper : public QwtSeriesData<QPointF>
 {
 private:
 	std::vector<double>& _x;
-	std::vector<sint16>& _y;
+	std::vector<double>& _y;
 	
 public:
-	EventDataWrapper(std::vector<double>& _x, std::vector<sint16>& _y) :
+	EventDataWrapper(std::vector<double>& _x, std::vector<double>& _y) :
 		_x(_x),
 		_y(_y)
 	{ }
 	virtual QRectF boundingRect () const { return qwtBoundingRect(*this); }
-	virtual QPointF sample (size_t i) const { return QPointF(_x[i], double(_y[i])); }
+	virtual QPointF sample (size_t i) const { return QPointF(_x[i], _y[i]); }
 	virtual size_t size () const { return _x.size(); }
 };
 #else
@@ -47,40 +52,112 @@ class EventDataWrapper : public QwtData
 {
 private:
 	std::vector<double>& _x;
-	std::vector<sint16>& _y;
+	std::vector<double>& _y;
 	
 public:
-	EventDataWrapper(std::vector<double>& _x, std::vector<sint16>& _y) :
+	EventDataWrapper(std::vector<double>& _x, std::vector<double>& _y) :
 		_x(_x),
 		_y(_y)
 	{ }
 	virtual QwtData *   copy () const { return new EventDataWrapper(*this); }
 	virtual size_t   size () const { return _x.size(); }
 	virtual double x (size_t i) const { return _x[i]; }
-	virtual double y (size_t i) const { return (double)_y[i]; }
+	virtual double y (size_t i) const { return _y[i]; }
 };
 #endif
 
+//! Writes text to a file from a thread of its own, so that the plot never waits for the disk
+class BackgroundWriter : public QThread
+{
+protected:
+	std::ofstream file;
+	QMutex mutex;
+	QWaitCondition textAvailable;
+	std::string pending;
+	bool stopping;
+	
+public:
+	BackgroundWriter(const char* filename) :
+		file(filename),
+		stopping(false)
+	{
+		start();
+	}
+	
+	~BackgroundWriter()
+	{
+		{
+			QMutexLocker locker(&mutex);
+			stopping = true;
+			textAvailable.wakeOne();
+		}
+		wait();
+	}
+	
+	//! Queue text for writing; text is left empty
+	void append(std::string& text)
+	{
+		if (text.empty())
+			return;
+		QMutexLocker locker(&mutex);
+		if (pending.empty())
+			pending.swap(text);
+		else
+			pending += text;
+		text.clear();
+		textAvailable.wakeOne();
+	}
+	
+protected:
+	virtual void run()
+	{
+		std::string writing;
+		while (true)
+		{
+			{
+				QMutexLocker locker(&mutex);
+				while (pending.empty() && !stopping)
+					textAvailable.wait(&mutex);
+				if (pending.empty())
+					break;
+				writing.swap(pending);
+			}
+			file.write(writing.data(), writing.size());
+			file.flush();
+			writing.clear();
+		}
+	}
+};
+
 class EventLogger : public Hub, public QwtPlot
 {
 protected:
 	Stream* stream;
 	int eventId;
-	vector<vector<sint16> > values;
-	vector<double> timeStamps;
+	RingSeries series;
+	vector<vector<double> > plotTimes;
+	vector<vector<double> > plotValues;
+	bool plotOutdated;
+	QTime lastReplot;
 	QTime startingTime;
-	ofstream outputFile;
+	BackgroundWriter* outputFile;
+	string outputLines;
 	
 public:
 	EventLogger(const char* target, int eventId, int eventVariablesCount, const char* filename) :
 		QwtPlot(QwtText(QString(tr("Plot for event %0")).arg(eventId))),
 		eventId(eventId),
-		values(eventVariablesCount)
+		series(eventVariablesCount, eventPlotCapacity),
+		plotTimes(eventVariablesCount),
+		plotValues(eventVariablesCount),
+		plotOutdated(false),
+		outputFile(0)
 	{
 		stream = Hub::connect(target);
 		cout << "Connected to " << stream->getTargetName() << endl;
 		
 		startingTime = QTime::currentTime();
+		lastReplot.start();
 		
 		setCanvasBackground(Qt::white);
 		setAxisTitle(xBottom, tr("Time (seconds)"));
@@ -90,31 +167,55 @@ public:
 		//legend->setItemMode(QwtLegend::CheckableItem);
 		insertLegend(legend, QwtPlot::BottomLegend);
 		
-		for (size_t i = 0; i < values.size(); i++)
+		for (size_t i = 0; i < series.channelsCount(); i++)
 		{
 			QwtPlotCurve *curve = new QwtPlotCurve(QString("%0").arg(i));
 			#if QWT_VERSION >= 0x060000
-			curve->setData(new EventDataWrapper(timeStamps, values[i]));
+			curve->setData(new EventDataWrapper(plotTimes[i], plotValues[i]));
 			#else
-			curve->setData(EventDataWrapper(timeStamps, values[i]));
+			curve->setData(EventDataWrapper(plotTimes[i], plotValues[i]));
 			#endif
 			curve->attach(this);
-			curve->setPen(QColor::fromHsv((i * 360) / values.size(), 255, 100));
+			curve->setPen(QColor::fromHsv((i * 360) / series.channelsCount(), 255, 100));
 		}
 		
 		resize(1000, 600);
 		
 		if (filename)
-			outputFile.open(filename);
+			outputFile = new BackgroundWriter(filename);
 		
 		startTimer(10);
 	}
+	
+	~EventLogger()
+	{
+		if (outputFile)
+		{
+			outputFile->append(outputLines);
+			delete outputFile;
+		}
+	}
 
 protected:
 	virtual void timerEvent ( QTimerEvent * event )
 	{
 		if (!step(0))
 			close();
+		
+		// hand the lines of this step over to the writing thread
+		if (outputFile)
+			outputFile->append(outputLines);
+		
+		// replot at most at display rate, whatever the rate of events
+		if (plotOutdated && lastReplot.elapsed() >= eventPlotReplotInterval)
+		{
+			const unsigned columns(canvas()->width());
+			for (size_t i = 0; i < series.channelsCount(); i++)
+				series.decimate(i, series.time(0), series.time(series.size() - 1), columns, plotTimes[i], plotValues[i]);
+			replot();
+			plotOutdated = false;
+			lastReplot.restart();
+		}
 	}
 	
 	void incomingData(Stream *stream)
@@ -126,27 +227,18 @@ protected:
 			if (userMessage->type == eventId)
 			{
 				double elapsedTime = (double)startingTime.msecsTo(QTime::currentTime()) / 1000.;
-				if (outputFile.is_open())
-					outputFile << elapsedTime;
-				timeStamps.push_back(elapsedTime);
-				for (size_t i = 0; i < values.size(); i++)
+				const size_t count(userMessage->data.size());
+				series.push(elapsedTime, count ? &userMessage->data[0] : 0, count);
+				plotOutdated = true;
+				if (outputFile)
 				{
-					if (i < userMessage->data.size())
-					{
-						if (outputFile.is_open())
-							outputFile << " " << userMessage->data[i];
-						values[i].push_back(userMessage->data[i]);
-					}
-					else
-					{
-						if (outputFile.is_open())
-							outputFile << " " << 0;
-						values[i].push_back(0);
-					}
+					ostringstream line;
+					line << elapsedTime;
+					for (size_t i = 0; i < series.channelsCount(); i++)
+						line << " " << (i < count ? userMessage->data[i] : 0);
+					line << "\n";
+					outputLines += line.str();
 				}
-				if (outputFile.is_open())
-					outputFile << endl;
-				replot();
 			}
 		}
 		delete message;
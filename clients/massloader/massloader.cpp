@@ -21,16 +21,22 @@
 #include <memory>
 #include <cassert>
 #include <iostream>
+#include <algorithm>
+#include <map>
+#include <set>
 #include <dashel/dashel.h>
 #include "../../common/consts.h"
 #include "../../common/msg/msg.h"
 #include "../../common/msg/descriptions-manager.h"
+#include "../../common/msg/bytecode-uploader.h"
 #include "../../common/utils/utils.h"
 #include "../../transport/dashel_plugins/dashel-plugins.h"
 #include <QCoreApplication>
 #include <QString>
 #include <QStringList>
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QDomDocument>
 
 namespace Aseba 
@@ -38,17 +44,147 @@ namespace Aseba
 	using namespace Dashel;
 	using namespace std;
 	
-	class MassLoader: public Hub, public DescriptionsManager
+	//! Programs and common definitions of an AESL file
+	struct AeslFile
+	{
+		//! The program of a node in the file
+		struct NodeProgram
+		{
+			NodeProgram(const std::wstring& name, unsigned preferedId, const std::wstring& source) :
+				name(name), preferedId(preferedId), source(source) {}
+			
+			std::wstring name; //!< name of the nodes to load this program to
+			unsigned preferedId; //!< if several programs have this name, the one with the id of the node is used
+			std::wstring source; //!< source code
+		};
+		typedef std::vector<NodeProgram> NodePrograms;
+		
+		CommonDefinitions commonDefinitions; //!< events and constants
+		NodePrograms programs; //!< programs of all nodes
+		
+		//! Load fileName, return false and leave the file empty on error
+		bool load(const QString& fileName);
+		//! Return the index of the program for a node of name and id, or -1 if there is none
+		int findProgram(const std::wstring& name, unsigned nodeId) const;
+	};
+	
+	bool AeslFile::load(const QString& fileName)
+	{
+		commonDefinitions = CommonDefinitions();
+		programs.clear();
+		
+		// open file
+		QFile file(fileName);
+		if (!file.open(QFile::ReadOnly))
+		{
+			wcerr << QString("Cannot open file %0").arg(fileName).toStdWString() << endl;
+			return false;
+		}
+		// load document
+		QDomDocument document("aesl-source");
+		QString errorMsg;
+		int errorLine;
+		int errorColumn;
+		if (!document.setContent(&file, false, &errorMsg, &errorLine, &errorColumn))
+		{
+			wcerr << QString("Error in XML source file: %0 at line %1, column %2").arg(errorMsg).arg(errorLine).arg(errorColumn).toStdWString() << endl;
+			return false;
+		}
+		
+		QDomNode domNode = document.documentElement().firstChild();
+		while (!domNode.isNull())
+		{
+			if (domNode.isElement())
+			{
+				QDomElement element = domNode.toElement();
+				if (element.tagName() == "node")
+				{
+					programs.push_back(NodeProgram(element.attribute("name").toStdWString(), element.attribute("nodeId", 0).toUInt(), element.firstChild().toText().data().toStdWString()));
+				}
+				else if (element.tagName() == "event")
+				{
+					const QString eventName(element.attribute("name"));
+					const unsigned eventSize(element.attribute("size").toUInt());
+					if (eventSize > ASEBA_MAX_EVENT_ARG_SIZE)
+					{
+						wcerr << QString("Event %1 has a length %2 larger than maximum %3").arg(eventName).arg(eventSize).arg(ASEBA_MAX_EVENT_ARG_SIZE).toStdWString() << endl;
+						commonDefinitions = CommonDefinitions();
+						programs.clear();
+						return false;
+					}
+					else
+					{
+						commonDefinitions.events.push_back(NamedValue(eventName.toStdWString(), eventSize));
+					}
+				}
+				else if (element.tagName() == "constant")
+				{
+					commonDefinitions.constants.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("value").toUInt()));
+				}
+			}
+			domNode = domNode.nextSibling();
+		}
+		return true;
+	}
+	
+	int AeslFile::findProgram(const std::wstring& name, unsigned nodeId) const
+	{
+		int found(-1);
+		for (size_t i = 0; i < programs.size(); ++i)
+		{
+			if (programs[i].name != name)
+				continue;
+			if (programs[i].preferedId == nodeId)
+				return int(i);
+			if (found < 0)
+				found = int(i);
+		}
+		return found;
+	}
+	
+	//! Deploy the programs of an AESL file to all nodes appearing on a target, for as long as it runs
+	/**
+		The file is parsed once, and again only when it changes on disk.
+		Programs are compiled once per program and description of node, so that
+		any number of identical nodes share the same bytecode.
+		Nodes whose descriptions arrive together are deployed together.
+	*/
+	class MassLoader: public Hub, public DescriptionsManager, public BytecodeUploader
 	{
 	protected:
+		//! Program of the AESL file and crc of the description of the node it is compiled for
+		typedef std::pair<unsigned, uint16> ProgramKey;
+		//! The result of the compilation of a program for a description
+		struct CompiledProgram
+		{
+			CompiledProgram() : success(false) {}
+			
+			bool success; //!< whether compilation was successful
+			std::vector<uint16> bytecode; //!< bytecode, if compilation was successful
+		};
+		typedef std::map<ProgramKey, CompiledProgram> CompiledPrograms;
+		
 		QString fileName;
+		QDateTime fileLastModified; //!< modification time of the file when it was loaded
+		AeslFile aeslFile; //!< content of the file
+		CompiledPrograms compiledPrograms; //!< programs already compiled, for the current content of the file
+		
+		const unsigned discoveryPeriod; //!< period of the requests of descriptions, in ms; 0 to only request until the first answer
 		Stream* stream;
+		UnifiedTime lastDescriptionsRequest; //!< when descriptions were last requested
+		bool nodeSeen; //!< whether a node described itself since we connected
+		std::set<unsigned> pendingNodes; //!< nodes whose description was received, waiting to be deployed
+		std::map<unsigned, QString> uploadsNames; //!< names of the nodes being uploaded to
 		
 	public:
-		MassLoader(const QString& fileName):fileName(fileName),stream(0) {}
+		MassLoader(const QString& fileName, unsigned discoveryPeriod):fileName(fileName),discoveryPeriod(discoveryPeriod),stream(0),nodeSeen(false) {}
 		void loadToTarget(const std::string& target);
 		
 	protected:
+		void requestDescriptions();
+		void reloadIfChanged();
+		void stepDeployments();
+		
 		// from Hub
 		virtual void connectionCreated(Stream *stream);
 		virtual void incomingData(Stream *stream);
@@ -56,10 +192,18 @@ namespace Aseba
 	
 		// from DescriptionsManager
 		virtual void nodeDescriptionReceived(unsigned nodeId);
+		virtual void sendDescriptionsMessage(Message& message);
+		
+		// from BytecodeUploader
+		virtual void sendUploadMessage(Message& message);
+		virtual void uploadFinished(unsigned nodeId, UploadResult result);
 	};
 	
 	void MassLoader::loadToTarget(const std::string& target)
 	{
+		fileLastModified = QFileInfo(fileName).lastModified();
+		aeslFile.load(fileName);
+		
 		while (true)
 		{
 			try
@@ -67,22 +211,17 @@ namespace Aseba
 				stream = connect(target);
 				if (stream)
 				{
-					// TODO: make this timeout a parameter
-					// wait 1 s
-					UnifiedTime now;
-					while (true)
+					// ask nodes right away, and again as long as none answered or periodically to discover new ones
+					nodeSeen = false;
+					requestDescriptions();
+					while (step(10))
 					{
-						const UnifiedTime::Value delta((UnifiedTime() - now).value);
-						if (delta >= 1000)
-							break;
-						step(delta);
+						stepDeployments();
+						stepUploads();
+						const UnifiedTime::Value sinceRequest((UnifiedTime() - lastDescriptionsRequest).value);
+						if (discoveryPeriod ? sinceRequest >= discoveryPeriod : (!nodeSeen && sinceRequest >= 1000))
+							requestDescriptions();
 					}
-					
-					// requests description
-					GetDescription().serialize(stream);
-					stream->flush();
-					// then run
-					run();
 				}
 			}
 			catch (DashelException e)
@@ -91,6 +230,79 @@ namespace Aseba
 		}
 	}
 	
+	void MassLoader::requestDescriptions()
+	{
+		if (!stream)
+			return;
+		GetDescription().serialize(stream);
+		stream->flush();
+		lastDescriptionsRequest = UnifiedTime();
+	}
+	
+	void MassLoader::reloadIfChanged()
+	{
+		// parse the file once per version, even if it is invalid
+		const QDateTime lastModified(QFileInfo(fileName).lastModified());
+		if (lastModified == fileLastModified)
+			return;
+		fileLastModified = lastModified;
+		aeslFile.load(fileName);
+		compiledPrograms.clear();
+	}
+	
+	void MassLoader::stepDeployments()
+	{
+		if (pendingNodes.empty())
+			return;
+		reloadIfChanged();
+		
+		// the programs of the nodes, compiling those never seen with this description, all in parallel
+		BatchCompiler::Programs programs;
+		std::vector<ProgramKey> programsKeys;
+		std::map<unsigned, ProgramKey> nodesKeys;
+		for (std::set<unsigned>::const_iterator it = pendingNodes.begin(); it != pendingNodes.end(); ++it)
+		{
+			const unsigned nodeId(*it);
+			bool ok;
+			const TargetDescription* description(getDescription(nodeId, &ok));
+			if (!ok)
+				continue;
+			const int program(aeslFile.findProgram(description->name, nodeId));
+			if (program < 0)
+				continue;
+			const ProgramKey key(program, description->crc());
+			nodesKeys[nodeId] = key;
+			if (compiledPrograms.find(key) == compiledPrograms.end() && std::find(programsKeys.begin(), programsKeys.end(), key) == programsKeys.end())
+			{
+				programs.push_back(BatchCompiler::Program(aeslFile.programs[program].source, description, &aeslFile.commonDefinitions));
+				programsKeys.push_back(key);
+			}
+		}
+		pendingNodes.clear();
+		
+		const BatchCompiler::Results results(BatchCompiler().compile(programs));
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const BatchCompiler::Result& result(results[i]);
+			CompiledProgram& compiledProgram(compiledPrograms[programsKeys[i]]);
+			compiledProgram.success = result.success;
+			if (result.success)
+				compiledProgram.bytecode.assign(result.bytecode.begin(), result.bytecode.end());
+			else
+				wcerr << L"Compilation error for " << aeslFile.programs[programsKeys[i].first].name << L": " << result.error.toWString() << endl;
+		}
+		
+		// upload to all nodes at once
+		for (std::map<unsigned, ProgramKey>::const_iterator it = nodesKeys.begin(); it != nodesKeys.end(); ++it)
+		{
+			const CompiledProgram& compiledProgram(compiledPrograms[it->second]);
+			if (!compiledProgram.success)
+				continue;
+			uploadsNames[it->first] = QString::fromStdWString(getNodeName(it->first));
+			startUpload(it->first, compiledProgram.bytecode);
+		}
+	}
+	
 	void MassLoader::connectionCreated(Stream *stream)
 	{
 		//cerr << "Connection created to " << stream->getTargetName() << endl;
@@ -106,7 +318,10 @@ namespace Aseba
 			message->dump(wcerr);
 			wcerr << endl;*/
 			// process it
-			processMessage(message.get());
+			DescriptionsManager::processMessage(message.get());
+			BytecodeUploader::processMessage(message.get());
+			if (dynamic_cast<Disconnected*>(message.get()))
+				pendingNodes.erase(message->source);
 		}
 		catch (DashelException e)
 		{
@@ -121,92 +336,43 @@ namespace Aseba
 		this->stream = 0;
 		stop();
 		reset();
+		uploads.clear();
+		uploadsNames.clear();
+		pendingNodes.clear();
 	}
 	
 	void MassLoader::nodeDescriptionReceived(unsigned nodeId)
 	{
-		//cerr << "Description received" << endl;
-		assert(stream);
-		
-		// we have a new node description, load file to see if there is code for it
-		CommonDefinitions commonDefinitions;
-		
-		// open file
-		QFile file(fileName);
-		if (!file.open(QFile::ReadOnly))
-		{
-			wcerr << QString("Cannot open file %0").arg(fileName).toStdWString() << endl;
+		// deployed from the main loop, together with the nodes arriving at the same time
+		nodeSeen = true;
+		pendingNodes.insert(nodeId);
+	}
+	
+	void MassLoader::sendDescriptionsMessage(Message& message)
+	{
+		sendUploadMessage(message);
+	}
+	
+	void MassLoader::sendUploadMessage(Message& message)
+	{
+		if (!stream)
 			return;
-		}
-		// load document
-		QDomDocument document("aesl-source");
-		QString errorMsg;
-		int errorLine;
-		int errorColumn;
-		if (!document.setContent(&file, false, &errorMsg, &errorLine, &errorColumn))
+		message.serialize(stream);
+		stream->flush();
+	}
+	
+	void MassLoader::uploadFinished(unsigned nodeId, UploadResult result)
+	{
+		const QString name(uploadsNames[nodeId]);
+		uploadsNames.erase(nodeId);
+		if (result == UPLOAD_FAILED)
 		{
-			wcerr << QString("Error in XML source file: %0 at line %1, column %2").arg(errorMsg).arg(errorLine).arg(errorColumn).toStdWString() << endl;
+			wcerr << QString("Loading bytecode to target %0 failed").arg(name).toStdWString() << endl;
 			return;
 		}
-		
-		// FIXME: this code depends on event and contants being before any code
-		QDomNode domNode = document.documentElement().firstChild();
-		while (!domNode.isNull())
-		{
-			if (domNode.isElement())
-			{
-				QDomElement element = domNode.toElement();
-				if (element.tagName() == "node")
-				{
-					bool ok;
-					const unsigned nodeId(getNodeId(element.attribute("name").toStdWString(), element.attribute("nodeId", 0).toUInt(), &ok));
-					if (ok)
-					{
-						std::wistringstream is(element.firstChild().toText().data().toStdWString());
-						Error error;
-						BytecodeVector bytecode;
-						unsigned allocatedVariablesCount;
-						
-						Compiler compiler;
-						compiler.setTargetDescription(getDescription(nodeId));
-						compiler.setCommonDefinitions(&commonDefinitions);
-						bool result = compiler.compile(is, bytecode, allocatedVariablesCount, error);
-						
-						if (result)
-						{
-							sendBytecode(stream, nodeId, std::vector<uint16>(bytecode.begin(), bytecode.end()));
-							Run(nodeId).serialize(stream);
-							stream->flush();
-							wcerr << QString("! %1 bytecodes loaded to target %0, you can disconnect target !").arg(element.attribute("name")).arg(bytecode.size()).toStdWString() << endl;
-						}
-						else
-						{
-							wcerr << L"Compilation error: " << error.toWString() << endl;
-							break;
-						}
-					}
-				}
-				else if (element.tagName() == "event")
-				{
-					const QString eventName(element.attribute("name"));
-					const unsigned eventSize(element.attribute("size").toUInt());
-					if (eventSize > ASEBA_MAX_EVENT_ARG_SIZE)
-					{
-						wcerr << QString("Event %1 has a length %2 larger than maximum %3").arg(eventName).arg(eventSize).arg(ASEBA_MAX_EVENT_ARG_SIZE).toStdWString() << endl;
-						break;
-					}
-					else
-					{
-						commonDefinitions.events.push_back(NamedValue(eventName.toStdWString(), eventSize));
-					}
-				}
-				else if (element.tagName() == "constant")
-				{
-					commonDefinitions.constants.push_back(NamedValue(element.attribute("name").toStdWString(), element.attribute("value").toUInt()));
-				}
-			}
-			domNode = domNode.nextSibling();
-		}
+		Run(nodeId).serialize(stream);
+		stream->flush();
+		wcerr << QString("! bytecode %1 to target %0, you can disconnect target !").arg(name).arg(result == UPLOAD_VERIFIED ? "loaded and verified" : "loaded").toStdWString() << endl;
 	}
 }
 
@@ -217,16 +383,20 @@ int main(int argc, char *argv[])
 	
 	QString target(ASEBA_DEFAULT_TARGET);
 	
+	unsigned discoveryPeriod(0);
+	
 	if (app.arguments().size() < 2)
 	{
-		std::wcerr << L"Usage: " << app.arguments().first().toStdWString() << L" filename [target]" << std::endl;
+		std::wcerr << L"Usage: " << app.arguments().first().toStdWString() << L" filename [target] [discovery period in ms]" << std::endl;
 		return 1;
 	}
 	
 	if (app.arguments().size() >= 3)
 		target = app.arguments().at(2);
+	if (app.arguments().size() >= 4)
+		discoveryPeriod = app.arguments().at(3).toUInt();
 	
-	Aseba::MassLoader massLoader(app.arguments().at(1));
+	Aseba::MassLoader massLoader(app.arguments().at(1), discoveryPeriod);
 	massLoader.loadToTarget(target.toStdString());
 	return 0;
 }
@@ -0,0 +1,542 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dashel/dashel.h>
+#include "../../common/consts.h"
+#include "../../transport/dashel_plugins/dashel-plugins.h"
+#include "log.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <deque>
+#include <algorithm>
+#ifndef WIN32
+	#include <dirent.h>
+#else // WIN32
+	#include <windows.h>
+#endif // WIN32
+
+namespace Aseba
+{
+	using namespace Dashel;
+	using namespace std;
+
+	/**
+	\defgroup capture Message capture
+	*/
+	/*@{*/
+
+	//! Selects messages from their header, before their payload is read
+	class CaptureFilter
+	{
+	public:
+		//! Add an alternative made of terms separated by spaces, such as "source=2-4 type!=0x8000-0x80ff event=3,5";
+		//! a message is selected if it matches all the terms of any alternative
+		bool add(const string& expression)
+		{
+			vector<Term> terms;
+			istringstream iss(expression);
+			string word;
+			while (iss >> word)
+			{
+				Term term;
+				if (!term.parse(word))
+					return false;
+				terms.push_back(term);
+			}
+			if (terms.empty())
+				return false;
+			alternatives.push_back(terms);
+			return true;
+		}
+
+		//! Return whether there is no alternative, in which case all messages match
+		bool empty() const { return alternatives.empty(); }
+
+		//! Return whether the message of this source and type is selected
+		bool matches(uint16 source, uint16 type) const
+		{
+			if (alternatives.empty())
+				return true;
+			for (size_t i = 0; i < alternatives.size(); ++i)
+			{
+				bool allMatch(true);
+				for (size_t j = 0; allMatch && j < alternatives[i].size(); ++j)
+					allMatch = alternatives[i][j].matches(source, type);
+				if (allMatch)
+					return true;
+			}
+			return false;
+		}
+
+	protected:
+		struct Term
+		{
+			enum Field { SOURCE, TYPE, EVENT } field;
+			bool negated;
+			vector<pair<unsigned, unsigned> > ranges;
+
+			bool parse(const string& word)
+			{
+				const size_t equalPos(word.find('='));
+				if (equalPos == string::npos || equalPos == 0)
+					return false;
+				negated = word[equalPos - 1] == '!';
+				const string name(word.substr(0, negated ? equalPos - 1 : equalPos));
+				if (name == "source")
+					field = SOURCE;
+				else if (name == "type")
+					field = TYPE;
+				else if (name == "event")
+					field = EVENT;
+				else
+					return false;
+
+				// comma-separated numbers or ranges, in decimal or hexadecimal
+				const char* p(word.c_str() + equalPos + 1);
+				while (true)
+				{
+					char* end;
+					const unsigned long first(strtoul(p, &end, 0));
+					if (end == p)
+						return false;
+					unsigned long last(first);
+					p = end;
+					if (*p == '-')
+					{
+						++p;
+						last = strtoul(p, &end, 0);
+						if (end == p)
+							return false;
+						p = end;
+					}
+					if (first > last || last > 0xffff)
+						return false;
+					ranges.push_back(make_pair(unsigned(first), unsigned(last)));
+					if (*p == 0)
+						return true;
+					if (*p != ',')
+						return false;
+					++p;
+				}
+			}
+
+			bool matches(uint16 source, uint16 type) const
+			{
+				// events are user messages, whose type is the event identifier
+				if (field == EVENT && type >= 0x8000)
+					return negated;
+				const unsigned value(field == SOURCE ? source : type);
+				bool inRanges(false);
+				for (size_t i = 0; !inRanges && i < ranges.size(); ++i)
+					inRanges = value >= ranges[i].first && value <= ranges[i].second;
+				return inRanges != negated;
+			}
+		};
+
+		vector<vector<Term> > alternatives;
+	};
+
+	//! Set first and last to the lowest and highest numbers of the segments named prefix-NNNNNN.log that exist, to 1 and 0 if there is none
+	static void existingSegments(const string& prefix, unsigned& first, unsigned& last)
+	{
+		first = 1;
+		last = 0;
+		const size_t separatorPos(prefix.find_last_of("/\\"));
+		const string directory(separatorPos == string::npos ? string(".") : prefix.substr(0, separatorPos + 1));
+		const string baseName((separatorPos == string::npos ? prefix : prefix.substr(separatorPos + 1)) + "-");
+		vector<string> fileNames;
+		#ifndef WIN32
+		DIR* dir(opendir(directory.c_str()));
+		if (!dir)
+			return;
+		while (const dirent* entry = readdir(dir))
+			fileNames.push_back(entry->d_name);
+		closedir(dir);
+		#else // WIN32
+		WIN32_FIND_DATAA findData;
+		const HANDLE find(FindFirstFileA(((separatorPos == string::npos ? string() : directory) + "*").c_str(), &findData));
+		if (find == INVALID_HANDLE_VALUE)
+			return;
+		do
+			fileNames.push_back(findData.cFileName);
+		while (FindNextFileA(find, &findData));
+		FindClose(find);
+		#endif // WIN32
+
+		unsigned lowest(~0u);
+		for (size_t i = 0; i < fileNames.size(); ++i)
+		{
+			const string& fileName(fileNames[i]);
+			if (fileName.size() <= baseName.size() + 4 || fileName.compare(0, baseName.size(), baseName) != 0 || fileName.compare(fileName.size() - 4, 4, ".log") != 0)
+				continue;
+			const string digits(fileName.substr(baseName.size(), fileName.size() - baseName.size() - 4));
+			if (digits.find_first_not_of("0123456789") != string::npos)
+				continue;
+			const unsigned number(strtoul(digits.c_str(), 0, 10));
+			lowest = min(lowest, number);
+			last = max(last, number);
+		}
+		if (last)
+			first = lowest;
+	}
+
+	//! The last messages, bounded in duration and in memory; a ring of capacity 0 keeps nothing
+	class CaptureRing
+	{
+	public:
+		CaptureRing(LogTime duration, size_t capacity) :
+			duration(duration),
+			data(capacity),
+			head(0),
+			used(0)
+		{}
+
+		//! Add a message as on the wire, dropping the oldest ones that are too old or do not fit
+		void push(LogTime time, const uint8* packet, size_t packetSize)
+		{
+			if (packetSize > data.size())
+				return;
+			while (!records.empty() && (used + packetSize > data.size() || records.front().first + duration < time))
+				pop();
+			size_t tail((head + used) % data.size());
+			const size_t firstPart(min(packetSize, data.size() - tail));
+			memcpy(&data[tail], packet, firstPart);
+			memcpy(&data[0], packet + firstPart, packetSize - firstPart);
+			used += packetSize;
+			records.push_back(make_pair(time, packetSize));
+		}
+
+		//! Write all messages to writer and empty the ring
+		void drain(LogWriter& writer)
+		{
+			vector<uint8> packet;
+			while (!records.empty())
+			{
+				const size_t packetSize(records.front().second);
+				packet.resize(packetSize);
+				const size_t firstPart(min(packetSize, data.size() - head));
+				memcpy(&packet[0], &data[head], firstPart);
+				memcpy(&packet[firstPart], &data[0], packetSize - firstPart);
+				LogRecord record;
+				record.time = records.front().first;
+				record.source = uint16(packet[2]) | (uint16(packet[3]) << 8);
+				record.type = uint16(packet[4]) | (uint16(packet[5]) << 8);
+				record.packet = &packet[0];
+				record.packetSize = packetSize;
+				writer.write(record);
+				pop();
+			}
+		}
+
+	protected:
+		void pop()
+		{
+			head = (head + records.front().second) % data.size();
+			used -= records.front().second;
+			records.pop_front();
+		}
+
+	protected:
+		const LogTime duration;
+		vector<uint8> data;
+		size_t head;
+		size_t used;
+		deque<pair<LogTime, size_t> > records; //!< time and size of the messages in data, oldest first
+	};
+
+	//! A long-running recorder of raw messages into rotating binary logs
+	class Capture : public Hub
+	{
+	public:
+		//! Settings of the capture
+		struct Settings
+		{
+			string prefix; //!< segments are named prefix-NNNNNN.log, numbered after the existing ones
+			uint64 segmentSize; //!< start a new segment after this many bytes, 0 for no limit
+			LogTime segmentDuration; //!< start a new segment after this many microseconds, 0 for no limit
+			unsigned segmentsCount; //!< keep only this many segments, deleting the oldest, 0 to keep all
+			CaptureFilter filter; //!< messages to capture
+			CaptureFilter trigger; //!< when not empty, only save the ring when one of these messages arrives
+			LogTime ringDuration; //!< duration of the ring when triggering
+			size_t ringCapacity; //!< memory of the ring when triggering, in bytes
+		};
+
+		Capture(const Settings& settings) :
+			settings(settings),
+			ring(settings.ringDuration, settings.trigger.empty() ? 0 : settings.ringCapacity),
+			segmentNumber(0),
+			oldestSegmentNumber(1),
+			segmentStart(0),
+			capturedCount(0),
+			filteredCount(0),
+			triggersCount(0)
+		{
+			// never overwrite the segments of previous runs, but rotate them as ours
+			existingSegments(settings.prefix, oldestSegmentNumber, segmentNumber);
+		}
+
+		~Capture()
+		{
+			if (!writer.close())
+				cerr << "Cannot write " << segmentName(segmentNumber) << endl;
+			cerr << "Captured " << capturedCount << " messages, filtered out " << filteredCount;
+			if (!settings.trigger.empty())
+				cerr << ", " << triggersCount << " triggers";
+			cerr << endl;
+		}
+
+		//! Start a new segment if the current one is too old, so that segments rotate when nothing happens
+		void rotateIfDue()
+		{
+			if (writer.isOpen() && settings.segmentDuration && currentLogTime() >= segmentStart + settings.segmentDuration)
+				nextSegment();
+		}
+
+	protected:
+		void connectionCreated(Stream *stream)
+		{
+			cerr << "Capturing " << stream->getTargetName() << endl;
+		}
+
+		void connectionClosed(Stream *stream, bool abnormal)
+		{
+			cerr << "Connection closed to " << stream->getTargetName();
+			if (abnormal)
+				cerr << ": " << stream->getFailReason();
+			cerr << endl;
+		}
+
+		void incomingData(Stream *stream)
+		{
+			// decide from the header, then read the payload into the packet or skip it
+			packet.resize(6);
+			stream->read(&packet[0], 6);
+			const uint16 length(uint16(packet[0]) | (uint16(packet[1]) << 8));
+			const uint16 source(uint16(packet[2]) | (uint16(packet[3]) << 8));
+			const uint16 type(uint16(packet[4]) | (uint16(packet[5]) << 8));
+			packet.resize(6 + length);
+			if (length)
+				stream->read(&packet[6], length);
+			const LogTime time(currentLogTime());
+
+			if (!settings.filter.matches(source, type))
+			{
+				++filteredCount;
+				return;
+			}
+			++capturedCount;
+
+			if (settings.trigger.empty())
+			{
+				if (!writer.isOpen() || (settings.segmentSize && writer.size() >= settings.segmentSize))
+					nextSegment();
+				else
+					rotateIfDue();
+				LogRecord record;
+				record.time = time;
+				record.source = source;
+				record.type = type;
+				record.packet = &packet[0];
+				record.packetSize = packet.size();
+				writer.write(record);
+				if (writer.hasFailed())
+					closeSegment();
+			}
+			else
+			{
+				ring.push(time, &packet[0], packet.size());
+				if (settings.trigger.matches(source, type))
+				{
+					// each trigger saves what led to it in its own segment
+					++triggersCount;
+					nextSegment();
+					ring.drain(writer);
+					closeSegment();
+					cerr << "Trigger by message " << type << " from " << source << ", saved to " << segmentName(segmentNumber) << endl;
+				}
+			}
+		}
+
+		string segmentName(unsigned number) const
+		{
+			ostringstream oss;
+			oss << settings.prefix << "-" << setfill('0') << setw(6) << number << ".log";
+			return oss.str();
+		}
+
+		//! Close the current segment, if any, and stop if it could not be written completely
+		void closeSegment()
+		{
+			if (!writer.close())
+				throw DashelException(DashelException::IOError, 0, ("Cannot write " + segmentName(segmentNumber)).c_str());
+		}
+
+		void nextSegment()
+		{
+			closeSegment();
+			++segmentNumber;
+			while (settings.segmentsCount && oldestSegmentNumber + settings.segmentsCount <= segmentNumber)
+				remove(segmentName(oldestSegmentNumber++).c_str());
+			const string fileName(segmentName(segmentNumber));
+			if (!writer.open(fileName))
+				throw DashelException(DashelException::IOError, 0, ("Cannot create " + fileName).c_str());
+			segmentStart = currentLogTime();
+		}
+
+	protected:
+		const Settings settings;
+		LogWriter writer;
+		CaptureRing ring;
+		vector<uint8> packet;
+		unsigned segmentNumber; //!< number of the current segment
+		unsigned oldestSegmentNumber; //!< number of the oldest segment that may exist
+		LogTime segmentStart;
+		uint64 capturedCount;
+		uint64 filteredCount;
+		unsigned triggersCount;
+	};
+
+	/*@}*/
+}
+
+
+//! Show usage
+void dumpHelp(std::ostream &stream, const char *programName)
+{
+	stream << "Aseba capture, record raw messages into rotating binary logs, usage:\n";
+	stream << programName << " [options] [targets]*\n";
+	stream << "Options:\n";
+	stream << "-o PREFIX          : name segments PREFIX-NNNNNN.log, after existing ones (default: aseba-capture)\n";
+	stream << "-C MEGABYTES       : start a new segment when the current one is larger\n";
+	stream << "-G SECONDS         : start a new segment when the current one is older\n";
+	stream << "-W COUNT           : keep only the last COUNT segments, including those of previous runs\n";
+	stream << "--filter EXPR      : only capture messages matching EXPR, can be repeated\n";
+	stream << "--trigger EXPR     : keep messages in memory and save them when one matches EXPR\n";
+	stream << "--ring SECONDS     : with --trigger, save the last SECONDS of messages (default: 60)\n";
+	stream << "--ring-size MEGABYTES : with --trigger, memory for these messages (default: 64)\n";
+	stream << "-h, --help         : shows this help\n";
+	stream << "-V, --version      : shows the version number\n";
+	stream << "Expressions are terms separated by spaces, which must all match, such as\n";
+	stream << "\"source=2-4 type!=0x8000-0x80ff\"; fields are source, type and event, the latter\n";
+	stream << "only matching user messages; values are numbers or ranges separated by commas.\n";
+	stream << "Targets are any valid Dashel targets." << std::endl;
+	stream << "Report bugs to: aseba-dev@gna.org" << std::endl;
+}
+
+//! Show version
+void dumpVersion(std::ostream &stream)
+{
+	stream << "Aseba capture " << ASEBA_VERSION << std::endl;
+	stream << "Aseba protocol " << ASEBA_PROTOCOL_VERSION << std::endl;
+	stream << "Licence LGPLv3: GNU LGPL version 3 <http://www.gnu.org/licenses/lgpl.html>\n";
+}
+
+int main(int argc, char *argv[])
+{
+	Dashel::initPlugins();
+	Aseba::Capture::Settings settings;
+	settings.prefix = "aseba-capture";
+	settings.segmentSize = 0;
+	settings.segmentDuration = 0;
+	settings.segmentsCount = 0;
+	settings.ringDuration = 60 * 1000000ULL;
+	settings.ringCapacity = 64 << 20;
+	std::vector<std::string> targets;
+
+	int argCounter = 1;
+
+	while (argCounter < argc)
+	{
+		const char *arg = argv[argCounter];
+
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			dumpHelp(std::cout, argv[0]);
+			return 0;
+		}
+		else if ((strcmp(arg, "-V") == 0) || (strcmp(arg, "--version") == 0))
+		{
+			dumpVersion(std::cout);
+			return 0;
+		}
+		else if (arg[0] == '-' && strlen(arg) > 1)
+		{
+			// all other options take a value
+			argCounter++;
+			if (argCounter >= argc)
+			{
+				dumpHelp(std::cout, argv[0]);
+				return 1;
+			}
+			const char *value = argv[argCounter];
+			bool valid = true;
+			if (strcmp(arg, "-o") == 0)
+				settings.prefix = value;
+			else if (strcmp(arg, "-C") == 0)
+				valid = (settings.segmentSize = uint64(atof(value) * (1 << 20))) > 0;
+			else if (strcmp(arg, "-G") == 0)
+				valid = (settings.segmentDuration = Aseba::LogTime(atof(value) * 1000000)) > 0;
+			else if (strcmp(arg, "-W") == 0)
+				valid = (settings.segmentsCount = atoi(value)) > 0;
+			else if (strcmp(arg, "--filter") == 0)
+				valid = settings.filter.add(value);
+			else if (strcmp(arg, "--trigger") == 0)
+				valid = settings.trigger.add(value);
+			else if (strcmp(arg, "--ring") == 0)
+				valid = (settings.ringDuration = Aseba::LogTime(atof(value) * 1000000)) > 0;
+			else if (strcmp(arg, "--ring-size") == 0)
+				valid = (settings.ringCapacity = size_t(atof(value) * (1 << 20))) > 0;
+			else
+				valid = false;
+			if (!valid)
+			{
+				std::cerr << "Invalid option " << arg << " " << value << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			targets.push_back(argv[argCounter]);
+		}
+		argCounter++;
+	}
+
+	if (targets.empty())
+		targets.push_back(ASEBA_DEFAULT_TARGET);
+
+	try
+	{
+		Aseba::Capture capture(settings);
+		for (size_t i = 0; i < targets.size(); i++)
+			capture.connect(targets[i]);
+		while (capture.step(100))
+			capture.rotateIfDue();
+	}
+	catch(Dashel::DashelException e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../../common/consts.h"
+#include "log.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+//! Show usage
+void dumpHelp(std::ostream &stream, const char *programName)
+{
+	stream << "Aseba rec convert, convert recordings between the text and the binary log formats, usage:\n";
+	stream << programName << " [options] INPUT_FILE OUTPUT_FILE\n";
+	stream << "A binary log is converted to text, and text to a binary log.\n";
+	stream << "Only user messages can be written as text, the others are skipped.\n";
+	stream << "Options:\n";
+	stream << "-h, --help      : shows this help\n";
+	stream << "-V, --version   : shows the version number\n";
+	stream << "Report bugs to: aseba-dev@gna.org" << std::endl;
+}
+
+//! Show version
+void dumpVersion(std::ostream &stream)
+{
+	stream << "Aseba rec convert " << ASEBA_VERSION << std::endl;
+	stream << "Aseba protocol " << ASEBA_PROTOCOL_VERSION << std::endl;
+	stream << "Licence LGPLv3: GNU LGPL version 3 <http://www.gnu.org/licenses/lgpl.html>\n";
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> files;
+
+	int argCounter = 1;
+
+	while (argCounter < argc)
+	{
+		const char *arg = argv[argCounter];
+
+		if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
+		{
+			dumpHelp(std::cout, argv[0]);
+			return 0;
+		}
+		else if ((strcmp(arg, "-V") == 0) || (strcmp(arg, "--version") == 0))
+		{
+			dumpVersion(std::cout);
+			return 0;
+		}
+		else
+		{
+			files.push_back(argv[argCounter]);
+		}
+		argCounter++;
+	}
+
+	if (files.size() != 2)
+	{
+		dumpHelp(std::cerr, argv[0]);
+		return 1;
+	}
+
+	Aseba::LogReader log;
+	Aseba::LogRecord record;
+	if (Aseba::LogReader::isBinaryLog(files[0]))
+	{
+		if (!log.open(files[0]))
+		{
+			std::cerr << "Cannot read binary log " << files[0] << std::endl;
+			return 1;
+		}
+		std::ofstream output(files[1].c_str());
+		if (!output.good())
+		{
+			std::cerr << "Cannot create " << files[1] << std::endl;
+			return 1;
+		}
+		size_t skippedCount(0);
+		for (size_t pos(log.begin()); log.read(pos, record);)
+			if (!Aseba::writeTextRecord(output, record))
+				++skippedCount;
+		if (skippedCount)
+			std::cerr << "Skipped " << skippedCount << " messages that are not user messages" << std::endl;
+	}
+	else
+	{
+		std::ifstream input(files[0].c_str());
+		if (!input.good())
+		{
+			std::cerr << "Cannot open " << files[0] << std::endl;
+			return 1;
+		}
+		const unsigned malformedCount(log.loadText(input));
+		if (malformedCount)
+			std::cerr << "Skipped " << malformedCount << " malformed lines" << std::endl;
+		Aseba::LogWriter writer;
+		if (!writer.open(files[1]))
+		{
+			std::cerr << "Cannot create " << files[1] << std::endl;
+			return 1;
+		}
+		for (size_t pos(log.begin()); log.read(pos, record);)
+			writer.write(record);
+		if (!writer.close())
+		{
+			std::cerr << "Cannot write " << files[1] << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
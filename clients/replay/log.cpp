@@ -0,0 +1,534 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "log.h"
+#include "../../common/consts.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#ifndef WIN32
+	#include <sys/time.h>
+	#include <sys/types.h>
+	#include <sys/stat.h>
+	#include <sys/mman.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <time.h>
+#else // WIN32
+	#include <windows.h>
+#endif // WIN32
+
+namespace Aseba
+{
+	using namespace std;
+
+	/** \addtogroup rec */
+	/*@{*/
+
+	static const char logMagic[8] = { 'A', 'S', 'E', 'B', 'A', 'L', 'O', 'G' };
+	static const char indexMagic[8] = { 'A', 'S', 'E', 'B', 'A', 'I', 'D', 'X' };
+	static const uint16 logFormatVersion = 1;
+	static const size_t headerSize = 16;
+	static const size_t recordHeaderSize = 8 + 6;
+	//! index offset, index entries count, records count, time of the last record, magic
+	static const size_t footerSize = 5 * 8;
+
+	static inline uint16 readUint16(const uint8* p)
+	{
+		return uint16(p[0]) | (uint16(p[1]) << 8);
+	}
+
+	static inline uint64 readUint64(const uint8* p)
+	{
+		uint64 v(0);
+		for (int i = 7; i >= 0; --i)
+			v = (v << 8) | p[i];
+		return v;
+	}
+
+	static inline void putUint16(uint8* p, uint16 v)
+	{
+		p[0] = uint8(v);
+		p[1] = uint8(v >> 8);
+	}
+
+	static inline void putUint64(uint8* p, uint64 v)
+	{
+		for (int i = 0; i < 8; ++i)
+			p[i] = uint8(v >> (8 * i));
+	}
+
+	LogTime currentLogTime()
+	{
+		#ifndef WIN32
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return LogTime(tv.tv_sec) * 1000000 + LogTime(tv.tv_usec);
+		#else // WIN32
+		FILETIME ft;
+		LARGE_INTEGER li;
+		GetSystemTimeAsFileTime(&ft);
+		li.LowPart = ft.dwLowDateTime;
+		li.HighPart = ft.dwHighDateTime;
+		// in 100-nanosecond intervals since 1601
+		return (LogTime(li.QuadPart) - 116444736000000000ULL) / 10;
+		#endif // WIN32
+	}
+
+	void sleepLogTime(LogTime duration)
+	{
+		#ifndef WIN32
+		struct timespec ts;
+		ts.tv_sec = duration / 1000000;
+		ts.tv_nsec = (duration % 1000000) * 1000;
+		nanosleep(&ts, 0);
+		#else // WIN32
+		Sleep(DWORD(duration / 1000));
+		#endif // WIN32
+	}
+
+	void appendLogRecord(std::vector<uint8>& buffer, LogTime time, uint16 source, uint16 type, const uint8* payload, uint16 payloadSize)
+	{
+		const size_t pos(buffer.size());
+		buffer.resize(pos + recordHeaderSize + payloadSize);
+		uint8* p(&buffer[pos]);
+		putUint64(p, time);
+		putUint16(p + 8, payloadSize);
+		putUint16(p + 10, source);
+		putUint16(p + 12, type);
+		if (payloadSize)
+			memcpy(p + recordHeaderSize, payload, payloadSize);
+	}
+
+	bool writeTextRecord(std::ostream& stream, const LogRecord& record)
+	{
+		if (!record.isUserMessage())
+			return false;
+		// same layout as dumpTime() followed by the fields of the user message
+		const LogTime ms(record.time / 1000);
+		const unsigned count(record.payloadSize() / 2);
+		stream << ms / 1000 << "." << setfill('0') << setw(3) << ms % 1000 << " ";
+		stream << record.source << " " << record.type << " " << count << " ";
+		const uint8* payload(record.payload());
+		for (unsigned i = 0; i < count; ++i)
+			stream << sint16(readUint16(payload + 2 * i)) << " ";
+		stream << "\n";
+		return true;
+	}
+
+	bool parseTextRecord(const char* line, LogTime& time, uint16& source, uint16& type, std::vector<uint8>& payload)
+	{
+		char* end;
+		// as written by UnifiedTime::toRawTimeString()
+		const LogTime seconds(strtoull(line, &end, 10));
+		if (end == line || *end != '.')
+			return false;
+		line = end + 1;
+		const LogTime milliseconds(strtoull(line, &end, 10));
+		if (end == line)
+			return false;
+		time = (seconds * 1000 + milliseconds) * 1000;
+
+		long fields[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			line = end;
+			fields[i] = strtol(line, &end, 10);
+			if (end == line)
+				return false;
+		}
+		source = uint16(fields[0]);
+		type = uint16(fields[1]);
+
+		// like the legacy player, trust the values rather than their count
+		payload.clear();
+		payload.reserve(size_t(max(fields[2], 0L)) * 2);
+		while (true)
+		{
+			line = end;
+			const long value(strtol(line, &end, 10));
+			if (end == line)
+				break;
+			payload.push_back(uint8(value));
+			payload.push_back(uint8(value >> 8));
+		}
+		return payload.size() <= ASEBA_MAX_EVENT_ARG_SIZE;
+	}
+
+	const LogTime LogWriter::indexInterval;
+
+	LogWriter::LogWriter() :
+		file(0),
+		ownsFile(false),
+		failed(false),
+		offset(0),
+		recordsCount(0),
+		lastTime(0),
+		nextIndexTime(0)
+	{
+	}
+
+	LogWriter::~LogWriter()
+	{
+		close();
+	}
+
+	bool LogWriter::open(const std::string& fileName)
+	{
+		close();
+		FILE* f(fopen(fileName.c_str(), "wb"));
+		if (!f)
+			return false;
+		// large buffer, we flush at every index entry anyway
+		setvbuf(f, 0, _IOFBF, 1 << 16);
+		file = f;
+		ownsFile = true;
+		failed = false;
+		writeHeader();
+		return true;
+	}
+
+	bool LogWriter::open(FILE* file)
+	{
+		close();
+		if (!file)
+			return false;
+		this->file = file;
+		ownsFile = false;
+		failed = false;
+		writeHeader();
+		return true;
+	}
+
+	bool LogWriter::close()
+	{
+		if (!file)
+			return !failed;
+
+		// index, then footer
+		const uint64 indexOffset(offset);
+		uint8 entry[16];
+		for (size_t i = 0; i < index.size(); ++i)
+		{
+			putUint64(entry, index[i].first);
+			putUint64(entry + 8, index[i].second);
+			writeBytes(entry, sizeof(entry));
+		}
+		uint8 footer[footerSize];
+		putUint64(footer, indexOffset);
+		putUint64(footer + 8, index.size());
+		putUint64(footer + 16, recordsCount);
+		putUint64(footer + 24, lastTime);
+		memcpy(footer + 32, indexMagic, 8);
+		writeBytes(footer, sizeof(footer));
+
+		if (ownsFile)
+			failed = (fclose(file) != 0) || failed;
+		else
+			failed = (fflush(file) != 0) || failed;
+		file = 0;
+		index.clear();
+		return !failed;
+	}
+
+	void LogWriter::writeHeader()
+	{
+		uint8 header[headerSize];
+		memset(header, 0, sizeof(header));
+		memcpy(header, logMagic, 8);
+		putUint16(header + 8, logFormatVersion);
+		putUint16(header + 10, ASEBA_PROTOCOL_VERSION);
+		offset = 0;
+		nextIndexTime = 0;
+		recordsCount = 0;
+		lastTime = 0;
+		index.clear();
+		writeBytes(header, sizeof(header));
+	}
+
+	void LogWriter::writeBytes(const void* data, size_t size)
+	{
+		if (!failed && fwrite(data, 1, size, file) != size)
+			failed = true;
+		offset += size;
+	}
+
+	void LogWriter::write(LogTime time, uint16 source, uint16 type, const uint8* payload, uint16 payloadSize)
+	{
+		if (!file || failed)
+			return;
+		if (time >= nextIndexTime)
+		{
+			// make the records before this entry visible to readers of an unfinished log
+			if (!index.empty())
+				fflush(file);
+			index.push_back(make_pair(time, offset));
+			nextIndexTime = time + indexInterval;
+		}
+		recordBuffer.clear();
+		appendLogRecord(recordBuffer, time, source, type, payload, payloadSize);
+		writeBytes(&recordBuffer[0], recordBuffer.size());
+		++recordsCount;
+		lastTime = time;
+	}
+
+	void LogWriter::write(const LogRecord& record)
+	{
+		write(record.time, record.source, record.type, record.payload(), record.payloadSize());
+	}
+
+	void LogWriter::flush()
+	{
+		if (file)
+			fflush(file);
+	}
+
+	LogReader::LogReader() :
+		data(0),
+		size(0),
+		mapping(0),
+		recordsBegin(0),
+		recordsEnd(0),
+		count(0),
+		lastTime(0)
+	{
+	}
+
+	LogReader::~LogReader()
+	{
+		close();
+	}
+
+	bool LogReader::isBinaryLog(const std::string& fileName)
+	{
+		FILE* f(fopen(fileName.c_str(), "rb"));
+		if (!f)
+			return false;
+		char magic[8];
+		const bool isLog(fread(magic, 1, 8, f) == 8 && memcmp(magic, logMagic, 8) == 0);
+		fclose(f);
+		return isLog;
+	}
+
+	bool LogReader::open(const std::string& fileName)
+	{
+		close();
+
+		#ifndef WIN32
+		const int fd(::open(fileName.c_str(), O_RDONLY));
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size < off_t(headerSize))
+		{
+			::close(fd);
+			return false;
+		}
+		void* p(mmap(0, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0));
+		::close(fd);
+		if (p == MAP_FAILED)
+			return false;
+		// records are read in order, except when seeking
+		madvise(p, size_t(st.st_size), MADV_SEQUENTIAL);
+		mapping = p;
+		data = reinterpret_cast<const uint8*>(p);
+		size = size_t(st.st_size);
+		#else // WIN32
+		FILE* f(fopen(fileName.c_str(), "rb"));
+		if (!f)
+			return false;
+		uint8 chunk[1 << 16];
+		size_t amount;
+		while ((amount = fread(chunk, 1, sizeof(chunk), f)) > 0)
+			buffer.insert(buffer.end(), chunk, chunk + amount);
+		fclose(f);
+		if (buffer.empty())
+			return false;
+		data = &buffer[0];
+		size = buffer.size();
+		#endif // WIN32
+
+		if (!parse())
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	unsigned LogReader::loadText(std::istream& stream)
+	{
+		close();
+
+		unsigned malformedCount(0);
+		string line;
+		vector<uint8> payload;
+		while (getline(stream, line))
+		{
+			LogTime time;
+			uint16 source, type;
+			if (line.empty())
+				continue;
+			if (parseTextRecord(line.c_str(), time, source, type, payload))
+				appendLogRecord(buffer, time, source, type, payload.empty() ? 0 : &payload[0], uint16(payload.size()));
+			else
+				++malformedCount;
+		}
+
+		data = buffer.empty() ? 0 : &buffer[0];
+		size = buffer.size();
+		recordsBegin = 0;
+		scanRecords();
+		return malformedCount;
+	}
+
+	void LogReader::close()
+	{
+		#ifndef WIN32
+		if (mapping)
+			munmap(mapping, size);
+		#endif // WIN32
+		mapping = 0;
+		buffer.clear();
+		data = 0;
+		size = 0;
+		recordsBegin = recordsEnd = 0;
+		count = 0;
+		lastTime = 0;
+		index.clear();
+	}
+
+	bool LogReader::parse()
+	{
+		if (size < headerSize || memcmp(data, logMagic, 8) != 0)
+			return false;
+		if (readUint16(data + 8) != logFormatVersion)
+			return false;
+		recordsBegin = headerSize;
+		if (!readIndex())
+			scanRecords();
+		return true;
+	}
+
+	bool LogReader::readIndex()
+	{
+		if (size < headerSize + footerSize)
+			return false;
+		const uint8* footer(data + size - footerSize);
+		if (memcmp(footer + 32, indexMagic, 8) != 0)
+			return false;
+		const uint64 indexOffset(readUint64(footer));
+		const uint64 entriesCount(readUint64(footer + 8));
+		if (indexOffset < headerSize || indexOffset > size - footerSize || entriesCount != (size - footerSize - indexOffset) / 16)
+			return false;
+
+		index.reserve(size_t(entriesCount));
+		for (size_t i = 0; i < entriesCount; ++i)
+		{
+			const uint8* entry(data + indexOffset + i * 16);
+			const uint64 offset(readUint64(entry + 8));
+			if (offset < headerSize || offset >= indexOffset)
+			{
+				index.clear();
+				return false;
+			}
+			index.push_back(make_pair(readUint64(entry), size_t(offset)));
+		}
+		recordsEnd = size_t(indexOffset);
+		count = size_t(readUint64(footer + 16));
+		lastTime = readUint64(footer + 24);
+		return true;
+	}
+
+	void LogReader::scanRecords()
+	{
+		// the log might have been cut in the middle of a record, stop before it
+		index.clear();
+		count = 0;
+		lastTime = 0;
+		LogTime nextIndexTime(0);
+		size_t offset(recordsBegin);
+		while (offset + recordHeaderSize <= size)
+		{
+			const size_t recordSize(recordHeaderSize + readUint16(data + offset + 8));
+			if (offset + recordSize > size)
+				break;
+			const LogTime time(readUint64(data + offset));
+			if (time >= nextIndexTime)
+			{
+				index.push_back(make_pair(time, offset));
+				nextIndexTime = time + LogWriter::indexInterval;
+			}
+			lastTime = time;
+			++count;
+			offset += recordSize;
+		}
+		recordsEnd = offset;
+	}
+
+	bool LogReader::read(size_t& offset, LogRecord& record) const
+	{
+		if (offset + recordHeaderSize > recordsEnd)
+			return false;
+		const uint8* p(data + offset);
+		// a corrupt length in an indexed log must not make us read past the records
+		const size_t packetSize(6 + readUint16(p + 8));
+		if (offset + 8 + packetSize > recordsEnd)
+			return false;
+		record.time = readUint64(p);
+		record.packet = p + 8;
+		record.packetSize = packetSize;
+		record.source = readUint16(p + 10);
+		record.type = readUint16(p + 12);
+		offset += 8 + record.packetSize;
+		return true;
+	}
+
+	size_t LogReader::seek(LogTime time) const
+	{
+		// start from the last index entry before time, then look at the records
+		size_t offset(recordsBegin);
+		vector<pair<LogTime, size_t> >::const_iterator it(upper_bound(index.begin(), index.end(), make_pair(time, size_t(-1))));
+		if (it != index.begin())
+			offset = (it - 1)->second;
+		LogRecord record;
+		size_t next(offset);
+		while (read(next, record))
+		{
+			if (record.time >= time)
+				return offset;
+			offset = next;
+		}
+		return recordsEnd;
+	}
+
+	LogTime LogReader::startTime() const
+	{
+		size_t offset(recordsBegin);
+		LogRecord record;
+		if (read(offset, record))
+			return record.time;
+		return 0;
+	}
+
+	/*@}*/
+}
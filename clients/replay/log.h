@@ -0,0 +1,182 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_REPLAY_LOG_H
+#define ASEBA_REPLAY_LOG_H
+
+#include "../../common/types.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <istream>
+
+namespace Aseba
+{
+	/**
+	\addtogroup rec
+
+	Binary log of Aseba messages, all numbers are little-endian:
+	- header: "ASEBALOG", format version (16 bits), protocol version (16 bits), 4 reserved bytes
+	- records: time in microseconds since the epoch (64 bits), then the message as on the wire:
+	  payload length, source, type (16 bits each) and payload
+	- optionally, an index of (time, offset) pairs (64 bits each) to seek without reading the records,
+	  followed by its offset, its number of entries, the number of records and the time of the last record
+	  (64 bits each) and "ASEBAIDX"
+
+	The index is written when the log is closed; if it is missing, for instance because
+	the recorder was killed, the reader rebuilds it by scanning the records.
+	*/
+	/*@{*/
+
+	//! Time in a log, in microseconds since the epoch
+	typedef uint64 LogTime;
+
+	//! Return the current time in microseconds since the epoch
+	LogTime currentLogTime();
+	//! Sleep for a duration in microseconds
+	void sleepLogTime(LogTime duration);
+
+	//! A record of a log, pointing into the memory of its reader
+	struct LogRecord
+	{
+		LogTime time; //!< time of reception of the message
+		uint16 source; //!< source of the message
+		uint16 type; //!< type of the message
+		const uint8* packet; //!< message as sent on the wire: payload length, source, type and payload
+		size_t packetSize; //!< size of packet, 6 bytes plus the payload
+
+		//! Return a pointer to the payload of the message
+		const uint8* payload() const { return packet + 6; }
+		//! Return the size of the payload of the message, in bytes
+		uint16 payloadSize() const { return uint16(packetSize - 6); }
+		//! Return whether this is a user message, the only kind in the legacy text format; the others are system messages
+		bool isUserMessage() const { return type < 0x8000; }
+	};
+
+	//! Append a record to a buffer, the payload must be in network order
+	void appendLogRecord(std::vector<uint8>& buffer, LogTime time, uint16 source, uint16 type, const uint8* payload, uint16 payloadSize);
+
+	//! Write a record as a line of the legacy text format, return false if it is not a user message and was not written
+	bool writeTextRecord(std::ostream& stream, const LogRecord& record);
+	//! Parse a line of the legacy text format, return false if it is malformed
+	bool parseTextRecord(const char* line, LogTime& time, uint16& source, uint16& type, std::vector<uint8>& payload);
+
+	//! Writes a binary log to a file, through the buffering of the C library
+	class LogWriter
+	{
+	public:
+		//! Interval between index entries, in microseconds
+		static const LogTime indexInterval = 1000000;
+
+		LogWriter();
+		~LogWriter();
+
+		//! Create a log in fileName, return false if the file cannot be created
+		bool open(const std::string& fileName);
+		//! Write the log to an already open file, which will not be closed, such as stdout
+		bool open(FILE* file);
+		//! Write the index and close the log, return false if some of it could not be written
+		bool close();
+
+		//! Add a message received at time, payload is in network order
+		void write(LogTime time, uint16 source, uint16 type, const uint8* payload, uint16 payloadSize);
+		//! Add a record, for instance from another log
+		void write(const LogRecord& record);
+
+		//! Push buffered records to the operating system
+		void flush();
+
+		//! Return whether a log is open
+		bool isOpen() const { return file != 0; }
+		//! Return whether writing to the log failed, for instance because the disk is full; later records are then dropped
+		bool hasFailed() const { return failed; }
+		//! Number of bytes written to the log so far
+		uint64 size() const { return offset; }
+
+	protected:
+		void writeHeader();
+		void writeBytes(const void* data, size_t size);
+
+	protected:
+		FILE* file;
+		bool ownsFile;
+		bool failed;
+		uint64 offset;
+		uint64 recordsCount;
+		LogTime lastTime;
+		LogTime nextIndexTime;
+		std::vector<std::pair<LogTime, uint64> > index;
+		std::vector<uint8> recordBuffer;
+	};
+
+	//! Reads a binary log, mapped in memory when possible
+	class LogReader
+	{
+	public:
+		LogReader();
+		~LogReader();
+
+		//! Open the binary log in fileName, return false if the file cannot be read or is not a binary log
+		bool open(const std::string& fileName);
+		//! Load a log in the legacy text format, return the number of malformed lines that were skipped
+		unsigned loadText(std::istream& stream);
+		//! Release the log
+		void close();
+
+		//! Return whether fileName starts like a binary log
+		static bool isBinaryLog(const std::string& fileName);
+
+		//! Offset of the first record
+		size_t begin() const { return recordsBegin; }
+		//! Offset past the last complete record
+		size_t end() const { return recordsEnd; }
+		//! Read the record at offset and move offset to the next one, return false at the end of the log
+		bool read(size_t& offset, LogRecord& record) const;
+		//! Return the offset of the first record at or after time
+		size_t seek(LogTime time) const;
+
+		//! Time of the first record, 0 if the log is empty
+		LogTime startTime() const;
+		//! Time of the last record, 0 if the log is empty
+		LogTime endTime() const { return lastTime; }
+		//! Number of records
+		size_t recordsCount() const { return count; }
+
+	protected:
+		bool parse();
+		bool readIndex();
+		void scanRecords();
+
+	protected:
+		const uint8* data;
+		size_t size;
+		void* mapping;
+		std::vector<uint8> buffer;
+		size_t recordsBegin;
+		size_t recordsEnd;
+		size_t count;
+		LogTime lastTime;
+		std::vector<std::pair<LogTime, size_t> > index;
+	};
+
+	/*@}*/
+}
+
+#endif // ASEBA_REPLAY_LOG_H
@@ -23,11 +23,13 @@
 #include "../../common/msg/msg.h"
 #include "../../common/utils/utils.h"
 #include "../../transport/dashel_plugins/dashel-plugins.h"
+#include "log.h"
 #include <time.h>
 #include <iostream>
+#include <fstream>
 #include <cstring>
+#include <cstdlib>
 #include <string>
-#include <deque>
 
 namespace Aseba
 {
@@ -40,110 +42,154 @@ namespace Aseba
 	/*@{*/
 	
 	//! A message player
-	//! This class replay saved user messages
+	//! This class replays saved messages, either live from a text stream or from a log in memory.
+	//! Unless asked for all messages, it only replays user messages, so that a log does not reprogram, reset or flash the nodes.
 	class Player : public Hub
 	{
 	private:
-		typedef deque<string> StringList;
-		
 		bool respectTimings;
-		int speedFactor;
+		bool allMessages;
+		double speedFactor;
 		Stream* in;
 		string line;
-		UnifiedTime lastTimeStamp;
-		UnifiedTime lastEventTime;
+		LogTime lastTimeStamp;
+		LogTime lastEventTime;
+		vector<uint8> packet;
+		vector<uint8> payload;
 	
 	public:
-		Player(const char* inputFile, bool respectTimings, int speedFactor) :
+		Player(bool respectTimings, bool allMessages, double speedFactor) :
 			respectTimings(respectTimings),
+			allMessages(allMessages),
 			speedFactor(speedFactor),
-			lastTimeStamp(0)
+			in(0),
+			lastTimeStamp(0),
+			lastEventTime(0)
 		{
-			if (inputFile)
-				in = connect("file:" + string(inputFile) + ";mode=read");
-			else
-				in = connect("stdin:");
 		}
 		
-		StringList tokenize(const string& input)
+		//! Replay lines of text from stdin as they arrive, for instance from asebarec
+		void playLive()
 		{
-			StringList list;
-			const size_t inputSize(input.size());
-			
-			size_t pos(0);
-			while ((pos != string::npos) && (pos < inputSize))
+			in = connect("stdin:");
+			run();
+		}
+		
+		//! Replay log from offset microseconds after its start, possibly again and again
+		void play(const LogReader& log, LogTime offset, bool loop)
+		{
+			const size_t begin(log.seek(log.startTime() + offset));
+			unsigned sentCount;
+			do
 			{
-				const size_t next = input.find(' ', pos);
-				string word;
-				if (next != string::npos)
-					word = input.substr(pos, next-pos);
-				else
-					word = input.substr(pos);
-				if (!word.empty())
-					list.push_back(word);
-				pos = next + 1;
+				LogRecord record;
+				bool first(true);
+				LogTime logStart(0);
+				LogTime wallStart(0);
+				unsigned unflushedCount(0);
+				sentCount = 0;
+				for (size_t pos(begin); log.read(pos, record);)
+				{
+					if (!allMessages && !record.isUserMessage())
+						continue;
+					++sentCount;
+					
+					if (respectTimings)
+					{
+						// follow the clock of the log from the first record, to not accumulate delays
+						if (first)
+						{
+							logStart = record.time;
+							wallStart = currentLogTime();
+							first = false;
+						}
+						else if (record.time > logStart)
+						{
+							const LogTime dueTime(wallStart + LogTime(double(record.time - logStart) / speedFactor));
+							const LogTime now(currentLogTime());
+							if (dueTime > now)
+							{
+								flushStreams();
+								unflushedCount = 0;
+								sleepLogTime(dueTime - now);
+								if (!step(0))
+									return;
+							}
+						}
+					}
+					
+					sendPacket(record.packet, record.packetSize);
+					
+					// let the streams breathe and notice interruptions when replaying fast
+					if (++unflushedCount == 1024)
+					{
+						flushStreams();
+						unflushedCount = 0;
+						if (!step(0))
+							return;
+					}
+				}
+				flushStreams();
+			}
+			// a log with nothing to replay is not looped over forever
+			while (loop && sentCount && step(0));
+		}
+		
+	protected:
+		
+		//! Write a message as it was on the wire on all connected streams
+		void sendPacket(const uint8* data, size_t size)
+		{
+			for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
+			{
+				Stream* destStream(*it);
+				if (destStream != in)
+					destStream->write(data, size);
+			}
+		}
+		
+		void flushStreams()
+		{
+			for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
+			{
+				Stream* destStream(*it);
+				if (destStream != in)
+					destStream->flush();
 			}
-			
-			return list;
 		}
 		
 		void sendLine()
 		{
-			// parse line and build user message
-			UserMessage userMessage;
-			
-			StringList tokenizedLine(tokenize(line));
-			
-			UnifiedTime timeStamp(UnifiedTime::fromRawTimeString(tokenizedLine.front()));
-			tokenizedLine.pop_front();
-			
-			userMessage.source = atoi(tokenizedLine.front().c_str());
-			tokenizedLine.pop_front();
-			
-			userMessage.type = atoi(tokenizedLine.front().c_str());
-			tokenizedLine.pop_front();
-			
-			userMessage.data.reserve(size_t(atoi(tokenizedLine.front().c_str())));
-			tokenizedLine.pop_front();
-			
-			while (!tokenizedLine.empty())
+			LogTime timeStamp;
+			uint16 source, type;
+			if (!parseTextRecord(line.c_str(), timeStamp, source, type, payload))
 			{
-				userMessage.data.push_back(atoi(tokenizedLine.front().c_str()));
-				tokenizedLine.pop_front();
+				line.clear();
+				return;
 			}
+			line.clear();
+			if (!allMessages && type >= 0x8000)
+				return;
 			
 			// if required, sleep
-			if ((respectTimings) && (lastTimeStamp.value != 0))
+			if ((respectTimings) && (lastTimeStamp != 0) && (timeStamp > lastTimeStamp))
 			{
-				const UnifiedTime lostTime(UnifiedTime() - lastEventTime);
-				const UnifiedTime deltaTimeStamp(timeStamp - lastTimeStamp);
+				const LogTime lostTime(currentLogTime() - lastEventTime);
+				const LogTime deltaTimeStamp(LogTime(double(timeStamp - lastTimeStamp) / speedFactor));
 				if (lostTime < deltaTimeStamp)
-				{
-					UnifiedTime waitTime(deltaTimeStamp - lostTime);
-					waitTime /= speedFactor;
-					waitTime.sleep();
-				}
+					sleepLogTime(deltaTimeStamp - lostTime);
 			}
 			
-			// write message on all connected streams
-			for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
-			{
-				Stream* destStream(*it);
-				if (destStream != in)
-				{
-					userMessage.serialize(destStream);
-					destStream->flush();
-				}
-			}
+			// build the message as on the wire
+			packet.clear();
+			appendLogRecord(packet, timeStamp, source, type, payload.empty() ? 0 : &payload[0], uint16(payload.size()));
+			sendPacket(&packet[8], packet.size() - 8);
+			flushStreams();
 			
-			lastEventTime = UnifiedTime();
+			lastEventTime = currentLogTime();
 			lastTimeStamp = timeStamp;
-			
-			line.clear();
 		}
 		
-	protected:
-		
 		void connectionCreated(Stream *stream)
 		{
 			//cerr << "got connection " << stream->getTargetName()  << endl;
@@ -175,13 +221,18 @@ namespace Aseba
 //! Show usage
 void dumpHelp(std::ostream &stream, const char *programName)
 {
-	stream << "Aseba play, play recorded user messages from a file or stdin, usage:\n";
+	stream << "Aseba play, play recorded messages from a file or stdin, usage:\n";
 	stream << programName << " [options] [targets]*\n";
 	stream << "Options:\n";
 	stream << "--fast          : replay messages twice the speed of real time\n";
 	stream << "--faster        : replay messages four times the speed of real time\n";
 	stream << "--fastest       : replay messages as fast as possible\n";
-	stream << "-f INPUT_FILE   : open INPUT_FILE instead of stdin\n";
+	stream << "--speed FACTOR  : replay messages FACTOR times the speed of real time\n";
+	stream << "--seek SECONDS  : start SECONDS after the beginning of the recording\n";
+	stream << "--loop          : replay the recording again and again\n";
+	stream << "--all-messages  : replay all recorded messages, not only user messages;\n";
+	stream << "                  beware that this reprograms, resets and even flashes the nodes as recorded\n";
+	stream << "-f INPUT_FILE   : open INPUT_FILE instead of stdin, in text or binary log format\n";
 	stream << "-h, --help      : shows this help\n";
 	stream << "-V, --version   : shows the version number\n";
 	stream << "Targets are any valid Dashel targets." << std::endl;
@@ -200,7 +251,10 @@ int main(int argc, char *argv[])
 {
 	Dashel::initPlugins();
 	bool respectTimings = true;
-	int speedFactor = 1;
+	double speedFactor = 1;
+	double seekSeconds = 0;
+	bool loop = false;
+	bool allMessages = false;
 	std::vector<std::string> targets;
 	const char* inputFile = 0;
 	
@@ -222,6 +276,36 @@ int main(int argc, char *argv[])
 		{
 			speedFactor = 4;
 		}
+		else if (strcmp(arg, "--speed") == 0)
+		{
+			argCounter++;
+			if (argCounter >= argc || atof(argv[argCounter]) <= 0)
+			{
+				dumpHelp(std::cout, argv[0]);
+				return 1;
+			}
+			else
+				speedFactor = atof(argv[argCounter]);
+		}
+		else if (strcmp(arg, "--seek") == 0)
+		{
+			argCounter++;
+			if (argCounter >= argc || atof(argv[argCounter]) < 0)
+			{
+				dumpHelp(std::cout, argv[0]);
+				return 1;
+			}
+			else
+				seekSeconds = atof(argv[argCounter]);
+		}
+		else if (strcmp(arg, "--loop") == 0)
+		{
+			loop = true;
+		}
+		else if (strcmp(arg, "--all-messages") == 0)
+		{
+			allMessages = true;
+		}
 		else if ((strcmp(arg, "-h") == 0) || (strcmp(arg, "--help") == 0))
 		{
 			dumpHelp(std::cout, argv[0]);
@@ -253,12 +337,44 @@ int main(int argc, char *argv[])
 	if (targets.empty())
 		targets.push_back(ASEBA_DEFAULT_TARGET);
 	
+	// text from stdin is replayed as it comes, unless we must know all of it to seek or loop;
+	// files are loaded or mapped in memory
+	const bool live((!inputFile) && (seekSeconds == 0) && (!loop));
+	Aseba::LogReader log;
+	if (inputFile && Aseba::LogReader::isBinaryLog(inputFile))
+	{
+		if (!log.open(inputFile))
+		{
+			std::cerr << "Cannot read binary log " << inputFile << std::endl;
+			return 1;
+		}
+	}
+	else if (!live)
+	{
+		std::ifstream file;
+		if (inputFile)
+		{
+			file.open(inputFile);
+			if (!file.good())
+			{
+				std::cerr << "Cannot open " << inputFile << std::endl;
+				return 1;
+			}
+		}
+		const unsigned malformedCount(log.loadText(inputFile ? file : std::cin));
+		if (malformedCount)
+			std::cerr << "Skipped " << malformedCount << " malformed lines" << std::endl;
+	}
+	
 	try
 	{
-		Aseba::Player player(inputFile, respectTimings, speedFactor);
+		Aseba::Player player(respectTimings, allMessages, speedFactor);
 		for (size_t i = 0; i < targets.size(); i++)
 			player.connect(targets[i]);
-		player.run();
+		if (live)
+			player.playLive();
+		else
+			player.play(log, Aseba::LogTime(seekSeconds * 1000000), loop);
 	}
 	catch(Dashel::DashelException e)
 	{
@@ -23,9 +23,14 @@
 #include "../../common/msg/msg.h"
 #include "../../common/utils/utils.h"
 #include "../../transport/dashel_plugins/dashel-plugins.h"
+#include "log.h"
 #include <time.h>
 #include <iostream>
 #include <cstring>
+#ifdef WIN32
+	#include <io.h>
+	#include <fcntl.h>
+#endif // WIN32
 
 namespace Aseba
 {
@@ -38,25 +43,49 @@ namespace Aseba
 	/*@{*/
 	
 	//! A message recorder.
-	//! This class saves user messages
+	//! This class saves user messages in the text format, or all messages in a binary log
 	class Recorder : public Hub
 	{
+	protected:
+		LogWriter* writer;
+		std::vector<uint8> packet;
+		
+	public:
+		//! Record in text to stdout, or in binary to writer if it is not 0
+		Recorder(LogWriter* writer) :
+			writer(writer)
+		{}
+		
 	protected:
 		
 		void incomingData(Stream *stream)
 		{
-			Message *message = Message::receive(stream);
-			UserMessage *userMessage = dynamic_cast<UserMessage *>(message);
-			if (userMessage)
+			// keep the message as on the wire, there is no need to decode it
+			packet.resize(6);
+			stream->read(&packet[0], 6);
+			const uint16 length(uint16(packet[0]) | (uint16(packet[1]) << 8));
+			packet.resize(6 + length);
+			if (length)
+				stream->read(&packet[6], length);
+			
+			LogRecord record;
+			record.time = currentLogTime();
+			record.source = uint16(packet[2]) | (uint16(packet[3]) << 8);
+			record.type = uint16(packet[4]) | (uint16(packet[5]) << 8);
+			record.packet = &packet[0];
+			record.packetSize = packet.size();
+			
+			if (writer)
 			{
-				dumpTime(cout, true);
-				cout << userMessage->source << " ";
-				cout << userMessage->type << " ";
-				cout << userMessage->data.size() << " ";
-				for (UserMessage::DataVector::const_iterator it = userMessage->data.begin(); it != userMessage->data.end(); ++it)
-					cout << *it << " ";
-				cout << endl;
+				writer->write(record);
+				if (writer->hasFailed())
+				{
+					cerr << "Cannot write the log, stopping" << endl;
+					stop();
+				}
 			}
+			else if (writeTextRecord(cout, record))
+				cout.flush();
 		}
 	};
 	
@@ -70,6 +99,8 @@ void dumpHelp(std::ostream &stream, const char *programName)
 	stream << "Aseba rec, record the user messages to stdout for later replay, usage:\n";
 	stream << programName << " [options] [targets]*\n";
 	stream << "Options:\n";
+	stream << "-o OUTPUT_FILE  : record all messages to the binary log OUTPUT_FILE\n";
+	stream << "--binary        : record all messages as a binary log to stdout\n";
 	stream << "-h, --help      : shows this help\n";
 	stream << "-V, --version   : shows the version number\n";
 	stream << "Targets are any valid Dashel targets." << std::endl;
@@ -88,6 +119,8 @@ int main(int argc, char *argv[])
 {
 	Dashel::initPlugins();
 	std::vector<std::string> targets;
+	const char* outputFile = 0;
+	bool binary = false;
 	
 	int argCounter = 1;
 	
@@ -105,6 +138,21 @@ int main(int argc, char *argv[])
 			dumpVersion(std::cout);
 			return 0;
 		}
+		else if (strcmp(arg, "-o") == 0)
+		{
+			argCounter++;
+			if (argCounter >= argc)
+			{
+				dumpHelp(std::cout, argv[0]);
+				return 1;
+			}
+			else
+				outputFile = argv[argCounter];
+		}
+		else if (strcmp(arg, "--binary") == 0)
+		{
+			binary = true;
+		}
 		else
 		{
 			targets.push_back(argv[argCounter]);
@@ -115,9 +163,26 @@ int main(int argc, char *argv[])
 	if (targets.empty())
 		targets.push_back(ASEBA_DEFAULT_TARGET);
 	
+	Aseba::LogWriter writer;
+	if (outputFile)
+	{
+		if (!writer.open(outputFile))
+		{
+			std::cerr << "Cannot create " << outputFile << std::endl;
+			return 1;
+		}
+	}
+	else if (binary)
+	{
+		#ifdef WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+		#endif // WIN32
+		writer.open(stdout);
+	}
+	
 	try
 	{
-		Aseba::Recorder recorder;
+		Aseba::Recorder recorder((outputFile || binary) ? &writer : 0);
 		for (size_t i = 0; i < targets.size(); i++)
 			recorder.connect(targets[i]);
 		recorder.run();
@@ -127,5 +192,12 @@ int main(int argc, char *argv[])
 		std::cerr << e.what() << std::endl;
 	}
 	
+	// when interrupted, run() returns and the index is written
+	if (!writer.close())
+	{
+		std::cerr << "Cannot write " << (outputFile ? outputFile : "the log") << std::endl;
+		return 1;
+	}
+	
 	return 0;
 }
@@ -251,7 +251,9 @@ namespace Aseba
 	
 	DashelInterface::DashelInterface(QVector<QTranslator*> translators, const QString& commandLineTarget) :
 		isRunning(true),
-		stream(0)
+		stream(0),
+		incomingMessages(16384),
+		incomingMessagesSignaled(0)
 	{
 		// first use local name
 		const QString& systemLocale(QLocale::system().name());
@@ -347,14 +349,37 @@ namespace Aseba
 	// In QThread main function, we just make our Dashel hub switch listen for incoming data
 	void DashelInterface::run()
 	{
+		// while messages wait for room in the ring, poll so that they are handed over once the GUI thread took some
 		while (isRunning)
-			Dashel::Hub::run();
+		{
+			Dashel::Hub::step(overflowMessages.empty() ? -1 : 1);
+			handOverMessages();
+		}
+		
+		for (std::deque<Message*>::iterator it = overflowMessages.begin(); it != overflowMessages.end(); ++it)
+			delete *it;
+		overflowMessages.clear();
 	}
 	
 	void DashelInterface::incomingData(Stream *stream)
 	{
-		Message *message = Message::receive(stream);
-		emit messageAvailable(message);
+		// never wait for the GUI thread here: we hold the hub lock, which it might be waiting for
+		overflowMessages.push_back(Message::receive(stream));
+		handOverMessages();
+	}
+	
+	void DashelInterface::handOverMessages()
+	{
+		bool handedOver(false);
+		while (!overflowMessages.empty() && incomingMessages.push(overflowMessages.front()))
+		{
+			overflowMessages.pop_front();
+			handedOver = true;
+		}
+		
+		// wake the GUI thread once for all the messages it has not started to take
+		if (handedOver && incomingMessagesSignaled.testAndSetOrdered(0, 1))
+			emit messagesAvailable();
 	}
 	
 	void DashelInterface::connectionClosed(Stream* stream, bool abnormal)
@@ -389,6 +414,11 @@ namespace Aseba
 		emit nodeDescriptionReceivedSignal(nodeId);
 	}
 	
+	void SignalingDescriptionsManager::sendDescriptionsMessage(Message& message)
+	{
+		emit sendDescriptionsMessageSignal(&message);
+	}
+	
 	
 	enum InNextState
 	{
@@ -400,7 +430,15 @@ namespace Aseba
 	DashelTarget::Node::Node() :
 		steppingInNext(NOT_IN_NEXT),
 		lineInNext(0),
-		executionMode(EXECUTION_UNKNOWN)
+		executionMode(EXECUTION_UNKNOWN),
+		variablesDeltaSupported(false),
+		variablesCopyVersion(0),
+		variablesDeltaPending(false),
+		variablesDeltaPendingEnd(0),
+		variablesDeltaPendingAge(0),
+		variablesWatchSupported(false),
+		runAfterUpload(false),
+		writeAfterUpload(false)
 	{
 	}
 	
@@ -410,16 +448,21 @@ namespace Aseba
 	{
 		userEventsTimer.setSingleShot(true);
 		connect(&userEventsTimer, SIGNAL(timeout()), SLOT(updateUserEvents()));
+		connect(&uploadsTimer, SIGNAL(timeout()), SLOT(updateUploads()));
 		
 		// we connect the events from the stream listening thread to slots living in our gui thread
-		connect(&dashelInterface, SIGNAL(messageAvailable(Message *)), SLOT(messageFromDashel(Message *)), Qt::QueuedConnection);
+		connect(&dashelInterface, SIGNAL(messagesAvailable()), SLOT(messagesFromDashel()), Qt::QueuedConnection);
 		connect(&dashelInterface, SIGNAL(dashelDisconnection()), SLOT(disconnectionFromDashel()), Qt::QueuedConnection);
 		
 		// we also connect to the description manager to know when we have a new node available
 		connect(&descriptionManager, SIGNAL(nodeDescriptionReceivedSignal(unsigned)), SLOT(nodeDescriptionReceived(unsigned)));
+		// and let it ask the nodes for their capabilities, which tell whether they support variables deltas, watches and checksums
+		connect(&descriptionManager, SIGNAL(sendDescriptionsMessageSignal(Message*)), SLOT(sendDescriptionsMessage(Message*)));
 		
 		messagesHandlersMap[ASEBA_MESSAGE_DISCONNECTED] = &Aseba::DashelTarget::receivedDisconnected;
 		messagesHandlersMap[ASEBA_MESSAGE_VARIABLES] = &Aseba::DashelTarget::receivedVariables;
+		messagesHandlersMap[ASEBA_MESSAGE_CAPABILITIES] = &Aseba::DashelTarget::receivedCapabilities;
+		messagesHandlersMap[ASEBA_MESSAGE_VARIABLES_DELTA] = &Aseba::DashelTarget::receivedVariablesDelta;
 		messagesHandlersMap[ASEBA_MESSAGE_ARRAY_ACCESS_OUT_OF_BOUNDS] = &Aseba::DashelTarget::receivedArrayAccessOutOfBounds;
 		messagesHandlersMap[ASEBA_MESSAGE_DIVISION_BY_ZERO] = &Aseba::DashelTarget::receivedDivisionByZero;
 		messagesHandlersMap[ASEBA_MESSAGE_EVENT_EXECUTION_KILLED] = &Aseba::DashelTarget::receivedEventExecutionKilled;
@@ -436,6 +479,10 @@ namespace Aseba
 		dashelInterface.stop();
 		dashelInterface.wait();
 		DashelTarget::disconnect();
+		
+		Message* message;
+		while (dashelInterface.incomingMessages.pop(message))
+			delete message;
 	}
 	
 	void DashelTarget::disconnect()
@@ -503,20 +550,42 @@ namespace Aseba
 	
 	void DashelTarget::uploadBytecode(unsigned node, const BytecodeVector &bytecode)
 	{
+		dashelInterface.lock();
+		const bool canWrite(dashelInterface.stream && !writeBlocked);
+		dashelInterface.unlock();
+		if (!canWrite)
+			return;
+		
+		NodesMap::iterator nodeIt = nodes.find(node);
+		assert(nodeIt != nodes.end());
+		
+		// fill debug bytecode and build address map
+		nodeIt->second.debugBytecode = bytecode;
+		nodeIt->second.eventAddressToId = bytecode.getEventAddressesToIds();
+		nodeIt->second.runAfterUpload = false;
+		nodeIt->second.writeAfterUpload = false;
+		
+		// send bytecode, along with the uploads to other nodes
+		startUpload(node, std::vector<uint16>(bytecode.begin(), bytecode.end()));
+		if (!uploadsTimer.isActive())
+			uploadsTimer.start(10);
+	}
+	
+	void DashelTarget::writeBytecode(unsigned node)
+	{
+		// every chunk of bytecode resets the node, so wait for the last one
+		if (isUploading(node))
+		{
+			nodes[node].writeAfterUpload = true;
+			return;
+		}
+		
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
-			NodesMap::iterator nodeIt = nodes.find(node);
-			assert(nodeIt != nodes.end());
-			
-			// fill debug bytecode and build address map
-			nodeIt->second.debugBytecode = bytecode;
-			nodeIt->second.eventAddressToId = bytecode.getEventAddressesToIds();
-			
-			// send bytecode
 			try
 			{
-				sendBytecode(dashelInterface.stream, node, std::vector<uint16>(bytecode.begin(), bytecode.end()));
+				WriteBytecode(node).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -530,14 +599,14 @@ namespace Aseba
 			dashelInterface.unlock();
 	}
 	
-	void DashelTarget::writeBytecode(unsigned node)
+	void DashelTarget::reboot(unsigned node)
 	{
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
 			try
 			{
-				WriteBytecode(node).serialize(dashelInterface.stream);
+				Reboot(node).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -551,14 +620,14 @@ namespace Aseba
 			dashelInterface.unlock();
 	}
 	
-	void DashelTarget::reboot(unsigned node)
+	void DashelTarget::sendEvent(unsigned id, const VariablesDataVector &data)
 	{
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
 			try
 			{
-				Reboot(node).serialize(dashelInterface.stream);
+				UserMessage(id, data).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -572,14 +641,14 @@ namespace Aseba
 			dashelInterface.unlock();
 	}
 	
-	void DashelTarget::sendEvent(unsigned id, const VariablesDataVector &data)
+	void DashelTarget::setVariables(unsigned node, unsigned start, const VariablesDataVector &data)
 	{
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
 			try
 			{
-				UserMessage(id, data).serialize(dashelInterface.stream);
+				SetVariables(node, start, data).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -593,14 +662,23 @@ namespace Aseba
 			dashelInterface.unlock();
 	}
 	
-	void DashelTarget::setVariables(unsigned node, unsigned start, const VariablesDataVector &data)
+	void DashelTarget::getVariables(unsigned node, unsigned start, unsigned length)
 	{
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
+			const unsigned variablesPayloadSize = ASEBA_MAX_EVENT_ARG_COUNT-1;
+
 			try
 			{
-				SetVariables(node, start, data).serialize(dashelInterface.stream);
+				while (length > variablesPayloadSize)
+				{
+					GetVariables(node, start, variablesPayloadSize).serialize(dashelInterface.stream);
+					start += variablesPayloadSize;
+					length -= variablesPayloadSize;
+				}
+
+				GetVariables(node, start, length).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -614,23 +692,70 @@ namespace Aseba
 			dashelInterface.unlock();
 	}
 	
-	void DashelTarget::getVariables(unsigned node, unsigned start, unsigned length)
+	bool DashelTarget::getVariablesDelta(unsigned node, unsigned start, unsigned length)
 	{
+		NodesMap::iterator nodeIt = nodes.find(node);
+		if (nodeIt == nodes.end() || !nodeIt->second.variablesDeltaSupported)
+			return false;
+		Node& target(nodeIt->second);
+		
+		// on slow links, do not queue requests behind one not answered yet, unless its answer seems lost
+		if (target.variablesDeltaPending && ++target.variablesDeltaPendingAge < 10)
+			return true;
+		
+		dashelInterface.lock();
+		if (dashelInterface.stream && !writeBlocked)
+		{
+			try
+			{
+				GetVariablesDelta(node, start, length, target.variablesCopyVersion).serialize(dashelInterface.stream);
+				dashelInterface.stream->flush();
+				dashelInterface.unlock();
+				target.variablesDeltaPending = true;
+				target.variablesDeltaPendingEnd = start + length;
+				target.variablesDeltaPendingAge = 0;
+			}
+			catch(Dashel::DashelException e)
+			{
+				dashelInterface.unlock();
+				handleDashelException(e);
+			}
+		}
+		else
+			dashelInterface.unlock();
+		return true;
+	}
+	
+	bool DashelTarget::watchVariables(unsigned node, unsigned start, unsigned length, unsigned period)
+	{
+		NodesMap::iterator nodeIt = nodes.find(node);
+		if (nodeIt == nodes.end() || !nodeIt->second.variablesWatchSupported)
+			return false;
+		Node& target(nodeIt->second);
+		
+		// the same range is only requested again when its lease is half over
+		const std::pair<unsigned, unsigned> range(start, length);
+		const std::map<std::pair<unsigned, unsigned>, QTime>::iterator requestIt(target.watchesRequests.find(range));
+		if (requestIt != target.watchesRequests.end() && requestIt->second.elapsed() < ASEBA_VARIABLES_WATCH_LEASE / 2)
+			return true;
+		target.watchesRequests[range].start();
+		
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
 			const unsigned variablesPayloadSize = ASEBA_MAX_EVENT_ARG_COUNT-1;
-
+			
 			try
 			{
+				// each watch is sent as a single variables message, which must fit in a packet
 				while (length > variablesPayloadSize)
 				{
-					GetVariables(node, start, variablesPayloadSize).serialize(dashelInterface.stream);
+					WatchVariables(node, start, variablesPayloadSize, period).serialize(dashelInterface.stream);
 					start += variablesPayloadSize;
 					length -= variablesPayloadSize;
 				}
-
-				GetVariables(node, start, length).serialize(dashelInterface.stream);
+				
+				WatchVariables(node, start, length, period).serialize(dashelInterface.stream);
 				dashelInterface.stream->flush();
 				dashelInterface.unlock();
 			}
@@ -642,6 +767,7 @@ namespace Aseba
 		}
 		else
 			dashelInterface.unlock();
+		return true;
 	}
 	
 	void DashelTarget::reset(unsigned node)
@@ -667,6 +793,13 @@ namespace Aseba
 	
 	void DashelTarget::run(unsigned node)
 	{
+		// every chunk of bytecode resets the node, so wait for the last one
+		if (isUploading(node))
+		{
+			nodes[node].runAfterUpload = true;
+			return;
+		}
+		
 		dashelInterface.lock();
 		if (dashelInterface.stream && !writeBlocked)
 		{
@@ -856,23 +989,57 @@ namespace Aseba
 	
 	void DashelTarget::updateUserEvents()
 	{
-		// send only 20 latest user events
-		if (userEventsQueue.size() > 20)
-			emit userEventsDropped(userEventsQueue.size() - 20);
-		while (userEventsQueue.size() > 20)
+		// keep only the 20 latest events of each type, so that a flood of one does not hide the others
+		const unsigned maxEventsPerType(20);
+		std::map<unsigned, unsigned> keptCounts;
+		QList<UserMessage *> kept;
+		unsigned droppedCount(0);
+		while (!userEventsQueue.isEmpty())
 		{
-			delete userEventsQueue.head();
-			userEventsQueue.dequeue();
+			UserMessage *userMessage(userEventsQueue.takeLast());
+			unsigned& keptCount(keptCounts[userMessage->type]);
+			if (keptCount < maxEventsPerType)
+			{
+				++keptCount;
+				kept.prepend(userMessage);
+			}
+			else
+			{
+				delete userMessage;
+				++droppedCount;
+			}
 		}
+		if (droppedCount)
+			emit userEventsDropped(droppedCount);
 		
-		while (!userEventsQueue.isEmpty())
+		for (QList<UserMessage *>::const_iterator it = kept.begin(); it != kept.end(); ++it)
 		{
-			emit userEvent(userEventsQueue.head()->type, userEventsQueue.head()->data);
-			delete userEventsQueue.head();
-			userEventsQueue.dequeue();
+			emit userEvent((*it)->type, (*it)->data);
+			delete *it;
 		}
 	}
 	
+	void DashelTarget::updateUploads()
+	{
+		stepUploads();
+		if (!isUploading())
+			uploadsTimer.stop();
+	}
+	
+	void DashelTarget::messagesFromDashel()
+	{
+		// messages pushed from now on wake us up again
+		dashelInterface.incomingMessagesSignaled.fetchAndStoreOrdered(0);
+		
+		// process a bounded batch, and leave the rest for the next turn of the event loop so that the GUI stays responsive
+		const unsigned maxMessagesPerBatch(1024);
+		Message* message;
+		for (unsigned i = 0; i < maxMessagesPerBatch && dashelInterface.incomingMessages.pop(message); ++i)
+			messageFromDashel(message);
+		if (dashelInterface.incomingMessages.size() != 0)
+			QTimer::singleShot(0, this, SLOT(messagesFromDashel()));
+	}
+	
 	void DashelTarget::messageFromDashel(Message *message)
 	{
 		bool deleteMessage = true;
@@ -881,6 +1048,8 @@ namespace Aseba
 		
 		// let the description manager filter the message
 		descriptionManager.processMessage(message);
+		// and the uploader check the chunks of bytecode
+		BytecodeUploader::processMessage(message);
 		
 		// see if we have a registered handler for this message
 		MessagesHandlersMap::const_iterator messageHandler = messagesHandlersMap.find(message->type);
@@ -947,7 +1116,10 @@ namespace Aseba
 	{
 		emit networkDisconnected();
 		nodes.clear();
+		nodesCapabilities.clear();
 		descriptionManager.reset();
+		uploads.clear();
+		uploadsTimer.stop();
 		
 		// show a dialog box that is trying to reconnect
 		ReconnectionDialog reconnectionDialog(dashelInterface);
@@ -960,6 +1132,8 @@ namespace Aseba
 		
 		node.steppingInNext = NOT_IN_NEXT;
 		node.lineInNext = 0;
+		node.variablesDeltaSupported = (nodesCapabilities[nodeId] & ASEBA_CAPABILITY_VARIABLES_DELTA) != 0;
+		node.variablesWatchSupported = (nodesCapabilities[nodeId] & ASEBA_CAPABILITY_WATCH_VARIABLES) != 0;
 		
 		emit nodeConnected(nodeId);
 	}
@@ -970,6 +1144,51 @@ namespace Aseba
 		emit variablesMemoryChanged(variables->source, variables->start, variables->variables);
 	}
 	
+	void DashelTarget::receivedCapabilities(Message *message)
+	{
+		Capabilities *capabilities = polymorphic_downcast<Capabilities *>(message);
+		nodesCapabilities[capabilities->source] = capabilities->capabilities;
+		NodesMap::iterator nodeIt = nodes.find(capabilities->source);
+		if (nodeIt != nodes.end())
+		{
+			nodeIt->second.variablesDeltaSupported = (capabilities->capabilities & ASEBA_CAPABILITY_VARIABLES_DELTA) != 0;
+			nodeIt->second.variablesWatchSupported = (capabilities->capabilities & ASEBA_CAPABILITY_WATCH_VARIABLES) != 0;
+		}
+	}
+	
+	void DashelTarget::receivedVariablesDelta(Message *message)
+	{
+		VariablesDelta *delta = polymorphic_downcast<VariablesDelta *>(message);
+		
+		// answer to another client
+		if (delta->dest != ASEBA_DEST_DEBUG)
+			return;
+		NodesMap::iterator nodeIt = nodes.find(delta->source);
+		if (nodeIt == nodes.end())
+			return;
+		Node& node(nodeIt->second);
+		
+		// the node zeroes its snapshot when it does not know our version, positions never sent since are zero
+		const size_t end(size_t(delta->start) + delta->length);
+		if (delta->baseVersion == 0)
+			std::fill(node.variablesCopy.begin(), node.variablesCopy.end(), 0);
+		if (node.variablesCopy.size() < end)
+			node.variablesCopy.resize(end, 0);
+		
+		// if a message was lost, start over from zero with the next request
+		if ((delta->baseVersion != 0 && delta->baseVersion != node.variablesCopyVersion) || !delta->apply(node.variablesCopy))
+		{
+			node.variablesCopyVersion = 0;
+			node.variablesDeltaPending = false;
+			return;
+		}
+		node.variablesCopyVersion = delta->version;
+		if (end >= node.variablesDeltaPendingEnd)
+			node.variablesDeltaPending = false;
+		
+		emit variablesMemoryChanged(delta->source, delta->start, VariablesDataVector(node.variablesCopy.begin() + delta->start, node.variablesCopy.begin() + end));
+	}
+	
 	void DashelTarget::receivedArrayAccessOutOfBounds(Message *message)
 	{
 		ArrayAccessOutOfBounds *aa = polymorphic_downcast<ArrayAccessOutOfBounds *>(message);
@@ -1145,6 +1364,61 @@ namespace Aseba
 		emit bootloaderAck(ack->errorCode, ack->errorAddress);
 	}
 	
+	void DashelTarget::sendDescriptionsMessage(Message* message)
+	{
+		sendMessage(*message);
+	}
+	
+	void DashelTarget::sendMessage(Message& message)
+	{
+		dashelInterface.lock();
+		if (dashelInterface.stream && !writeBlocked)
+		{
+			try
+			{
+				message.serialize(dashelInterface.stream);
+				dashelInterface.stream->flush();
+				dashelInterface.unlock();
+			}
+			catch(Dashel::DashelException e)
+			{
+				dashelInterface.unlock();
+				handleDashelException(e);
+			}
+		}
+		else
+			dashelInterface.unlock();
+	}
+	
+	void DashelTarget::sendUploadMessage(Message& message)
+	{
+		sendMessage(message);
+	}
+	
+	void DashelTarget::uploadProgress(unsigned nodeId, unsigned words, unsigned total)
+	{
+		emit bytecodeUploadProgress(nodeId, words, total);
+	}
+	
+	void DashelTarget::uploadFinished(unsigned nodeId, UploadResult result)
+	{
+		emit bytecodeUploadFinished(nodeId, result != UPLOAD_FAILED);
+		
+		NodesMap::iterator nodeIt = nodes.find(nodeId);
+		if (nodeIt == nodes.end())
+			return;
+		const bool runAfterUpload(nodeIt->second.runAfterUpload);
+		const bool writeAfterUpload(nodeIt->second.writeAfterUpload);
+		nodeIt->second.runAfterUpload = false;
+		nodeIt->second.writeAfterUpload = false;
+		if (result == UPLOAD_FAILED)
+			return;
+		if (writeAfterUpload)
+			writeBytecode(nodeId);
+		if (runAfterUpload)
+			run(nodeId);
+	}
+	
 	int DashelTarget::getPCFromLine(unsigned node, unsigned line)
 	{
 		// first lookup node
@@ -24,12 +24,17 @@
 #include "Target.h"
 #include "../../common/consts.h"
 #include "../../common/msg/descriptions-manager.h"
+#include "../../common/msg/bytecode-uploader.h"
+#include "../../common/utils/SingleProducerRing.h"
 #include <QString>
 #include <QDialog>
 #include <QQueue>
 #include <QTimer>
+#include <QTime>
 #include <QThread>
+#include <QAtomicInt>
 #include <map>
+#include <deque>
 #include <dashel/dashel.h>
 
 class QPushButton;
@@ -95,6 +100,9 @@ namespace Aseba
 		std::string lastConnectedTarget;
 		std::string lastConnectedTargetName;
 		QString language;
+		SingleProducerRing<Message*> incomingMessages; //!< messages received by this thread, taken by the GUI thread
+		QAtomicInt incomingMessagesSignaled; //!< 1 if messagesAvailable() was emitted and the GUI thread did not start taking messages since
+		std::deque<Message*> overflowMessages; //!< messages waiting for room in incomingMessages, only touched by this thread
 		
 	public:
 		DashelInterface(QVector<QTranslator*> translators, const QString& commandLineTarget);
@@ -104,7 +112,7 @@ namespace Aseba
 		virtual void stop();
 		
 	signals:
-		void messageAvailable(Message *message);
+		void messagesAvailable();
 		void dashelDisconnection();
 	
 	protected:
@@ -114,6 +122,8 @@ namespace Aseba
 		// from Dashel::Hub
 		virtual void incomingData(Dashel::Stream *stream);
 		virtual void connectionClosed(Dashel::Stream *stream, bool abnormal);
+		
+		void handOverMessages();
 	};
 	
 	//! Provides a signal/slot interface for the description manager
@@ -123,13 +133,15 @@ namespace Aseba
 	
 	signals:
 		void nodeDescriptionReceivedSignal(unsigned nodeId);
+		void sendDescriptionsMessageSignal(Message* message);
 	
 	protected:
 		virtual void nodeProtocolVersionMismatch(const std::wstring &nodeName, uint16 protocolVersion);
 		virtual void nodeDescriptionReceived(unsigned nodeId);
+		virtual void sendDescriptionsMessage(Message& message);
 	};
 	
-	class DashelTarget: public Target
+	class DashelTarget: public Target, public BytecodeUploader
 	{
 		Q_OBJECT
 		
@@ -143,6 +155,16 @@ namespace Aseba
 			unsigned steppingInNext; //!< state of node when in next and stepping
 			unsigned lineInNext; //!< line of node to execute when in next and stepping
 			ExecutionMode executionMode; //!< last known execution mode if this node
+			bool variablesDeltaSupported; //!< true if the node has advertised ASEBA_CAPABILITY_VARIABLES_DELTA
+			std::vector<sint16> variablesCopy; //!< variables of the node as of variablesCopyVersion, same as its snapshot for us
+			uint16 variablesCopyVersion; //!< version of variablesCopy, 0 if we have none
+			bool variablesDeltaPending; //!< true while the answer to a delta request has not been fully received
+			unsigned variablesDeltaPendingEnd; //!< end of the range of the pending delta request
+			unsigned variablesDeltaPendingAge; //!< number of delta requests not sent while waiting for the pending one
+			bool variablesWatchSupported; //!< true if the node, or a switch on its behalf, has advertised ASEBA_CAPABILITY_WATCH_VARIABLES
+			std::map<std::pair<unsigned, unsigned>, QTime> watchesRequests; //!< when each watched range of variables was last requested
+			bool runAfterUpload; //!< true if run() was called while the bytecode was being uploaded
+			bool writeAfterUpload; //!< true if writeBytecode() was called while the bytecode was being uploaded
 		};
 		
 		typedef void (DashelTarget::*MessageHandler)(Message *message);
@@ -156,7 +178,9 @@ namespace Aseba
 		QQueue<UserMessage *> userEventsQueue;
 		SignalingDescriptionsManager descriptionManager;
 		NodesMap nodes;
+		std::map<unsigned, unsigned> nodesCapabilities; //!< capabilities received from nodes, even before their description is complete
 		QTimer userEventsTimer;
+		QTimer uploadsTimer;
 		bool writeBlocked; //!< true if write is being blocked by invasive plugins, false if write is allowed
 		
 	public:
@@ -181,6 +205,8 @@ namespace Aseba
 		
 		virtual void setVariables(unsigned node, unsigned start, const VariablesDataVector &data);
 		virtual void getVariables(unsigned node, unsigned start, unsigned length);
+		virtual bool getVariablesDelta(unsigned node, unsigned start, unsigned length);
+		virtual bool watchVariables(unsigned node, unsigned start, unsigned length, unsigned period);
 		
 		virtual void reset(unsigned node);
 		virtual void run(unsigned node);
@@ -198,16 +224,21 @@ namespace Aseba
 	
 	protected slots:
 		void updateUserEvents();
-		void messageFromDashel(Message *message);
+		void updateUploads();
+		void messagesFromDashel();
 		void disconnectionFromDashel();
 		void nodeDescriptionReceived(unsigned node);
+		void sendDescriptionsMessage(Message* message);
 	
 	protected:
+		void messageFromDashel(Message *message);
 		void receivedDescription(Message *message);
 		void receivedLocalEventDescription(Message *message);
 		void receivedNativeFunctionDescription(Message *message);
 		void receivedDisconnected(Message *message);
 		void receivedVariables(Message *message);
+		void receivedCapabilities(Message *message);
+		void receivedVariablesDelta(Message *message);
 		void receivedArrayAccessOutOfBounds(Message *message);
 		void receivedDivisionByZero(Message *message);
 		void receivedEventExecutionKilled(Message *message);
@@ -216,6 +247,14 @@ namespace Aseba
 		void receivedBreakpointSetResult(Message *message);
 		void receivedBootloaderAck(Message *message);
 		
+	protected:
+		void sendMessage(Message& message);
+		
+		// from BytecodeUploader
+		virtual void sendUploadMessage(Message& message);
+		virtual void uploadProgress(unsigned nodeId, unsigned words, unsigned total);
+		virtual void uploadFinished(unsigned nodeId, UploadResult result);
+		
 	protected:
 		bool emitNodeConnectedIfDescriptionComplete(unsigned id, const Node& node);
 		int getPCFromLine(unsigned node, unsigned line);
@@ -50,41 +50,44 @@ namespace Aseba
 	class EventDataWrapper : public QwtSeriesData<QPointF>
 	{
 	private:
-		std::deque<double>& _x;
-		std::deque<sint16>& _y;
+		std::vector<double>& _x;
+		std::vector<double>& _y;
 		
 	public:
-		EventDataWrapper(std::deque<double>& _x, std::deque<sint16>& _y) :
+		EventDataWrapper(std::vector<double>& _x, std::vector<double>& _y) :
 			_x(_x),
 			_y(_y)
 		{ }
 		virtual QRectF boundingRect () const { return qwtBoundingRect(*this); }
-		virtual QPointF sample (size_t i) const { return QPointF(_x[i], double(_y[i])); }
+		virtual QPointF sample (size_t i) const { return QPointF(_x[i], _y[i]); }
 		virtual size_t size () const { return _x.size(); }
 	};
 	#else
 	class EventDataWrapper : public QwtData
 	{
 	private:
-		std::deque<double>& _x;
-		std::deque<sint16>& _y;
+		std::vector<double>& _x;
+		std::vector<double>& _y;
 		
 	public:
-		EventDataWrapper(std::deque<double>& _x, std::deque<sint16>& _y) :
+		EventDataWrapper(std::vector<double>& _x, std::vector<double>& _y) :
 			_x(_x),
 			_y(_y)
 		{ }
 		virtual QwtData *   copy () const { return new EventDataWrapper(*this); }
 		virtual size_t   size () const { return _x.size(); }
 		virtual double x (size_t i) const { return _x[i]; }
-		virtual double y (size_t i) const { return (double)_y[i]; }
+		virtual double y (size_t i) const { return _y[i]; }
 	};
 	#endif
 	
 	EventViewer::EventViewer(unsigned eventId, const QString& eventName, unsigned eventVariablesCount, MainWindow::EventViewers* eventsViewers) :
 		eventId(eventId),
 		eventsViewers(eventsViewers),
-		values(eventVariablesCount),
+		series(eventVariablesCount, eventPlotCapacity),
+		plotTimes(eventVariablesCount),
+		plotValues(eventVariablesCount),
+		plotOutdated(false),
 		startingTime(QTime::currentTime())
 	{
 		QSettings settings;
@@ -99,16 +102,16 @@ namespace Aseba
 		//legend->setItemMode(QwtLegend::CheckableItem);
 		plot->insertLegend(legend, QwtPlot::BottomLegend);
 		
-		for (size_t i = 0; i < values.size(); i++)
+		for (size_t i = 0; i < series.channelsCount(); i++)
 		{
 			QwtPlotCurve *curve = new QwtPlotCurve(QString("%0").arg(i));
 			#if QWT_VERSION >= 0x060000
-			curve->setData(new EventDataWrapper(timeStamps, values[i]));
+			curve->setData(new EventDataWrapper(plotTimes[i], plotValues[i]));
 			#else
-			curve->setData(EventDataWrapper(timeStamps, values[i]));
+			curve->setData(EventDataWrapper(plotTimes[i], plotValues[i]));
 			#endif
 			curve->attach(plot);
-			curve->setPen(QPen(QColor::fromHsv((i * 360) / values.size(), 255, 100), 2));
+			curve->setPen(QPen(QColor::fromHsv((i * 360) / series.channelsCount(), 255, 100), 2));
 		}
 		
 		QVBoxLayout *layout = new QVBoxLayout(this);
@@ -150,6 +153,9 @@ namespace Aseba
 		// receive events
 		eventsViewers->insert(eventId, this);
 		isCapturing = true;
+		
+		// replot at display rate rather than for every event
+		startTimer(eventPlotReplotInterval);
 	}
 	
 	EventViewer::~EventViewer()
@@ -167,31 +173,29 @@ namespace Aseba
 		if (timeWindowCheckBox->isChecked())
 		{
 			// remove old data
-			while (
-				(!timeStamps.empty()) &&
-				(elapsedTime - timeStamps[0] > timeWindowLength->value())
-			)
-			{
-				timeStamps.pop_front();
-				for (size_t i = 0; i < values.size(); i++)
-					values[i].pop_front();
-			}
-		}
-			
-			
-		timeStamps.push_back(elapsedTime);
-		for (size_t i = 0; i < values.size(); i++)
-		{
-			if (i < data.size())
-			{
-				values[i].push_back(data[i]);
-			}
-			else
-			{
-				values[i].push_back(0);
-			}
+			series.dropBefore(elapsedTime - timeWindowLength->value());
 		}
+		
+		series.push(elapsedTime, data.empty() ? 0 : &data[0], data.size());
+		plotOutdated = true;
+	}
+	
+	void EventViewer::timerEvent(QTimerEvent *event)
+	{
+		if (plotOutdated)
+			updatePlot();
+	}
+	
+	void EventViewer::updatePlot()
+	{
+		// keep a few points per pixel column, the series can be much longer than the plot is wide
+		const unsigned columns(plot->canvas()->width());
+		const double start(series.size() ? series.time(0) : 0);
+		const double end(series.size() ? series.time(series.size() - 1) : 0);
+		for (size_t i = 0; i < series.channelsCount(); i++)
+			series.decimate(i, start, end, columns, plotTimes[i], plotValues[i]);
 		plot->replot();
+		plotOutdated = false;
 	}
 	
 	void EventViewer::pauseRunCapture()
@@ -218,11 +222,9 @@ namespace Aseba
 	
 	void EventViewer::clearPlot()
 	{
-		for (size_t i = 0; i < values.size(); i++)
-			values[i].clear();
-		timeStamps.clear();
+		series.clear();
 		startingTime = QTime::currentTime();
-		plot->replot();
+		updatePlot();
 	}
 	
 	void EventViewer::saveToFile()
@@ -238,13 +240,13 @@ namespace Aseba
 		settings.setValue("EventViewer/exportFileName", fileName);
 		
 		QTextStream out(&file);
-		for (size_t i = 0; i < timeStamps.size(); ++i)
+		for (size_t i = 0; i < series.size(); ++i)
 		{
-			out << timeStamps[i] << " ";
-			for (size_t j = 0; j < values.size(); ++j)
+			out << series.time(i) << " ";
+			for (size_t j = 0; j < series.channelsCount(); ++j)
 			{
-				out << values[j][i];
-				if (j + 1 < values.size())
+				out << series.value(j, i);
+				if (j + 1 < series.channelsCount())
 					out << " ";
 			}
 			out << "\n";
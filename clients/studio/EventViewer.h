@@ -27,11 +27,12 @@
 #define QWT_DLL
 #endif // _MSC_VER
 
-#include <deque>
+#include <vector>
 #include <QTime>
 
 #include "MainWindow.h"
 #include "../../common/types.h"
+#include "../../common/utils/RingSeries.h"
 
 class QwtPlot;
 class QDoubleSpinBox;
@@ -58,8 +59,10 @@ namespace Aseba
 		QCheckBox *timeWindowCheckBox;
 		QDoubleSpinBox *timeWindowLength;
 		
-		std::vector<std::deque<sint16> > values;
-		std::deque<double> timeStamps;
+		RingSeries series;
+		std::vector<std::vector<double> > plotTimes;
+		std::vector<std::vector<double> > plotValues;
+		bool plotOutdated;
 		QTime startingTime;
 	
 	public:
@@ -69,6 +72,10 @@ namespace Aseba
 		void detachFromMain() { eventsViewers=0; }
 		void addData(const VariablesDataVector& data);
 		
+	protected:
+		virtual void timerEvent(QTimerEvent *event);
+		void updatePlot();
+		
 	protected slots:
 		void pauseRunCapture();
 		void clearPlot();
@@ -324,7 +324,7 @@ namespace Aseba
 	
 	//////
 	
-	NodeTab::CompilationResult* compilationThread(const TargetDescription targetDescription, const CommonDefinitions commonDefinitions, QString source, bool dump);
+	NodeTab::CompilationResult* compilationThread(Compiler* compiler, const TargetDescription targetDescription, const CommonDefinitions commonDefinitions, QString source, bool dump);
 	
 	NodeTab::NodeTab(MainWindow* mainWindow, Target *target, const CommonDefinitions *commonDefinitions, int id, QWidget *parent) :
 		QSplitter(parent),
@@ -384,8 +384,9 @@ namespace Aseba
 		setSizePolicy(QSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding));
 		
 		// get the value of the variables
-		// compile in this thread the first time
-		NodeTab::CompilationResult* result = compilationThread(*target->getDescription(id), *commonDefinitions, editor->toPlainText(), false);
+		// compile in this thread the first time, then only recompile what changed
+		compiler.setIncremental(true);
+		NodeTab::CompilationResult* result = compilationThread(&compiler, *target->getDescription(id), *commonDefinitions, editor->toPlainText(), false);
 		processCompilationResult(result);
 	}
 
@@ -646,6 +647,7 @@ namespace Aseba
 		const QList<TargetVariablesModel::Variable> variables(variablesModel->getVariables());
 		assert(variables.size() == variablesModel->rowCount());
 		
+		QList<QPair<unsigned, unsigned> > requests;
 		unsigned currentReqCount(0);
 		unsigned currentReqPos(0);
 		for (int i = 0; i < variables.size(); ++i)
@@ -671,7 +673,7 @@ namespace Aseba
 				else
 				{
 					// flush and reset
-					target->getVariables(id, currentReqPos, currentReqCount);
+					requests.append(qMakePair(currentReqPos, currentReqCount));
 					// new request
 					currentReqPos = var.pos;
 					currentReqCount = var.value.size();
@@ -681,8 +683,26 @@ namespace Aseba
 		if (currentReqCount != 0)
 		{
 			// flush request
-			target->getVariables(id, currentReqPos, currentReqCount);
+			requests.append(qMakePair(currentReqPos, currentReqCount));
 		}
+		if (requests.empty())
+			return;
+		
+		// if the node sends only what changed, a single request over all visible variables is cheaper;
+		// if it pushes its changes, this request is only renewed from time to time, at the refresh rate
+		unsigned start(requests.first().first);
+		unsigned end(requests.first().first + requests.first().second);
+		for (int i = 1; i < requests.size(); ++i)
+		{
+			start = qMin(start, requests[i].first);
+			end = qMax(end, requests[i].first + requests[i].second);
+		}
+		if (target->watchVariables(id, start, end - start, 200))
+			return;
+		if (target->getVariablesDelta(id, start, end - start))
+			return;
+		for (int i = 0; i < requests.size(); ++i)
+			target->getVariables(id, requests[i].first, requests[i].second);
 	}
 	
 	void NodeTab::variableValueUpdated(const QString& name, const VariablesDataVector& values)
@@ -1032,26 +1052,26 @@ namespace Aseba
 
 	}
 	
-	NodeTab::CompilationResult* compilationThread(const TargetDescription targetDescription, const CommonDefinitions commonDefinitions, QString source, bool dump)
+	NodeTab::CompilationResult* compilationThread(Compiler* compiler, const TargetDescription targetDescription, const CommonDefinitions commonDefinitions, QString source, bool dump)
 	{
 		NodeTab::CompilationResult* result(new NodeTab::CompilationResult(dump));
 		
-		Compiler compiler;
-		compiler.setTargetDescription(&targetDescription);
-		compiler.setCommonDefinitions(&commonDefinitions);
-		compiler.setTranslateCallback(CompilerTranslator::translate);
+		// the compiler is owned by the tab, and only used by one compilation at a time
+		compiler->setTargetDescription(&targetDescription);
+		compiler->setCommonDefinitions(&commonDefinitions);
+		compiler->setTranslateCallback(CompilerTranslator::translate);
 		
-		std::wistringstream is(source.toStdWString());
+		const std::wstring text(source.toStdWString());
 		
 		if (dump)
-			result->success = compiler.compile(is, result->bytecode, result->allocatedVariablesCount, result->error, &result->compilationMessages);
+			result->success = compiler->compile(text, result->bytecode, result->allocatedVariablesCount, result->error, &result->compilationMessages);
 		else
-			result->success = compiler.compile(is, result->bytecode, result->allocatedVariablesCount, result->error);
+			result->success = compiler->compile(text, result->bytecode, result->allocatedVariablesCount, result->error);
 		
 		if (result->success)
 		{
-			result->variablesMap = *compiler.getVariablesMap();
-			result->subroutineTable = *compiler.getSubroutineTable();
+			result->variablesMap = *compiler->getVariablesMap();
+			result->subroutineTable = *compiler->getSubroutineTable();
 		}
 		
 		return result;
@@ -1065,7 +1085,7 @@ namespace Aseba
 		else
 		{
 			bool dump(mainWindow->nodes->currentWidget() == this);
-			compilationFuture = QtConcurrent::run(compilationThread, *target->getDescription(id), *commonDefinitions, editor->toPlainText(), dump);
+			compilationFuture = QtConcurrent::run(compilationThread, &compiler, *target->getDescription(id), *commonDefinitions, editor->toPlainText(), dump);
 			compilationWatcher.setFuture(compilationFuture);
 			compilationDirty = false;
 			
@@ -2883,6 +2903,29 @@ namespace Aseba
 		tab->breakpointSetResult(line, success);
 	}
 	
+	void MainWindow::bytecodeUploadProgress(unsigned node, unsigned words, unsigned total)
+	{
+		statusText->setText(tr("Loading program into %0: %1%").arg(target->getName(node)).arg(total ? (100 * words) / total : 100));
+		statusText->show();
+	}
+	
+	void MainWindow::bytecodeUploadFinished(unsigned node, bool success)
+	{
+		if (success)
+		{
+			// go back to telling whether some nodes need a reload
+			statusText->setText(tr("Desynchronised! Please reload."));
+			resetStatusText();
+			return;
+		}
+		
+		NodeTab* tab = getTabFromId(node);
+		if (tab)
+			tab->isSynchronized = false;
+		statusText->setText(tr("Loading program into %0 failed! Please reload.").arg(target->getName(node)));
+		statusText->show();
+	}
+	
 	//! If any node was disconnected, send get description
 	void MainWindow::timerEvent ( QTimerEvent * event )
 	{
@@ -3243,6 +3286,9 @@ namespace Aseba
 		connect(target, SIGNAL(variablesMemoryChanged(unsigned, unsigned, const VariablesDataVector &)), SLOT(variablesMemoryChanged(unsigned, unsigned, const VariablesDataVector &)));
 		
 		connect(target, SIGNAL(breakpointSetResult(unsigned, unsigned, bool)), SLOT(breakpointSetResult(unsigned, unsigned, bool)));
+		
+		connect(target, SIGNAL(bytecodeUploadProgress(unsigned, unsigned, unsigned)), SLOT(bytecodeUploadProgress(unsigned, unsigned, unsigned)));
+		connect(target, SIGNAL(bytecodeUploadFinished(unsigned, bool)), SLOT(bytecodeUploadFinished(unsigned, bool)));
 	}
 	
 	void MainWindow::regenerateOpenRecentMenu()
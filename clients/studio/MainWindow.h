@@ -359,6 +359,7 @@ namespace Aseba
 		Target::ExecutionMode previousMode;
 		bool showHidden;
 		
+		Compiler compiler; //!< compiler kept between compilations, to reuse the code of unchanged event handlers and subroutines
 		QFuture<CompilationResult*> compilationFuture;
 		QFutureWatcher<CompilationResult*> compilationWatcher;
 		bool compilationDirty;
@@ -476,6 +477,9 @@ namespace Aseba
 		void variablesMemoryChanged(unsigned node, unsigned start, const VariablesDataVector &variables);
 		
 		void breakpointSetResult(unsigned node, unsigned line, bool success);
+		
+		void bytecodeUploadProgress(unsigned node, unsigned words, unsigned total);
+		void bytecodeUploadFinished(unsigned node, bool success);
 	
 		void recompileAll();
 		void writeAllBytecodes();
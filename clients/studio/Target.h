@@ -86,6 +86,11 @@ namespace Aseba
 		//! The result of a set breakpoint call
 		void breakpointSetResult(unsigned node, unsigned line, bool success);
 		
+		//! Words out of total of the bytecode of a node were uploaded
+		void bytecodeUploadProgress(unsigned node, unsigned words, unsigned total);
+		//! The upload of the bytecode of a node is over; if it failed, the node may hold a partial program
+		void bytecodeUploadFinished(unsigned node, bool success);
+		
 		//! We received an ack from the bootloader
 		void bootloaderAck(unsigned errorCode, unsigned errorAddress);
 		
@@ -133,6 +138,12 @@ namespace Aseba
 		//! Get part of variables memory
 		virtual void getVariables(unsigned node, unsigned start, unsigned length) = 0;
 		
+		//! Get part of variables memory, transferring only what changed since the last call; return false if the node does not support it
+		virtual bool getVariablesDelta(unsigned node, unsigned start, unsigned length) = 0;
+		
+		//! Have part of variables memory sent whenever it changes, at most every period ms, as long as this is called again regularly; return false if the node does not support it
+		virtual bool watchVariables(unsigned node, unsigned start, unsigned length, unsigned period) = 0;
+		
 		// execution
 		
 		//! Reset the execution of a node, do not clear bytecode nor breakpoints
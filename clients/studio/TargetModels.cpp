@@ -271,34 +271,25 @@ namespace Aseba
 	
 	unsigned TargetVariablesModel::getVariablePos(const QString& name) const
 	{
-		for (int i = 0; i < variables.size(); ++i)
-		{
-			const Variable& variable(variables[i]);
-			if (variable.name == name)
-				return variable.pos;
-		}
+		const QHash<QString, int>::const_iterator it(variablesRows.constFind(name));
+		if (it != variablesRows.constEnd())
+			return variables[it.value()].pos;
 		return 0;
 	}
 	
 	unsigned TargetVariablesModel::getVariableSize(const QString& name) const
 	{
-		for (int i = 0; i < variables.size(); ++i)
-		{
-			const Variable& variable(variables[i]);
-			if (variable.name == name)
-				return variable.value.size();
-		}
+		const QHash<QString, int>::const_iterator it(variablesRows.constFind(name));
+		if (it != variablesRows.constEnd())
+			return variables[it.value()].value.size();
 		return 0;
 	}
 	
 	VariablesDataVector TargetVariablesModel::getVariableValue(const QString& name) const
 	{
-		for (int i = 0; i < variables.size(); ++i)
-		{
-			const Variable& variable(variables[i]);
-			if (variable.name == name)
-				return variable.value;
-		}
+		const QHash<QString, int>::const_iterator it(variablesRows.constFind(name));
+		if (it != variablesRows.constEnd())
+			return variables[it.value()].value;
 		return VariablesDataVector();
 	}
 	
@@ -355,6 +346,10 @@ namespace Aseba
 				variables.append(newVariables[j]);
 			endInsertRows();
 		}
+		
+		variablesRows.clear();
+		for (int j = 0; j < variables.size(); ++j)
+			variablesRows.insert(variables[j].name, j);
 
 		/*variables.clear();
 		for (Compiler::VariablesMap::const_iterator it = variablesMap->begin(); it != variablesMap->end(); ++it)
@@ -378,51 +373,70 @@ namespace Aseba
 		reset();*/
 	}
 	
+	int TargetVariablesModel::firstVariableAfter(unsigned address) const
+	{
+		// binary search, variables do not overlap
+		int lo(0), hi(variables.size());
+		while (lo < hi)
+		{
+			const int mid((lo + hi) / 2);
+			const Variable& var(variables[mid]);
+			if (var.pos + var.value.size() <= address)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+	
 	void TargetVariablesModel::setVariablesData(unsigned start, const VariablesDataVector &data)
 	{
-		size_t dataLength = data.size();
-		for (int i = 0; i < variables.size(); ++i)
+		const unsigned end(start + data.size());
+		for (int i = firstVariableAfter(start); i < variables.size() && variables[i].pos < end; ++i)
 		{
 			Variable &var = variables[i];
-			int varLen = (int)var.value.size();
-			int varStart = (int)start - (int)var.pos;
-			int copyLen = (int)dataLength;
-			int copyStart = 0;
-			// crop data before us
-			if (varStart < 0)
-			{
-				copyLen += varStart;
-				copyStart -= varStart;
-				varStart = 0;
-			}
-			// if nothing to copy, continue
-			if (copyLen <= 0)
+			const unsigned copyStart(std::max(start, var.pos));
+			const unsigned copyEnd(std::min(end, unsigned(var.pos + var.value.size())));
+			if (copyStart >= copyEnd)
 				continue;
-			// crop data after us
-			if (varStart + copyLen > varLen)
+			
+			// copy only what changed
+			int firstChanged(-1), lastChanged(-1);
+			for (unsigned address = copyStart; address < copyEnd; ++address)
 			{
-				copyLen = varLen - varStart;
+				const int row(address - var.pos);
+				const sint16 value(data[address - start]);
+				if (var.value[row] != value)
+				{
+					var.value[row] = value;
+					if (firstChanged < 0)
+						firstChanged = row;
+					lastChanged = row;
+				}
 			}
-			// if nothing to copy, continue
-			if (copyLen <= 0)
-				continue;
-			
-			// copy
-			copy(data.begin() + copyStart, data.begin() + copyStart + copyLen, var.value.begin() + varStart);
-			
-			// notify gui
-			QModelIndex parentIndex = index(i, 0);
-			emit dataChanged(index(varStart, 0, parentIndex), index(varStart + copyLen, 0, parentIndex));
 			
-			// and notify view plugins
-			for (VariableListenersNameMap::iterator it = variableListenersMap.begin(); it != variableListenersMap.end(); ++it)
+			// notify gui, scalars are shown on the row of the variable
+			if (firstChanged >= 0)
 			{
-				QStringList &list = it.value();
-				for (int v = 0; v < list.size(); v++)
+				if (var.value.size() == 1)
 				{
-					if (list[v] == var.name)
-						it.key()->variableValueUpdated(var.name, var.value);
+					emit dataChanged(index(i, 1), index(i, 1));
 				}
+				else
+				{
+					QModelIndex parentIndex = index(i, 0);
+					emit dataChanged(index(firstChanged, 1, parentIndex), index(lastChanged, 1, parentIndex));
+				}
+			}
+			
+			// and notify view plugins, even if the values are the same, as they might be waiting for fresh values
+			const VariableNameListenersMap::const_iterator it(variableNameListenersMap.constFind(var.name));
+			if (it != variableNameListenersMap.constEnd())
+			{
+				// a listener might unsubscribe while being notified
+				const QList<VariableListener*> listeners(it.value());
+				for (int l = 0; l < listeners.size(); ++l)
+					listeners[l]->variableValueUpdated(var.name, var.value);
 			}
 		}
 	}
@@ -444,29 +458,47 @@ namespace Aseba
 	
 	void TargetVariablesModel::unsubscribeViewPlugin(VariableListener* listener)
 	{
-		variableListenersMap.remove(listener);
+		unsubscribeToVariablesOfInterest(listener);
 	}
 	
 	bool TargetVariablesModel::subscribeToVariableOfInterest(VariableListener* listener, const QString& name)
 	{
 		QStringList &list = variableListenersMap[listener];
 		list.push_back(name);
-		for (int i = 0; i < variables.size(); i++)
-			if (variables[i].name == name)
-				return true;
-		return false;
+		variableNameListenersMap[name].push_back(listener);
+		return variablesRows.contains(name);
 	}
 	
 	void TargetVariablesModel::unsubscribeToVariableOfInterest(VariableListener* listener, const QString& name)
 	{
 		QStringList &list = variableListenersMap[listener];
 		list.removeAll(name);
+		VariableNameListenersMap::iterator it(variableNameListenersMap.find(name));
+		if (it != variableNameListenersMap.end())
+		{
+			it.value().removeAll(listener);
+			if (it.value().isEmpty())
+				variableNameListenersMap.erase(it);
+		}
 	}
 	
 	void TargetVariablesModel::unsubscribeToVariablesOfInterest(VariableListener* plugin)
 	{
 		if (variableListenersMap.contains(plugin))
+		{
+			const QStringList names(variableListenersMap.value(plugin));
+			for (int i = 0; i < names.size(); ++i)
+			{
+				VariableNameListenersMap::iterator it(variableNameListenersMap.find(names[i]));
+				if (it != variableNameListenersMap.end())
+				{
+					it.value().removeAll(plugin);
+					if (it.value().isEmpty())
+						variableNameListenersMap.erase(it);
+				}
+			}
 			variableListenersMap.remove(plugin);
+		}
 	}
 	
 	struct TargetFunctionsModel::TreeItem
@@ -26,6 +26,7 @@
 #include <QStringListModel>
 #include <QVector>
 #include <QList>
+#include <QHash>
 #include <QString>
 #include <QStringList>
 #include <QRegExp>
@@ -64,8 +65,6 @@ namespace Aseba
 	class TargetVariablesModel: public QAbstractItemModel
 	{
 		Q_OBJECT
-		
-		// FIXME: uses map for fast variable access
 	
 	public:
 		// variables
@@ -121,12 +120,20 @@ namespace Aseba
 		//! Unsubscribe to all variables of interest for a given plugin
 		void unsubscribeToVariablesOfInterest(VariableListener* plugin);
 		
+		//! Return the row of the first variable ending after address, variables are sorted by position
+		int firstVariableAfter(unsigned address) const;
+		
 	private:
 		QList<Variable> variables;
+		//! Row of each variable in variables, by name
+		QHash<QString, int> variablesRows;
 		
 		// VariablesViewPlugin API 
 		typedef QMap<VariableListener*, QStringList> VariableListenersNameMap;
 		VariableListenersNameMap variableListenersMap;
+		//! The same subscriptions by variable name, to only look at the listeners of the variables that changed
+		typedef QHash<QString, QList<VariableListener*> > VariableNameListenersMap;
+		VariableNameListenersMap variableNameListenersMap;
 	};
 	
 	class TargetFunctionsModel: public QAbstractItemModel
@@ -163,6 +163,9 @@ typedef enum
 	ASEBA_MESSAGE_NODE_SPECIFIC_ERROR,
 	ASEBA_MESSAGE_EXECUTION_STATE_CHANGED,
 	ASEBA_MESSAGE_BREAKPOINT_SET_RESULT,
+	ASEBA_MESSAGE_CAPABILITIES,
+	ASEBA_MESSAGE_VARIABLES_DELTA,
+	ASEBA_MESSAGE_BYTECODE_CHECKSUM,
 	
 	/* from IDE to all nodes */
 	ASEBA_MESSAGE_GET_DESCRIPTION = 0xA000,
@@ -183,10 +186,28 @@ typedef enum
 	ASEBA_MESSAGE_WRITE_BYTECODE,
 	ASEBA_MESSAGE_REBOOT,
 	ASEBA_MESSAGE_SUSPEND_TO_RAM,
+	ASEBA_MESSAGE_GET_VARIABLES_DELTA,
+	ASEBA_MESSAGE_WATCH_VARIABLES,
+	ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM,
+	ASEBA_MESSAGE_GET_CAPABILITIES,
 	
 	ASEBA_MESSAGE_INVALID = 0xFFFF
 } AsebaSystemMessagesTypes;
 
+/*! Optional features of a node, sent in a capabilities message in answer to ASEBA_MESSAGE_GET_CAPABILITIES */
+typedef enum
+{
+	/*! The node answers ASEBA_MESSAGE_GET_VARIABLES_DELTA with ASEBA_MESSAGE_VARIABLES_DELTA */
+	ASEBA_CAPABILITY_VARIABLES_DELTA = 0x1,
+	/*! The node, or a switch on its behalf, answers ASEBA_MESSAGE_WATCH_VARIABLES by sending ASEBA_MESSAGE_VARIABLES when the watched ones change */
+	ASEBA_CAPABILITY_WATCH_VARIABLES = 0x2,
+	/*! The node answers ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM with ASEBA_MESSAGE_BYTECODE_CHECKSUM, so that uploads can be verified */
+	ASEBA_CAPABILITY_BYTECODE_CHECKSUM = 0x4
+} AsebaCapabilities;
+
+/*! Duration in ms for which an ASEBA_MESSAGE_WATCH_VARIABLES request holds, clients renew it before it expires */
+#define ASEBA_VARIABLES_WATCH_LEASE 4000
+
 /*! Identifiers for destinations */
 typedef enum
 {
@@ -0,0 +1,237 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "bytecode-uploader.h"
+#include "../consts.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! Time after which a chunk whose checksum did not come back is sent again, in ms
+	static const UnifiedTime::Value checksumTimeout = 500;
+	//! Number of words of bytecode per message, as sendBytecode() does
+	static const unsigned chunkSize = ASEBA_MAX_EVENT_ARG_COUNT - 2;
+
+	BytecodeUploader::Chunk::Chunk(uint16 start, uint16 length, uint16 crc) :
+		start(start),
+		length(length),
+		crc(crc),
+		state(CHUNK_PENDING),
+		attempts(0),
+		lastSent(0)
+	{
+	}
+
+	BytecodeUploader::BytecodeUploader(unsigned window, unsigned maxAttempts) :
+		window(std::max(window, 1u)),
+		maxAttempts(maxAttempts)
+	{
+	}
+
+	void BytecodeUploader::startUpload(unsigned nodeId, const std::vector<uint16>& bytecode)
+	{
+		Upload& upload(uploads[nodeId]);
+		upload.bytecode = bytecode;
+		upload.chunks.clear();
+		const CapabilitiesMap::const_iterator capableIt(checksumCapable.find(nodeId));
+		upload.verified = (capableIt != checksumCapable.end()) && capableIt->second;
+		upload.inFlight = 0;
+		upload.wordsDone = 0;
+
+		// as sendBytecode(), always send at least one chunk, as it resets the node
+		unsigned start(0);
+		do
+		{
+			const unsigned length(std::min<unsigned>(chunkSize, bytecode.size() - start));
+			// as the node, hash each word low byte first, whatever the byte order of the host
+			uint16 crc(0);
+			for (unsigned i = start; i < start + length; ++i)
+			{
+				const uint8 bytes[2] = { uint8(bytecode[i] & 0xff), uint8(bytecode[i] >> 8) };
+				crc = crcXModem(crc, bytes, 2);
+			}
+			upload.chunks.push_back(Chunk(start, length, crc));
+			start += length;
+		}
+		while (start < bytecode.size());
+
+		sendChunks(nodeId, upload);
+	}
+
+	void BytecodeUploader::cancelUpload(unsigned nodeId)
+	{
+		uploads.erase(nodeId);
+	}
+
+	bool BytecodeUploader::isUploading(unsigned nodeId) const
+	{
+		return uploads.find(nodeId) != uploads.end();
+	}
+
+	void BytecodeUploader::processMessage(const Message* message)
+	{
+		// a new description resets what we know about a node, whose capabilities our client asks for
+		if (dynamic_cast<const Description *>(message))
+		{
+			checksumCapable[message->source] = false;
+			return;
+		}
+		{
+			const Capabilities *capabilities = dynamic_cast<const Capabilities *>(message);
+			if (capabilities)
+			{
+				checksumCapable[capabilities->source] = (capabilities->capabilities & ASEBA_CAPABILITY_BYTECODE_CHECKSUM) != 0;
+				return;
+			}
+		}
+
+		// uploads to a disconnected node fail
+		if (dynamic_cast<const Disconnected *>(message))
+		{
+			if (isUploading(message->source))
+				finishUpload(message->source, UPLOAD_FAILED);
+			return;
+		}
+
+		const BytecodeChecksum *checksum = dynamic_cast<const BytecodeChecksum *>(message);
+		if (!checksum)
+			return;
+		const unsigned nodeId(checksum->source);
+		const UploadsMap::iterator uploadIt(uploads.find(nodeId));
+		if (uploadIt == uploads.end() || !uploadIt->second.verified)
+			return;
+		Upload& upload(uploadIt->second);
+
+		// chunks are in address order, answers to resent chunks or to other clients are ignored
+		Chunks::iterator chunkIt(upload.chunks.begin());
+		while (chunkIt != upload.chunks.end() && chunkIt->start < checksum->start)
+			++chunkIt;
+		if (chunkIt == upload.chunks.end() || chunkIt->start != checksum->start || chunkIt->length != checksum->length || chunkIt->state != CHUNK_IN_FLIGHT)
+			return;
+		--upload.inFlight;
+		if (chunkIt->crc == checksum->crc)
+		{
+			chunkIt->state = CHUNK_DONE;
+			upload.wordsDone += chunkIt->length;
+			uploadProgress(nodeId, upload.wordsDone, upload.bytecode.size());
+		}
+		else
+			chunkIt->state = CHUNK_PENDING;
+
+		bool done(true);
+		for (Chunks::const_iterator it(upload.chunks.begin()); it != upload.chunks.end(); ++it)
+			done = done && (it->state == CHUNK_DONE);
+		if (done)
+		{
+			finishUpload(nodeId, UPLOAD_VERIFIED);
+			return;
+		}
+		if (!sendChunks(nodeId, upload))
+			finishUpload(nodeId, UPLOAD_FAILED);
+	}
+
+	void BytecodeUploader::stepUploads()
+	{
+		const UnifiedTime now;
+		std::vector<std::pair<unsigned, UploadResult> > finished;
+
+		for (UploadsMap::iterator it(uploads.begin()); it != uploads.end(); ++it)
+		{
+			const unsigned nodeId(it->first);
+			Upload& upload(it->second);
+			if (upload.verified)
+			{
+				// either the chunk or its checksum was lost
+				for (Chunks::iterator chunkIt(upload.chunks.begin()); chunkIt != upload.chunks.end(); ++chunkIt)
+				{
+					if (chunkIt->state == CHUNK_IN_FLIGHT && (now - chunkIt->lastSent).value >= checksumTimeout)
+					{
+						chunkIt->state = CHUNK_PENDING;
+						--upload.inFlight;
+					}
+				}
+				if (!sendChunks(nodeId, upload))
+					finished.push_back(std::make_pair(nodeId, UPLOAD_FAILED));
+			}
+			else
+			{
+				sendChunks(nodeId, upload);
+				if (upload.chunks.back().state == CHUNK_DONE)
+					finished.push_back(std::make_pair(nodeId, UPLOAD_UNVERIFIED));
+			}
+		}
+
+		// uploadFinished() may start new uploads
+		for (size_t i = 0; i < finished.size(); ++i)
+			finishUpload(finished[i].first, finished[i].second);
+	}
+
+	bool BytecodeUploader::sendChunks(unsigned nodeId, Upload& upload)
+	{
+		const UnifiedTime now;
+		unsigned sent(0);
+		for (Chunks::iterator it(upload.chunks.begin()); it != upload.chunks.end(); ++it)
+		{
+			if (upload.verified ? (upload.inFlight >= window) : (sent >= window))
+				break;
+			Chunk& chunk(*it);
+			if (chunk.state != CHUNK_PENDING)
+				continue;
+			if (chunk.attempts >= maxAttempts)
+				return false;
+
+			SetBytecode setBytecode(nodeId, chunk.start);
+			setBytecode.bytecode.assign(upload.bytecode.begin() + chunk.start, upload.bytecode.begin() + chunk.start + chunk.length);
+			sendUploadMessage(setBytecode);
+			++chunk.attempts;
+			chunk.lastSent = now;
+			++sent;
+			if (upload.verified)
+			{
+				GetBytecodeChecksum getChecksum(nodeId, chunk.start, chunk.length);
+				sendUploadMessage(getChecksum);
+				chunk.state = CHUNK_IN_FLIGHT;
+				++upload.inFlight;
+			}
+			else
+			{
+				chunk.state = CHUNK_DONE;
+				upload.wordsDone += chunk.length;
+			}
+		}
+		if (!upload.verified && sent)
+			uploadProgress(nodeId, upload.wordsDone, upload.bytecode.size());
+		return true;
+	}
+
+	void BytecodeUploader::finishUpload(unsigned nodeId, UploadResult result)
+	{
+		uploads.erase(nodeId);
+		uploadFinished(nodeId, result);
+	}
+
+	/*@}*/
+} // namespace Aseba
@@ -0,0 +1,127 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ASEBA_BYTECODE_UPLOADER_H
+#define ASEBA_BYTECODE_UPLOADER_H
+
+#include "msg.h"
+#include "../utils/utils.h"
+#include <map>
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! This helper class uploads bytecode to many nodes at once, interleaving the ASEBA_MESSAGE_SET_BYTECODE chunks of all nodes.
+	//! Nodes that advertise ASEBA_CAPABILITY_BYTECODE_CHECKSUM get each chunk verified by its checksum, with at most window chunks
+	//! waiting for their checksum at a time; chunks whose checksum is wrong or does not come back are sent again, the others are not.
+	//! Other nodes get window chunks per call to stepUploads(), without verification.
+	//! Its client must ask every node whose description starts for its capabilities, as DescriptionsManager does.
+	class BytecodeUploader
+	{
+	public:
+		//! Outcome of an upload
+		enum UploadResult
+		{
+			UPLOAD_VERIFIED, //!< all chunks were sent and their checksums match
+			UPLOAD_UNVERIFIED, //!< all chunks were sent, but the node cannot check them
+			UPLOAD_FAILED //!< a chunk could not be verified after maxAttempts, or the node disconnected
+		};
+
+	protected:
+		//! State of a chunk of bytecode
+		enum ChunkState
+		{
+			CHUNK_PENDING, //!< to send, or to send again
+			CHUNK_IN_FLIGHT, //!< sent, waiting for its checksum
+			CHUNK_DONE //!< verified, or sent if the node cannot verify it
+		};
+		//! A range of bytecode sent in a single message
+		struct Chunk
+		{
+			Chunk(uint16 start, uint16 length, uint16 crc);
+
+			uint16 start; //!< address of the first word
+			uint16 length; //!< number of words
+			uint16 crc; //!< expected checksum of these words
+			ChunkState state; //!< where this chunk is in the upload
+			unsigned attempts; //!< number of times this chunk was sent
+			UnifiedTime lastSent; //!< when this chunk was last sent
+		};
+		typedef std::vector<Chunk> Chunks;
+		//! Upload to a node
+		struct Upload
+		{
+			std::vector<uint16> bytecode; //!< bytecode to upload
+			Chunks chunks; //!< chunks of bytecode, in address order
+			bool verified; //!< whether the node checks the chunks
+			unsigned inFlight; //!< number of chunks waiting for their checksum
+			unsigned wordsDone; //!< number of words verified, or sent if the node cannot verify them
+		};
+		typedef std::map<unsigned, Upload> UploadsMap;
+		UploadsMap uploads; //!< uploads in progress, by node
+
+		typedef std::map<unsigned, bool> CapabilitiesMap;
+		CapabilitiesMap checksumCapable; //!< for each node seen, whether it advertised ASEBA_CAPABILITY_BYTECODE_CHECKSUM
+
+		const unsigned window; //!< maximum number of chunks in flight per node
+		const unsigned maxAttempts; //!< number of times a chunk is sent before the upload is considered failed
+
+	public:
+		//! Constructor, with at most window chunks in flight per node, each sent at most maxAttempts times
+		BytecodeUploader(unsigned window = 4, unsigned maxAttempts = 4);
+		//! Virtual destructor
+		virtual ~BytecodeUploader() {}
+
+		//! Start uploading bytecode to a node, replacing any upload in progress to this node
+		void startUpload(unsigned nodeId, const std::vector<uint16>& bytecode);
+		//! Stop uploading to a node, without calling uploadFinished()
+		void cancelUpload(unsigned nodeId);
+		//! Return whether an upload to nodeId is in progress
+		bool isUploading(unsigned nodeId) const;
+		//! Return whether any upload is in progress
+		bool isUploading() const { return !uploads.empty(); }
+
+		//! Process a message received from the network, to learn the capabilities of nodes and check the checksums of chunks
+		void processMessage(const Message* message);
+		//! Send the chunks that are due and resend those whose checksum did not come back in time; to call regularly while uploading
+		void stepUploads();
+
+	protected:
+		//! Send pending chunks of an upload until window chunks are in flight, return false if a chunk was sent too many times
+		bool sendChunks(unsigned nodeId, Upload& upload);
+		//! Remove the upload to nodeId and call uploadFinished()
+		void finishUpload(unsigned nodeId, UploadResult result);
+
+		//! Virtual function that is called to send a message on the network
+		virtual void sendUploadMessage(Message& message) = 0;
+		//! Virtual function that is called when words out of total were uploaded to nodeId; it must not start or cancel uploads
+		virtual void uploadProgress(unsigned nodeId, unsigned words, unsigned total) {}
+		//! Virtual function that is called when the upload to nodeId is over; the node is left in step-by-step mode, ready to run
+		virtual void uploadFinished(unsigned nodeId, UploadResult result) {}
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif
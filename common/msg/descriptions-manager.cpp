@@ -59,6 +59,10 @@ namespace Aseba
 			const Description *description = dynamic_cast<const Description *>(message);
 			if (description)
 			{
+				// a new description resets what helpers know about a node, so we ask for its capabilities again
+				GetCapabilities getCapabilities(description->source);
+				sendDescriptionsMessage(getCapabilities);
+				
 				NodesDescriptionsMap::iterator it = nodesDescriptions.find(description->source);
 				
 				// We can receive a description twice, for instance if there is another IDE connected
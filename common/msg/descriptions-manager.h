@@ -30,7 +30,8 @@ namespace Aseba
 	/*@{*/
 	
 	//! This helper class builds complete descriptions out of multiple message parts.
-	//! For now, it does not support the disconnection of a whole network nor the update of the description of any node
+	//! For now, it does not support the disconnection of a whole network nor the update of the description of any node.
+	//! It asks every node whose description starts for its capabilities, once for the WatchesManager and BytecodeUploader of the client.
 	class DescriptionsManager
 	{
 	protected:
@@ -80,6 +81,9 @@ namespace Aseba
 		
 		//! Virtual function that is called when a node description has been fully received
 		virtual void nodeDescriptionReceived(unsigned nodeId) { }
+		
+		//! Virtual function that is called to send a message on the network, clients that need the capabilities of nodes must implement it
+		virtual void sendDescriptionsMessage(Message& message) { }
 	};
 	
 	/*@}*/
@@ -56,6 +56,9 @@ namespace Aseba
 			registerMessageType<NodeSpecificError>(ASEBA_MESSAGE_NODE_SPECIFIC_ERROR);
 			registerMessageType<ExecutionStateChanged>(ASEBA_MESSAGE_EXECUTION_STATE_CHANGED);
 			registerMessageType<BreakpointSetResult>(ASEBA_MESSAGE_BREAKPOINT_SET_RESULT);
+			registerMessageType<Capabilities>(ASEBA_MESSAGE_CAPABILITIES);
+			registerMessageType<VariablesDelta>(ASEBA_MESSAGE_VARIABLES_DELTA);
+			registerMessageType<BytecodeChecksum>(ASEBA_MESSAGE_BYTECODE_CHECKSUM);
 			
 			registerMessageType<GetDescription>(ASEBA_MESSAGE_GET_DESCRIPTION);
 			
@@ -81,6 +84,10 @@ namespace Aseba
 			registerMessageType<WriteBytecode>(ASEBA_MESSAGE_WRITE_BYTECODE);
 			registerMessageType<Reboot>(ASEBA_MESSAGE_REBOOT);
 			registerMessageType<Sleep>(ASEBA_MESSAGE_SUSPEND_TO_RAM);
+			registerMessageType<GetVariablesDelta>(ASEBA_MESSAGE_GET_VARIABLES_DELTA);
+			registerMessageType<WatchVariables>(ASEBA_MESSAGE_WATCH_VARIABLES);
+			registerMessageType<GetBytecodeChecksum>(ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM);
+			registerMessageType<GetCapabilities>(ASEBA_MESSAGE_GET_CAPABILITIES);
 		}
 		
 		//! Register a message type by storing a pointer to its constructor
@@ -674,6 +681,106 @@ namespace Aseba
 	
 	//
 	
+	void Capabilities::serializeSpecific()
+	{
+		add(capabilities);
+	}
+	
+	void Capabilities::deserializeSpecific()
+	{
+		capabilities = get<uint16>();
+	}
+	
+	void Capabilities::dumpSpecific(wostream &stream) const
+	{
+		stream << hex << showbase << capabilities << dec << noshowbase;
+	}
+	
+	//
+	
+	bool VariablesDelta::apply(std::vector<sint16>& variables) const
+	{
+		size_t pos = start;
+		const size_t end = size_t(start) + length;
+		if (end > variables.size())
+			return false;
+		for (size_t i = 0; i < runs.size(); ++i)
+		{
+			pos += runs[i].skip;
+			if (pos + runs[i].values.size() > end)
+				return false;
+			for (size_t j = 0; j < runs[i].values.size(); ++j, ++pos)
+				variables[pos] ^= runs[i].values[j];
+		}
+		return true;
+	}
+	
+	void VariablesDelta::serializeSpecific()
+	{
+		add(dest);
+		add(start);
+		add(length);
+		add(baseVersion);
+		add(version);
+		for (size_t i = 0; i < runs.size(); ++i)
+		{
+			add(runs[i].skip);
+			add(static_cast<uint16>(runs[i].values.size()));
+			for (size_t j = 0; j < runs[i].values.size(); ++j)
+				add(runs[i].values[j]);
+		}
+	}
+	
+	void VariablesDelta::deserializeSpecific()
+	{
+		dest = get<uint16>();
+		start = get<uint16>();
+		length = get<uint16>();
+		baseVersion = get<uint16>();
+		version = get<uint16>();
+		runs.clear();
+		while (readPos < rawData.size())
+		{
+			runs.push_back(Run());
+			runs.back().skip = get<uint16>();
+			runs.back().values.resize(get<uint16>());
+			for (size_t j = 0; j < runs.back().values.size(); ++j)
+				runs.back().values[j] = get<uint16>();
+		}
+	}
+	
+	void VariablesDelta::dumpSpecific(wostream &stream) const
+	{
+		size_t changed(0);
+		for (size_t i = 0; i < runs.size(); ++i)
+			changed += runs[i].values.size();
+		stream << "dest " << dest << ", start " << start << ", length " << length;
+		stream << ", version " << baseVersion << " to " << version << ", " << changed << " values in " << runs.size() << " runs";
+	}
+	
+	//
+	
+	void BytecodeChecksum::serializeSpecific()
+	{
+		add(start);
+		add(length);
+		add(crc);
+	}
+	
+	void BytecodeChecksum::deserializeSpecific()
+	{
+		start = get<uint16>();
+		length = get<uint16>();
+		crc = get<uint16>();
+	}
+	
+	void BytecodeChecksum::dumpSpecific(wostream &stream) const
+	{
+		stream << "start " << start << ", length " << length << ", crc " << hex << showbase << crc << dec << noshowbase;
+	}
+	
+	//
+	
 	void CmdMessage::serializeSpecific()
 	{
 		add(dest);
@@ -953,4 +1060,106 @@ namespace Aseba
 		
 		stream << "start " << start << ", variables vector of size " << variables.size();
 	}
+	
+	//
+	
+	GetVariablesDelta::GetVariablesDelta(uint16 dest, uint16 start, uint16 length, uint16 baseVersion) :
+		CmdMessage(ASEBA_MESSAGE_GET_VARIABLES_DELTA, dest),
+		start(start),
+		length(length),
+		baseVersion(baseVersion)
+	{
+	}
+	
+	void GetVariablesDelta::serializeSpecific()
+	{
+		CmdMessage::serializeSpecific();
+		
+		add(start);
+		add(length);
+		add(baseVersion);
+	}
+	
+	void GetVariablesDelta::deserializeSpecific()
+	{
+		CmdMessage::deserializeSpecific();
+		
+		start = get<uint16>();
+		length = get<uint16>();
+		baseVersion = get<uint16>();
+	}
+	
+	void GetVariablesDelta::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+		
+		stream << "start " << start << ", length " << length << ", since version " << baseVersion;
+	}
+	
+	//
+	
+	WatchVariables::WatchVariables(uint16 dest, uint16 start, uint16 length, uint16 period) :
+		CmdMessage(ASEBA_MESSAGE_WATCH_VARIABLES, dest),
+		start(start),
+		length(length),
+		period(period)
+	{
+	}
+	
+	void WatchVariables::serializeSpecific()
+	{
+		CmdMessage::serializeSpecific();
+		
+		add(start);
+		add(length);
+		add(period);
+	}
+	
+	void WatchVariables::deserializeSpecific()
+	{
+		CmdMessage::deserializeSpecific();
+		
+		start = get<uint16>();
+		length = get<uint16>();
+		period = get<uint16>();
+	}
+	
+	void WatchVariables::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+		
+		stream << "start " << start << ", length " << length << ", every " << period << " ms at most";
+	}
+	
+	//
+	
+	GetBytecodeChecksum::GetBytecodeChecksum(uint16 dest, uint16 start, uint16 length) :
+		CmdMessage(ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM, dest),
+		start(start),
+		length(length)
+	{
+	}
+	
+	void GetBytecodeChecksum::serializeSpecific()
+	{
+		CmdMessage::serializeSpecific();
+		
+		add(start);
+		add(length);
+	}
+	
+	void GetBytecodeChecksum::deserializeSpecific()
+	{
+		CmdMessage::deserializeSpecific();
+		
+		start = get<uint16>();
+		length = get<uint16>();
+	}
+	
+	void GetBytecodeChecksum::dumpSpecific(wostream &stream) const
+	{
+		CmdMessage::dumpSpecific(stream);
+		
+		stream << "start " << start << ", length " << length;
+	}
 } // namespace Aseba
@@ -351,6 +351,72 @@ namespace Aseba
 		virtual operator const char * () const { return "breakpoint set result"; }
 	};
 	
+	//! Optional features of a node, sent in answer to GetCapabilities by nodes having some
+	class Capabilities : public Message
+	{
+	public:
+		uint16 capabilities;
+		
+	public:
+		Capabilities() : Message(ASEBA_MESSAGE_CAPABILITIES), capabilities(0) { }
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "capabilities"; }
+	};
+	
+	//! Content of some variables, as the difference to the version of these variables the client already has
+	class VariablesDelta : public Message
+	{
+	public:
+		//! Changed variables following some unchanged ones, xored with their previous values
+		struct Run
+		{
+			uint16 skip;
+			std::vector<uint16> values;
+		};
+		typedef std::vector<Run> Runs;
+		
+		uint16 dest; //!< source of the clients this message is for, ASEBA_DEST_DEBUG for all of them
+		uint16 start;
+		uint16 length;
+		uint16 baseVersion; //!< version this message is a difference to, 0 for a difference to zero
+		uint16 version; //!< version of the variables once this message is applied
+		Runs runs;
+		
+	public:
+		VariablesDelta() : Message(ASEBA_MESSAGE_VARIABLES_DELTA) { }
+		
+		//! Apply the runs to a copy of the variables of the node, return false if they do not fit in the message range or in variables
+		bool apply(std::vector<sint16>& variables) const;
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "variables delta"; }
+	};
+	
+	//! XModem CRC of a range of the bytecode of a node, in answer to GetBytecodeChecksum
+	class BytecodeChecksum : public Message
+	{
+	public:
+		uint16 start;
+		uint16 length;
+		uint16 crc;
+		
+	public:
+		BytecodeChecksum() : Message(ASEBA_MESSAGE_BYTECODE_CHECKSUM), start(0), length(0), crc(0) { }
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "bytecode checksum"; }
+	};
+	
 	//! Commands messages talk to a specific node
 	class CmdMessage : public Message
 	{
@@ -600,6 +666,73 @@ namespace Aseba
 		virtual operator const char * () const { return "set variables"; }
 	};
 	
+	//! Read some variables from a node, which only sends those that changed since baseVersion
+	class GetVariablesDelta : public CmdMessage
+	{
+	public:
+		uint16 start;
+		uint16 length;
+		uint16 baseVersion;
+		
+	public:
+		GetVariablesDelta() : CmdMessage(ASEBA_MESSAGE_GET_VARIABLES_DELTA, ASEBA_DEST_INVALID) { }
+		GetVariablesDelta(uint16 dest, uint16 start, uint16 length, uint16 baseVersion);
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "get variables delta"; }
+	};
+	
+	//! Ask a node to send some variables whenever they change, at most once per period ms, until the request is not renewed for ASEBA_VARIABLES_WATCH_LEASE ms
+	class WatchVariables : public CmdMessage
+	{
+	public:
+		uint16 start;
+		uint16 length;
+		uint16 period;
+		
+	public:
+		WatchVariables() : CmdMessage(ASEBA_MESSAGE_WATCH_VARIABLES, ASEBA_DEST_INVALID) { }
+		WatchVariables(uint16 dest, uint16 start, uint16 length, uint16 period);
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "watch variables"; }
+	};
+	
+	//! Ask a node for the XModem CRC of a range of its bytecode, to verify an upload
+	class GetBytecodeChecksum : public CmdMessage
+	{
+	public:
+		uint16 start;
+		uint16 length;
+		
+	public:
+		GetBytecodeChecksum() : CmdMessage(ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM, ASEBA_DEST_INVALID) { }
+		GetBytecodeChecksum(uint16 dest, uint16 start, uint16 length);
+		
+	protected:
+		virtual void serializeSpecific();
+		virtual void deserializeSpecific();
+		virtual void dumpSpecific(std::wostream &stream) const;
+		virtual operator const char * () const { return "get bytecode checksum"; }
+	};
+	
+	//! Ask a node for its optional features, which it sends in a capabilities message; nodes without any do not answer
+	class GetCapabilities : public CmdMessage
+	{
+	public:
+		GetCapabilities() : CmdMessage(ASEBA_MESSAGE_GET_CAPABILITIES, ASEBA_DEST_INVALID) { }
+		GetCapabilities(uint16 dest) : CmdMessage(ASEBA_MESSAGE_GET_CAPABILITIES, dest) { }
+		
+	protected:
+		virtual operator const char * () const { return "get capabilities"; }
+	};
+	
 	//! Save the current bytecode of a node
 	class WriteBytecode : public CmdMessage
 	{
@@ -0,0 +1,306 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "watches-manager.h"
+#include "../consts.h"
+#include <algorithm>
+
+using namespace std;
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! Time after which a poll that was not answered is sent again, in ms
+	static const UnifiedTime::Value pollTimeout = 1000;
+	//! Time after which a node that was asked for its capabilities is considered not to have any, in ms
+	static const UnifiedTime::Value capabilitiesTimeout = 500;
+	//! Maximum number of requests from clients that we remember per node, in case some are never answered
+	static const unsigned maxClientRequestsPending = 16;
+
+	bool WatchesManager::WatchKey::operator<(const WatchKey& that) const
+	{
+		if (nodeId != that.nodeId)
+			return nodeId < that.nodeId;
+		if (start != that.start)
+			return start < that.start;
+		return length < that.length;
+	}
+
+	WatchesManager::Watch::Watch() :
+		period(0xFFFF),
+		periodLeaseEnd(0),
+		leaseEnd(0),
+		lastRequest(0),
+		pollPending(false),
+		valuesKnown(false)
+	{
+	}
+
+	WatchesManager::NodeState::NodeState() :
+		watchesCapable(false),
+		capabilitiesKnown(false),
+		capabilities(0),
+		capabilitiesRequest(0),
+		clientCapabilitiesPending(false),
+		clientRequestsPending(0)
+	{
+	}
+
+	WatchesManager::WatchesManager(bool proxy) :
+		proxy(proxy)
+	{
+	}
+
+	bool WatchesManager::processMessage(Message* message)
+	{
+		// the capabilities of a node, in answer to our request or to the one of a client
+		{
+			Capabilities *capabilities = dynamic_cast<Capabilities *>(message);
+			if (capabilities)
+			{
+				NodeState& state(nodesStates[capabilities->source]);
+				state.watchesCapable = (capabilities->capabilities & ASEBA_CAPABILITY_WATCH_VARIABLES) != 0;
+				state.capabilitiesKnown = true;
+				state.capabilities = capabilities->capabilities;
+				if (!proxy)
+					return true;
+				// as a proxy, clients only get the answers they asked for
+				if (!state.clientCapabilitiesPending)
+					return false;
+				state.clientCapabilitiesPending = false;
+				capabilities->capabilities |= ASEBA_CAPABILITY_WATCH_VARIABLES;
+				return true;
+			}
+		}
+
+		// a new description resets what we know about a node, whose capabilities our client asks for
+		if (dynamic_cast<Description *>(message))
+		{
+			NodeState& state(nodesStates[message->source]);
+			state = NodeState();
+			state.capabilitiesRequest = UnifiedTime();
+			return true;
+		}
+
+		// as a proxy, we answer the requests of clients for capabilities ourselves once we know them
+		{
+			const GetCapabilities *getCapabilities = dynamic_cast<GetCapabilities *>(message);
+			if (getCapabilities)
+			{
+				if (!proxy)
+					return true;
+				NodeState& state(nodesStates[getCapabilities->dest]);
+				if (state.capabilitiesKnown)
+				{
+					sendProxyCapabilities(getCapabilities->dest, state.capabilities);
+					return false;
+				}
+				state.clientCapabilitiesPending = true;
+				state.capabilitiesRequest = UnifiedTime();
+				return true;
+			}
+		}
+
+		// a disconnected node forgets all its watches
+		if (dynamic_cast<Disconnected *>(message))
+		{
+			const unsigned nodeId(message->source);
+			nodesStates.erase(nodeId);
+			watches.erase(watches.lower_bound(WatchKey(nodeId, 0, 0)), watches.lower_bound(WatchKey(nodeId + 1, 0, 0)));
+			return true;
+		}
+
+		// as a proxy, we handle the watches of clients ourselves
+		{
+			const WatchVariables *watchVariables = dynamic_cast<WatchVariables *>(message);
+			if (watchVariables)
+			{
+				if (!proxy)
+					return true;
+				watch(watchVariables->dest, watchVariables->start, watchVariables->length, watchVariables->period);
+				// a new subscriber to an existing watch gets the current values right away
+				const WatchKey key(watchVariables->dest, watchVariables->start, watchVariables->length);
+				const WatchesMap::const_iterator it(watches.find(key));
+				if (it != watches.end() && it->second.valuesKnown)
+					sendCachedValues(key, it->second);
+				return false;
+			}
+		}
+
+		// remember the requests of clients, so that we never drop their answers
+		{
+			const GetVariables *getVariables = dynamic_cast<GetVariables *>(message);
+			if (getVariables)
+			{
+				NodeState& state(nodesStates[getVariables->dest]);
+				state.clientRequestsPending = std::min(state.clientRequestsPending + 1, maxClientRequestsPending);
+				return true;
+			}
+		}
+
+		// update the watches covering received variables
+		{
+			const Variables *variables = dynamic_cast<Variables *>(message);
+			if (variables)
+			{
+				const unsigned nodeId(variables->source);
+				const unsigned start(variables->start);
+				const unsigned end(start + variables->variables.size());
+				bool answersClient(false);
+				NodesStatesMap::iterator nodeIt(nodesStates.find(nodeId));
+				if (nodeIt != nodesStates.end() && nodeIt->second.clientRequestsPending)
+				{
+					--nodeIt->second.clientRequestsPending;
+					answersClient = true;
+				}
+
+				bool forward(true);
+				const WatchesMap::iterator watchesEnd(watches.lower_bound(WatchKey(nodeId + 1, 0, 0)));
+				for (WatchesMap::iterator it(watches.lower_bound(WatchKey(nodeId, 0, 0))); it != watchesEnd; ++it)
+				{
+					const WatchKey& key(it->first);
+					Watch& watch(it->second);
+					if (start == key.start && end == key.start + key.length)
+					{
+						// the answer to our poll is only useful to others if it changed
+						if (proxy && watch.pollPending && !answersClient && watch.valuesKnown && watch.values == variables->variables)
+							forward = false;
+						watch.pollPending = false;
+						watch.values = variables->variables;
+						watch.valuesKnown = true;
+					}
+					else if (watch.valuesKnown && start >= key.start && end <= key.start + key.length)
+					{
+						std::copy(variables->variables.begin(), variables->variables.end(), watch.values.begin() + (start - key.start));
+					}
+				}
+				return forward;
+			}
+		}
+
+		return true;
+	}
+
+	void WatchesManager::watch(unsigned nodeId, unsigned start, unsigned length, unsigned period)
+	{
+		const UnifiedTime now;
+		const UnifiedTime lease(ASEBA_VARIABLES_WATCH_LEASE);
+		const pair<WatchesMap::iterator, bool> inserted(watches.insert(make_pair(WatchKey(nodeId, start, length), Watch())));
+		Watch& watch(inserted.first->second);
+
+		// the fastest subscriber wins, a slower one only once the fastest stopped renewing
+		if (period < watch.period || watch.periodLeaseEnd < now)
+		{
+			// tell the node about a faster period right away
+			if (period < watch.period && !inserted.second)
+				watch.lastRequest = UnifiedTime(0);
+			watch.period = period;
+		}
+		if (period <= watch.period)
+			watch.periodLeaseEnd = now + lease;
+		watch.leaseEnd = now + lease;
+	}
+
+	bool WatchesManager::isWatchCapable(unsigned nodeId) const
+	{
+		const NodesStatesMap::const_iterator nodeIt(nodesStates.find(nodeId));
+		return nodeIt != nodesStates.end() && nodeIt->second.watchesCapable;
+	}
+
+	const WatchesManager::VariablesDataVector* WatchesManager::getWatchedValues(unsigned nodeId, unsigned start, unsigned length) const
+	{
+		const WatchesMap::const_iterator it(watches.find(WatchKey(nodeId, start, length)));
+		if (it == watches.end() || !it->second.valuesKnown)
+			return 0;
+		return &it->second.values;
+	}
+
+	void WatchesManager::stepWatches()
+	{
+		const UnifiedTime now;
+
+		// nodes that do not answer our requests for capabilities have none
+		for (NodesStatesMap::iterator it(nodesStates.begin()); it != nodesStates.end(); ++it)
+		{
+			NodeState& state(it->second);
+			if (state.capabilitiesKnown || state.capabilitiesRequest.value == 0 || (now - state.capabilitiesRequest).value < capabilitiesTimeout)
+				continue;
+			state.capabilitiesKnown = true;
+			if (state.clientCapabilitiesPending)
+			{
+				state.clientCapabilitiesPending = false;
+				sendProxyCapabilities(it->first, 0);
+			}
+		}
+
+		for (WatchesMap::iterator it(watches.begin()); it != watches.end();)
+		{
+			const WatchKey& key(it->first);
+			Watch& watch(it->second);
+			if (watch.leaseEnd < now)
+			{
+				watches.erase(it++);
+				continue;
+			}
+
+			const UnifiedTime::Value sinceRequest((now - watch.lastRequest).value);
+			if (isWatchCapable(key.nodeId))
+			{
+				// renew our own subscription, the node pushes the changes
+				if (sinceRequest >= ASEBA_VARIABLES_WATCH_LEASE / 2)
+				{
+					WatchVariables watchVariables(key.nodeId, key.start, key.length, watch.period);
+					sendWatchMessage(watchVariables);
+					watch.lastRequest = now;
+				}
+			}
+			else if (sinceRequest >= watch.period && (!watch.pollPending || sinceRequest >= pollTimeout))
+			{
+				// poll the node, waiting for the answer before polling again
+				GetVariables getVariables(key.nodeId, key.start, key.length);
+				sendWatchMessage(getVariables);
+				watch.lastRequest = now;
+				watch.pollPending = true;
+			}
+			++it;
+		}
+	}
+
+	void WatchesManager::sendCachedValues(const WatchKey& key, const Watch& watch)
+	{
+		Variables variables;
+		variables.source = key.nodeId;
+		variables.start = key.start;
+		variables.variables = watch.values;
+		sendWatchMessage(variables);
+	}
+
+	void WatchesManager::sendProxyCapabilities(unsigned nodeId, unsigned capabilities)
+	{
+		Capabilities message;
+		message.source = nodeId;
+		message.capabilities = capabilities | ASEBA_CAPABILITY_WATCH_VARIABLES;
+		sendWatchMessage(message);
+	}
+
+	/*@}*/
+} // namespace Aseba
@@ -0,0 +1,121 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_WATCHES_MANAGER_H
+#define ASEBA_WATCHES_MANAGER_H
+
+#include "msg.h"
+#include "../utils/utils.h"
+#include <map>
+
+namespace Aseba
+{
+	/** \addtogroup msg */
+	/*@{*/
+
+	//! This helper class keeps one subscription per range of variables, whoever asks for it, and caches the values received for it.
+	//! Nodes that advertise ASEBA_CAPABILITY_WATCH_VARIABLES are asked to push their changes, the others are polled at the requested rate.
+	//! Its client must ask every node whose description starts for its capabilities, as DescriptionsManager does.
+	//! As a proxy, in a switch, it answers the ASEBA_MESSAGE_WATCH_VARIABLES of clients on behalf of all nodes,
+	//! advertises this capability for them to the clients that ask, and drops the answers to its own polls that did not change.
+	class WatchesManager
+	{
+	public:
+		//! Values of a range of variables
+		typedef std::vector<sint16> VariablesDataVector;
+
+	protected:
+		//! Key of a watch: node, start, length
+		struct WatchKey
+		{
+			unsigned nodeId;
+			unsigned start;
+			unsigned length;
+
+			WatchKey(unsigned nodeId, unsigned start, unsigned length) : nodeId(nodeId), start(start), length(length) {}
+			bool operator<(const WatchKey& that) const;
+		};
+		//! A range of variables watched by one or more subscribers
+		struct Watch
+		{
+			Watch();
+
+			unsigned period; //!< shortest period requested, in ms
+			UnifiedTime periodLeaseEnd; //!< once passed, a longer period can replace this one
+			UnifiedTime leaseEnd; //!< once passed, the watch is removed
+			UnifiedTime lastRequest; //!< when the node was last polled or asked to watch this range
+			bool pollPending; //!< whether our last poll is not answered yet
+			bool valuesKnown; //!< whether values holds the current values
+			VariablesDataVector values; //!< last values received
+		};
+		typedef std::map<WatchKey, Watch> WatchesMap;
+		WatchesMap watches; //!< all active watches
+
+		//! What we know about a node
+		struct NodeState
+		{
+			NodeState();
+			bool watchesCapable; //!< whether the node itself handles ASEBA_MESSAGE_WATCH_VARIABLES
+			bool capabilitiesKnown; //!< whether the node answered our request for its capabilities, or is considered not to
+			unsigned capabilities; //!< capabilities of the node itself, once known
+			UnifiedTime capabilitiesRequest; //!< when its capabilities were last asked for
+			bool clientCapabilitiesPending; //!< as a proxy, whether a client waits for the capabilities of this node
+			unsigned clientRequestsPending; //!< number of ASEBA_MESSAGE_GET_VARIABLES from clients not answered yet
+		};
+		typedef std::map<unsigned, NodeState> NodesStatesMap;
+		NodesStatesMap nodesStates; //!< all nodes seen
+
+		const bool proxy; //!< whether we answer watches on behalf of the nodes
+
+	public:
+		//! Constructor, proxy tells whether we are a switch answering the watches of clients
+		WatchesManager(bool proxy);
+		//! Virtual destructor
+		virtual ~WatchesManager() {}
+
+		//! Process a message before it is forwarded; return false if it must not be forwarded, because it was handled here
+		bool processMessage(Message* message);
+
+		//! Subscribe to a range of variables of a node, at most once every period ms; call again within ASEBA_VARIABLES_WATCH_LEASE ms to renew
+		void watch(unsigned nodeId, unsigned start, unsigned length, unsigned period);
+
+		//! Return whether a node advertised ASEBA_CAPABILITY_WATCH_VARIABLES, and thus pushes the changes of watched variables instead of being polled
+		bool isWatchCapable(unsigned nodeId) const;
+
+		//! Return the values last received for a watched range of variables, or 0 if the range is not watched or its values are not known yet
+		const VariablesDataVector* getWatchedValues(unsigned nodeId, unsigned start, unsigned length) const;
+
+		//! Renew the watches, poll the nodes and expire the subscriptions that are due; to call at least as often as the shortest period
+		void stepWatches();
+
+	protected:
+		//! Send the values of a watch as if they came from its node, for subscribers that joined an existing watch
+		void sendCachedValues(const WatchKey& key, const Watch& watch);
+		//! Answer a client with the capabilities of a node, completed with the capability to watch variables that we provide on its behalf
+		void sendProxyCapabilities(unsigned nodeId, unsigned capabilities);
+
+		//! Virtual function that is called to send a message on the network
+		virtual void sendWatchMessage(Message& message) = 0;
+	};
+
+	/*@}*/
+} // namespace Aseba
+
+#endif
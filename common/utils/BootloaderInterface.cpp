@@ -26,6 +26,7 @@
 #include "FormatableString.h"
 #include <dashel/dashel.h>
 #include <memory>
+#include <fstream>
 #include <unistd.h>
 
 namespace Aseba 
@@ -33,12 +34,70 @@ namespace Aseba
 	using namespace Dashel;
 	using namespace std;
 	
+	bool PageChecksumCache::get(unsigned dest, unsigned pageSize, uint32 pageNumber, uint16& checksum) const
+	{
+		const NodesPagesMap::const_iterator nodeIt(nodes.find(dest));
+		if (nodeIt == nodes.end() || nodeIt->second.pageSize != pageSize)
+			return false;
+		const map<uint32, uint16>::const_iterator pageIt(nodeIt->second.checksums.find(pageNumber));
+		if (pageIt == nodeIt->second.checksums.end())
+			return false;
+		checksum = pageIt->second;
+		return true;
+	}
+	
+	void PageChecksumCache::set(unsigned dest, unsigned pageSize, uint32 pageNumber, uint16 checksum)
+	{
+		NodePages& node(nodes[dest]);
+		if (node.pageSize != pageSize)
+		{
+			node.checksums.clear();
+			node.pageSize = pageSize;
+		}
+		node.checksums[pageNumber] = checksum;
+	}
+	
+	void PageChecksumCache::forget(unsigned dest, uint32 pageNumber)
+	{
+		const NodesPagesMap::iterator nodeIt(nodes.find(dest));
+		if (nodeIt != nodes.end())
+			nodeIt->second.checksums.erase(pageNumber);
+	}
+	
+	bool PageChecksumCache::load(const string& fileName)
+	{
+		nodes.clear();
+		ifstream ifs(fileName.c_str());
+		if (!ifs.good())
+			return false;
+		// one line per page: node id, page size, page number, checksum
+		unsigned dest, pageSize;
+		uint32 pageNumber;
+		unsigned checksum;
+		while (ifs >> dest >> pageSize >> pageNumber >> checksum)
+			set(dest, pageSize, pageNumber, uint16(checksum));
+		return true;
+	}
+	
+	bool PageChecksumCache::save(const string& fileName) const
+	{
+		ofstream ofs(fileName.c_str());
+		for (NodesPagesMap::const_iterator nodeIt = nodes.begin(); nodeIt != nodes.end(); ++nodeIt)
+		{
+			const NodePages& node(nodeIt->second);
+			for (map<uint32, uint16>::const_iterator pageIt = node.checksums.begin(); pageIt != node.checksums.end(); ++pageIt)
+				ofs << nodeIt->first << " " << node.pageSize << " " << pageIt->first << " " << pageIt->second << "\n";
+		}
+		return ofs.good();
+	}
+	
 	BootloaderInterface::BootloaderInterface(Stream* stream, int dest) :
 		stream(stream),
 		dest(dest),
 		pageSize(0),
 		pagesStart(0),
-		pagesCount(0)
+		pagesCount(0),
+		checksumCache(0)
 	{
 		
 	}
@@ -87,7 +146,6 @@ namespace Aseba
 				copy(dataMessage->data, dataMessage->data + sizeof(dataMessage->data), data);
 				data += sizeof(dataMessage->data);
 				dataRead += sizeof(dataMessage->data);
-				cout << "Page read so far (" << dataRead << "/" << pageSize << ") bytes.\n";
 			}
 		}
 		
@@ -204,7 +262,79 @@ namespace Aseba
 		return true;
 	}
 	
-	void BootloaderInterface::writeHex(const string &fileName, bool reset, bool simple)
+	BootloaderInterface::PageMap BootloaderInterface::pagesFromHex(const HexFile& hexFile, unsigned pageSize)
+	{
+		PageMap pageMap;
+		for (HexFile::ChunkMap::const_iterator it = hexFile.data.begin(); it != hexFile.data.end(); it ++)
+		{
+			// get page number
+			unsigned chunkAddress = it->first;
+			// index inside data chunk
+			unsigned chunkDataIndex = 0;
+			// size of chunk in bytes
+			unsigned chunkSize = it->second.size();
+			
+			// copy data from chunk to page
+			do
+			{
+				// get page number
+				unsigned pageIndex = (chunkAddress + chunkDataIndex) / pageSize;
+				// get address inside page
+				unsigned byteIndex = (chunkAddress + chunkDataIndex) % pageSize;
+			
+				// if page does not exists, create it
+				if (pageMap.find(pageIndex) == pageMap.end())
+				{
+				//	std::cout << "New page N° " << pageIndex << " for address 0x" << std::hex << chunkAddress << endl;
+					pageMap[pageIndex] = vector<uint8>(pageSize, (uint8)0);
+				}
+				// copy data
+				unsigned amountToCopy = min(pageSize - byteIndex, chunkSize - chunkDataIndex);
+				copy(it->second.begin() + chunkDataIndex, it->second.begin() + chunkDataIndex + amountToCopy, pageMap[pageIndex].begin() + byteIndex);
+				
+				// increment chunk data pointer
+				chunkDataIndex += amountToCopy;
+			}
+			while (chunkDataIndex < chunkSize);
+		}
+		return pageMap;
+	}
+	
+	uint16 BootloaderInterface::pageChecksum(const uint8* data, size_t size, uint16 crc)
+	{
+		return crcXModem(crc, data, size & ~size_t(1));
+	}
+	
+	bool BootloaderInterface::pageUnchanged(unsigned pageNumber, const vector<uint8>& data)
+	{
+		const uint16 checksum(pageChecksum(&data[0], data.size()));
+		uint16 knownChecksum;
+		if (checksumCache && checksumCache->get(dest, pageSize, pageNumber, knownChecksum))
+			return knownChecksum == checksum;
+		
+		// if the page cannot be read, it will be written
+		vector<uint8> buffer(pageSize, 0);
+		if (!readPage(pageNumber, &buffer[0]))
+			return false;
+		const uint16 readChecksum(pageChecksum(&buffer[0], buffer.size()));
+		if (checksumCache)
+			checksumCache->set(dest, pageSize, pageNumber, readChecksum);
+		return readChecksum == checksum;
+	}
+	
+	bool BootloaderInterface::writePageChecked(unsigned pageNumber, const vector<uint8>& data)
+	{
+		// a page that failed to write holds unknown content
+		if (checksumCache)
+			checksumCache->forget(dest, pageNumber);
+		if (!writePage(pageNumber, &data[0], false))
+			return false;
+		if (checksumCache)
+			checksumCache->set(dest, pageSize, pageNumber, pageChecksum(&data[0], data.size()));
+		return true;
+	}
+	
+	void BootloaderInterface::writeHex(const string &fileName, bool reset, bool simple, bool differential)
 	{
 		// Load hex file
 		HexFile hexFile;
@@ -257,47 +387,14 @@ namespace Aseba
 		}
 		
 		// Build a map of pages out of the map of addresses
-		typedef map<uint32, vector<uint8> > PageMap;
-		PageMap pageMap;
-		for (HexFile::ChunkMap::iterator it = hexFile.data.begin(); it != hexFile.data.end(); it ++)
-		{
-			// get page number
-			unsigned chunkAddress = it->first;
-			// index inside data chunk
-			unsigned chunkDataIndex = 0;
-			// size of chunk in bytes
-			unsigned chunkSize = it->second.size();
-			
-			// copy data from chunk to page
-			do
-			{
-				// get page number
-				unsigned pageIndex = (chunkAddress + chunkDataIndex) / pageSize;
-				// get address inside page
-				unsigned byteIndex = (chunkAddress + chunkDataIndex) % pageSize;
-			
-				// if page does not exists, create it
-				if (pageMap.find(pageIndex) == pageMap.end())
-				{
-				//	std::cout << "New page N° " << pageIndex << " for address 0x" << std::hex << chunkAddress << endl;
-					pageMap[pageIndex] = vector<uint8>(pageSize, (uint8)0);
-				}
-				// copy data
-				unsigned amountToCopy = min(pageSize - byteIndex, chunkSize - chunkDataIndex);
-				copy(it->second.begin() + chunkDataIndex, it->second.begin() + chunkDataIndex + amountToCopy, pageMap[pageIndex].begin() + byteIndex);
-				
-				// increment chunk data pointer
-				chunkDataIndex += amountToCopy;
-			}
-			while (chunkDataIndex < chunkSize);
-		}
+		const PageMap pageMap(pagesFromHex(hexFile, pageSize));
 		
 		writeHexGotDescription(pageMap.size());
 		
 		if (simple)
 		{
 			// Write pages
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			for (PageMap::const_iterator it = pageMap.begin(); it != pageMap.end(); it ++)
 			{
 				unsigned pageIndex = it->first;
 				if (pageIndex != 0)
@@ -305,7 +402,7 @@ namespace Aseba
 						errorWritePageNonFatal(pageIndex);
 			}
 			// Now look for the index 0 page
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			for (PageMap::const_iterator it = pageMap.begin(); it != pageMap.end(); it ++)
 			{
 				unsigned pageIndex = it->first;
 				if (pageIndex == 0)
@@ -316,12 +413,15 @@ namespace Aseba
 		else
 		{
 			// Write pages
-			for (PageMap::iterator it = pageMap.begin(); it != pageMap.end(); it ++)
+			for (PageMap::const_iterator it = pageMap.begin(); it != pageMap.end(); it ++)
 			{
 				unsigned pageIndex = it->first;
-				if ((pageIndex >= pagesStart) && (pageIndex < pagesStart + pagesCount))
-					if (!writePage(pageIndex, &it->second[0], false))
-						throw Error(FormatableString("Error while writing page %0").arg(pageIndex));
+				if ((pageIndex < pagesStart) || (pageIndex >= pagesStart + pagesCount))
+					continue;
+				if (differential && pageUnchanged(pageIndex, it->second))
+					writePageUnchanged(pageIndex);
+				else if (!writePageChecked(pageIndex, it->second))
+					throw Error(FormatableString("Error while writing page %0").arg(pageIndex));
 			}
 		}
 		
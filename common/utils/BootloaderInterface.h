@@ -23,6 +23,8 @@
 
 #include <string>
 #include <stdexcept>
+#include <map>
+#include <vector>
 #include "../types.h"
 
 
@@ -33,6 +35,41 @@ namespace Dashel
 
 namespace Aseba 
 {
+	class HexFile;
+	
+	//! Checksums of the flash pages of nodes, as last written or read back, kept by the host between updates
+	/**
+		This allows to skip reading back pages that are known to be up to date.
+		It is only valid as long as the nodes are always flashed through the cache,
+		and as long as different nodes do not share the same id.
+	*/
+	class PageChecksumCache
+	{
+	public:
+		//! Return whether the checksum of a page of node dest, using pages of pageSize, is known, and if so put it in checksum
+		bool get(unsigned dest, unsigned pageSize, uint32 pageNumber, uint16& checksum) const;
+		//! Remember the checksum of a page of node dest, forgetting the other pages of this node if its page size changed
+		void set(unsigned dest, unsigned pageSize, uint32 pageNumber, uint16 checksum);
+		//! Forget the checksum of a page of node dest, for instance because it is being written
+		void forget(unsigned dest, uint32 pageNumber);
+		
+		//! Load the cache from fileName, return false and leave the cache empty if it cannot be read
+		bool load(const std::string& fileName);
+		//! Save the cache to fileName, return false if it cannot be written
+		bool save(const std::string& fileName) const;
+		
+	protected:
+		//! Checksums of the pages of a node
+		struct NodePages
+		{
+			NodePages() : pageSize(0) {}
+			unsigned pageSize; //!< size of the pages of the node
+			std::map<uint32, uint16> checksums; //!< checksums by page number
+		};
+		typedef std::map<unsigned, NodePages> NodesPagesMap;
+		NodesPagesMap nodes; //!< pages of all nodes, by node id
+	};
+	
 	// TODO: change API to use HexFile instead of file names
 	
 	//! Manage interactions with an aseba-compatible bootloader
@@ -52,6 +89,14 @@ namespace Aseba
 			Error(const std::string& what): std::runtime_error(what) {}
 		};
 		
+		//! Content of flash pages, by page number
+		typedef std::map<uint32, std::vector<uint8> > PageMap;
+		
+		//! Split the content of an hex file into pages of pageSize bytes, filling the gaps with zeros
+		static PageMap pagesFromHex(const HexFile& hexFile, unsigned pageSize);
+		//! Return the checksum of size bytes of a page, continuing from crc
+		static uint16 pageChecksum(const uint8* data, size_t size, uint16 crc = 0);
+		
 	public:
 		// main interface
 		
@@ -70,8 +115,11 @@ namespace Aseba
 		//! Write a page, if simple is true, use simplified protocol, otherwise use complete protocol
 		bool writePage(unsigned pageNumber, const uint8 *data, bool simple);
 		
-		//! Write an hex file
-		void writeHex(const std::string &fileName, bool reset, bool simple);
+		//! Use cache to skip reading back pages whose checksum is known, and keep it up to date; 0 to stop using it
+		void setChecksumCache(PageChecksumCache* cache) { checksumCache = cache; }
+		
+		//! Write an hex file; if differential, only write the pages whose content differs (complete protocol only)
+		void writeHex(const std::string &fileName, bool reset, bool simple, bool differential = false);
 		
 		//! Read an hex file and write it to fileName
 		void readHex(const std::string &fileName);
@@ -84,6 +132,7 @@ namespace Aseba
 		virtual void writePageWaitAck() {}
 		virtual void writePageSuccess() {}
 		virtual void writePageFailure() {}
+		virtual void writePageUnchanged(unsigned pageNumber) {}
 		
 		virtual void writeHexStart(const std::string &fileName, bool reset, bool simple) {}
 		virtual void writeHexEnteringBootloader() {}
@@ -96,6 +145,12 @@ namespace Aseba
 		//! Warn about an error but do not quit
 		virtual void errorWritePageNonFatal(unsigned pageNumber) {}
 		
+	protected:
+		//! Return whether a page already holds data, from the cache or by reading it back
+		bool pageUnchanged(unsigned pageNumber, const std::vector<uint8>& data);
+		//! Write a page with the complete protocol, keeping the cache up to date
+		bool writePageChecked(unsigned pageNumber, const std::vector<uint8>& data);
+		
 	protected:
 		// member variables
 		Dashel::Stream* stream;
@@ -103,6 +158,7 @@ namespace Aseba
 		unsigned pageSize;
 		unsigned pagesStart;
 		unsigned pagesCount;
+		PageChecksumCache* checksumCache;
 	};
 } // namespace Aseba
 
@@ -0,0 +1,317 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+	
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "MultiBootloaderInterface.h"
+#include "../consts.h"
+#include "../msg/msg.h"
+#include "FormatableString.h"
+#include <memory>
+
+namespace Aseba 
+{
+	using namespace Dashel;
+	using namespace std;
+	
+	MultiBootloaderInterface::Statistics::Statistics() :
+		nodesFlashed(0),
+		nodesFailed(0),
+		pagesWritten(0),
+		pagesSkipped(0),
+		bytesWritten(0),
+		bytesRead(0),
+		duration(0)
+	{
+	}
+	
+	MultiBootloaderInterface::Session::Session(Dashel::Stream* stream, unsigned dest) :
+		stream(stream),
+		dest(dest),
+		state(SESSION_WAIT_DESCRIPTION),
+		pageSize(0),
+		pagesStart(0),
+		pagesCount(0),
+		pageNumber(0),
+		readCrc(0),
+		bytesRead(0)
+	{
+	}
+	
+	MultiBootloaderInterface::MultiBootloaderInterface(bool reset, bool skipUnchanged, unsigned timeout) :
+		reset(reset),
+		skipUnchanged(skipUnchanged),
+		timeout(timeout),
+		checksumCache(0),
+		sessionsChecksumCache(0)
+	{
+	}
+	
+	void MultiBootloaderInterface::addNode(Dashel::Stream* stream, unsigned dest)
+	{
+		sessions.push_back(Session(stream, dest));
+	}
+	
+	MultiBootloaderInterface::Statistics MultiBootloaderInterface::writeHex(const std::string &fileName)
+	{
+		HexFile hexFile;
+		hexFile.read(fileName);
+		
+		startWriteHex(hexFile);
+		while (stepSessions())
+			step(10);
+		
+		if (statistics.nodesFlashed == 0)
+			throw Error("Error, no node could be flashed");
+		return statistics;
+	}
+	
+	void MultiBootloaderInterface::startWriteHex(const HexFile& hexFile)
+	{
+		this->hexFile = hexFile;
+		statistics = Statistics();
+		startTime = UnifiedTime();
+		
+		// the cache knows nodes by id only, which may collide between streams
+		sessionsChecksumCache = checksumCache;
+		for (Sessions::const_iterator it = sessions.begin(); it != sessions.end(); ++it)
+			if (it->stream != sessions.front().stream)
+				sessionsChecksumCache = 0;
+		
+		for (Sessions::iterator it = sessions.begin(); it != sessions.end(); ++it)
+		{
+			it->state = SESSION_WAIT_DESCRIPTION;
+			it->lastActivity = startTime;
+			// the bootloader describes itself when it starts
+			if (reset)
+			{
+				Reboot message(it->dest);
+				sendMessage(*it, message);
+			}
+		}
+	}
+	
+	void MultiBootloaderInterface::processMessage(Dashel::Stream* stream, const Message* message)
+	{
+		Sessions::iterator it = sessions.begin();
+		while (it != sessions.end() && !(it->stream == stream && it->dest == message->source))
+			++it;
+		if (it == sessions.end())
+			return;
+		Session& session(*it);
+		if (session.state == SESSION_DONE || session.state == SESSION_FAILED)
+			return;
+		session.lastActivity = UnifiedTime();
+		
+		// get page layout
+		const BootloaderDescription *description = dynamic_cast<const BootloaderDescription *>(message);
+		if (description)
+		{
+			if (session.state != SESSION_WAIT_DESCRIPTION)
+				return;
+			session.pageSize = description->pageSize;
+			session.pagesStart = description->pagesStart;
+			session.pagesCount = description->pagesCount;
+			session.pages = BootloaderInterface::pagesFromHex(hexFile, session.pageSize);
+			nodeGotDescription(session.stream, session.dest, session.pages.size());
+			session.pageNumber = session.pagesStart;
+			startPage(session);
+			return;
+		}
+		
+		// accumulate the checksum of the page being read back
+		const BootloaderDataRead *dataRead = dynamic_cast<const BootloaderDataRead *>(message);
+		if (dataRead)
+		{
+			if (session.state != SESSION_WAIT_READ)
+				return;
+			session.readCrc = BootloaderInterface::pageChecksum(dataRead->data, sizeof(dataRead->data), session.readCrc);
+			session.bytesRead += sizeof(dataRead->data);
+			statistics.bytesRead += sizeof(dataRead->data);
+			return;
+		}
+		
+		const BootloaderAck *ack = dynamic_cast<const BootloaderAck *>(message);
+		if (!ack)
+			return;
+		const bool success(ack->errorCode == BootloaderAck::SUCCESS);
+		switch (session.state)
+		{
+			case SESSION_WAIT_READ:
+			{
+				// if the page cannot be read, write it anyway
+				const vector<uint8>& data(session.pages[session.pageNumber]);
+				const bool read(success && session.bytesRead >= session.pageSize);
+				if (read && sessionsChecksumCache)
+					sessionsChecksumCache->set(session.dest, session.pageSize, session.pageNumber, session.readCrc);
+				if (read && BootloaderInterface::pageChecksum(&data[0], data.size()) == session.readCrc)
+					nextPage(session, false);
+				else
+					writePage(session);
+			}
+			break;
+			
+			case SESSION_WAIT_WRITE_READY:
+			if (success)
+			{
+				// send the whole page, the bootloader acknowledges it once written
+				const vector<uint8>& data(session.pages[session.pageNumber]);
+				for (unsigned dataWritten = 0; dataWritten < session.pageSize;)
+				{
+					BootloaderPageDataWrite pageData(session.dest);
+					copy(data.begin() + dataWritten, data.begin() + dataWritten + sizeof(pageData.data), pageData.data);
+					pageData.serialize(session.stream);
+					dataWritten += sizeof(pageData.data);
+				}
+				session.stream->flush();
+				session.state = SESSION_WAIT_WRITE_DONE;
+			}
+			else
+				finishSession(session, false, FormatableString("Error while writing page %0").arg(session.pageNumber));
+			break;
+			
+			case SESSION_WAIT_WRITE_DONE:
+			if (success)
+			{
+				if (sessionsChecksumCache)
+				{
+					const vector<uint8>& data(session.pages[session.pageNumber]);
+					sessionsChecksumCache->set(session.dest, session.pageSize, session.pageNumber, BootloaderInterface::pageChecksum(&data[0], data.size()));
+				}
+				statistics.bytesWritten += session.pageSize;
+				nextPage(session, true);
+			}
+			else
+				finishSession(session, false, FormatableString("Error while writing page %0").arg(session.pageNumber));
+			break;
+			
+			default:
+			break;
+		}
+	}
+	
+	bool MultiBootloaderInterface::stepSessions()
+	{
+		const UnifiedTime now;
+		bool active(false);
+		for (Sessions::iterator it = sessions.begin(); it != sessions.end(); ++it)
+		{
+			if (it->state == SESSION_DONE || it->state == SESSION_FAILED)
+				continue;
+			if ((now - it->lastActivity).value >= UnifiedTime::Value(timeout))
+				finishSession(*it, false, it->state == SESSION_WAIT_DESCRIPTION ? "No bootloader description received" : "Bootloader stopped answering");
+			else
+				active = true;
+		}
+		return active;
+	}
+	
+	void MultiBootloaderInterface::incomingData(Dashel::Stream *stream)
+	{
+		auto_ptr<Message> message(Message::receive(stream));
+		processMessage(stream, message.get());
+	}
+	
+	void MultiBootloaderInterface::connectionClosed(Dashel::Stream *stream, bool abnormal)
+	{
+		for (Sessions::iterator it = sessions.begin(); it != sessions.end(); ++it)
+			if (it->stream == stream && it->state != SESSION_DONE && it->state != SESSION_FAILED)
+				finishSession(*it, false, "Connection closed");
+	}
+	
+	void MultiBootloaderInterface::sendMessage(Session& session, Message& message)
+	{
+		message.serialize(session.stream);
+		session.stream->flush();
+	}
+	
+	void MultiBootloaderInterface::startPage(Session& session)
+	{
+		// only pages of the hex file that the bootloader can write, and that are not known to be up to date
+		PageMap::const_iterator it(session.pages.lower_bound(session.pageNumber));
+		uint16 knownChecksum;
+		while (skipUnchanged && sessionsChecksumCache && it != session.pages.end() && it->first < session.pagesStart + session.pagesCount &&
+			sessionsChecksumCache->get(session.dest, session.pageSize, it->first, knownChecksum) &&
+			knownChecksum == BootloaderInterface::pageChecksum(&it->second[0], it->second.size()))
+		{
+			++statistics.pagesSkipped;
+			nodePageDone(session.stream, session.dest, it->first, false);
+			++it;
+		}
+		if (it == session.pages.end() || it->first >= session.pagesStart + session.pagesCount)
+		{
+			if (reset)
+			{
+				BootloaderReset message(session.dest);
+				sendMessage(session, message);
+			}
+			finishSession(session, true);
+			return;
+		}
+		session.pageNumber = it->first;
+		if (skipUnchanged)
+			readPage(session);
+		else
+			writePage(session);
+	}
+	
+	void MultiBootloaderInterface::readPage(Session& session)
+	{
+		BootloaderReadPage message(session.dest);
+		message.pageNumber = session.pageNumber;
+		sendMessage(session, message);
+		session.readCrc = 0;
+		session.bytesRead = 0;
+		session.state = SESSION_WAIT_READ;
+	}
+	
+	void MultiBootloaderInterface::writePage(Session& session)
+	{
+		// a page that failed to write holds unknown content
+		if (sessionsChecksumCache)
+			sessionsChecksumCache->forget(session.dest, session.pageNumber);
+		BootloaderWritePage message(session.dest);
+		message.pageNumber = session.pageNumber;
+		sendMessage(session, message);
+		session.state = SESSION_WAIT_WRITE_READY;
+	}
+	
+	void MultiBootloaderInterface::nextPage(Session& session, bool written)
+	{
+		if (written)
+			++statistics.pagesWritten;
+		else
+			++statistics.pagesSkipped;
+		nodePageDone(session.stream, session.dest, session.pageNumber, written);
+		++session.pageNumber;
+		startPage(session);
+	}
+	
+	void MultiBootloaderInterface::finishSession(Session& session, bool success, const std::string& reason)
+	{
+		session.state = success ? SESSION_DONE : SESSION_FAILED;
+		if (success)
+			++statistics.nodesFlashed;
+		else
+			++statistics.nodesFailed;
+		statistics.duration = UnifiedTime() - startTime;
+		nodeDone(session.stream, session.dest, success, reason);
+	}
+	
+} // namespace Aseba
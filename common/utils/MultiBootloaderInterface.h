@@ -0,0 +1,151 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+	
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+	
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef ASEBA_MULTI_BOOTLOADER_INTERFACE_H
+#define ASEBA_MULTI_BOOTLOADER_INTERFACE_H
+
+#include "BootloaderInterface.h"
+#include "utils.h"
+#include "HexFile.h"
+#include <dashel/dashel.h>
+#include <vector>
+
+namespace Aseba 
+{
+	class Message;
+	
+	//! Flash several nodes at once through the complete bootloader protocol
+	/**
+		Each node has its own bootloader session, and all sessions progress
+		together: while a node programs a page, the others receive theirs.
+		Nodes can share a stream, for instance behind a switch, or have their own.
+		Optionally, each page is first read back and only written if its
+		checksum differs from the one in the hex file; with a PageChecksumCache,
+		the pages known to be up to date are not even read back.
+		The simple bootloader protocol cannot be shared, so it is not supported here.
+	*/
+	class MultiBootloaderInterface: public Dashel::Hub
+	{
+	public:
+		typedef BootloaderInterface::Error Error;
+		typedef BootloaderInterface::PageMap PageMap;
+		
+		//! Totals over all nodes of a writeHex()
+		struct Statistics
+		{
+			Statistics();
+			
+			unsigned nodesFlashed; //!< nodes whose pages were all written or found up to date
+			unsigned nodesFailed; //!< nodes that did not answer in time or reported an error
+			unsigned pagesWritten; //!< pages written
+			unsigned pagesSkipped; //!< pages read back and found up to date
+			unsigned bytesWritten; //!< content of the pages written, in bytes
+			unsigned bytesRead; //!< content of the pages read back, in bytes
+			UnifiedTime duration; //!< time from the start of writeHex() to the end of the last session
+		};
+		
+	protected:
+		//! Step of a bootloader session
+		enum SessionState
+		{
+			SESSION_WAIT_DESCRIPTION, //!< waiting for the bootloader to describe its pages
+			SESSION_WAIT_READ, //!< reading the current page back
+			SESSION_WAIT_WRITE_READY, //!< waiting for the bootloader to accept to write the current page
+			SESSION_WAIT_WRITE_DONE, //!< waiting for the bootloader to have written the current page
+			SESSION_DONE, //!< all pages written
+			SESSION_FAILED //!< the bootloader reported an error or did not answer in time
+		};
+		//! Flashing of a node
+		struct Session
+		{
+			Session(Dashel::Stream* stream, unsigned dest);
+			
+			Dashel::Stream* stream; //!< stream to reach the node
+			unsigned dest; //!< identifier of the node
+			SessionState state; //!< where the session is
+			unsigned pageSize; //!< size of a page, from the bootloader description
+			unsigned pagesStart; //!< first page that can be written, from the bootloader description
+			unsigned pagesCount; //!< number of pages that can be written, from the bootloader description
+			PageMap pages; //!< content of the hex file, split in pages of pageSize
+			uint32 pageNumber; //!< page being read or written
+			uint16 readCrc; //!< checksum of the data of page read back so far
+			unsigned bytesRead; //!< amount of data of page read back so far
+			UnifiedTime lastActivity; //!< when we last received something from the node
+		};
+		typedef std::vector<Session> Sessions;
+		
+	public:
+		//! Create an interface that, if reset, reboots the nodes into their bootloader and back, and if skipUnchanged, does not write up-to-date pages;
+		//! a node that stays silent for timeout ms fails
+		MultiBootloaderInterface(bool reset, bool skipUnchanged, unsigned timeout = 5000);
+		
+		//! Add the bootloader with id dest, reached through stream; stream must have been connected by this hub, unless processMessage() is called directly
+		void addNode(Dashel::Stream* stream, unsigned dest);
+		
+		//! If skipUnchanged, use cache to skip reading back pages whose checksum is known; keep it up to date in any case; 0 to stop using it.
+		//! As the cache knows nodes by id only, it is ignored when the nodes are reached through several streams
+		void setChecksumCache(PageChecksumCache* cache) { checksumCache = cache; }
+		
+		//! Write an hex file to all nodes and return the totals, or throw Error if no node could be flashed
+		Statistics writeHex(const std::string &fileName);
+		
+		//! Start writing hexFile to all nodes; then processMessage() and stepSessions() drive the sessions
+		void startWriteHex(const HexFile& hexFile);
+		//! Process a message received from stream
+		void processMessage(Dashel::Stream* stream, const Message* message);
+		//! Fail the sessions whose node stayed silent for too long, return whether some are still in progress
+		bool stepSessions();
+		//! Return the totals so far
+		const Statistics& getStatistics() const { return statistics; }
+		
+	protected:
+		// from Dashel::Hub
+		virtual void incomingData(Dashel::Stream *stream);
+		virtual void connectionClosed(Dashel::Stream *stream, bool abnormal);
+		
+		// reporting functions
+		
+		virtual void nodeGotDescription(Dashel::Stream* stream, unsigned dest, unsigned pagesCount) {}
+		virtual void nodePageDone(Dashel::Stream* stream, unsigned dest, unsigned pageNumber, bool written) {}
+		virtual void nodeDone(Dashel::Stream* stream, unsigned dest, bool success, const std::string& reason) {}
+		
+	protected:
+		void sendMessage(Session& session, Message& message);
+		void startPage(Session& session);
+		void writePage(Session& session);
+		void nextPage(Session& session, bool written);
+		void readPage(Session& session);
+		void finishSession(Session& session, bool success, const std::string& reason = std::string());
+		
+	protected:
+		const bool reset;
+		const bool skipUnchanged;
+		const unsigned timeout;
+		Sessions sessions;
+		HexFile hexFile;
+		UnifiedTime startTime;
+		Statistics statistics;
+		PageChecksumCache* checksumCache;
+		PageChecksumCache* sessionsChecksumCache; //!< checksumCache if all sessions share a stream, 0 otherwise
+	};
+} // namespace Aseba
+
+#endif // ASEBA_MULTI_BOOTLOADER_INTERFACE_H
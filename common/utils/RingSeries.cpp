@@ -0,0 +1,165 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RingSeries.h"
+#include <algorithm>
+#include <cassert>
+
+namespace Aseba
+{
+	/** \addtogroup utils */
+	/*@{*/
+
+	//! Number of samples allocated at first, the storage then doubles until it reaches the capacity
+	static const size_t initialStorage = 1024;
+
+	RingSeries::RingSeries(size_t channelsCount, size_t capacity) :
+		channels(channelsCount),
+		capacity(std::max<size_t>(capacity, 1)),
+		times(std::min(this->capacity, initialStorage)),
+		values(times.size() * channelsCount),
+		first(0),
+		count(0)
+	{
+	}
+
+	void RingSeries::push(double time, const sint16* values, size_t count)
+	{
+		size_t pos;
+		if (this->count == times.size() && times.size() < capacity)
+			grow();
+		if (this->count == times.size())
+		{
+			// overwrite the oldest sample
+			pos = first;
+			first = (first + 1) % times.size();
+		}
+		else
+		{
+			pos = index(this->count);
+			++this->count;
+		}
+		times[pos] = time;
+		sint16* dest(&this->values[pos * channels]);
+		const size_t copied(std::min(count, channels));
+		std::copy(values, values + copied, dest);
+		std::fill(dest + copied, dest + channels, sint16(0));
+	}
+
+	void RingSeries::dropBefore(double time)
+	{
+		const size_t dropped(lowerBound(time));
+		first = index(dropped);
+		count -= dropped;
+	}
+
+	void RingSeries::clear()
+	{
+		first = 0;
+		count = 0;
+	}
+
+	void RingSeries::grow()
+	{
+		// copy the samples in time order, so that the oldest one is first
+		std::vector<double> newTimes(std::min(times.size() * 2, capacity));
+		std::vector<sint16> newValues(newTimes.size() * channels);
+		for (size_t i = 0; i < count; ++i)
+		{
+			newTimes[i] = times[index(i)];
+			std::copy(&values[index(i) * channels], &values[index(i) * channels] + channels, &newValues[i * channels]);
+		}
+		times.swap(newTimes);
+		values.swap(newValues);
+		first = 0;
+	}
+
+	size_t RingSeries::lowerBound(double time) const
+	{
+		// samples are added in time order
+		size_t lo(0), hi(count);
+		while (lo < hi)
+		{
+			const size_t mid((lo + hi) / 2);
+			if (this->time(mid) < time)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	void RingSeries::decimate(size_t channel, double start, double end, unsigned columns, std::vector<double>& x, std::vector<double>& y) const
+	{
+		assert(channel < channels);
+		x.clear();
+		y.clear();
+		if (count == 0)
+			return;
+
+		// visible samples, and one on each side
+		size_t begin(lowerBound(start));
+		size_t stop(lowerBound(end));
+		if (begin > 0)
+			--begin;
+		if (stop < count)
+			++stop;
+
+		if (columns == 0 || end <= start || stop - begin <= size_t(columns) * 4)
+		{
+			for (size_t i = begin; i < stop; ++i)
+			{
+				x.push_back(time(i));
+				y.push_back(value(channel, i));
+			}
+			return;
+		}
+
+		const double scale(double(columns) / (end - start));
+		size_t i(begin);
+		while (i < stop)
+		{
+			// the samples falling in the same column as sample i
+			const double column(std::max(0., std::min(double(columns - 1), double(unsigned((std::max(time(i), start) - start) * scale)))));
+			const double columnEnd(start + (column + 1) / scale);
+			size_t minIndex(i), maxIndex(i), last(i);
+			for (size_t j = i + 1; j < stop && (time(j) < columnEnd || column == columns - 1); ++j)
+			{
+				if (value(channel, j) < value(channel, minIndex))
+					minIndex = j;
+				if (value(channel, j) > value(channel, maxIndex))
+					maxIndex = j;
+				last = j;
+			}
+
+			size_t kept[4] = { i, std::min(minIndex, maxIndex), std::max(minIndex, maxIndex), last };
+			for (size_t k = 0; k < 4; ++k)
+			{
+				if (k > 0 && kept[k] == kept[k - 1])
+					continue;
+				x.push_back(time(kept[k]));
+				y.push_back(value(channel, kept[k]));
+			}
+			i = last + 1;
+		}
+	}
+
+	/*@}*/
+}
@@ -0,0 +1,83 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_RING_SERIES_H
+#define ASEBA_RING_SERIES_H
+
+#include "../types.h"
+#include <vector>
+
+namespace Aseba
+{
+	/** \addtogroup utils */
+	/*@{*/
+
+	//! Samples kept by the plots of events, about 90 minutes at 100 Hz
+	static const size_t eventPlotCapacity = 1 << 19;
+	//! Minimum interval between two replots of events, in ms
+	static const int eventPlotReplotInterval = 40;
+
+	//! Time series of several channels with a maximum capacity, the oldest samples are overwritten when it is full.
+	//! Its storage grows with the samples, so that a slow series does not take the memory of a full one.
+	class RingSeries
+	{
+	public:
+		//! Create a series of channelsCount channels, holding at most capacity samples
+		RingSeries(size_t channelsCount, size_t capacity);
+
+		//! Add a sample at time, channels beyond count are set to 0
+		void push(double time, const sint16* values, size_t count);
+		//! Remove samples older than time
+		void dropBefore(double time);
+		//! Remove all samples
+		void clear();
+
+		//! Number of channels
+		size_t channelsCount() const { return channels; }
+		//! Number of samples
+		size_t size() const { return count; }
+		//! Time of sample i, 0 being the oldest
+		double time(size_t i) const { return times[index(i)]; }
+		//! Value of a channel for sample i, 0 being the oldest
+		sint16 value(size_t channel, size_t i) const { return values[index(i) * channels + channel]; }
+
+		//! Fill x and y with the points to draw a channel between times start and end in columns pixel columns.
+		//! For each column, only its first, minimum, maximum and last samples are kept, which draws the same line;
+		//! the samples just outside the interval are kept as well so that the line reaches the borders.
+		void decimate(size_t channel, double start, double end, unsigned columns, std::vector<double>& x, std::vector<double>& y) const;
+
+	protected:
+		size_t index(size_t i) const { return (first + i) % times.size(); }
+		size_t lowerBound(double time) const;
+		void grow();
+
+	protected:
+		const size_t channels;
+		const size_t capacity;
+		std::vector<double> times;
+		std::vector<sint16> values;
+		size_t first;
+		size_t count;
+	};
+
+	/*@}*/
+}
+
+#endif // ASEBA_RING_SERIES_H
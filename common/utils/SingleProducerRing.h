@@ -0,0 +1,119 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_SINGLE_PRODUCER_RING_H
+#define ASEBA_SINGLE_PRODUCER_RING_H
+
+#include <vector>
+#include <cstddef>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Aseba
+{
+	/** \addtogroup utils */
+	/*@{*/
+
+	//! Full memory barrier, ordering the reads and writes before it with those after it
+	inline void memoryBarrier()
+	{
+	#if defined(__GNUC__)
+		__sync_synchronize();
+	#elif defined(_MSC_VER)
+		// volatile accesses already have acquire and release semantics with this compiler
+		_ReadWriteBarrier();
+	#else
+		#error "Please provide a memory barrier for your compiler"
+	#endif
+	}
+
+	//! Fixed-size queue between exactly one producer thread and one consumer thread, without locks.
+	//! Each index is only written by one side, and published after the slot it guards.
+	template<typename T>
+	class SingleProducerRing
+	{
+	public:
+		//! Create a ring holding at least capacity values
+		explicit SingleProducerRing(size_t capacity) :
+			head(0),
+			tail(0)
+		{
+			size_t size(1);
+			while (size < capacity)
+				size *= 2;
+			slots.resize(size);
+			mask = size - 1;
+		}
+
+		//! Producer: add a value, return false if the ring is full
+		bool push(const T& value)
+		{
+			const size_t position(head);
+			if (position - tail > mask)
+				return false;
+			// the consumer is done with this slot once it has published tail
+			memoryBarrier();
+			slots[position & mask] = value;
+			memoryBarrier();
+			head = position + 1;
+			return true;
+		}
+
+		//! Consumer: take up to maxCount values into values, return how many were taken
+		size_t pop(T* values, size_t maxCount)
+		{
+			const size_t position(tail);
+			size_t count(head - position);
+			if (count == 0)
+				return 0;
+			if (count > maxCount)
+				count = maxCount;
+			// the producer has written these slots before publishing head
+			memoryBarrier();
+			for (size_t i = 0; i < count; ++i)
+				values[i] = slots[(position + i) & mask];
+			memoryBarrier();
+			tail = position + count;
+			return count;
+		}
+
+		//! Consumer: take one value, return false if the ring is empty
+		bool pop(T& value)
+		{
+			return pop(&value, 1) == 1;
+		}
+
+		//! Number of values in the ring, only exact when called by the producer or the consumer while the other is idle
+		size_t size() const { return head - tail; }
+		//! Maximum number of values in the ring
+		size_t capacity() const { return slots.size(); }
+
+	protected:
+		std::vector<T> slots;
+		size_t mask;
+		volatile size_t head; //!< index of the next slot to write, only written by the producer
+		volatile size_t tail; //!< index of the next slot to read, only written by the consumer
+	};
+
+	/*@}*/
+}
+
+#endif // ASEBA_SINGLE_PRODUCER_RING_H
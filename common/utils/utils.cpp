@@ -264,6 +264,11 @@ namespace Aseba
 		return crc_xmodem_update(oldCrc, reinterpret_cast<const uint8*>(&v), 2);
 	}
 	
+	uint16 crcXModem(const uint16 oldCrc, const uint8* data, size_t length)
+	{
+		return crc_xmodem_update(oldCrc, data, length);
+	}
+	
 	template<typename T>
 	std::vector<T> split(const T& s, const T& delim)
 	{
@@ -122,6 +122,9 @@ namespace Aseba
 	//! Update the XModem CRC (x^16 + x^12 + x^5 + 1 (0x1021)) with a uint16 value
 	uint16 crcXModem(const uint16 oldCrc, const uint16 v);
 	
+	//! Update the XModem CRC (x^16 + x^12 + x^5 + 1 (0x1021)) with length bytes, independently of the byte order of the host
+	uint16 crcXModem(const uint16 oldCrc, const uint8* data, size_t length);
+	
 	//! Split a string using given delimiters
 	template<typename T>
 	std::vector<T> split(const T& s, const T& delim);
@@ -0,0 +1,252 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "compiler.h"
+#include <map>
+#include <algorithm>
+#include <cassert>
+
+#ifndef WIN32
+	#include <pthread.h>
+	#include <unistd.h>
+#else // WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#endif // WIN32
+
+namespace Aseba
+{
+	/** \addtogroup compiler */
+	/*@{*/
+
+	//! Lock protecting the state shared by the workers of a batch
+	class BatchLock
+	{
+	public:
+		#ifndef WIN32
+		BatchLock() { pthread_mutex_init(&mutex, 0); }
+		~BatchLock() { pthread_mutex_destroy(&mutex); }
+		void lock() { pthread_mutex_lock(&mutex); }
+		void unlock() { pthread_mutex_unlock(&mutex); }
+		#else // WIN32
+		BatchLock() { InitializeCriticalSection(&mutex); }
+		~BatchLock() { DeleteCriticalSection(&mutex); }
+		void lock() { EnterCriticalSection(&mutex); }
+		void unlock() { LeaveCriticalSection(&mutex); }
+		#endif // WIN32
+
+	private:
+		#ifndef WIN32
+		pthread_mutex_t mutex;
+		#else // WIN32
+		CRITICAL_SECTION mutex;
+		#endif // WIN32
+	};
+
+	//! Work shared by the workers of a batch, each worker taking the next program to compile
+	struct BatchWork
+	{
+		BatchWork(const BatchCompiler::Programs& programs, const std::vector<size_t>& toCompile, BatchCompiler::Results& results) :
+			programs(programs), toCompile(toCompile), results(results), next(0) {}
+
+		const BatchCompiler::Programs& programs; //!< all programs
+		const std::vector<size_t>& toCompile; //!< indices of the programs to compile
+		BatchCompiler::Results& results; //!< results, one per program
+		size_t next; //!< index in toCompile of the next program to compile
+		BatchLock lock; //!< lock protecting next
+	};
+
+	//! A worker of a batch, with its own compiler
+	struct BatchWorker
+	{
+		BatchWork* work; //!< work shared with other workers
+		Compiler compiler; //!< compiler of this worker
+
+		void run()
+		{
+			while (true)
+			{
+				work->lock.lock();
+				const size_t next(work->next);
+				if (next < work->toCompile.size())
+					++work->next;
+				work->lock.unlock();
+				if (next >= work->toCompile.size())
+					return;
+
+				const size_t index(work->toCompile[next]);
+				const BatchCompiler::Program& program(work->programs[index]);
+				BatchCompiler::Result& result(work->results[index]);
+
+				compiler.setTargetDescription(program.targetDescription);
+				compiler.setCommonDefinitions(program.commonDefinitions);
+				result.success = compiler.compile(program.source, result.bytecode, result.allocatedVariablesCount, result.error);
+				if (result.success)
+					result.variablesMap = *compiler.getVariablesMap();
+			}
+		}
+	};
+
+	#ifndef WIN32
+	static void* runBatchWorker(void* worker)
+	{
+		static_cast<BatchWorker*>(worker)->run();
+		return 0;
+	}
+	#else // WIN32
+	static DWORD WINAPI runBatchWorker(LPVOID worker)
+	{
+		static_cast<BatchWorker*>(worker)->run();
+		return 0;
+	}
+	#endif // WIN32
+
+	//! Key identifying identical programs, without comparing their common definitions
+	struct ProgramKey
+	{
+		ProgramKey(uint16 crc, const std::wstring* source) : crc(crc), source(source) {}
+
+		bool operator<(const ProgramKey& that) const
+		{
+			if (crc != that.crc)
+				return crc < that.crc;
+			return *source < *that.source;
+		}
+
+		uint16 crc; //!< crc of the target description
+		const std::wstring* source; //!< source code
+	};
+
+	// helper function
+	static bool isSameDefinitions(const CommonDefinitions* a, const CommonDefinitions* b)
+	{
+		return (a == b) || ((a->events == b->events) && (a->constants == b->constants));
+	}
+
+	//! Constructor, use at most threadsCount worker threads, or one per hardware thread if 0
+	BatchCompiler::BatchCompiler(unsigned threadsCount) :
+		threadsCount(threadsCount ? threadsCount : hardwareThreadsCount())
+	{
+	}
+
+	//! Compile programs and return their results, in the same order.
+	//! The translation callback for error messages must be set before calling this function.
+	BatchCompiler::Results BatchCompiler::compile(const Programs& programs) const
+	{
+		Results results(programs.size());
+
+		// find identical programs, so that they are compiled only once
+		typedef std::multimap<ProgramKey, size_t> CompiledPrograms;
+		CompiledPrograms compiledPrograms;
+		std::vector<size_t> toCompile;
+		std::vector<size_t> sameAs(programs.size());
+		for (size_t i = 0; i < programs.size(); ++i)
+		{
+			const Program& program(programs[i]);
+			assert(program.targetDescription);
+			assert(program.commonDefinitions);
+			const ProgramKey key(program.targetDescription->crc(), &program.source);
+
+			sameAs[i] = i;
+			std::pair<CompiledPrograms::const_iterator, CompiledPrograms::const_iterator> range(compiledPrograms.equal_range(key));
+			for (CompiledPrograms::const_iterator it(range.first); it != range.second; ++it)
+			{
+				if (isSameDefinitions(programs[it->second].commonDefinitions, program.commonDefinitions))
+				{
+					sameAs[i] = it->second;
+					break;
+				}
+			}
+			if (sameAs[i] == i)
+			{
+				compiledPrograms.insert(std::make_pair(key, i));
+				toCompile.push_back(i);
+			}
+		}
+
+		// the constructor of Compiler resets the translation callback, so create them here and restore it
+		const ErrorMessages::ErrorCallback translateCB(TranslatableError::translateCB);
+		BatchWork work(programs, toCompile, results);
+		const size_t workersCount(std::max<size_t>(1, std::min<size_t>(threadsCount, toCompile.size())));
+		std::vector<BatchWorker*> workers(workersCount);
+		for (size_t i = 0; i < workersCount; ++i)
+		{
+			workers[i] = new BatchWorker;
+			workers[i]->work = &work;
+		}
+		TranslatableError::setTranslateCB(translateCB);
+
+		// compile, using the calling thread as the first worker
+		#ifndef WIN32
+		std::vector<pthread_t> threads;
+		for (size_t i = 1; i < workersCount; ++i)
+		{
+			pthread_t thread;
+			if (pthread_create(&thread, 0, runBatchWorker, workers[i]) == 0)
+				threads.push_back(thread);
+		}
+		workers[0]->run();
+		for (size_t i = 0; i < threads.size(); ++i)
+			pthread_join(threads[i], 0);
+		#else // WIN32
+		std::vector<HANDLE> threads;
+		for (size_t i = 1; i < workersCount; ++i)
+		{
+			HANDLE thread(CreateThread(0, 0, runBatchWorker, workers[i], 0, 0));
+			if (thread)
+				threads.push_back(thread);
+		}
+		workers[0]->run();
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+		#endif // WIN32
+
+		for (size_t i = 0; i < workersCount; ++i)
+			delete workers[i];
+
+		// copy the results of identical programs
+		for (size_t i = 0; i < programs.size(); ++i)
+			if (sameAs[i] != i)
+				results[i] = results[sameAs[i]];
+
+		return results;
+	}
+
+	//! Return the number of threads the hardware can run in parallel
+	unsigned BatchCompiler::hardwareThreadsCount()
+	{
+		#ifndef WIN32
+		const long count(sysconf(_SC_NPROCESSORS_ONLN));
+		return count > 0 ? unsigned(count) : 1;
+		#else // WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return info.dwNumberOfProcessors > 0 ? unsigned(info.dwNumberOfProcessors) : 1;
+		#endif // WIN32
+	}
+
+	/*@}*/
+
+} // namespace Aseba
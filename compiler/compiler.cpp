@@ -28,6 +28,7 @@
 #include <cstdlib>
 #include <sstream>
 #include <iostream>
+#include <iterator>
 #include <fstream>
 #include <iomanip>
 #include <memory>
@@ -117,6 +118,8 @@ namespace Aseba
 		commonDefinitions = 0;
 		freeVariableIndex = 0;
 		endVariableIndex = 0;
+		incremental = false;
+		temporaryVariableUid = 0;
 		TranslatableError::setTranslateCB(ErrorMessages::defaultCallback);
 	}
 	
@@ -140,12 +143,23 @@ namespace Aseba
 	//! \param dump stream to send dump messages to
 	//! \return returns true on success 
 	bool Compiler::compile(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump)
+	{
+		const std::wstring text((std::istreambuf_iterator<wchar_t>(source)), std::istreambuf_iterator<wchar_t>());
+		return compile(text, bytecode, allocatedVariablesCount, errorDescription, dump);
+	}
+	
+	//! Compile a new condition
+	//! \param source source code
+	//! \param bytecode destination array for bytecode
+	//! \param allocatedVariablesCount amount of allocated variables
+	//! \param errorDescription error is copied there on error
+	//! \param dump stream to send dump messages to
+	//! \return returns true on success 
+	bool Compiler::compile(const std::wstring& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump)
 	{
 		assert(targetDescription);
 		assert(commonDefinitions);
 		
-		unsigned indent = 0;
-		
 		// we need to build maps at each compilation in case previous ones produced errors and messed maps up
 		buildMaps();
 		if (freeVariableIndex > targetDescription->variablesSize)
@@ -157,7 +171,7 @@ namespace Aseba
 		// tokenization
 		try
 		{
-			tokenize(source);
+			tokenize(source.data(), source.data() + source.size());
 		}
 		catch (TranslatableError error)
 		{
@@ -172,11 +186,15 @@ namespace Aseba
 			*dump << "\n\n";
 		}
 		
-		// parsing
-		std::auto_ptr<Node> program;
+		// parsing, tree passes and code generation, with all nodes released in bulk at the end
+		PreLinkBytecode preLinkBytecode;
+		NodeArena nodeArena;
 		try
 		{
-			program.reset(parseProgram());
+			if (incremental)
+				generateCodeIncrementally(preLinkBytecode, dump);
+			else
+				generateCode(parseProgram(), preLinkBytecode, dump);
 		}
 		catch (TranslatableError error)
 		{
@@ -184,45 +202,75 @@ namespace Aseba
 			return false;
 		}
 		
+		// set the number of allocated variables
+		allocatedVariablesCount = freeVariableIndex;
+		
 		if (dump)
 		{
-			*dump << "Vectorial syntax tree:\n";
-			program->dump(*dump, indent);
+			const float fillPercentage = float(allocatedVariablesCount * 100.f) / float(targetDescription->variablesSize);
+			*dump << "Using " << allocatedVariablesCount << " on " << targetDescription->variablesSize << " (" << fillPercentage << " %) words of variable space\n";
 			*dump << "\n\n";
-			*dump << "Checking the vectors' size:\n";
 		}
 		
-		// check vectors' size
-		try
+		// fix-up (add of missing STOP and RET bytecodes at code generation)
+		preLinkBytecode.fixup(subroutineTable);
+		
+		// stack check
+		if (!verifyStackCalls(preLinkBytecode))
 		{
-			program->checkVectorSize();
+			errorDescription = TranslatableError(SourcePos(), ERROR_STACK_OVERFLOW).toError();
+			return false;
 		}
-		catch(TranslatableError error)
+		
+		// linking (flattening of complex structure into linear vector)
+		if (!link(preLinkBytecode, bytecode))
 		{
-			errorDescription = error.toError();
+			errorDescription = TranslatableError(SourcePos(), ERROR_SCRIPT_TOO_BIG).toError();
 			return false;
 		}
-
+		
 		if (dump)
 		{
-			*dump << "Ok\n";
+			*dump << "Bytecode:\n";
+			disassemble(bytecode, preLinkBytecode, *dump);
 			*dump << "\n\n";
-			*dump << "Expanding the syntax tree...\n";
 		}
-
-		// expand the syntax tree to Aseba-like syntax
-		try
+		
+		return true;
+	}
+	
+	//! Run all tree passes on program and generate its code into preLinkBytecode, throw a TranslatableError on error
+	//! \param programTree syntax tree as returned by the parser, ownership is taken
+	//! \param preLinkBytecode destination for the generated code
+	//! \param dump stream to send dump messages to
+	void Compiler::generateCode(Node* programTree, PreLinkBytecode& preLinkBytecode, std::wostream* dump)
+	{
+		std::auto_ptr<Node> program(programTree);
+		unsigned indent = 0;
+		
+		if (dump)
 		{
-			Node* expandedProgram(program->expandAbstractNodes(dump));
-			program.release();
-			program.reset(expandedProgram);
+			*dump << "Vectorial syntax tree:\n";
+			program->dump(*dump, indent);
+			*dump << "\n\n";
+			*dump << "Checking the vectors' size:\n";
 		}
-		catch (TranslatableError error)
+		
+		// check vectors' size
+		program->checkVectorSize();
+		
+		if (dump)
 		{
-			errorDescription = error.toError();
-			return false;
+			*dump << "Ok\n";
+			*dump << "\n\n";
+			*dump << "Expanding the syntax tree...\n";
 		}
-
+		
+		// expand the syntax tree to Aseba-like syntax
+		Node* expandedProgram(program->expandAbstractNodes(dump));
+		program.release();
+		program.reset(expandedProgram);
+		
 		if (dump)
 		{
 			*dump << "Expanded syntax tree (pass 1):\n";
@@ -230,20 +278,12 @@ namespace Aseba
 			*dump << "\n\n";
 			*dump << "Second pass for vectorial operations:\n";
 		}
-
+		
 		// expand the vectorial nodes into scalar operations
-		try
-		{
-			Node* expandedProgram(program->expandVectorialNodes(dump, this));
-			program.release();
-			program.reset(expandedProgram);
-		}
-		catch (TranslatableError error)
-		{
-			errorDescription = error.toError();
-			return false;
-		}
-
+		expandedProgram = program->expandVectorialNodes(dump, this);
+		program.release();
+		program.reset(expandedProgram);
+		
 		if (dump)
 		{
 			*dump << "Expanded syntax tree (pass 2):\n";
@@ -251,17 +291,9 @@ namespace Aseba
 			*dump << "\n\n";
 			*dump << "Type checking:\n";
 		}
-
+		
 		// typecheck
-		try
-		{
-			program->typeCheck();
-		}
-		catch(TranslatableError error)
-		{
-			errorDescription = error.toError();
-			return false;
-		}
+		program->typeCheck();
 		
 		if (dump)
 		{
@@ -271,17 +303,9 @@ namespace Aseba
 		}
 		
 		// optimization
-		try
-		{
-			Node* optimizedProgram(program->optimize(dump));
-			program.release();
-			program.reset(optimizedProgram);
-		}
-		catch (TranslatableError error)
-		{
-			errorDescription = error.toError();
-			return false;
-		}
+		Node* optimizedProgram(program->optimize(dump));
+		program.release();
+		program.reset(optimizedProgram);
 		
 		if (dump)
 		{
@@ -291,45 +315,8 @@ namespace Aseba
 			*dump << "\n\n";
 		}
 		
-		// set the number of allocated variables
-		allocatedVariablesCount = freeVariableIndex;
-		
-		if (dump)
-		{
-			const float fillPercentage = float(allocatedVariablesCount * 100.f) / float(targetDescription->variablesSize);
-			*dump << "Using " << allocatedVariablesCount << " on " << targetDescription->variablesSize << " (" << fillPercentage << " %) words of variable space\n";
-			*dump << "\n\n";
-		}
-		
 		// code generation
-		PreLinkBytecode preLinkBytecode;
 		program->emit(preLinkBytecode);
-		
-		// fix-up (add of missing STOP and RET bytecodes at code generation)
-		preLinkBytecode.fixup(subroutineTable);
-		
-		// stack check
-		if (!verifyStackCalls(preLinkBytecode))
-		{
-			errorDescription = TranslatableError(SourcePos(), ERROR_STACK_OVERFLOW).toError();
-			return false;
-		}
-		
-		// linking (flattening of complex structure into linear vector)
-		if (!link(preLinkBytecode, bytecode))
-		{
-			errorDescription = TranslatableError(SourcePos(), ERROR_SCRIPT_TOO_BIG).toError();
-			return false;
-		}
-		
-		if (dump)
-		{
-			*dump << "Bytecode:\n";
-			disassemble(bytecode, preLinkBytecode, *dump);
-			*dump << "\n\n";
-		}
-		
-		return true;
 	}
 	
 	//! Create the final bytecode for a microcontroller
@@ -216,6 +216,8 @@ namespace Aseba
 	{
 		//! Create a filled pair
 		NamedValue(const std::wstring& name, int value) : name(name), value(value) {}
+		//! Compare both name and value
+		bool operator==(const NamedValue& that) const { return name == that.name && value == that.value; }
 		
 		std::wstring name; //!< name part of the pair
 		int value; //!< value part of the pair
@@ -362,6 +364,28 @@ namespace Aseba
 		typedef std::map<std::wstring, int> ConstantsMap;
 		//! Lookup table for event name => id
 		typedef std::map<std::wstring, unsigned> EventsMap;
+		
+		//! Code of an event handler or a subroutine, reused by incremental compilation as long as its tokens and context do not change
+		struct CachedSegment
+		{
+			std::vector<Token> tokens; //!< tokens of the segment, starting with onevent or sub
+			std::vector<std::wstring> previousSubroutines; //!< names of the subroutines declared before this segment
+			std::map<unsigned, BytecodeVector> events; //!< bytecode of implemented events
+			std::map<unsigned, BytecodeVector> subroutines; //!< bytecode of declared subroutines
+			std::vector<SubroutineDescriptor> subroutineDescriptors; //!< descriptors of declared subroutines
+		};
+		//! Cached code of segments along with the context they were compiled in
+		struct SegmentCache
+		{
+			uint16 targetCrc; //!< CRC of the target description
+			CommonDefinitions commonDefinitions; //!< events and constants common to all nodes
+			VariablesMap variablesMap; //!< variables, including the ones declared in the program
+			ConstantsMap constantsMap; //!< constants, including the ones declared in the program
+			unsigned freeVariableIndex; //!< first free variable after declarations
+			std::vector<CachedSegment> segments; //!< cached segments
+			
+			SegmentCache() : targetCrc(0), freeVariableIndex(0) {}
+		};
 
 		friend struct AssignmentNode;
 	
@@ -373,6 +397,9 @@ namespace Aseba
 		const SubroutineTable *getSubroutineTable() const { return &subroutineTable; }
 		void setCommonDefinitions(const CommonDefinitions *definitions);
 		bool compile(std::wistream& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump = 0);
+		bool compile(const std::wstring& source, BytecodeVector& bytecode, unsigned& allocatedVariablesCount, Error &errorDescription, std::wostream* dump = 0);
+		void setIncremental(bool incremental);
+		bool isIncremental() const { return incremental; }
 		void setTranslateCallback(ErrorMessages::ErrorCallback newCB) { TranslatableError::setTranslateCB(newCB); }
 		static std::wstring translate(ErrorCode error) { return TranslatableError::translateCB(error); }
 		static bool isKeyword(const std::wstring& word);
@@ -398,6 +425,7 @@ namespace Aseba
 		void expectOneOf(const Token::Type types[length]) const;
 
 		void freeTemporaryMemory();
+		void releaseTemporaryMemory(const unsigned mark);
 		unsigned allocateTemporaryMemory(const SourcePos varPos, const unsigned size);
 		AssignmentNode* allocateTemporaryVariable(const SourcePos varPos, Node* rValue);
 
@@ -409,16 +437,23 @@ namespace Aseba
 		SubroutineReverseTable::const_iterator findSubroutine(const std::wstring& name, const SourcePos& pos) const;
 		bool constantExists(const std::wstring& name) const;
 		void buildMaps();
-		void tokenize(std::wistream& source);
-		wchar_t getNextCharacter(std::wistream& source, SourcePos& pos);
-		bool testNextCharacter(std::wistream& source, SourcePos& pos, wchar_t test, Token::Type tokenIfTrue);
+		void tokenize(const wchar_t* source, const wchar_t* end);
+		wchar_t getNextCharacter(const wchar_t*& source, SourcePos& pos);
+		bool testNextCharacter(const wchar_t*& source, const wchar_t* end, SourcePos& pos, wchar_t test, Token::Type tokenIfTrue);
 		void dumpTokens(std::wostream &dest) const;
+		void generateCode(Node* programTree, PreLinkBytecode& preLinkBytecode, std::wostream* dump);
+		void generateCodeIncrementally(PreLinkBytecode& preLinkBytecode, std::wostream* dump);
+		bool isSegmentCacheValid() const;
+		const CachedSegment* findCachedSegment(size_t tokensCount) const;
+		bool reuseCachedSegment(const CachedSegment& segment, PreLinkBytecode& preLinkBytecode);
 		bool verifyStackCalls(PreLinkBytecode& preLinkBytecode);
 		bool link(const PreLinkBytecode& preLinkBytecode, BytecodeVector& bytecode);
 		void disassemble(BytecodeVector& bytecode, const PreLinkBytecode& preLinkBytecode, std::wostream& dump) const;
 		
 	protected:
 		Node* parseProgram();
+		void parseDeclarations(Node* block);
+		Node* parseSegment(bool programStart);
 		
 		Node* parseStatement();
 		
@@ -474,10 +509,53 @@ namespace Aseba
 		unsigned endVariableIndex; //!< (endMemory - endVariableIndex) is pointing to the first free variable at the end
 		const TargetDescription *targetDescription; //!< description of the target VM
 		const CommonDefinitions *commonDefinitions; //!< common definitions, such as events or some constants
+		bool incremental; //!< if true, reuse the code of event handlers and subroutines that did not change since last compilation
+		SegmentCache segmentCache; //!< code of event handlers and subroutines of previous compilations, for incremental compilation
+		unsigned temporaryVariableUid; //!< unique id for naming temporary variables
 
 		ErrorMessages translator;
 	}; // Compiler
 	
+	//! Compile the programs of many nodes in parallel, programs with the same source,
+	//! target and common definitions being compiled only once
+	class BatchCompiler
+	{
+	public:
+		//! The program of a node
+		struct Program
+		{
+			Program(const std::wstring& source, const TargetDescription* targetDescription, const CommonDefinitions* commonDefinitions) :
+				source(source), targetDescription(targetDescription), commonDefinitions(commonDefinitions) {}
+			
+			std::wstring source; //!< source code
+			const TargetDescription* targetDescription; //!< description of the node
+			const CommonDefinitions* commonDefinitions; //!< events and constants of the network
+		};
+		typedef std::vector<Program> Programs;
+		
+		//! The result of the compilation of a program
+		struct Result
+		{
+			Result() : success(false), allocatedVariablesCount(0) {}
+			
+			bool success; //!< whether compilation was successful
+			BytecodeVector bytecode; //!< bytecode, if compilation was successful
+			unsigned allocatedVariablesCount; //!< amount of allocated variables, if compilation was successful
+			Error error; //!< error, if compilation failed
+			VariablesMap variablesMap; //!< variables of the program, if compilation was successful
+		};
+		typedef std::vector<Result> Results;
+		
+	public:
+		BatchCompiler(unsigned threadsCount = 0);
+		Results compile(const Programs& programs) const;
+		
+		static unsigned hardwareThreadsCount();
+		
+	protected:
+		unsigned threadsCount; //!< maximum number of worker threads
+	}; // BatchCompiler
+	
 	//! Bytecode use for compilation previous to linking
 	struct PreLinkBytecode
 	{
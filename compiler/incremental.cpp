@@ -0,0 +1,226 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "compiler.h"
+#include "tree.h"
+#include "../common/consts.h"
+#include <cassert>
+
+namespace Aseba
+{
+	/** \addtogroup compiler */
+	/*@{*/
+
+	/*
+	 * Incremental compilation
+	 *   - The program is split into segments: the first one holds the declarations and the init code,
+	 *     each following one starts with an "onevent" or a "sub" keyword and runs up to the next one.
+	 *   - The declarations and init code are always compiled, as every other segment depends on them.
+	 *   - The code of each other segment is cached after its compilation, and reused in the following
+	 *     compilations as long as its tokens, the subroutines declared before it and the declarations
+	 *     did not change. Lines are compared relatively to the segment start, so that a segment that
+	 *     only moved within the source is reused as well, with its lines shifted.
+	 *   - Linking, which is cheap, is always performed on the whole program.
+	 */
+
+	// helper function
+	static bool isSameSegment(const std::vector<Compiler::Token>& cached, const std::deque<Compiler::Token>& tokens, size_t tokensCount)
+	{
+		if (cached.size() != tokensCount)
+			return false;
+
+		// compare type, value and relative row of all tokens
+		const int cachedStartRow(cached[0].pos.row);
+		const int startRow(tokens[0].pos.row);
+		for (size_t i = 0; i < tokensCount; ++i)
+		{
+			const Compiler::Token& a(cached[i]);
+			const Compiler::Token& b(tokens[i]);
+			if (a.type != b.type || a.iValue != b.iValue || a.sValue != b.sValue)
+				return false;
+			if (int(a.pos.row) - cachedStartRow != int(b.pos.row) - startRow)
+				return false;
+		}
+		return true;
+	}
+
+	// helper function
+	static BytecodeVector moveLines(const BytecodeVector& source, int lineDelta)
+	{
+		BytecodeVector bytecode(source);
+		for (size_t i = 0; i < bytecode.size(); ++i)
+			bytecode[i].line += lineDelta;
+		bytecode.lastLine += lineDelta;
+		return bytecode;
+	}
+
+	//! Enable or disable incremental compilation. When enabled, the code of event handlers and subroutines
+	//! that did not change since the previous call to compile() is reused, so the same Compiler object should
+	//! be used for successive compilations of a given program. Output of dump is only provided for the parts
+	//! that are actually compiled.
+	void Compiler::setIncremental(bool incremental)
+	{
+		this->incremental = incremental;
+		if (!incremental)
+			segmentCache = SegmentCache();
+	}
+
+	//! Return whether the segments in the cache were compiled in the current context, once declarations are parsed
+	bool Compiler::isSegmentCacheValid() const
+	{
+		return
+			segmentCache.targetCrc == targetDescription->crc() &&
+			segmentCache.commonDefinitions.events == commonDefinitions->events &&
+			segmentCache.commonDefinitions.constants == commonDefinitions->constants &&
+			segmentCache.variablesMap == variablesMap &&
+			segmentCache.constantsMap == constantsMap &&
+			segmentCache.freeVariableIndex == freeVariableIndex;
+	}
+
+	//! Return the cached segment matching the first tokensCount tokens, or 0 if there is none
+	const Compiler::CachedSegment* Compiler::findCachedSegment(size_t tokensCount) const
+	{
+		for (size_t i = 0; i < segmentCache.segments.size(); ++i)
+		{
+			const CachedSegment& segment(segmentCache.segments[i]);
+			if (segment.previousSubroutines.size() != subroutineTable.size())
+				continue;
+			bool sameSubroutines(true);
+			for (size_t j = 0; j < subroutineTable.size(); ++j)
+				if (segment.previousSubroutines[j] != subroutineTable[j].name)
+					sameSubroutines = false;
+			if (sameSubroutines && isSameSegment(segment.tokens, tokens, tokensCount))
+				return &segment;
+		}
+		return 0;
+	}
+
+	//! Add the code of a cached segment to preLinkBytecode, return false if it conflicts with the rest of the program
+	bool Compiler::reuseCachedSegment(const CachedSegment& segment, PreLinkBytecode& preLinkBytecode)
+	{
+		// check for events implemented twice or subroutines defined twice, the parser will report them
+		for (PreLinkBytecode::EventsBytecode::const_iterator it = segment.events.begin(); it != segment.events.end(); ++it)
+			if (implementedEvents.find(it->first) != implementedEvents.end())
+				return false;
+		for (size_t i = 0; i < segment.subroutineDescriptors.size(); ++i)
+			if (subroutineReverseTable.find(segment.subroutineDescriptors[i].name) != subroutineReverseTable.end())
+				return false;
+
+		const int lineDelta(int(tokens.front().pos.row) - int(segment.tokens.front().pos.row));
+
+		// events
+		for (PreLinkBytecode::EventsBytecode::const_iterator it = segment.events.begin(); it != segment.events.end(); ++it)
+		{
+			implementedEvents.insert(it->first);
+			preLinkBytecode.events[it->first] = moveLines(it->second, lineDelta);
+		}
+
+		// subroutines, as they were declared after the same ones, they get the same ids
+		for (size_t i = 0; i < segment.subroutineDescriptors.size(); ++i)
+		{
+			const SubroutineDescriptor& descriptor(segment.subroutineDescriptors[i]);
+			const unsigned subroutineId = subroutineTable.size();
+			subroutineTable.push_back(SubroutineDescriptor(descriptor.name, 0, descriptor.line + lineDelta));
+			subroutineReverseTable[descriptor.name] = subroutineId;
+		}
+		for (PreLinkBytecode::SubroutinesBytecode::const_iterator it = segment.subroutines.begin(); it != segment.subroutines.end(); ++it)
+			preLinkBytecode.subroutines[it->first] = moveLines(it->second, lineDelta);
+
+		return true;
+	}
+
+	//! Generate the code of the program into preLinkBytecode, reusing the code of unchanged segments, throw a TranslatableError on error
+	void Compiler::generateCodeIncrementally(PreLinkBytecode& preLinkBytecode, std::wostream* dump)
+	{
+		// declarations and init code
+		generateCode(parseSegment(true), preLinkBytecode, dump);
+
+		// the cached segments are only valid if they were compiled with the same declarations
+		if (!isSegmentCacheValid())
+		{
+			segmentCache = SegmentCache();
+			segmentCache.targetCrc = targetDescription->crc();
+			segmentCache.commonDefinitions = *commonDefinitions;
+			segmentCache.variablesMap = variablesMap;
+			segmentCache.constantsMap = constantsMap;
+			segmentCache.freeVariableIndex = freeVariableIndex;
+		}
+
+		std::vector<CachedSegment> segments;
+		std::vector<CachedSegment> compiledSegments;
+		try
+		{
+			while (tokens.front() != Token::TOKEN_END_OF_STREAM)
+			{
+				// find the extent of the segment
+				size_t tokensCount(1);
+				while (tokens[tokensCount] != Token::TOKEN_END_OF_STREAM &&
+					tokens[tokensCount] != Token::TOKEN_STR_onevent &&
+					tokens[tokensCount] != Token::TOKEN_STR_sub)
+					++tokensCount;
+
+				// reuse cached code if available
+				const CachedSegment* cachedSegment(findCachedSegment(tokensCount));
+				if (cachedSegment && reuseCachedSegment(*cachedSegment, preLinkBytecode))
+				{
+					if (dump)
+						*dump << "Reusing code of lines " << tokens[0].pos.row + 1 << " to " << tokens[tokensCount - 1].pos.row + 1 << "\n\n";
+					segments.push_back(*cachedSegment);
+					tokens.erase(tokens.begin(), tokens.begin() + tokensCount);
+					continue;
+				}
+
+				// otherwise compile it separately
+				CachedSegment segment;
+				segment.tokens.assign(tokens.begin(), tokens.begin() + tokensCount);
+				for (size_t i = 0; i < subroutineTable.size(); ++i)
+					segment.previousSubroutines.push_back(subroutineTable[i].name);
+				const size_t subroutinesCount(subroutineTable.size());
+
+				PreLinkBytecode segmentBytecode;
+				generateCode(parseSegment(false), segmentBytecode, dump);
+				segmentBytecode.events.erase(ASEBA_EVENT_INIT);
+
+				for (PreLinkBytecode::EventsBytecode::const_iterator it = segmentBytecode.events.begin(); it != segmentBytecode.events.end(); ++it)
+					preLinkBytecode.events[it->first] = it->second;
+				for (PreLinkBytecode::SubroutinesBytecode::const_iterator it = segmentBytecode.subroutines.begin(); it != segmentBytecode.subroutines.end(); ++it)
+					preLinkBytecode.subroutines[it->first] = it->second;
+
+				segment.events = segmentBytecode.events;
+				segment.subroutines = segmentBytecode.subroutines;
+				segment.subroutineDescriptors.assign(subroutineTable.begin() + subroutinesCount, subroutineTable.end());
+				segments.push_back(segment);
+				compiledSegments.push_back(segment);
+			}
+		}
+		catch (TranslatableError error)
+		{
+			// keep the segments compiled so far, they will be trimmed by the next successful compilation
+			segmentCache.segments.insert(segmentCache.segments.end(), compiledSegments.begin(), compiledSegments.end());
+			throw;
+		}
+
+		// only keep the segments of the current program
+		segmentCache.segments.swap(segments);
+	}
+
+	/*@}*/
+
+} // namespace Aseba
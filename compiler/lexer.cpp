@@ -25,6 +25,9 @@
 #include <ostream>
 #include <cctype>
 #include <cstdio>
+#include <cwchar>
+#include <cassert>
+#include <algorithm>
 
 namespace Aseba
 {
@@ -170,21 +173,96 @@ namespace Aseba
 	}
 	
 	
+	//! A keyword of the language and the token it maps to
+	struct Keyword
+	{
+		const wchar_t* name;
+		Compiler::Token::Type type;
+	};
+	
+	//! All keywords of the language
+	static const Keyword keywords[] =
+	{
+		{ L"when", Compiler::Token::TOKEN_STR_when },
+		{ L"emit", Compiler::Token::TOKEN_STR_emit },
+		{ L"_emit", Compiler::Token::TOKEN_STR_hidden_emit },
+		{ L"for", Compiler::Token::TOKEN_STR_for },
+		{ L"in", Compiler::Token::TOKEN_STR_in },
+		{ L"step", Compiler::Token::TOKEN_STR_step },
+		{ L"while", Compiler::Token::TOKEN_STR_while },
+		{ L"do", Compiler::Token::TOKEN_STR_do },
+		{ L"if", Compiler::Token::TOKEN_STR_if },
+		{ L"then", Compiler::Token::TOKEN_STR_then },
+		{ L"else", Compiler::Token::TOKEN_STR_else },
+		{ L"elseif", Compiler::Token::TOKEN_STR_elseif },
+		{ L"end", Compiler::Token::TOKEN_STR_end },
+		{ L"var", Compiler::Token::TOKEN_STR_var },
+		{ L"const", Compiler::Token::TOKEN_STR_const },
+		{ L"call", Compiler::Token::TOKEN_STR_call },
+		{ L"sub", Compiler::Token::TOKEN_STR_sub },
+		{ L"callsub", Compiler::Token::TOKEN_STR_callsub },
+		{ L"onevent", Compiler::Token::TOKEN_STR_onevent },
+		{ L"abs", Compiler::Token::TOKEN_STR_abs },
+		{ L"return", Compiler::Token::TOKEN_STR_return },
+		{ L"or", Compiler::Token::TOKEN_OP_OR },
+		{ L"and", Compiler::Token::TOKEN_OP_AND },
+		{ L"not", Compiler::Token::TOKEN_OP_NOT },
+	};
+	static const size_t keywordsCount = sizeof(keywords) / sizeof(Keyword);
+	
+	//! Hash of a non-empty word, perfect on keywords: no two of them have the same value
+	static inline unsigned keywordHash(const wchar_t* word, size_t length)
+	{
+		return (unsigned(length) + 13 * unsigned(word[0]) + 5 * unsigned(word[length - 1])) & 63;
+	}
+	
+	//! Table from hash to keyword, built once at startup
+	struct KeywordTable
+	{
+		unsigned char slots[64]; //!< index in keywords plus one, 0 if no keyword has this hash
+		size_t lengths[keywordsCount]; //!< length of keywords
+		
+		KeywordTable()
+		{
+			std::fill(slots, slots + 64, 0);
+			for (size_t i = 0; i < keywordsCount; ++i)
+			{
+				lengths[i] = wcslen(keywords[i].name);
+				const unsigned hash(keywordHash(keywords[i].name, lengths[i]));
+				assert(slots[hash] == 0);
+				slots[hash] = i + 1;
+			}
+		}
+		
+		//! Return the keyword matching word, or 0 if it is not a keyword
+		const Keyword* find(const wchar_t* word, size_t length) const
+		{
+			if (length == 0)
+				return 0;
+			const unsigned slot(slots[keywordHash(word, length)]);
+			if (slot == 0 || lengths[slot - 1] != length)
+				return 0;
+			const Keyword* keyword(&keywords[slot - 1]);
+			if (std::wmemcmp(keyword->name, word, length) != 0)
+				return 0;
+			return keyword;
+		}
+	};
+	static const KeywordTable keywordTable;
+	
 	//! Parse source and build tokens vector
-	//! \param source source code
-	void Compiler::tokenize(std::wistream& source)
+	//! \param source start of source code
+	//! \param end end of source code
+	void Compiler::tokenize(const wchar_t* source, const wchar_t* end)
 	{
 		tokens.clear();
 		SourcePos pos(0, 0, 0);
 		const unsigned tabSize = 4;
 		
 		// tokenize text source
-		while (source.good())
+		while (source != end)
 		{
-			wchar_t c = source.get();
-			
-			if (source.eof())
-				break;
+			wchar_t c = *source++;
 			
 			pos.column++;
 			pos.character++;
@@ -208,14 +286,14 @@ namespace Aseba
 				case '#':
 				{
 					// check if it's a comment block #* ... *#
-					if (source.peek() == '*')
+					if (source != end && *source == '*')
 					{
 						// comment block
 						// record position of the begining
 						SourcePos begin(pos);
 						// move forward by 2 characters then search for the end
 						int step = 2;
-						while ((step > 0) || (c != '*') || (source.peek() != '#'))
+						while ((step > 0) || (c != '*') || (source == end) || (*source != '#'))
 						{
 							if (step)
 								step--;
@@ -229,28 +307,32 @@ namespace Aseba
 							}
 							else
 								pos.column++;
-							c = source.get();
 							pos.character++;
-							if (source.eof())
+							if (source == end)
 							{
 								// EOF -> unbalanced block
 								throw TranslatableError(begin, ERROR_UNBALANCED_COMMENT_BLOCK);
 							}
+							c = *source++;
 						}
 						// fetch the #
 						getNextCharacter(source, pos);
 					}
 					else
 					{
-						// simple comment
-						while ((c != '\n') && (c != '\r') && (!source.eof()))
+						// simple comment, nothing to skip if the # is the last character
+						bool comment(source != end);
+						while (comment && (c != '\n') && (c != '\r'))
 						{
 							if (c == '\t')
 								pos.column += tabSize;
 							else
 								pos.column++;
-							c = source.get();
 							pos.character++;
+							if (source == end)
+								comment = false;
+							else
+								c = *source++;
 						}
 						if (c == '\n')
 						{
@@ -265,53 +347,53 @@ namespace Aseba
 				
 				// cases that require one character look-ahead
 				case '+':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_ADD_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_ADD_EQUAL))
 						break;
-					if (testNextCharacter(source, pos, '+', Token::TOKEN_OP_PLUS_PLUS))
+					if (testNextCharacter(source, end, pos, '+', Token::TOKEN_OP_PLUS_PLUS))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_ADD, pos));
 					break;
 
 				case '-':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_NEG_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_NEG_EQUAL))
 						break;
-					if (testNextCharacter(source, pos, '-', Token::TOKEN_OP_MINUS_MINUS))
+					if (testNextCharacter(source, end, pos, '-', Token::TOKEN_OP_MINUS_MINUS))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_NEG, pos));
 					break;
 
 				case '*':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_MULT_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_MULT_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_MULT, pos));
 					break;
 
 				case '/':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_DIV_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_DIV_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_DIV, pos));
 					break;
 
 				case '%':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_MOD_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_MOD_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_MOD, pos));
 					break;
 
 				case '|':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_BIT_OR_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_BIT_OR_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_BIT_OR, pos));
 					break;
 
 				case '^':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_BIT_XOR_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_BIT_XOR_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_BIT_XOR, pos));
 					break;
 
 				case '&':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_BIT_AND_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_BIT_AND_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_BIT_AND, pos));
 					break;
@@ -321,46 +403,46 @@ namespace Aseba
 					break;
 
 				case '!':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_NOT_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_NOT_EQUAL))
 						break;
 					throw TranslatableError(pos, ERROR_SYNTAX);
 					break;
 				
 				case '=':
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_ASSIGN, pos));
 					break;
 				
 				// cases that require two characters look-ahead
 				case '<':
-					if (source.peek() == '<')
+					if (source != end && *source == '<')
 					{
 						// <<
 						getNextCharacter(source, pos);
-						if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_SHIFT_LEFT_EQUAL))
+						if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_SHIFT_LEFT_EQUAL))
 							break;
 						tokens.push_back(Token(Token::TOKEN_OP_SHIFT_LEFT, pos));
 						break;
 					}
 					// <
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_SMALLER_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_SMALLER_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_SMALLER, pos));
 					break;
 				
 				case '>':
-					if (source.peek() == '>')
+					if (source != end && *source == '>')
 					{
 						// >>
 						getNextCharacter(source, pos);
-						if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_SHIFT_RIGHT_EQUAL))
+						if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_SHIFT_RIGHT_EQUAL))
 							break;
 						tokens.push_back(Token(Token::TOKEN_OP_SHIFT_RIGHT, pos));
 						break;
 					}
 					// >
-					if (testNextCharacter(source, pos, '=', Token::TOKEN_OP_BIGGER_EQUAL))
+					if (testNextCharacter(source, end, pos, '=', Token::TOKEN_OP_BIGGER_EQUAL))
 						break;
 					tokens.push_back(Token(Token::TOKEN_OP_BIGGER, pos));
 					break;
@@ -372,22 +454,17 @@ namespace Aseba
 					if (!std::iswalnum(c) && (c != '_'))
 						throw TranslatableError(pos, ERROR_INVALID_IDENTIFIER).arg((unsigned)c, 0, 16);
 					
-					// get a string
-					std::wstring s;
-					s += c;
-					wchar_t nextC = source.peek();
-					int posIncrement = 0;
-					while ((source.good()) && (std::iswalnum(nextC) || (nextC == '_') || (nextC == '.')))
-					{
-						s += nextC;
-						source.get();
-						posIncrement++;
-						nextC = source.peek();
-					}
+					// find the end of the word in the buffer
+					const wchar_t* const wordBegin(source - 1);
+					while ((source != end) && (std::iswalnum(*source) || (*source == '_') || (*source == '.')))
+						++source;
+					const size_t wordLength(source - wordBegin);
+					const int posIncrement(wordLength - 1);
 					
-					// we now have a string, let's check what it is
-					if (std::iswdigit(s[0]))
+					// we now have a word, let's check what it is
+					if (std::iswdigit(c))
 					{
+						const std::wstring s(wordBegin, wordLength);
 						// check if hex or binary
 						if ((s.length() > 1) && (s[0] == '0') && (!std::iswdigit(s[1])))
 						{
@@ -420,57 +497,11 @@ namespace Aseba
 					else
 					{
 						// check if it is a known keyword
-						// FIXME: clean-up that with a table
-						if (s == L"when")
-							tokens.push_back(Token(Token::TOKEN_STR_when, pos));
-						else if (s == L"emit")
-							tokens.push_back(Token(Token::TOKEN_STR_emit, pos));
-						else if (s == L"_emit")
-							tokens.push_back(Token(Token::TOKEN_STR_hidden_emit, pos));
-						else if (s == L"for")
-							tokens.push_back(Token(Token::TOKEN_STR_for, pos));
-						else if (s == L"in")
-							tokens.push_back(Token(Token::TOKEN_STR_in, pos));
-						else if (s == L"step")
-							tokens.push_back(Token(Token::TOKEN_STR_step, pos));
-						else if (s == L"while")
-							tokens.push_back(Token(Token::TOKEN_STR_while, pos));
-						else if (s == L"do")
-							tokens.push_back(Token(Token::TOKEN_STR_do, pos));
-						else if (s == L"if")
-							tokens.push_back(Token(Token::TOKEN_STR_if, pos));
-						else if (s == L"then")
-							tokens.push_back(Token(Token::TOKEN_STR_then, pos));
-						else if (s == L"else")
-							tokens.push_back(Token(Token::TOKEN_STR_else, pos));
-						else if (s == L"elseif")
-							tokens.push_back(Token(Token::TOKEN_STR_elseif, pos));
-						else if (s == L"end")
-							tokens.push_back(Token(Token::TOKEN_STR_end, pos));
-						else if (s == L"var")
-							tokens.push_back(Token(Token::TOKEN_STR_var, pos));
-						else if (s == L"const")
-							tokens.push_back(Token(Token::TOKEN_STR_const, pos));
-						else if (s == L"call")
-							tokens.push_back(Token(Token::TOKEN_STR_call, pos));
-						else if (s == L"sub")
-							tokens.push_back(Token(Token::TOKEN_STR_sub, pos));
-						else if (s == L"callsub")
-							tokens.push_back(Token(Token::TOKEN_STR_callsub, pos));
-						else if (s == L"onevent")
-							tokens.push_back(Token(Token::TOKEN_STR_onevent, pos));
-						else if (s == L"abs")
-							tokens.push_back(Token(Token::TOKEN_STR_abs, pos));
-						else if (s == L"return")
-							tokens.push_back(Token(Token::TOKEN_STR_return, pos));
-						else if (s == L"or")
-							tokens.push_back(Token(Token::TOKEN_OP_OR, pos));
-						else if (s == L"and")
-							tokens.push_back(Token(Token::TOKEN_OP_AND, pos));
-						else if (s == L"not")
-							tokens.push_back(Token(Token::TOKEN_OP_NOT, pos));
+						const Keyword* keyword(keywordTable.find(wordBegin, wordLength));
+						if (keyword)
+							tokens.push_back(Token(keyword->type, pos));
 						else
-							tokens.push_back(Token(Token::TOKEN_STRING_LITERAL, pos, s));
+							tokens.push_back(Token(Token::TOKEN_STRING_LITERAL, pos, std::wstring(wordBegin, wordLength)));
 					}
 					
 					pos.column += posIncrement;
@@ -478,21 +509,21 @@ namespace Aseba
 				}
 				break;
 			} // switch (c)
-		} // while (source.good())
+		} // while (source != end)
 		
 		tokens.push_back(Token(Token::TOKEN_END_OF_STREAM, pos));
 	}
 
-	wchar_t Compiler::getNextCharacter(std::wistream &source, SourcePos &pos)
+	wchar_t Compiler::getNextCharacter(const wchar_t*& source, SourcePos &pos)
 	{
 		pos.column++;
 		pos.character++;
-		return source.get();
+		return *source++;
 	}
 
-	bool Compiler::testNextCharacter(std::wistream &source, SourcePos &pos, wchar_t test, Token::Type tokenIfTrue)
+	bool Compiler::testNextCharacter(const wchar_t*& source, const wchar_t* end, SourcePos &pos, wchar_t test, Token::Type tokenIfTrue)
 	{
-		if ((int)source.peek() == int(test))
+		if ((source != end) && (*source == test))
 		{
 			tokens.push_back(Token(tokenIfTrue, pos));
 			getNextCharacter(source, pos);
@@ -511,56 +542,6 @@ namespace Aseba
 	//! Return whether a string is a language keyword
 	bool Compiler::isKeyword(const std::wstring& s)
 	{
-		// FIXME: clean-up that with a table
-		if (s == L"when")
-			return true;
-		else if (s == L"emit")
-			return true;
-		else if (s == L"_emit")
-			return true;
-		else if (s == L"for")
-			return true;
-		else if (s == L"in")
-			return true;
-		else if (s == L"step")
-			return true;
-		else if (s == L"while")
-			return true;
-		else if (s == L"do")
-			return true;
-		else if (s == L"if")
-			return true;
-		else if (s == L"then")
-			return true;
-		else if (s == L"else")
-			return true;
-		else if (s == L"elseif")
-			return true;
-		else if (s == L"end")
-			return true;
-		else if (s == L"var")
-			return true;
-		else if (s == L"const")
-			return true;
-		else if (s == L"call")
-			return true;
-		else if (s == L"sub")
-			return true;
-		else if (s == L"callsub")
-			return true;
-		else if (s == L"onevent")
-			return true;
-		else if (s == L"abs")
-			return true;
-		else if (s == L"return")
-			return true;
-		else if (s == L"or")
-			return true;
-		else if (s == L"and")
-			return true;
-		else if (s == L"not")
-			return true;
-		else
-			return false;
+		return keywordTable.find(s.data(), s.size()) != 0;
 	}
 } // namespace Aseba
@@ -247,6 +247,13 @@ namespace Aseba
 		endVariableIndex = 0;
 	}
 
+	//! Release the temporary memory allocated since mark was taken from endVariableIndex
+	void Compiler::releaseTemporaryMemory(const unsigned mark)
+	{
+		assert(mark <= endVariableIndex);
+		endVariableIndex = mark;
+	}
+
 	unsigned Compiler::allocateTemporaryMemory(const SourcePos varPos, const unsigned size)
 	{
 		// allocate space at the end of the variables' memory
@@ -263,14 +270,12 @@ namespace Aseba
 
 	AssignmentNode* Compiler::allocateTemporaryVariable(const SourcePos varPos, Node* rValue)
 	{
-		static unsigned uid = 0;
-
 		// allocate the temporary variable
 		const unsigned size = rValue->getVectorSize();
 		const unsigned addr = allocateTemporaryMemory(varPos, size);
 
 		// create assignment
-		MemoryVectorNode* lValue = new MemoryVectorNode(varPos, addr, size, WFormatableString(L"temp%0").arg(uid++));
+		MemoryVectorNode* lValue = new MemoryVectorNode(varPos, addr, size, WFormatableString(L"temp%0").arg(temporaryVariableUid++));
 		return new AssignmentNode(varPos, lValue, rValue);
 	}
 	
@@ -278,6 +283,21 @@ namespace Aseba
 	Node* Compiler::parseProgram()
 	{
 		std::auto_ptr<ProgramNode> block(new ProgramNode(tokens.front().pos));
+		parseDeclarations(block.get());
+		// parse the rest of the code
+		while (tokens.front() != Token::TOKEN_END_OF_STREAM)
+		{
+			// only var declaration are allowed to return NULL node, so we assert on node
+			Node *child = parseStatement();
+			assert(child);
+			block->children.push_back(child);
+		}
+		return block.release();
+	}
+	
+	//! Parse all declarations for constants and variables, add variables initialisation code to block
+	void Compiler::parseDeclarations(Node* block)
+	{
 		// parse all declarations for constants
 		while (tokens.front() == Token::TOKEN_STR_const)
 		{
@@ -291,10 +311,21 @@ namespace Aseba
 			if (child)
 				block->children.push_back(child);
 		}
-		// parse the rest of the code
-		while (tokens.front() != Token::TOKEN_END_OF_STREAM)
+	}
+	
+	//! Parse the program up to the next event or subroutine declaration, for incremental compilation.
+	//! If programStart is true, parse declarations and init code, otherwise parse a whole event handler or subroutine.
+	Node* Compiler::parseSegment(bool programStart)
+	{
+		std::auto_ptr<ProgramNode> block(new ProgramNode(tokens.front().pos));
+		if (programStart)
+			parseDeclarations(block.get());
+		else
+			block->children.push_back(parseStatement());
+		while (tokens.front() != Token::TOKEN_END_OF_STREAM &&
+			tokens.front() != Token::TOKEN_STR_onevent &&
+			tokens.front() != Token::TOKEN_STR_sub)
 		{
-			// only var declaration are allowed to return NULL node, so we assert on node
 			Node *child = parseStatement();
 			assert(child);
 			block->children.push_back(child);
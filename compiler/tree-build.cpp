@@ -23,11 +23,105 @@
 #include <iostream>
 
 
+#if defined(_MSC_VER)
+	#define ASEBA_THREAD_LOCAL __declspec(thread)
+#else
+	#define ASEBA_THREAD_LOCAL __thread
+#endif
+
 namespace Aseba
 {
 	/** \addtogroup compiler */
 	/*@{*/
 
+	//! Current arena of this thread, compilations can run in parallel in different threads
+	static ASEBA_THREAD_LOCAL NodeArena* currentNodeArena = 0;
+	
+	//! Size of a normal block of arena
+	static const size_t nodeArenaBlockSize = 32768;
+	//! Alignment of allocations in arena, sufficient for any member of nodes
+	static const size_t nodeArenaAlignment = 2 * sizeof(void*);
+	
+	//! Constructor, make this arena the current one
+	NodeArena::NodeArena() :
+		used(0),
+		previous(currentNodeArena)
+	{
+		currentNodeArena = this;
+	}
+	
+	//! Destructor, release all memory and restore the previous arena
+	NodeArena::~NodeArena()
+	{
+		assert(currentNodeArena == this);
+		currentNodeArena = previous;
+		for (size_t i = 0; i < blocks.size(); ++i)
+			::operator delete(blocks[i].data);
+	}
+	
+	void* NodeArena::allocate(size_t size)
+	{
+		size = (size + nodeArenaAlignment - 1) & ~(nodeArenaAlignment - 1);
+		
+		// large allocations get their own block, put before the one being filled
+		if (size > nodeArenaBlockSize / 4)
+		{
+			Block block = { static_cast<char*>(::operator new(size)), size };
+			if (blocks.empty())
+			{
+				blocks.push_back(block);
+				used = size;
+			}
+			else
+				blocks.insert(blocks.end() - 1, block);
+			return block.data;
+		}
+		
+		// otherwise bump-allocate, starting a new block if needed
+		if (blocks.empty() || used + size > blocks.back().size)
+		{
+			Block block = { static_cast<char*>(::operator new(nodeArenaBlockSize)), nodeArenaBlockSize };
+			blocks.push_back(block);
+			used = 0;
+		}
+		void* p(blocks.back().data + used);
+		used += size;
+		return p;
+	}
+	
+	bool NodeArena::owns(const void* p) const
+	{
+		// the most recent blocks are the most likely to hold p
+		const char* c(static_cast<const char*>(p));
+		for (std::vector<Block>::const_reverse_iterator it(blocks.rbegin()); it != blocks.rend(); ++it)
+			if (c >= it->data && c < it->data + it->size)
+				return true;
+		return false;
+	}
+	
+	NodeArena* NodeArena::current()
+	{
+		return currentNodeArena;
+	}
+	
+	void* allocateNodeMemory(size_t size)
+	{
+		if (currentNodeArena)
+			return currentNodeArena->allocate(size);
+		else
+			return ::operator new(size);
+	}
+	
+	void releaseNodeMemory(void* p)
+	{
+		if (!p)
+			return;
+		for (const NodeArena* arena(currentNodeArena); arena; arena = arena->previous)
+			if (arena->owns(p))
+				return;
+		::operator delete(p);
+	}
+
 	const AsebaBinaryOperator ArithmeticAssignmentNode::operatorMap[] = {
 		ASEBA_OP_ADD,			// TOKEN_OP_ADD_EQUAL
 		ASEBA_OP_SUB,			// TOKEN_OP_NEG_EQUAL
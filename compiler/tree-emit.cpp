@@ -46,6 +46,27 @@ namespace Aseba
 			bytecodes.current->push_back(BytecodeElement(value, sourcePos.row));
 		}
 	}
+	
+	// helper function
+	static bool isCommutative(AsebaBinaryOperator op)
+	{
+		switch (op)
+		{
+			case ASEBA_OP_ADD:
+			case ASEBA_OP_MULT:
+			case ASEBA_OP_BIT_OR:
+			case ASEBA_OP_BIT_XOR:
+			case ASEBA_OP_BIT_AND:
+			case ASEBA_OP_EQUAL:
+			case ASEBA_OP_NOT_EQUAL:
+			case ASEBA_OP_OR:
+			case ASEBA_OP_AND:
+			return true;
+			
+			default:
+			return false;
+		}
+	}
 
 	//! Add init event and point to currentBytecode it
 	PreLinkBytecode::PreLinkBytecode()
@@ -144,6 +165,18 @@ namespace Aseba
 			children[i+0]->emit(bytecodes);
 		}
 	}
+	
+	unsigned AssignmentNode::getStackDepth() const
+	{
+		// the value is on the stack while the store code (i.e. an array index) is evaluated
+		unsigned stackDepth = 0;
+		for (size_t i = 0; i < children.size(); i += 2)
+		{
+			stackDepth = std::max(stackDepth, children[i+1]->getStackDepth());
+			stackDepth = std::max(stackDepth, 1 + children[i+0]->getStackDepth());
+		}
+		return stackDepth;
+	}
 
 	
 	void IfWhenNode::emit(PreLinkBytecode& bytecodes) const
@@ -229,7 +262,8 @@ namespace Aseba
 	
 	unsigned FoldedIfWhenNode::getStackDepth() const
 	{
-		unsigned stackDepth = children[0]->getStackDepth() + children[1]->getStackDepth();
+		// the left value is on the stack while the right expression is evaluated
+		unsigned stackDepth = std::max(children[0]->getStackDepth(), 1 + children[1]->getStackDepth());
 		stackDepth = std::max(stackDepth, children[2]->getStackDepth());
 		if (children.size() == 4)
 			stackDepth = std::max(stackDepth, children[3]->getStackDepth());
@@ -296,7 +330,7 @@ namespace Aseba
 	
 	unsigned FoldedWhileNode::getStackDepth() const
 	{
-		unsigned stackDepth = children[0]->getStackDepth() + children[1]->getStackDepth();
+		unsigned stackDepth = std::max(children[0]->getStackDepth(), 1 + children[1]->getStackDepth());
 		stackDepth = std::max(stackDepth, children[2]->getStackDepth());
 		return stackDepth;
 	}
@@ -347,15 +381,30 @@ namespace Aseba
 	
 	void BinaryArithmeticNode::emit(PreLinkBytecode& bytecodes) const
 	{
-		children[0]->emit(bytecodes);
-		children[1]->emit(bytecodes);
+		// for commutative operators, evaluate the deepest expression first to save stack
+		if (isCommutative(op) && children[1]->getStackDepth() > children[0]->getStackDepth())
+		{
+			children[1]->emit(bytecodes);
+			children[0]->emit(bytecodes);
+		}
+		else
+		{
+			children[0]->emit(bytecodes);
+			children[1]->emit(bytecodes);
+		}
 		unsigned short bytecode = AsebaBytecodeFromId(ASEBA_BYTECODE_BINARY_ARITHMETIC) | op;
 		bytecodes.current->push_back(BytecodeElement(bytecode, sourcePos.row));
 	}
 	
 	unsigned BinaryArithmeticNode::getStackDepth() const
 	{
-		return children[0]->getStackDepth() + children[1]->getStackDepth();
+		const unsigned leftDepth = children[0]->getStackDepth();
+		const unsigned rightDepth = children[1]->getStackDepth();
+		// the first evaluated value is on the stack while the second expression is evaluated
+		if (isCommutative(op) && rightDepth > leftDepth)
+			return std::max(rightDepth, 1 + leftDepth);
+		else
+			return std::max(leftDepth, 1 + rightDepth);
 	}
 	
 	
@@ -487,9 +536,10 @@ namespace Aseba
 	
 	unsigned CallNode::getStackDepth() const
 	{
-		unsigned stackDepth = 0;
+		// arguments are emitted in reverse order, on top of the template parameters
+		unsigned stackDepth = templateArgs.size();
 		for (size_t i = 0; i < children.size(); i++)
-			stackDepth = std::max(stackDepth, unsigned(templateArgs.size()+i)+children[i]->getStackDepth());
+			stackDepth = std::max(stackDepth, unsigned(templateArgs.size()+children.size()-1-i)+children[i]->getStackDepth());
 		
 		return stackDepth;
 	}
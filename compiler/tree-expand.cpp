@@ -184,6 +184,36 @@ namespace Aseba
 		return false;
 	}
 
+	/*
+	 * helper function to know if the references to 'name' in the tree of 'root' can be
+	 * expanded element by element into the vector of size 'size' at address 'addr'
+	 * without reading back an element that was already overwritten
+	 */
+	static bool isAliasingSafe(Node *root, std::wstring name, unsigned addr, unsigned size)
+	{
+		MemoryVectorNode* vector = dynamic_cast<MemoryVectorNode*>(root);
+		if (vector)
+		{
+			// element i reads at vector address + i, which must not be below addr + i
+			if (vector->arrayName == name)
+				return vector->isAddressStatic() && vector->getVectorSize() == size && vector->getVectorAddr() >= addr;
+			// indexes are not expanded element-wise
+			return !matchNameInMemoryVector(root, name);
+		}
+
+		// arithmetic is performed element-wise
+		if (dynamic_cast<BinaryArithmeticNode*>(root) || dynamic_cast<UnaryArithmeticNode*>(root))
+		{
+			for (unsigned int i = 0; i < root->children.size(); i++)
+				if (!isAliasingSafe(root->children[i], name, addr, size))
+					return false;
+			return true;
+		}
+
+		// anything else, for instance tuples, might reorder elements
+		return !matchNameInMemoryVector(root, name);
+	}
+
 	//! This is the root node, take in charge the tree creation / deletion
 	Node* ProgramNode::expandVectorialNodes(std::wostream *dump, Compiler* compiler, unsigned int index)
 	{
@@ -222,12 +252,16 @@ namespace Aseba
 		Node* rightVector = children[1];
 
 		// check if the left vector appears somewhere on the right side
-		if (matchNameInMemoryVector(rightVector, leftVector->arrayName) && leftVector->getVectorSize() > 1)
+		if (leftVector->getVectorSize() > 1 && !isAliasingSafe(rightVector, leftVector->arrayName, leftVector->getVectorAddr(), leftVector->getVectorSize()))
 		{
 			// in such case, there is a risk of involuntary overwriting the content
 			// we need to throw in a temporary variable to avoid this risk
 			std::auto_ptr<BlockNode> tempBlock(new BlockNode(sourcePos));
 
+			// the temporary variable is dead once this assignment is done,
+			// so release its space for the following statements
+			const unsigned tempMark(compiler->endVariableIndex);
+
 			// tempVar = rightVector
 			std::auto_ptr<AssignmentNode> temp(compiler->allocateTemporaryVariable(sourcePos, rightVector->deepCopy()));
 			MemoryVectorNode* tempVar = dynamic_cast<MemoryVectorNode*>(temp->children[0]);
@@ -238,7 +272,9 @@ namespace Aseba
 			temp.reset(new AssignmentNode(sourcePos, leftVector->deepCopy(), tempVar->deepCopy()));
 			tempBlock->children.push_back(temp.release());
 
-			return tempBlock->expandVectorialNodes(dump, compiler); // tempBlock will be reclaimed
+			Node* expandedBlock(tempBlock->expandVectorialNodes(dump, compiler)); // tempBlock will be reclaimed
+			compiler->releaseTemporaryMemory(tempMark);
+			return expandedBlock;
 		}
 		// else
 
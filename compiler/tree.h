@@ -29,6 +29,8 @@
 #include <ostream>
 #include <climits>
 #include <cassert>
+#include <cstddef>
+#include <new>
 
 #include <iostream>
 
@@ -43,6 +45,75 @@ namespace Aseba
 	//! Return the string corresponding to the unary operator
 	std::wstring unaryOperatorToString(AsebaUnaryOperator op);
 	
+	//! Memory arena holding the nodes of the syntax trees of a compilation.
+	//! While an arena is alive, it is the current arena of its thread, and nodes and their
+	//! children vectors are bump-allocated from it. Deleting them only calls their destructors,
+	//! the memory being released in bulk when the arena is destroyed, so they must not outlive it.
+	class NodeArena
+	{
+	public:
+		NodeArena();
+		~NodeArena();
+		
+		//! Return a block of size bytes of memory from the arena
+		void* allocate(size_t size);
+		//! Return whether p was allocated from this arena
+		bool owns(const void* p) const;
+		
+		//! Return the current arena of this thread, or 0 if there is none
+		static NodeArena* current();
+		
+	private:
+		friend void releaseNodeMemory(void* p);
+		
+		// non-copyable
+		NodeArena(const NodeArena&);
+		NodeArena& operator=(const NodeArena&);
+		
+		//! A block of memory
+		struct Block
+		{
+			char* data; //!< start of block
+			size_t size; //!< size of block in bytes
+		};
+		std::vector<Block> blocks; //!< allocated blocks, the last one is the one being filled
+		size_t used; //!< number of bytes used in the last block
+		NodeArena* previous; //!< arena that was current when this one was created
+	};
+	
+	//! Allocate from the current arena if any, from the heap otherwise
+	void* allocateNodeMemory(size_t size);
+	//! Release memory that was allocated by allocateNodeMemory
+	void releaseNodeMemory(void* p);
+	
+	//! Allocator for containers of nodes, using the current arena if any
+	template<typename T>
+	struct NodeAllocator
+	{
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef size_t size_type;
+		typedef ptrdiff_t difference_type;
+		template<typename U> struct rebind { typedef NodeAllocator<U> other; };
+		
+		NodeAllocator() {}
+		template<typename U> NodeAllocator(const NodeAllocator<U>&) {}
+		
+		pointer address(reference x) const { return &x; }
+		const_pointer address(const_reference x) const { return &x; }
+		pointer allocate(size_type n, const void* = 0) { return static_cast<pointer>(allocateNodeMemory(n * sizeof(T))); }
+		void deallocate(pointer p, size_type) { releaseNodeMemory(p); }
+		size_type max_size() const { return size_t(-1) / sizeof(T); }
+		void construct(pointer p, const T& val) { new (static_cast<void*>(p)) T(val); }
+		void destroy(pointer p) { p->~T(); }
+		
+		bool operator==(const NodeAllocator&) const { return true; }
+		bool operator!=(const NodeAllocator&) const { return false; }
+	};
+	
 	//! An abstract node of syntax tree
 	struct Node
 	{
@@ -57,6 +128,10 @@ namespace Aseba
 		//! Constructor
 		Node(const SourcePos& sourcePos) : sourcePos(sourcePos) { }		
 		virtual ~Node();
+		//! Allocate nodes from the current arena if any
+		static void* operator new(size_t size) { return allocateNodeMemory(size); }
+		//! Only release the memory of nodes not allocated from an arena
+		static void operator delete(void* p) { releaseNodeMemory(p); }
 		//! Return a shallow copy of the object (children point to the same objects)
 		virtual Node* shallowCopy() = 0;
 		//! Return a deep copy of the object (children are also copied)
@@ -97,7 +172,7 @@ namespace Aseba
 		virtual unsigned getVectorSize() const;
 
 		//! Vector for children of a node
-		typedef std::vector<Node *> NodesVector;
+		typedef std::vector<Node *, NodeAllocator<Node *> > NodesVector;
 		NodesVector children; //!< children of this node
 		SourcePos sourcePos; //!< position is source
 	};
@@ -142,6 +217,7 @@ namespace Aseba
 		virtual Node* expandVectorialNodes(std::wostream* dump, Compiler* compiler=0, unsigned int index = 0);
 		virtual ReturnType typeCheck() const;
 		virtual Node* optimize(std::wostream* dump);
+		virtual unsigned getStackDepth() const;
 		virtual void emit(PreLinkBytecode& bytecodes) const;
 		virtual std::wstring toWString() const { return L"Assign"; }
 		virtual std::wstring toNodeName() const { return L"assignment"; }
@@ -127,6 +127,9 @@ namespace Aseba
     using namespace std;
     using namespace Dashel;
     
+    //! Maximum age in ms of the values of variables answered from the cache, which are pushed while they are read by the nodes that can watch variables
+    static const unsigned readVariablesPeriod = 50;
+    
     /** \addtogroup http */
     /*@{*/
     
@@ -136,6 +139,7 @@ namespace Aseba
     
     HttpInterface::HttpInterface(const std::string& asebaTarget, const std::string& http_port, const int iterations) :
     Hub(false),  // don't resolve hostnames for incoming connections (there are a lot of them!)
+    WatchesManager(false),
     asebaStream(0),
     httpStream(0),
     nodeId(0),
@@ -168,6 +172,8 @@ namespace Aseba
         {
             sendAvailableResponses();
             step(2);
+            stepWatches();
+            stepUploads();
             if (verbose && streamsToShutdown.size() > 0)
             {
                 cerr << "HttpInterface::run "<< streamsToShutdown.size() <<" streams to shut down";
@@ -266,6 +272,10 @@ namespace Aseba
             // pass message to description manager, which builds
             // the node descriptions in background
             DescriptionsManager::processMessage(message);
+            // and to the watches manager, which caches the values of watched variables
+            WatchesManager::processMessage(message);
+            // and to the uploader, which verifies the bytecode sent to nodes
+            BytecodeUploader::processMessage(message);
             
             // if variables, check for pending requests
             const Variables *variables(dynamic_cast<Variables *>(message));
@@ -315,12 +325,7 @@ namespace Aseba
     void HttpInterface::incomingVariables(const Variables *variables)
     {
         // first, build result string from message
-        std::stringstream result;
-        result << "[";
-        for (size_t i = 0; i < variables->variables.size(); ++i)
-            result << (i ? "," : "") << variables->variables[i];
-        result << "]";
-        string result_str = result.str();
+        string result_str = formatVariables(variables->variables);
         
         VariableAddress address = std::make_pair(variables->source,variables->start);
         ResponseSet *pending = &pendingVariables[address];
@@ -353,6 +358,52 @@ namespace Aseba
         sendAvailableResponses();
     }
     
+    // Utility: format values as a JSON array
+    std::string HttpInterface::formatVariables(const std::vector<sint16>& values) const
+    {
+        std::stringstream result;
+        result << "[";
+        for (size_t i = 0; i < values.size(); ++i)
+            result << (i ? "," : "") << values[i];
+        result << "]";
+        return result.str();
+    }
+    
+    // Requests for capabilities are sent on the Aseba stream, once for the watches and the uploads
+    void HttpInterface::sendDescriptionsMessage(Message& message)
+    {
+        message.serialize(asebaStream);
+        asebaStream->flush();
+    }
+    
+    // Watched variables are sent on the Aseba stream
+    void HttpInterface::sendWatchMessage(Message& message)
+    {
+        message.serialize(asebaStream);
+        asebaStream->flush();
+    }
+    
+    // Bytecode is sent on the Aseba stream, to all nodes at once
+    void HttpInterface::sendUploadMessage(Message& message)
+    {
+        message.serialize(asebaStream);
+        asebaStream->flush();
+    }
+    
+    // Run the program once all of it is on the node, as each chunk resets the node
+    void HttpInterface::uploadFinished(unsigned nodeId, UploadResult result)
+    {
+        if (result == UPLOAD_FAILED)
+        {
+            if (verbose)
+                cerr << "upload to node " << nodeId << " failed" << endl;
+            return;
+        }
+        Run msg(nodeId);
+        msg.serialize(asebaStream);
+        asebaStream->flush();
+    }
+    
     // Incoming User Messages
     void HttpInterface::incomingUserMsg(const UserMessage *userMsg)
     {
@@ -561,6 +612,38 @@ namespace Aseba
                     return;
                 }
                 
+                // if the node pushes the changes of its variables, keep the variable watched while it is read,
+                // and answer with its last values if known; otherwise ask for them once
+                if (isWatchCapable(source))
+                {
+                    bool ok(false);
+                    unsigned length(0);
+                    const NodeNameVariablesMap::const_iterator allVarMapIt(allVariables.find(nodeName));
+                    if (allVarMapIt != allVariables.end())
+                    {
+                        const VariablesMap::const_iterator varIt(allVarMapIt->second.find(UTF8ToWString(values[0])));
+                        if (varIt != allVarMapIt->second.end())
+                        {
+                            length = varIt->second.second;
+                            ok = true;
+                        }
+                    }
+                    if (!ok)
+                        length = getVariableSize(source, UTF8ToWString(values[0]), &ok);
+                    if (ok)
+                    {
+                        watch(source, start, length, readVariablesPeriod);
+                        const VariablesDataVector* cached(getWatchedValues(source, start, length));
+                        if (cached)
+                        {
+                            finishResponse(req, 200, formatVariables(*cached));
+                            if (verbose)
+                                cerr << req << " evVariableOrEevent 200 cached var " << values[0] << endl;
+                            return;
+                        }
+                    }
+                }
+                
                 sendGetVariables(nodeName, values);
                 pendingVariables[std::make_pair(source,start)].insert(req);
                 
@@ -915,6 +998,9 @@ namespace Aseba
             xmlXPathFreeObject(obj); // also frees nodeset
         }
         // 4. Path network/node
+        BatchCompiler::Programs programs;
+        std::vector<unsigned> programNodeIds;
+        strings programNodeNames;
         if ((obj = xmlXPathEvalExpression(BAD_CAST"/network/node", context)))
         {
             xmlNodeSetPtr nodeset = obj->nodesetval;
@@ -931,12 +1017,16 @@ namespace Aseba
                 else
                 {
                     const string _name((const char *)name);
-                    // get the identifier of the node and compile the code
+                    // get the identifier of the node and queue the code for compilation
                     unsigned preferedId = storedId ? unsigned(atoi((char*)storedId)) : 0;
                     bool ok;
                     unsigned nodeId(getNodeId(UTF8ToWString(_name), preferedId, &ok));
                     if (ok)
-                        wasError = !compileAndSendCode(UTF8ToWString((const char *)text), nodeId, _name);
+                    {
+                        programs.push_back(BatchCompiler::Program(UTF8ToWString((const char *)text), getDescription(nodeId), &commonDefinitions));
+                        programNodeIds.push_back(nodeId);
+                        programNodeNames.push_back(_name);
+                    }
                     else
                         noNodeCount++;
                 }
@@ -951,6 +1041,12 @@ namespace Aseba
         // release memory
         xmlXPathFreeContext(context);
         
+        // compile the code of all nodes in parallel, and send it
+        const BatchCompiler::Results results(BatchCompiler().compile(programs));
+        for (size_t i = 0; i < results.size(); ++i)
+            if (!sendCompiledCode(results[i], programNodeIds[i], programNodeNames[i]))
+                wasError = true;
+        
         // check if there was an error
         if (wasError)
         {
@@ -968,34 +1064,19 @@ namespace Aseba
     }
     
     // Upload bytecode to node
-    bool HttpInterface::compileAndSendCode(const wstring& source, unsigned nodeId, const string& nodeName)
+    bool HttpInterface::sendCompiledCode(const BatchCompiler::Result& result, unsigned nodeId, const string& nodeName)
     {
-        // compile code
-        std::wistringstream is(source);
-        Error error;
-        BytecodeVector bytecode;
-        unsigned allocatedVariablesCount;
-        
-        Compiler compiler;
-        compiler.setTargetDescription(getDescription(nodeId));
-        compiler.setCommonDefinitions(&commonDefinitions);
-        bool result = compiler.compile(is, bytecode, allocatedVariablesCount, error);
-        
-        if (result)
+        if (result.success)
         {
-            // send bytecode
-            sendBytecode(asebaStream, nodeId, std::vector<uint16>(bytecode.begin(), bytecode.end()));
-            // run node
-            Run msg(nodeId);
-            msg.serialize(asebaStream);
-            asebaStream->flush();
+            // send bytecode, the node is run once it is uploaded
+            startUpload(nodeId, std::vector<uint16>(result.bytecode.begin(), result.bytecode.end()));
             // retrieve user-defined variables for use in get/set
-            allVariables[nodeName] = *compiler.getVariablesMap();
+            allVariables[nodeName] = result.variablesMap;
             return true;
         }
         else
         {
-            wcerr << "compilation for node " << UTF8ToWString(nodeName) << " failed: " << error.toWString() << endl;
+            wcerr << "compilation for node " << UTF8ToWString(nodeName) << " failed: " << result.error.toWString() << endl;
             return false;
         }
     }
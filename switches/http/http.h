@@ -27,6 +27,8 @@
 #include <dashel/dashel.h>
 #include "../../common/msg/msg.h"
 #include "../../common/msg/descriptions-manager.h"
+#include "../../common/msg/watches-manager.h"
+#include "../../common/msg/bytecode-uploader.h"
 
 #if defined(_WIN32) && defined(__MINGW32__)
 /* This is a workaround for MinGW32, see libxml/xmlexports.h */
@@ -47,7 +49,7 @@ namespace Aseba
     class HttpRequest;
     
     //! HTTP interface for aseba network
-    class HttpInterface:  public Dashel::Hub, public Aseba::DescriptionsManager
+    class HttpInterface:  public Dashel::Hub, public Aseba::DescriptionsManager, public Aseba::WatchesManager, public Aseba::BytecodeUploader
     {
     public: 
         typedef std::vector<std::string>      strings;
@@ -110,6 +112,10 @@ namespace Aseba
         virtual void connectionClosed(Dashel::Stream* stream, bool abnormal);
         virtual void incomingData(Dashel::Stream* stream);
         virtual void nodeDescriptionReceived(unsigned nodeId);
+        virtual void sendDescriptionsMessage(Message& message);
+        virtual void sendWatchMessage(Message& message);
+        virtual void sendUploadMessage(Message& message);
+        virtual void uploadFinished(unsigned nodeId, UploadResult result);
         // specific to http interface
         virtual void sendEvent(const std::string nodeName, const strings& args);
         virtual void sendSetVariable(const std::string nodeName, const strings& args);
@@ -117,12 +123,13 @@ namespace Aseba
         virtual bool getNodeAndVarPos(const std::string& nodeName, const std::string& variableName, unsigned& nodeId, unsigned& pos);
         virtual void aeslLoad(xmlDoc* doc);
         virtual void incomingVariables(const Variables *variables);
+        virtual std::string formatVariables(const std::vector<sint16>& values) const;
         virtual void incomingUserMsg(const UserMessage *userMsg);
         virtual void routeRequest(HttpRequest* req);
         
         // helper functions
         bool getNodeAndVarPos(const std::string& nodeName, const std::string& variableName, unsigned& nodeId, unsigned& pos) const;
-        bool compileAndSendCode(const std::wstring& source, unsigned nodeId, const std::string& nodeName);
+        bool sendCompiledCode(const BatchCompiler::Result& result, unsigned nodeId, const std::string& nodeName);
         virtual void parse_json_form(std::string content, strings& values);
 
     };
@@ -49,6 +49,9 @@ namespace Aseba
 	/** \addtogroup medulla */
 	/*@{*/
 	
+	//! Maximum age in ms of the values returned by GetVariable, which are pushed while they are read by the nodes that can watch variables
+	static const unsigned readVariablesPeriod = 50;
+	
 	std::vector<sint16> toAsebaVector(const Values& values)
 	{
 		std::vector<sint16> data;
@@ -107,6 +110,7 @@ namespace Aseba
 	
 	AsebaNetworkInterface::AsebaNetworkInterface(Hub* hub, bool systemBus) :
 		QDBusAbstractAdaptor(hub),
+		WatchesManager(true),
 		hub(hub),
 		systemBus(systemBus),
 		eventsFiltersCounter(0)
@@ -116,12 +120,16 @@ namespace Aseba
 		//FIXME: here no error handling is done, with system bus these calls can fail	
 		DBusConnectionBus().registerObject("/", hub);
 		DBusConnectionBus().registerService("ch.epfl.mobots.Aseba");
+		
+		// renew and poll the watches of variables
+		startTimer(10);
 	}
 	
 	void AsebaNetworkInterface::processMessage(Message *message, Dashel::Stream* sourceStream)
 	{
-		// send messages to Dashel peers
-		hub->sendMessage(message, sourceStream);
+		// send messages to Dashel peers, unless they are watches of variables handled here
+		if (WatchesManager::processMessage(message))
+			hub->sendMessage(message, sourceStream);
 		
 		// scan this message for nodes descriptions
 		DescriptionsManager::processMessage(message);
@@ -436,6 +444,16 @@ namespace Aseba
 			}
 		}
 		
+		// if the node pushes the changes of its variables, keep the variable watched while it is read,
+		// and answer with its last values if known; otherwise ask for them once
+		if (isWatchCapable(nodeId))
+		{
+			watch(nodeId, pos, length, readVariablesPeriod);
+			const VariablesDataVector* values(getWatchedValues(nodeId, pos, length));
+			if (values)
+				return fromAsebaVector(*values);
+		}
+		
 		// send request to aseba network
 		{
 			GetVariables msg(nodeId, pos, length);
@@ -492,6 +510,21 @@ namespace Aseba
 			return QDBusConnection::sessionBus();
 	}
 	
+	void AsebaNetworkInterface::sendDescriptionsMessage(Message& message)
+	{
+		hub->sendMessage(message);
+	}
+	
+	void AsebaNetworkInterface::sendWatchMessage(Message& message)
+	{
+		hub->sendMessage(message);
+	}
+	
+	void AsebaNetworkInterface::timerEvent(QTimerEvent *event)
+	{
+		stepWatches();
+	}
+	
 	// the following methods run in the main thread (event loop)
 	
 	Hub::Hub(unsigned port, bool verbose, bool dump, bool forward, bool rawTime, bool systemBus) :
@@ -32,6 +32,7 @@
 #include <QList>
 #include "../../common/msg/msg.h"
 #include "../../common/msg/descriptions-manager.h"
+#include "../../common/msg/watches-manager.h"
 
 typedef QList<qint16> Values;
 
@@ -75,8 +76,8 @@ namespace Aseba
 			AsebaNetworkInterface* network;
 	};
 	
-	//! DBus interface for aseba network
-	class AsebaNetworkInterface: public QDBusAbstractAdaptor, public DescriptionsManager
+	//! DBus interface for aseba network, which also merges the watches of variables of Dashel peers
+	class AsebaNetworkInterface: public QDBusAbstractAdaptor, public DescriptionsManager, public WatchesManager
 	{
 		Q_OBJECT
 		Q_CLASSINFO("D-Bus Interface", "ch.epfl.mobots.AsebaNetwork")
@@ -114,6 +115,9 @@ namespace Aseba
 		
 		protected:
 			virtual void nodeDescriptionReceived(unsigned nodeId);
+			virtual void sendDescriptionsMessage(Message& message);
+			virtual void sendWatchMessage(Message& message);
+			virtual void timerEvent(QTimerEvent *event);
 			QDBusConnection DBusConnectionBus() const;
 			
 		protected:
@@ -46,6 +46,7 @@ namespace Aseba
 		#ifdef DASHEL_VERSION_INT
 		Dashel::Hub(verbose || dump),
 		#endif // DASHEL_VERSION_INT
+		WatchesManager(true),
 		verbose(verbose),
 		dump(dump),
 		forward(forward),
@@ -85,13 +86,29 @@ namespace Aseba
 			std::wcout << std::endl;
 		}
 		
+		// ask every node whose description starts for its capabilities, on which watches rely
+		if (dynamic_cast<Description *>(message))
+		{
+			GetCapabilities getCapabilities(message->source);
+			sendWatchMessage(getCapabilities);
+		}
+		
+		// watches of variables are merged, and unchanged answers to our polls dropped
+		if (WatchesManager::processMessage(message))
+			sendMessage(message, stream);
+		
+		delete message;
+	}
+	
+	void Switch::sendMessage(Message* message, Stream* sourceStream)
+	{
 		// write on all connected streams
 		CmdMessage* cmdMessage(dynamic_cast<CmdMessage*>(message));
 		for (StreamsSet::iterator it = dataStreams.begin(); it != dataStreams.end();++it)
 		{
 			Stream* destStream = *it;
 			
-			if ((forward) && (destStream == stream))
+			if ((forward) && (destStream == sourceStream))
 				continue;
 			
 			try
@@ -120,8 +137,16 @@ namespace Aseba
 				std::cerr << "error while writing" << std::endl;
 			}
 		}
-		
-		delete message;
+	}
+	
+	void Switch::sendWatchMessage(Message& message)
+	{
+		if (dump)
+		{
+			message.dump(std::wcout);
+			std::wcout << std::endl;
+		}
+		sendMessage(&message, 0);
 	}
 	
 	void Switch::connectionClosed(Stream *stream, bool abnormal)
@@ -262,13 +287,14 @@ int main(int argc, char *argv[])
 			}
 		}
 		/*
-		Uncomment this and comment aswitch.run() to flood all pears with dummy user messages
+		Uncomment this and comment the loop below to flood all pears with dummy user messages
 		while (1)
 		{
 			aswitch.step(10);
 			aswitch.broadcastDummyUserMessage();
 		}*/
-		aswitch.run();
+		while (aswitch.step(10))
+			aswitch.stepWatches();
 	}
 	catch(Dashel::DashelException e)
 	{
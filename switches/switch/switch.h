@@ -24,6 +24,7 @@
 #include <dashel/dashel.h>
 #include <map>
 #include "../../common/types.h"
+#include "../../common/msg/watches-manager.h"
 
 namespace Aseba
 {
@@ -34,8 +35,10 @@ namespace Aseba
 
 	/*!
 		Route Aseba messages on the TCP part of the network.
+		Watches of variables from clients are merged, one per range of variables,
+		and handled on behalf of the nodes that do not support them.
 	*/
-	class Switch: public Dashel::Hub
+	class Switch: public Dashel::Hub, public WatchesManager
 	{
 		public:
 			/*! Creates the switch, listen to TCP on port.
@@ -62,6 +65,8 @@ namespace Aseba
 			void remapId(Dashel::Stream* stream, const uint16 localId, const uint16 targetId);
 			
 		private:
+			void sendMessage(Message* message, Dashel::Stream* sourceStream);
+			virtual void sendWatchMessage(Message& message);
 			virtual void connectionCreated(Dashel::Stream *stream);
 			virtual void incomingData(Dashel::Stream *stream);
 			virtual void connectionClosed(Dashel::Stream *stream, bool abnormal);
@@ -222,6 +222,7 @@ namespace Enki
 				abort();
 			}
 			
+			AsebaVMSetRandomSeed(&vm, id);
 			AsebaVMInit(&vm);
 			
 			variables.productId = ASEBA_PID_CHALLENGE;
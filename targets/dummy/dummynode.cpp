@@ -24,8 +24,11 @@
 
 #include "../../vm/vm.h"
 #include "../../vm/natives.h"
+#include "../../vm/natives-dsp.h"
+#include "../../vm/natives-sort.h"
 #include "../../common/productids.h"
 #include "../../common/consts.h"
+#include "../../common/utils/utils.h"
 #include "../../transport/buffer/vm-buffer.h"
 #include <dashel/dashel.h>
 #include <iostream>
@@ -50,6 +53,12 @@ private:
 		sint16 productId;
 		sint16 user[1024];
 	} variables;
+	// copy of variables to only send what changed to clients
+	Variables variablesSnapshot;
+	AsebaVariablesSnapshot snapshot;
+	// ranges of variables sent to clients when they change
+	AsebaVariablesWatch watches[8];
+	Aseba::UnifiedTime lastWatchesStep;
 	char mutableName[12];
 	
 public:
@@ -78,6 +87,11 @@ public:
 		
 		vm.variables = reinterpret_cast<sint16 *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(sint16);
+		
+		snapshot.variables = reinterpret_cast<sint16 *>(&variablesSnapshot);
+		AsebaEnableVariablesDelta(&snapshot, 1);
+		AsebaEnableVariablesWatches(watches, 8);
+		AsebaEnableBytecodeChecksum();
 	}
 	
 	void listen(int basePort, int deltaPort)
@@ -102,6 +116,7 @@ public:
 		}
 		
 		// init VM
+		AsebaVMSetRandomSeed(&vm, vm.nodeId);
 		AsebaVMInit(&vm);
 	}
 	
@@ -151,6 +166,21 @@ public:
 		AsebaProcessIncomingEvents(&vm);
 	}
 	
+	void flushStream()
+	{
+		if (stream)
+		{
+			try
+			{
+				stream->flush();
+			}
+			catch (Dashel::DashelException e)
+			{
+				std::cerr << "Cannot write to socket: " << stream->getFailReason() << std::endl;
+			}
+		}
+	}
+	
 	virtual void applicationStep()
 	{
 		// run VM
@@ -159,6 +189,12 @@ public:
 		// reschedule a periodic event if we are not in step by step
 		if (AsebaMaskIsClear(vm.flags, ASEBA_VM_STEP_BY_STEP_MASK) || AsebaMaskIsClear(vm.flags, ASEBA_VM_EVENT_ACTIVE_MASK))
 			AsebaVMSetupEvent(&vm, ASEBA_EVENT_LOCAL_EVENTS_START-0);
+		
+		// send the watched variables that changed
+		const Aseba::UnifiedTime now;
+		const Aseba::UnifiedTime::Value elapsed((now - lastWatchesStep).value);
+		AsebaVariablesWatchesStep(&vm, elapsed < 0xffff ? uint16(elapsed) : 0xffff);
+		lastWatchesStep = now;
 	}
 } node;
 
@@ -169,20 +205,25 @@ extern "C" void AsebaPutVmToSleep(AsebaVMState *vm)
 	std::cerr << "Received request to go into sleep" << std::endl;
 }
 
-extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 length)
+extern "C" void AsebaSendBufferGather(AsebaVMState *vm, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength)
 {
 	Dashel::Stream* stream = node.stream;
 	if (stream)
 	{
 		try
 		{
-			uint16 temp;
-			temp = bswap16(length - 2);
-			stream->write(&temp, 2);
-			temp = bswap16(vm->nodeId);
-			stream->write(&temp, 2);
-			stream->write(data, length);
-			stream->flush();
+			// length and source, then the message header, in a single write
+			uint8 outerHeader[8];
+			const uint16 length = bswap16(headerLength + payloadLength - 2);
+			const uint16 source = bswap16(vm->nodeId);
+			assert(headerLength <= 4);
+			memcpy(outerHeader, &length, 2);
+			memcpy(outerHeader + 2, &source, 2);
+			memcpy(outerHeader + 4, header, headerLength);
+			stream->write(outerHeader, 4 + headerLength);
+			// payload straight from the VM, the stream is flushed once per step in main()
+			if (payloadLength)
+				stream->write(payload, payloadLength);
 		}
 		catch (Dashel::DashelException e)
 		{
@@ -191,6 +232,11 @@ extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 leng
 	}
 }
 
+extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 length)
+{
+	AsebaSendBufferGather(vm, data, 0, data, length);
+}
+
 extern "C" uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* source)
 {
 	if (node.lastMessageData.size())
@@ -211,11 +257,15 @@ extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
 static AsebaNativeFunctionPointer nativeFunctions[] =
 {
 	ASEBA_NATIVES_STD_FUNCTIONS,
+	ASEBA_NATIVES_DSP_FUNCTIONS,
+	ASEBA_NATIVES_SORT_FUNCTIONS
 };
 
 static const AsebaNativeFunctionDescription* nativeFunctionsDescriptions[] =
 {
 	ASEBA_NATIVES_STD_DESCRIPTIONS,
+	ASEBA_NATIVES_DSP_DESCRIPTIONS,
+	ASEBA_NATIVES_SORT_DESCRIPTIONS,
 	0
 };
 
@@ -299,5 +349,8 @@ int main(int argc, char* argv[])
 		
 		// run VM
 		node.applicationStep();
+		
+		// send the messages of this step
+		node.flushStream();
 	}
 }
@@ -259,7 +259,9 @@ namespace Enki
 		}
 		marxbotNumber++;
 		
-		// init VM
+		// init VM, each module of each robot having its own random sequence
+		for (size_t i = 0; i < modules.size(); ++i)
+			AsebaVMSetRandomSeed(&modules[i]->vm, port * modules.size() + i);
 		AsebaVMInit(&leftMotor.vm);
 		AsebaVMInit(&rightMotor.vm);
 		AsebaVMInit(&proximitySensors.vm);
@@ -29,6 +29,7 @@
 #include <typeinfo>
 #include <algorithm>
 #include <cassert>
+#include <cstring>
 #include "AsebaGlue.h"
 #include "PlaygroundViewer.h"
 #include "../../transport/buffer/vm-buffer.h"
@@ -40,6 +41,18 @@ namespace Aseba
 {
 	// Mapping so that Aseba C callbacks can dispatch to the right objects
 	VMStateToEnvironment vmStateToEnvironment;
+	
+	// AbstractNodeConnection
+	
+	void AbstractNodeConnection::sendBufferGather(uint16 nodeId, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength)
+	{
+		std::vector<uint8> buffer(headerLength + payloadLength);
+		if (headerLength)
+			memcpy(&buffer[0], header, headerLength);
+		if (payloadLength)
+			memcpy(&buffer[headerLength], payload, payloadLength);
+		sendBuffer(nodeId, &buffer[0], buffer.size());
+	}
 
 	// SimpleDashelConnection
 
@@ -58,19 +71,29 @@ namespace Aseba
 	}
 
 	void SimpleDashelConnection::sendBuffer(uint16 nodeId, const uint8* data, uint16 length)
+	{
+		sendBufferGather(nodeId, data, 0, data, length);
+	}
+	
+	void SimpleDashelConnection::sendBufferGather(uint16 nodeId, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength)
 	{
 		if (stream)
 		{
 			try
 			{
-				uint16 temp;
+				// length, source and message header in a single write, then the payload without copy
+				uint8 outerHeader[8];
+				const uint16 length(bswap16(headerLength + payloadLength - 2));
+				const uint16 source(bswap16(nodeId));
+				assert(headerLength <= 4);
+				memcpy(outerHeader, &length, 2);
+				memcpy(outerHeader + 2, &source, 2);
+				memcpy(outerHeader + 4, header, headerLength);
 				
 				// this may happen if target has disconnected
-				temp = bswap16(length - 2);
-				stream->write(&temp, 2);
-				temp = bswap16(nodeId);
-				stream->write(&temp, 2);
-				stream->write(data, length);
+				stream->write(outerHeader, 4 + headerLength);
+				if (payloadLength)
+					stream->write(payload, payloadLength);
 				stream->flush();
 			}
 			catch (Dashel::DashelException e)
@@ -179,6 +202,14 @@ extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 leng
 	connection->sendBuffer(vm->nodeId, data, length);
 }
 
+extern "C" void AsebaSendBufferGather(AsebaVMState *vm, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength)
+{
+	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.value(vm));
+	Aseba::AbstractNodeConnection* connection(environment.second);
+	assert(connection);
+	connection->sendBufferGather(vm->nodeId, header, headerLength, payload, payloadLength);
+}
+
 extern "C" uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* source)
 {
 	const Aseba::NodeEnvironment& environment(Aseba::vmStateToEnvironment.value(vm));
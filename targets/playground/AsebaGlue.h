@@ -24,6 +24,8 @@
 #include "../../common/types.h"
 #include "../../common/consts.h"
 #include "../../vm/natives.h"
+#include "../../vm/natives-dsp.h"
+#include "../../vm/natives-sort.h"
 #include <dashel/dashel.h>
 #include <valarray>
 #include <vector>
@@ -45,6 +47,8 @@ namespace Aseba
 	struct AbstractNodeConnection
 	{
 		virtual void sendBuffer(uint16 nodeId, const uint8* data, uint16 length) = 0;
+		// send a message made of a header and a payload, by default concatenated and passed to sendBuffer
+		virtual void sendBufferGather(uint16 nodeId, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength);
 		virtual uint16 getBuffer(uint8* data, uint16 maxLength, uint16* source) = 0;
 	};
 
@@ -68,6 +72,7 @@ namespace Aseba
 		SimpleDashelConnection(unsigned port);
 		
 		virtual void sendBuffer(uint16 nodeId, const uint8* data, uint16 length);
+		virtual void sendBufferGather(uint16 nodeId, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength);
 		virtual uint16 getBuffer(uint8* data, uint16 maxLength, uint16* source);
 		
 		virtual void connectionCreated(Dashel::Stream *stream);
@@ -190,6 +190,7 @@ namespace Enki
 		vm.variables = reinterpret_cast<sint16 *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(sint16);
 		
+		AsebaVMSetRandomSeed(&vm, id);
 		AsebaVMInit(&vm);
 		
 		variables.id = id;
@@ -293,6 +294,8 @@ namespace Enki
 		&PlaygroundEPuckNativeDescription_energysend,
 		&PlaygroundEPuckNativeDescription_energyreceive,
 		&PlaygroundEPuckNativeDescription_energyamount,
+		ASEBA_NATIVES_DSP_DESCRIPTIONS,
+		ASEBA_NATIVES_SORT_DESCRIPTIONS,
 		0
 	};
 
@@ -308,7 +311,9 @@ namespace Enki
 		ASEBA_NATIVES_STD_FUNCTIONS,
 		PlaygroundEPuckNative_energysend,
 		PlaygroundEPuckNative_energyreceive,
-		PlaygroundEPuckNative_energyamount
+		PlaygroundEPuckNative_energyamount,
+		ASEBA_NATIVES_DSP_FUNCTIONS,
+		ASEBA_NATIVES_SORT_FUNCTIONS
 	};
 	
 	void AsebaFeedableEPuck::callNativeFunction(uint16 id)
@@ -56,6 +56,8 @@ namespace Enki
 		vm.variables = reinterpret_cast<sint16 *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(sint16);
 		
+		// all simulated Thymios have the same node id, but listen on different ports
+		AsebaVMSetRandomSeed(&vm, port);
 		AsebaVMInit(&vm);
 		
 		variables.id = vm.nodeId;
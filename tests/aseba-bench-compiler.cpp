@@ -0,0 +1,159 @@
+// Aseba
+#include "../compiler/compiler.h"
+#include "../vm/natives.h"
+#include "../vm/natives-dsp.h"
+#include "../vm/natives-sort.h"
+#include "../common/consts.h"
+#include "../common/utils/utils.h"
+using namespace Aseba;
+
+// C++
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <new>
+
+// C
+#include <stdlib.h>		// exit(), malloc(), free()
+
+// count the heap allocations of the whole program
+static unsigned long long allocationsCount = 0;
+
+#if __cplusplus < 201103L
+void* operator new(size_t size) throw(std::bad_alloc)
+#else
+void* operator new(size_t size)
+#endif
+{
+	++allocationsCount;
+	void* p(malloc(size ? size : 1));
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+#if __cplusplus < 201103L
+void operator delete(void* p) throw()
+#else
+void operator delete(void* p) noexcept
+#endif
+{
+	free(p);
+}
+
+#if __cplusplus >= 201103L
+// C++14 calls the sized version when the size is known, it must free as the unsized one
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+#endif
+
+static const AsebaNativeFunctionDescription* nativeFunctionsDescriptions[] =
+{
+	ASEBA_NATIVES_STD_DESCRIPTIONS,
+	ASEBA_NATIVES_DSP_DESCRIPTIONS,
+	ASEBA_NATIVES_SORT_DESCRIPTIONS,
+	0
+};
+
+// same target as asebatest
+static TargetDescription createTargetDescription()
+{
+	TargetDescription d;
+	d.name = L"testvm";
+	d.protocolVersion = ASEBA_PROTOCOL_VERSION;
+	d.bytecodeSize = 512;
+	d.variablesSize = 256;
+	d.stackSize = 64;
+
+	for (const AsebaNativeFunctionDescription* const* nativeDescs(nativeFunctionsDescriptions); *nativeDescs; ++nativeDescs)
+	{
+		const AsebaNativeFunctionDescription* nativeDesc(*nativeDescs);
+		TargetDescription::NativeFunction native(UTF8ToWString(nativeDesc->name), UTF8ToWString(nativeDesc->doc));
+		for (const AsebaNativeFunctionArgumentDescription* params(nativeDesc->arguments); params->size; ++params)
+			native.parameters.push_back(TargetDescription::NativeFunctionParameter(UTF8ToWString(params->name), params->size));
+		d.nativeFunctions.push_back(native);
+	}
+	return d;
+}
+
+static std::wstring readSource(const char* filename)
+{
+	std::ifstream ifs(filename);
+	if (!ifs.good())
+	{
+		std::cerr << "Error, cannot read " << filename << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::ostringstream content;
+	content << ifs.rdbuf();
+	return UTF8ToWString(content.str());
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [-n ITERATIONS] FILE..." << std::endl;
+	std::cerr << "Compile each file ITERATIONS times (default: 100) and report the time and heap allocations used" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned iterations(100);
+	std::vector<std::wstring> sources;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		if (arg == "-n" && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (arg == "-h" || arg == "--help")
+		{
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		}
+		else
+			sources.push_back(readSource(argv[i]));
+	}
+	if (sources.empty() || iterations == 0)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	const TargetDescription targetDescription(createTargetDescription());
+	CommonDefinitions definitions;
+	definitions.events.push_back(NamedValue(L"event1", 0));
+	definitions.events.push_back(NamedValue(L"event2", 3));
+	definitions.constants.push_back(NamedValue(L"FOO", 2));
+
+	Compiler compiler;
+	compiler.setTargetDescription(&targetDescription);
+	compiler.setCommonDefinitions(&definitions);
+
+	unsigned failedCount(0);
+	const unsigned long long startAllocationsCount(allocationsCount);
+	const UnifiedTime startTime;
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		for (size_t j = 0; j < sources.size(); ++j)
+		{
+			BytecodeVector bytecode;
+			unsigned allocatedVariablesCount;
+			Error error;
+			if (!compiler.compile(sources[j], bytecode, allocatedVariablesCount, error))
+				++failedCount;
+		}
+	}
+	const UnifiedTime duration(UnifiedTime() - startTime);
+	const unsigned long long compilationsCount(iterations * sources.size());
+
+	std::cout << "Compiled " << sources.size() << " files " << iterations << " times";
+	std::cout << " (" << failedCount / iterations << " files with errors)" << std::endl;
+	std::cout << "Total time: " << duration.value << " ms" << std::endl;
+	std::cout << "Time per compilation: " << double(duration.value) * 1000. / compilationsCount << " us" << std::endl;
+	std::cout << "Heap allocations per compilation: " << (allocationsCount - startAllocationsCount) / compilationsCount << std::endl;
+
+	return EXIT_SUCCESS;
+}
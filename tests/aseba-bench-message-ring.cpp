@@ -0,0 +1,175 @@
+// Aseba
+#include "../common/msg/msg.h"
+#include "../common/utils/utils.h"
+#include "../common/utils/SingleProducerRing.h"
+using namespace Aseba;
+
+// C++
+#include <iostream>
+#include <deque>
+
+// C
+#include <stdlib.h>
+#include <pthread.h>
+
+// Flood of user messages from a network thread to a GUI thread, as in Studio:
+// a queue under a mutex with one wakeup per message, as a queued signal per message does,
+// against a single-producer ring with one wakeup per batch
+
+static const unsigned messagesCount(1000000);
+static const unsigned maxMessagesPerBatch(1024);
+
+//! Wakeup of the consumer, standing for the event loop of the GUI thread
+struct Wakeup
+{
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	unsigned pending;
+
+	Wakeup() : pending(0)
+	{
+		pthread_mutex_init(&mutex, 0);
+		pthread_cond_init(&cond, 0);
+	}
+	~Wakeup()
+	{
+		pthread_cond_destroy(&cond);
+		pthread_mutex_destroy(&mutex);
+	}
+	void post()
+	{
+		pthread_mutex_lock(&mutex);
+		++pending;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&mutex);
+	}
+	void wait()
+	{
+		pthread_mutex_lock(&mutex);
+		while (pending == 0)
+			pthread_cond_wait(&cond, &mutex);
+		--pending;
+		pthread_mutex_unlock(&mutex);
+	}
+};
+
+static UserMessage* makeMessage(unsigned i)
+{
+	UserMessage* message(new UserMessage(i % 8));
+	message->data.resize(4, sint16(i));
+	return message;
+}
+
+// mutex and queue, one wakeup per message
+
+struct LockedQueue
+{
+	pthread_mutex_t mutex;
+	std::deque<Message*> messages;
+	Wakeup wakeup;
+
+	LockedQueue() { pthread_mutex_init(&mutex, 0); }
+	~LockedQueue() { pthread_mutex_destroy(&mutex); }
+};
+
+static void* lockedProducer(void* data)
+{
+	LockedQueue& queue(*reinterpret_cast<LockedQueue*>(data));
+	for (unsigned i = 0; i < messagesCount; ++i)
+	{
+		Message* message(makeMessage(i));
+		pthread_mutex_lock(&queue.mutex);
+		queue.messages.push_back(message);
+		pthread_mutex_unlock(&queue.mutex);
+		queue.wakeup.post();
+	}
+	return 0;
+}
+
+static unsigned lockedConsumer(LockedQueue& queue)
+{
+	unsigned received(0), wakeups(0);
+	while (received < messagesCount)
+	{
+		queue.wakeup.wait();
+		++wakeups;
+		pthread_mutex_lock(&queue.mutex);
+		Message* message(queue.messages.front());
+		queue.messages.pop_front();
+		pthread_mutex_unlock(&queue.mutex);
+		delete message;
+		++received;
+	}
+	return wakeups;
+}
+
+// ring, one wakeup per batch
+
+struct Ring
+{
+	SingleProducerRing<Message*> messages;
+	Wakeup wakeup;
+	volatile unsigned signaled;
+
+	Ring() : messages(16384), signaled(0) {}
+};
+
+static void* ringProducer(void* data)
+{
+	Ring& ring(*reinterpret_cast<Ring*>(data));
+	for (unsigned i = 0; i < messagesCount; ++i)
+	{
+		Message* message(makeMessage(i));
+		while (!ring.messages.push(message))
+			sched_yield();
+		if (__sync_bool_compare_and_swap(&ring.signaled, 0, 1))
+			ring.wakeup.post();
+	}
+	return 0;
+}
+
+static unsigned ringConsumer(Ring& ring)
+{
+	unsigned received(0), wakeups(0);
+	while (received < messagesCount)
+	{
+		ring.wakeup.wait();
+		++wakeups;
+		// as DashelTarget::messagesFromDashel() does
+		__sync_lock_test_and_set(&ring.signaled, 0);
+		Message* message;
+		bool more(true);
+		while (more)
+		{
+			unsigned i(0);
+			for (; i < maxMessagesPerBatch && ring.messages.pop(message); ++i)
+			{
+				delete message;
+				++received;
+			}
+			more = (i == maxMessagesPerBatch);
+		}
+	}
+	return wakeups;
+}
+
+template<typename Queue>
+static void bench(const char* name, void* (*producer)(void*), unsigned (*consumer)(Queue&))
+{
+	Queue queue;
+	const UnifiedTime startTime;
+	pthread_t thread;
+	pthread_create(&thread, 0, producer, &queue);
+	const unsigned wakeups(consumer(queue));
+	pthread_join(thread, 0);
+	const UnifiedTime duration(UnifiedTime() - startTime);
+	std::cout << name << ": " << double(messagesCount) / (double(duration.value) / 1000.) / 1e6 << " million messages per second, ";
+	std::cout << wakeups << " wakeups for " << messagesCount << " messages" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	bench<LockedQueue>("mutex and queue", lockedProducer, lockedConsumer);
+	bench<Ring>("single-producer ring", ringProducer, ringConsumer);
+	return 0;
+}
@@ -0,0 +1,196 @@
+// Aseba
+#include "../vm/vm.h"
+#include "../vm/natives.h"
+#include "../vm/natives-simd.h"
+#include "../common/utils/utils.h"
+using namespace Aseba;
+
+// C++
+#include <string>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+// C
+#include <stdlib.h>		// exit(), rand()
+
+struct BenchedNative
+{
+	const char* name;
+	AsebaNativeFunctionPointer function;
+	unsigned argumentsCount; //!< number of addresses popped before the length
+};
+
+static const BenchedNative benchedNatives[] =
+{
+	{ "math.copy", AsebaNative_veccopy, 2 },
+	{ "math.fill", AsebaNative_vecfill, 2 },
+	{ "math.addscalar", AsebaNative_vecaddscalar, 3 },
+	{ "math.add", AsebaNative_vecadd, 3 },
+	{ "math.sub", AsebaNative_vecsub, 3 },
+	{ "math.mul", AsebaNative_vecmul, 3 },
+	{ "math.div", AsebaNative_vecdiv, 3 },
+	{ "math.min", AsebaNative_vecmin, 3 },
+	{ "math.max", AsebaNative_vecmax, 3 },
+	{ "math.clamp", AsebaNative_vecclamp, 4 },
+	{ "math.dot", AsebaNative_vecdot, 4 },
+	{ "math.stat", AsebaNative_vecstat, 4 },
+};
+
+// sorting functions of natives.c, not part of its interface
+extern "C" void aseba_heap_sort(sint16* input, uint16 size);
+extern "C" void aseba_intro_sort(sint16* input, uint16 size);
+
+// comb sort that math.sort used before, for comparison
+static void combSort(sint16* input, uint16 size)
+{
+	uint16 gap = size;
+	uint16 swapped = 0;
+	uint16 i;
+
+	while ((gap > 1) || swapped)
+	{
+		if (gap > 1)
+			gap = (uint16)(((uint32)gap * 4) / 5);
+
+		swapped = 0;
+
+		for (i = 0; gap + i < size; i++)
+		{
+			if (input[i] - input[i + gap] > 0)
+			{
+				sint16 swap = input[i];
+				input[i] = input[i + gap];
+				input[i + gap] = swap;
+				swapped = 1;
+			}
+		}
+	}
+}
+
+typedef void (*SortFunction)(sint16* input, uint16 size);
+
+// time sorting random vectors of length elements, return the time per sort in microseconds
+static double benchSort(SortFunction sort, unsigned iterations, uint16 length)
+{
+	std::vector<sint16> values(length);
+	std::vector<sint16> work(length);
+	for (size_t i = 0; i < values.size(); ++i)
+		values[i] = sint16((rand() % 65536) - 32768);
+
+	const UnifiedTime startTime;
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		work = values;
+		sort(&work[0], length);
+	}
+	const UnifiedTime duration(UnifiedTime() - startTime);
+	return double(duration.value) * 1000. / iterations;
+}
+
+static void usage(const char* name)
+{
+	std::cerr << "Usage: " << name << " [-n ITERATIONS] [-l LENGTH]" << std::endl;
+	std::cerr << "Call each vector native ITERATIONS times (default: 100000) on vectors of LENGTH elements (default: 256)" << std::endl;
+	std::cerr << "with every SIMD level the CPU supports, and report the throughput" << std::endl;
+	std::cerr << "Then compare the sorts of math.sort with the previous comb sort on 16 to 1024 random elements" << std::endl;
+}
+
+// time native on disjoint vectors of length elements, return the throughput in million elements per second
+static double benchNative(const BenchedNative& native, unsigned iterations, uint16 length)
+{
+	std::vector<sint16> variables(5 * length + 1);
+	for (size_t i = 0; i < variables.size(); ++i)
+		variables[i] = sint16((rand() % 200) + 1);
+	// the last variable is the scalar argument
+	const uint16 scalar(5 * length);
+	variables[scalar] = 4;
+
+	sint16 stack[8];
+	AsebaVMState vm;
+	memset(&vm, 0, sizeof(vm));
+	vm.variables = &variables[0];
+	vm.variablesSize = variables.size();
+	vm.stack = stack;
+	vm.stackSize = sizeof(stack) / sizeof(stack[0]);
+
+	const UnifiedTime startTime;
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		// the scalar argument is the second one of fill, the third one of addscalar and the fourth one of dot
+		stack[0] = length;
+		for (unsigned a = 0; a < native.argumentsCount; ++a)
+			stack[native.argumentsCount - a] = a * length;
+		if (native.function == AsebaNative_vecfill)
+			stack[native.argumentsCount - 1] = scalar;
+		else if (native.function == AsebaNative_vecaddscalar || native.function == AsebaNative_vecdot)
+			stack[1] = scalar;
+		vm.sp = native.argumentsCount;
+		native.function(&vm);
+	}
+	const UnifiedTime duration(UnifiedTime() - startTime);
+	if (duration.value == 0)
+		return 0;
+	return double(iterations) * length / (double(duration.value) * 1000.);
+}
+
+int main(int argc, char** argv)
+{
+	unsigned iterations(100000);
+	unsigned length(256);
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg(argv[i]);
+		if (arg == "-n" && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (arg == "-l" && i + 1 < argc)
+			length = atoi(argv[++i]);
+		else
+		{
+			usage(argv[0]);
+			return arg == "-h" || arg == "--help" ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+	if (iterations == 0 || length == 0 || length > 10000)
+	{
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	#ifdef ASEBA_NATIVES_SIMD
+	const char* levelNames[] = { "none", "SSE2", "AVX2", "NEON" };
+	const int lastLevel(ASEBA_SIMD_NEON);
+	#else // ASEBA_NATIVES_SIMD
+	const char* levelNames[] = { "none" };
+	const int lastLevel(0);
+	#endif // ASEBA_NATIVES_SIMD
+
+	std::cout << "Throughput in million elements per second, vectors of " << length << " elements" << std::endl;
+	for (size_t n = 0; n < sizeof(benchedNatives) / sizeof(benchedNatives[0]); ++n)
+	{
+		std::cout << benchedNatives[n].name;
+		for (int level = 0; level <= lastLevel; ++level)
+		{
+			#ifdef ASEBA_NATIVES_SIMD
+			if (!AsebaSimdSetLevel(AsebaSimdLevel(level)))
+				continue;
+			#endif // ASEBA_NATIVES_SIMD
+			std::cout << "\t" << levelNames[level] << ": " << benchNative(benchedNatives[n], iterations, length);
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl << "Time per sort in microseconds of random vectors, math.sort using intro sort on hosts and heap sort on dsPIC" << std::endl;
+	for (unsigned size = 16; size <= 1024; size *= 4)
+	{
+		const unsigned sortIterations(std::max(1u, iterations * 16 / size));
+		std::cout << size << " elements";
+		std::cout << "\tcomb: " << benchSort(combSort, sortIterations, size);
+		std::cout << "\tintro: " << benchSort(aseba_intro_sort, sortIterations, size);
+		std::cout << "\theap: " << benchSort(aseba_heap_sort, sortIterations, size);
+		std::cout << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,266 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Aseba
+#include "../common/consts.h"
+#include "../common/msg/msg.h"
+#include "../common/msg/bytecode-uploader.h"
+#include "../common/msg/descriptions-manager.h"
+#include "vm-buffer-test-glue.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// Check that BytecodeUploader uploads to several nodes at once, keeps its window,
+// verifies the chunks using vm-buffer checksums and only sends again those that are wrong
+
+using namespace Aseba;
+
+static const unsigned nodesCount(2);
+static const uint16 bytecodeSize(1024);
+static const uint16 variablesSize(16);
+
+static AsebaVMState vms[nodesCount];
+static uint16 bytecodes[nodesCount][bytecodeSize];
+static sint16 stacks[nodesCount][32];
+static sint16 variables[nodesCount][variablesSize];
+
+static MemoryStream toNodes[nodesCount];
+static MemoryStream fromNodes;
+
+// glue
+
+static MemoryStream& streamToNode(AsebaVMState *vm) { return toNodes[vm - vms]; }
+static MemoryStream& streamFromNode(AsebaVMState *vm) { return fromNodes; }
+
+// uploader
+
+//! Uploader on a bus shared by all nodes, that can lose chunks, and learns the capabilities of nodes as clients do
+class TestUploader: public DescriptionsManager, public BytecodeUploader
+{
+public:
+	std::vector<std::vector<uint16> > chunksStarts; //!< for each node, the start of every chunk sent
+	std::vector<unsigned> maxInFlight; //!< for each node, the maximum number of checksums requested and not answered
+	std::vector<unsigned> inFlight; //!< for each node, the number of checksums requested and not answered
+	std::vector<int> results; //!< for each node, the result of its upload, -1 if not finished
+	std::vector<unsigned> progress; //!< for each node, the last number of words reported
+	int lostNode; //!< node whose chunk starting at lostStart is lost, -1 if none
+	uint16 lostStart;
+	unsigned lostCount; //!< number of times this chunk is lost
+
+	TestUploader(unsigned window) :
+		BytecodeUploader(window, 3),
+		chunksStarts(nodesCount),
+		maxInFlight(nodesCount, 0),
+		inFlight(nodesCount, 0),
+		results(nodesCount, -1),
+		progress(nodesCount, 0),
+		lostNode(-1),
+		lostStart(0),
+		lostCount(0)
+	{}
+
+	//! Deliver the messages until the network is idle
+	void deliver()
+	{
+		bool idle(false);
+		while (!idle)
+		{
+			idle = true;
+			for (unsigned i = 0; i < nodesCount; ++i)
+			{
+				while (!toNodes[i].data.empty())
+				{
+					AsebaProcessIncomingEvents(&vms[i]);
+					idle = false;
+				}
+			}
+			while (!fromNodes.data.empty())
+			{
+				std::auto_ptr<Message> message(Message::receive(&fromNodes));
+				const BytecodeChecksum* checksum(dynamic_cast<BytecodeChecksum*>(message.get()));
+				if (checksum)
+					--inFlight[checksum->source - 1];
+				DescriptionsManager::processMessage(message.get());
+				BytecodeUploader::processMessage(message.get());
+				idle = false;
+			}
+		}
+	}
+
+protected:
+	virtual void sendDescriptionsMessage(Message& message)
+	{
+		sendUploadMessage(message);
+	}
+	virtual void sendUploadMessage(Message& message)
+	{
+		const CmdMessage& cmdMessage(dynamic_cast<CmdMessage&>(message));
+		const unsigned node(cmdMessage.dest - 1);
+		const SetBytecode* setBytecode(dynamic_cast<SetBytecode*>(&message));
+		if (setBytecode)
+		{
+			chunksStarts[node].push_back(setBytecode->start);
+			if (int(node) == lostNode && setBytecode->start == lostStart && lostCount)
+			{
+				--lostCount;
+				return;
+			}
+		}
+		else if (dynamic_cast<GetBytecodeChecksum*>(&message))
+			maxInFlight[node] = std::max(maxInFlight[node], ++inFlight[node]);
+		for (unsigned i = 0; i < nodesCount; ++i)
+			message.serialize(&toNodes[i]);
+	}
+	virtual void uploadProgress(unsigned nodeId, unsigned words, unsigned total)
+	{
+		check(words > progress[nodeId - 1] && words <= total, "progress increases up to total");
+		progress[nodeId - 1] = words;
+	}
+	virtual void uploadFinished(unsigned nodeId, UploadResult result)
+	{
+		results[nodeId - 1] = result;
+	}
+};
+
+//! Return a program of length words, different for each seed
+static std::vector<uint16> makeBytecode(unsigned length, unsigned seed)
+{
+	std::vector<uint16> bytecode(length);
+	// an empty event table, so that the node can reset
+	bytecode[0] = 1;
+	for (unsigned i = 1; i < length; ++i)
+		bytecode[i] = uint16(i * 7919 + seed * 104729);
+	return bytecode;
+}
+
+//! Return whether node holds bytecode
+static bool holds(unsigned node, const std::vector<uint16>& bytecode)
+{
+	return std::equal(bytecode.begin(), bytecode.end(), bytecodes[node]);
+}
+
+//! Have the nodes send their description to uploader, whose descriptions manager asks for their capabilities
+static void describeNodes(TestUploader& uploader)
+{
+	for (unsigned i = 0; i < nodesCount; ++i)
+		AsebaSendDescription(&vms[i]);
+	uploader.deliver();
+}
+
+static void testConcurrentUpload()
+{
+	TestUploader uploader(2);
+	describeNodes(uploader);
+	const std::vector<uint16> bytecode0(makeBytecode(900, 1));
+	const std::vector<uint16> bytecode1(makeBytecode(600, 2));
+	uploader.startUpload(1, bytecode0);
+	uploader.startUpload(2, bytecode1);
+	check(uploader.chunksStarts[0].size() == 2 && uploader.chunksStarts[1].size() == 2, "both nodes get a window of chunks at once");
+	uploader.deliver();
+	check(!uploader.isUploading(), "uploads finished");
+	check(uploader.results[0] == BytecodeUploader::UPLOAD_VERIFIED && uploader.results[1] == BytecodeUploader::UPLOAD_VERIFIED, "uploads verified");
+	check(uploader.maxInFlight[0] <= 2 && uploader.maxInFlight[1] <= 2, "window respected");
+	check(uploader.chunksStarts[0].size() == 4 && uploader.chunksStarts[1].size() == 3, "each chunk sent once");
+	check(uploader.progress[0] == 900 && uploader.progress[1] == 600, "progress reaches total");
+	check(holds(0, bytecode0) && holds(1, bytecode1), "nodes hold the bytecode");
+}
+
+static void testLostChunk()
+{
+	TestUploader uploader(4);
+	describeNodes(uploader);
+	const std::vector<uint16> bytecode(makeBytecode(900, 3));
+	uploader.lostNode = 1;
+	uploader.lostStart = ASEBA_MAX_EVENT_ARG_COUNT - 2;
+	uploader.lostCount = 1;
+	uploader.startUpload(2, bytecode);
+	uploader.deliver();
+	check(uploader.results[1] == BytecodeUploader::UPLOAD_VERIFIED, "upload with a lost chunk verified");
+	check(uploader.chunksStarts[1].size() == 5 && uploader.chunksStarts[1].back() == uploader.lostStart, "only the lost chunk sent again");
+	check(holds(1, bytecode), "node holds the bytecode despite the lost chunk");
+}
+
+static void testFailure()
+{
+	TestUploader uploader(4);
+	describeNodes(uploader);
+	uploader.lostNode = 0;
+	uploader.lostStart = 0;
+	uploader.lostCount = 100;
+	uploader.startUpload(1, makeBytecode(900, 4));
+	uploader.deliver();
+	check(uploader.results[0] == BytecodeUploader::UPLOAD_FAILED, "upload fails when a chunk is always lost");
+	check(!uploader.isUploading(1), "failed upload removed");
+	check(std::count(uploader.chunksStarts[0].begin(), uploader.chunksStarts[0].end(), 0) == 3, "chunk sent maxAttempts times");
+}
+
+static void testUnverified()
+{
+	// without their description, we do not know that nodes can verify chunks
+	TestUploader uploader(2);
+	const std::vector<uint16> bytecode(makeBytecode(900, 5));
+	uploader.startUpload(1, bytecode);
+	check(uploader.chunksStarts[0].size() == 2, "window of chunks sent at once");
+	check(uploader.results[0] == -1, "upload not finished before all chunks are sent");
+	uploader.stepUploads();
+	check(uploader.chunksStarts[0].size() == 4, "remaining chunks sent at the next step");
+	check(uploader.results[0] == BytecodeUploader::UPLOAD_UNVERIFIED, "upload finished unverified");
+	check(uploader.maxInFlight[0] == 0, "no checksum requested");
+	uploader.deliver();
+	check(holds(0, bytecode), "node holds the unverified bytecode");
+}
+
+int main(int argc, char* argv[])
+{
+	for (unsigned i = 0; i < nodesCount; ++i)
+	{
+		AsebaVMState& vm(vms[i]);
+		memset(&vm, 0, sizeof(vm));
+		vm.nodeId = i + 1;
+		vm.bytecode = bytecodes[i];
+		vm.bytecodeSize = bytecodeSize;
+		vm.stack = stacks[i];
+		vm.stackSize = 32;
+		vm.variables = variables[i];
+		vm.variablesSize = variablesSize;
+		AsebaVMInit(&vm);
+	}
+
+	AsebaEnableBytecodeChecksum();
+
+	testConcurrentUpload();
+	testLostChunk();
+	testFailure();
+	testUnverified();
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
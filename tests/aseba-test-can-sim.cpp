@@ -0,0 +1,254 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../transport/can/can-sim.h"
+#include "../transport/can/can-net.h"
+#include "test-helpers.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+
+// Check fragmentation, reassembly and arbitration of the CAN transport on a virtual bus
+
+static AsebaCanSimConfig makeConfig(uint16 nodesCount, double lossProbability)
+{
+	AsebaCanSimConfig config;
+	config.bitrate = 1000000;
+	config.nodesCount = nodesCount;
+	config.sendQueueSize = 256;
+	config.recvQueueSize = 4096;
+	config.txQueueSize = 3;
+	config.lossProbability = lossProbability;
+	config.seed = 1;
+	return config;
+}
+
+// content of the packet number seq of a source, its first byte is the sequence number
+static std::vector<uint8> makePacket(uint16 source, unsigned seq)
+{
+	std::vector<uint8> packet(1 + (source * 7 + seq * 13) % 60);
+	packet[0] = uint8(seq);
+	for (size_t i = 1; i < packet.size(); ++i)
+		packet[i] = uint8(source * 31 + seq * 17 + i);
+	return packet;
+}
+
+static void testTiming()
+{
+	AsebaCanSimConfig config(makeConfig(2, 0));
+	AsebaCanSim* sim(AsebaCanSimCreate(&config));
+	const uint8 data[8] = { 0 };
+	AsebaCanSimSend(sim, 0, data, 8);
+	check(AsebaCanSimRunUntilIdle(sim, 1000000000ULL) == 1, "bus idle after one frame");
+	AsebaCanSimBusStats stats;
+	AsebaCanSimGetBusStats(sim, &stats);
+	// 47 + 64 bits at 1 Mbit/s
+	check(stats.time == 111000 && stats.busyTime == 111000 && stats.framesCount == 1, "duration of an 8-byte frame");
+	AsebaCanSimRun(sim, 111000);
+	check(AsebaCanSimGetBusUtilization(sim) == 0.5, "utilization of a half-idle bus");
+	AsebaCanSimDestroy(sim);
+}
+
+static void testArbitration()
+{
+	AsebaCanSimConfig config(makeConfig(3, 0));
+	AsebaCanSim* sim(AsebaCanSimCreate(&config));
+	const uint8 data[2] = { 1, 2 };
+	// the node with the higher identifier queues first but the lower identifier wins
+	AsebaCanSimSend(sim, 1, data, 2);
+	AsebaCanSimSend(sim, 0, data, 2);
+	AsebaCanSimRunUntilIdle(sim, 1000000000ULL);
+	uint8 buffer[8];
+	uint16 source(0);
+	AsebaCanSimRecv(sim, 2, buffer, sizeof(buffer), &source);
+	check(source == 1, "lower identifier transmits first");
+	AsebaCanSimRecv(sim, 2, buffer, sizeof(buffer), &source);
+	check(source == 2, "higher identifier transmits second");
+	AsebaCanSimDestroy(sim);
+}
+
+static void testManyNodes()
+{
+	const uint16 nodesCount(120);
+	const unsigned rounds(4);
+	AsebaCanSimConfig config(makeConfig(nodesCount, 0));
+	AsebaCanSim* sim(AsebaCanSimCreate(&config));
+	std::vector<std::vector<unsigned> > nextSeq(nodesCount, std::vector<unsigned>(nodesCount + 1, 0));
+
+	for (unsigned round = 0; round < rounds; ++round)
+	{
+		for (uint16 node = 0; node < nodesCount; ++node)
+		{
+			const std::vector<uint8> packet(makePacket(node + 1, round));
+			check(AsebaCanSimSend(sim, node, &packet[0], packet.size()) == 1, "send accepted");
+		}
+		check(AsebaCanSimRunUntilIdle(sim, 10000000000ULL) == 1, "all packets transmitted");
+
+		for (uint16 node = 0; node < nodesCount; ++node)
+		{
+			uint8 buffer[100];
+			uint16 source, amount;
+			while ((amount = AsebaCanSimRecv(sim, node, buffer, sizeof(buffer), &source)) != 0)
+			{
+				const std::vector<uint8> expected(makePacket(source, nextSeq[node][source]));
+				check(source != node + 1, "no packet from self");
+				check(amount == expected.size() && std::equal(expected.begin(), expected.end(), buffer), "packet intact and in order");
+				++nextSeq[node][source];
+			}
+			for (uint16 source = 1; source <= nodesCount; ++source)
+				check(source == node + 1 || nextSeq[node][source] == round + 1, "all packets received");
+		}
+	}
+
+	// the bus was saturated from the first send to the last frame
+	check(AsebaCanSimGetBusUtilization(sim) > 0.999, "saturated bus");
+	AsebaCanSimNodeStats stats;
+	AsebaCanSimGetNodeStats(sim, 0, &stats);
+	check(stats.packetsSent == rounds && stats.latencyCount == rounds && stats.receivedPacketsDropped == 0, "node statistics");
+	check(stats.latencyMin > 0 && stats.latencyMin <= stats.latencyMax, "latency statistics");
+	AsebaCanSimDestroy(sim);
+}
+
+static void testLoss()
+{
+	const uint16 nodesCount(20);
+	AsebaCanSimConfig config(makeConfig(nodesCount, 0.01));
+	AsebaCanSim* sim(AsebaCanSimCreate(&config));
+	unsigned intact(0), damaged(0);
+
+	for (unsigned round = 0; round < 50; ++round)
+	{
+		for (uint16 node = 0; node < nodesCount; ++node)
+		{
+			const std::vector<uint8> packet(makePacket(node + 1, round));
+			AsebaCanSimSend(sim, node, &packet[0], packet.size());
+		}
+		AsebaCanSimRunUntilIdle(sim, 10000000000ULL);
+		for (uint16 node = 0; node < nodesCount; ++node)
+		{
+			uint8 buffer[100];
+			uint16 source, amount;
+			while ((amount = AsebaCanSimRecv(sim, node, buffer, sizeof(buffer), &source)) != 0)
+			{
+				const std::vector<uint8> expected(makePacket(source, round));
+				// a lost frame in the middle of a packet can only shorten it
+				check(amount <= expected.size(), "no packet longer than sent");
+				if (amount == expected.size() && std::equal(expected.begin(), expected.end(), buffer))
+					++intact;
+				else
+					++damaged;
+			}
+		}
+	}
+
+	AsebaCanSimBusStats stats;
+	AsebaCanSimGetBusStats(sim, &stats);
+	check(stats.framesLost > 0, "frames lost");
+	check(intact > 0 && intact + damaged < 50 * nodesCount * (nodesCount - 1), "lost frames lose packets");
+	AsebaCanSimDestroy(sim);
+}
+
+// receive up to maxCount pending packets of node, checking that they are intact and in order
+static unsigned receiveIntact(AsebaCanSim* sim, uint16 node, std::vector<int>& lastSeq, unsigned maxCount)
+{
+	uint8 buffer[100];
+	uint16 source, amount;
+	unsigned count(0);
+	while (count < maxCount && (amount = AsebaCanSimRecv(sim, node, buffer, sizeof(buffer), &source)) != 0)
+	{
+		const std::vector<uint8> expected(makePacket(source, buffer[0]));
+		check(amount == expected.size() && std::equal(expected.begin(), expected.end(), buffer), "packet intact despite overflow");
+		check(int(buffer[0]) > lastSeq[source], "packets in order despite overflow");
+		lastSeq[source] = buffer[0];
+		++count;
+	}
+	return count;
+}
+
+static void testSmallRecvQueue()
+{
+	// a few dozen frames for packets of up to 8 frames, coming interleaved from several senders
+	const uint16 nodesCount(7);
+	const unsigned rounds(20);
+	AsebaCanSimConfig config(makeConfig(nodesCount, 0));
+	config.recvQueueSize = 32;
+	AsebaCanSim* sim(AsebaCanSimCreate(&config));
+	AsebaCan* receiver(AsebaCanSimGetNode(sim, 0));
+	std::vector<int> lastSeq(nodesCount + 1, -1);
+	unsigned received(0);
+
+	for (unsigned round = 0; round < rounds; ++round)
+	{
+		for (unsigned seq = round * 3; seq < round * 3 + 3; ++seq)
+			for (uint16 node = 1; node < nodesCount; ++node)
+			{
+				const std::vector<uint8> packet(makePacket(node + 1, seq));
+				AsebaCanSimSend(sim, node, &packet[0], packet.size());
+			}
+		// consume slowly while frames arrive, so that the queue overflows
+		for (unsigned step = 0; step < 20; ++step)
+		{
+			AsebaCanSimRun(sim, 100000);
+			received += receiveIntact(sim, 0, lastSeq, 1);
+		}
+		check(AsebaCanSimRunUntilIdle(sim, 10000000000ULL) == 1, "all packets transmitted");
+		received += receiveIntact(sim, 0, lastSeq, rounds * 3 * nodesCount);
+		check(AsebaCanInstanceRecvBufferEmpty(receiver) != 0, "queue empty once drained");
+
+		// dropped packets must have released their frames
+		const uint8 data[2] = { 0, 0 };
+		AsebaCanSimSend(sim, 1, data, 2);
+		AsebaCanSimRunUntilIdle(sim, 10000000000ULL);
+		check(AsebaCanInstanceRecvBufferEmpty(receiver) == 0, "queue not empty with a waiting packet");
+		uint8 buffer[8];
+		uint16 source(0);
+		check(AsebaCanSimRecv(sim, 0, buffer, sizeof(buffer), &source) == 2 && source == 2, "small packet received after overflow");
+		check(AsebaCanInstanceRecvBufferEmpty(receiver) != 0, "queue empty again");
+	}
+
+	AsebaCanSimNodeStats stats;
+	AsebaCanSimGetNodeStats(sim, 0, &stats);
+	check(stats.receivedPacketsDropped > 0, "packets dropped on overflow");
+	check(received > 0 && received + stats.receivedPacketsDropped == rounds * 3 * (nodesCount - 1), "every packet received or dropped");
+	AsebaCanSimDestroy(sim);
+}
+
+int main(int argc, char* argv[])
+{
+	AsebaCanSimConfig invalid(makeConfig(256, 0));
+	check(AsebaCanSimCreate(&invalid) == 0, "at most 255 nodes");
+
+	testTiming();
+	testArbitration();
+	testManyNodes();
+	testLoss();
+	testSmallRecvQueue();
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
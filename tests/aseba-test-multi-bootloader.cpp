@@ -0,0 +1,416 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// Aseba
+#include "../common/consts.h"
+#include "../common/msg/msg.h"
+#include "../common/utils/HexFile.h"
+#include "../common/utils/BootloaderInterface.h"
+#include "../common/utils/MultiBootloaderInterface.h"
+#include "test-helpers.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+#include <stdio.h>
+
+// Check that MultiBootloaderInterface flashes several simulated bootloaders at once,
+// on one or several streams, skips the pages that are up to date, and fails the nodes
+// that report errors or stay silent without stopping the others;
+// and that BootloaderInterface in differential mode only writes the pages that changed
+
+using namespace Aseba;
+
+static const unsigned pageSize(64);
+static const unsigned pagesStart(2);
+static const unsigned pagesCount(8);
+
+//! Bootloader of a node, answering the complete protocol
+struct SimulatedBootloader
+{
+	unsigned id;
+	std::vector<uint8> flash; //!< content of the pages, from page 0
+	bool silent; //!< whether it never answers
+	bool failWrites; //!< whether it refuses to write pages
+	unsigned pageWriting; //!< page receiving data
+	unsigned dataReceived; //!< amount of data received for this page
+	unsigned pagesWritten;
+	unsigned pagesRead;
+	int firstWriteRound; //!< delivery round in which the first page write was asked, -1 if none
+	bool exited; //!< whether it was asked to leave the bootloader
+
+	SimulatedBootloader(unsigned id) :
+		id(id),
+		flash((pagesStart + pagesCount) * pageSize, 0xff),
+		silent(false),
+		failWrites(false),
+		pageWriting(0),
+		dataReceived(0),
+		pagesWritten(0),
+		pagesRead(0),
+		firstWriteRound(-1),
+		exited(false)
+	{}
+
+	void send(Dashel::Stream* stream, Message& message)
+	{
+		message.source = id;
+		message.serialize(stream);
+	}
+
+	void ack(Dashel::Stream* stream, uint16 errorCode)
+	{
+		BootloaderAck message;
+		message.errorCode = errorCode;
+		message.errorAddress = 0;
+		send(stream, message);
+	}
+
+	void process(Dashel::Stream* stream, const Message* message, int round)
+	{
+		const CmdMessage* cmdMessage(dynamic_cast<const CmdMessage*>(message));
+		if (silent || !cmdMessage || cmdMessage->dest != id)
+			return;
+
+		if (dynamic_cast<const Reboot*>(message))
+		{
+			BootloaderDescription description;
+			description.pageSize = pageSize;
+			description.pagesStart = pagesStart;
+			description.pagesCount = pagesCount;
+			send(stream, description);
+		}
+		else if (const BootloaderReadPage* readPage = dynamic_cast<const BootloaderReadPage*>(message))
+		{
+			for (unsigned i = 0; i < pageSize; i += 4)
+			{
+				BootloaderDataRead dataRead;
+				std::copy(&flash[readPage->pageNumber * pageSize + i], &flash[readPage->pageNumber * pageSize + i] + 4, dataRead.data);
+				send(stream, dataRead);
+			}
+			++pagesRead;
+			ack(stream, BootloaderAck::SUCCESS);
+		}
+		else if (const BootloaderWritePage* writePage = dynamic_cast<const BootloaderWritePage*>(message))
+		{
+			if (firstWriteRound < 0)
+				firstWriteRound = round;
+			if (failWrites || writePage->pageNumber < pagesStart || writePage->pageNumber >= pagesStart + pagesCount)
+			{
+				ack(stream, BootloaderAck::ERROR_PROGRAMMING_FAILED);
+				return;
+			}
+			pageWriting = writePage->pageNumber;
+			dataReceived = 0;
+			ack(stream, BootloaderAck::SUCCESS);
+		}
+		else if (const BootloaderPageDataWrite* pageData = dynamic_cast<const BootloaderPageDataWrite*>(message))
+		{
+			std::copy(pageData->data, pageData->data + 4, &flash[pageWriting * pageSize + dataReceived]);
+			dataReceived += 4;
+			if (dataReceived == pageSize)
+			{
+				++pagesWritten;
+				ack(stream, BootloaderAck::SUCCESS);
+			}
+		}
+		else if (dynamic_cast<const BootloaderReset*>(message))
+			exited = true;
+	}
+};
+
+//! Stream shared by several bootloaders, as behind a switch
+struct Bus
+{
+	MemoryStream toNodes;
+	MemoryStream fromNodes;
+	LoopbackStream flasherSide;
+	LoopbackStream nodesSide;
+	std::vector<SimulatedBootloader> nodes;
+
+	Bus() :
+		flasherSide(fromNodes, toNodes),
+		nodesSide(toNodes, fromNodes)
+	{}
+};
+
+//! Stream of a bus whose nodes answer as soon as it is flushed, for the blocking BootloaderInterface
+class DirectStream: public LoopbackStream
+{
+public:
+	Bus& bus;
+
+	DirectStream(Bus& bus) : LoopbackStream(bus.fromNodes, bus.toNodes), bus(bus) {}
+	virtual void flush()
+	{
+		while (!bus.toNodes.data.empty())
+		{
+			std::auto_ptr<Message> message(Message::receive(&bus.nodesSide));
+			for (size_t j = 0; j < bus.nodes.size(); ++j)
+				bus.nodes[j].process(&bus.nodesSide, message.get(), 0);
+		}
+	}
+};
+
+//! Bootloader interface counting the pages found up to date
+class TestBootloaderInterface: public BootloaderInterface
+{
+public:
+	unsigned pagesUnchanged;
+
+	TestBootloaderInterface(Dashel::Stream* stream, int dest) : BootloaderInterface(stream, dest), pagesUnchanged(0) {}
+
+protected:
+	virtual void writePageUnchanged(unsigned pageNumber) { ++pagesUnchanged; }
+};
+
+//! Deliver the messages of all buses until the network is idle
+static void deliver(MultiBootloaderInterface& flasher, std::vector<Bus*>& buses)
+{
+	bool idle(false);
+	for (int round = 0; !idle; ++round)
+	{
+		idle = true;
+		for (size_t i = 0; i < buses.size(); ++i)
+		{
+			Bus& bus(*buses[i]);
+			while (!bus.toNodes.data.empty())
+			{
+				std::auto_ptr<Message> message(Message::receive(&bus.nodesSide));
+				for (size_t j = 0; j < bus.nodes.size(); ++j)
+					bus.nodes[j].process(&bus.nodesSide, message.get(), round);
+				idle = false;
+			}
+		}
+		for (size_t i = 0; i < buses.size(); ++i)
+		{
+			Bus& bus(*buses[i]);
+			while (!bus.fromNodes.data.empty())
+			{
+				std::auto_ptr<Message> message(Message::receive(&bus.flasherSide));
+				flasher.processMessage(&bus.flasherSide, message.get());
+				idle = false;
+			}
+		}
+	}
+}
+
+//! Return an hex file covering pages 1 to 4, page 1 being outside what the bootloader can write
+static HexFile makeHexFile(unsigned seed)
+{
+	HexFile hexFile;
+	std::vector<uint8>& data(hexFile.data[pageSize]);
+	for (unsigned i = 0; i < 4 * pageSize; ++i)
+		data.push_back(uint8(i * 31 + seed * 7));
+	return hexFile;
+}
+
+//! Return whether node holds the pages of hexFile that it can write
+static bool holds(const SimulatedBootloader& node, const HexFile& hexFile)
+{
+	const std::vector<uint8>& data(hexFile.data.begin()->second);
+	return std::equal(data.begin() + pageSize, data.end(), node.flash.begin() + pagesStart * pageSize);
+}
+
+//! Flash hexFile on all nodes of buses and return the totals
+static MultiBootloaderInterface::Statistics flash(std::vector<Bus*>& buses, const HexFile& hexFile, bool skipUnchanged, unsigned timeout = 5000, PageChecksumCache* cache = 0)
+{
+	MultiBootloaderInterface flasher(true, skipUnchanged, timeout);
+	flasher.setChecksumCache(cache);
+	for (size_t i = 0; i < buses.size(); ++i)
+		for (size_t j = 0; j < buses[i]->nodes.size(); ++j)
+			flasher.addNode(&buses[i]->flasherSide, buses[i]->nodes[j].id);
+	flasher.startWriteHex(hexFile);
+	deliver(flasher, buses);
+	while (flasher.stepSessions())
+	{
+		UnifiedTime(10).sleep();
+		deliver(flasher, buses);
+	}
+	return flasher.getStatistics();
+}
+
+static void testConcurrentFlash()
+{
+	Bus bus0, bus1;
+	bus0.nodes.push_back(SimulatedBootloader(1));
+	bus0.nodes.push_back(SimulatedBootloader(2));
+	bus1.nodes.push_back(SimulatedBootloader(1));
+	std::vector<Bus*> buses;
+	buses.push_back(&bus0);
+	buses.push_back(&bus1);
+
+	const HexFile hexFile(makeHexFile(1));
+	const MultiBootloaderInterface::Statistics statistics(flash(buses, hexFile, false));
+	check(statistics.nodesFlashed == 3 && statistics.nodesFailed == 0, "all nodes flashed");
+	check(statistics.pagesWritten == 9 && statistics.pagesSkipped == 0, "writable pages written on every node");
+	check(statistics.bytesWritten == 9 * pageSize && statistics.bytesRead == 0, "bytes written counted");
+	check(holds(bus0.nodes[0], hexFile) && holds(bus0.nodes[1], hexFile) && holds(bus1.nodes[0], hexFile), "nodes hold the hex file");
+	check(bus0.nodes[0].firstWriteRound == bus0.nodes[1].firstWriteRound && bus0.nodes[0].firstWriteRound == bus1.nodes[0].firstWriteRound, "nodes flashed at once");
+	check(bus0.nodes[0].exited && bus0.nodes[1].exited && bus1.nodes[0].exited, "nodes leave the bootloader");
+}
+
+static void testSkipUnchanged()
+{
+	Bus bus;
+	bus.nodes.push_back(SimulatedBootloader(1));
+	bus.nodes.push_back(SimulatedBootloader(2));
+	std::vector<Bus*> buses(1, &bus);
+
+	const HexFile hexFile(makeHexFile(2));
+	flash(buses, hexFile, true);
+	check(holds(bus.nodes[0], hexFile) && holds(bus.nodes[1], hexFile), "nodes hold the hex file after a read-back");
+
+	// a second time, only the page that changed in between is written
+	bus.nodes[1].flash[(pagesStart + 1) * pageSize + 5] ^= 0xff;
+	bus.nodes[0].pagesWritten = bus.nodes[1].pagesWritten = 0;
+	const MultiBootloaderInterface::Statistics statistics(flash(buses, hexFile, true));
+	check(statistics.nodesFlashed == 2, "up-to-date nodes flashed");
+	check(statistics.pagesWritten == 1 && statistics.pagesSkipped == 5, "only the changed page written");
+	check(bus.nodes[0].pagesWritten == 0 && bus.nodes[1].pagesWritten == 1, "written page on the right node");
+	check(statistics.bytesRead == 6 * pageSize, "bytes read back counted");
+	check(holds(bus.nodes[1], hexFile), "changed page restored");
+}
+
+static void testFailures()
+{
+	Bus bus;
+	bus.nodes.push_back(SimulatedBootloader(1));
+	bus.nodes.push_back(SimulatedBootloader(2));
+	bus.nodes.push_back(SimulatedBootloader(3));
+	bus.nodes[1].failWrites = true;
+	bus.nodes[2].silent = true;
+	std::vector<Bus*> buses(1, &bus);
+
+	const HexFile hexFile(makeHexFile(3));
+	const MultiBootloaderInterface::Statistics statistics(flash(buses, hexFile, false, 50));
+	check(statistics.nodesFlashed == 1 && statistics.nodesFailed == 2, "failing and silent nodes fail");
+	check(holds(bus.nodes[0], hexFile), "other node flashed despite the failures");
+	check(bus.nodes[1].pagesWritten == 0 && !bus.nodes[1].exited, "failing node left in its bootloader");
+}
+
+static void testChecksumCache()
+{
+	Bus bus;
+	bus.nodes.push_back(SimulatedBootloader(1));
+	bus.nodes.push_back(SimulatedBootloader(2));
+	std::vector<Bus*> buses(1, &bus);
+	PageChecksumCache cache;
+
+	const HexFile hexFile(makeHexFile(4));
+	flash(buses, hexFile, true, 5000, &cache);
+	bus.nodes[0].pagesRead = bus.nodes[1].pagesRead = 0;
+	bus.nodes[0].pagesWritten = bus.nodes[1].pagesWritten = 0;
+	const MultiBootloaderInterface::Statistics statistics(flash(buses, hexFile, true, 5000, &cache));
+	check(statistics.nodesFlashed == 2 && statistics.pagesSkipped == 6 && statistics.bytesRead == 0, "cached pages skipped without reading back");
+	check(bus.nodes[0].pagesRead == 0 && bus.nodes[1].pagesRead == 0, "no page read back");
+
+	// a new image is written where it changed, and the cache follows
+	const HexFile newHexFile(makeHexFile(5));
+	const MultiBootloaderInterface::Statistics newStatistics(flash(buses, newHexFile, true, 5000, &cache));
+	check(newStatistics.pagesWritten == 6 && holds(bus.nodes[0], newHexFile) && holds(bus.nodes[1], newHexFile), "changed pages written despite the cache");
+	uint16 checksum;
+	const std::vector<uint8>& data(newHexFile.data.begin()->second);
+	check(cache.get(2, pageSize, pagesStart, checksum) && checksum == BootloaderInterface::pageChecksum(&data[pageSize], pageSize), "cache holds the new checksum");
+	check(!cache.get(2, pageSize * 2, pagesStart, checksum), "cache ignores another page size");
+
+	// the cache survives a round-trip to a file
+	const char* fileName("aseba-test-multi-bootloader.cache");
+	check(cache.save(fileName), "cache saved");
+	PageChecksumCache loadedCache;
+	check(loadedCache.load(fileName) && loadedCache.get(2, pageSize, pagesStart, checksum) && checksum == BootloaderInterface::pageChecksum(&data[pageSize], pageSize), "cache loaded");
+	remove(fileName);
+}
+
+static void testChecksumCacheSeveralStreams()
+{
+	Bus bus0, bus1;
+	bus0.nodes.push_back(SimulatedBootloader(1));
+	bus1.nodes.push_back(SimulatedBootloader(1));
+	std::vector<Bus*> buses;
+	buses.push_back(&bus0);
+	buses.push_back(&bus1);
+	PageChecksumCache cache;
+
+	// both nodes have id 1, the cache could not tell them apart
+	const HexFile hexFile(makeHexFile(7));
+	flash(buses, hexFile, true, 5000, &cache);
+	uint16 checksum;
+	check(!cache.get(1, pageSize, pagesStart, checksum), "cache ignored with several streams");
+	check(holds(bus0.nodes[0], hexFile) && holds(bus1.nodes[0], hexFile), "nodes flashed without the cache");
+}
+
+static void testDifferentialWrite()
+{
+	Bus bus;
+	bus.nodes.push_back(SimulatedBootloader(1));
+	DirectStream stream(bus);
+	const char* fileName("aseba-test-multi-bootloader.hex");
+	const HexFile hexFile(makeHexFile(6));
+	hexFile.write(fileName);
+	PageChecksumCache cache;
+
+	{
+		TestBootloaderInterface bootloader(&stream, 1);
+		bootloader.setChecksumCache(&cache);
+		bootloader.writeHex(fileName, true, false, true);
+		check(holds(bus.nodes[0], hexFile) && bus.nodes[0].pagesWritten == 3 && bootloader.pagesUnchanged == 0, "differential write of a blank node writes all pages");
+	}
+
+	bus.nodes[0].flash[(pagesStart + 2) * pageSize] ^= 0xff;
+	bus.nodes[0].pagesRead = bus.nodes[0].pagesWritten = 0;
+	{
+		TestBootloaderInterface bootloader(&stream, 1);
+		bootloader.writeHex(fileName, true, false, true);
+		check(bus.nodes[0].pagesRead == 3 && bus.nodes[0].pagesWritten == 1 && bootloader.pagesUnchanged == 2, "differential write only writes the changed page");
+		check(holds(bus.nodes[0], hexFile), "changed page restored by differential write");
+	}
+
+	bus.nodes[0].pagesRead = bus.nodes[0].pagesWritten = 0;
+	{
+		TestBootloaderInterface bootloader(&stream, 1);
+		bootloader.setChecksumCache(&cache);
+		bootloader.writeHex(fileName, true, false, true);
+		check(bus.nodes[0].pagesRead == 0 && bus.nodes[0].pagesWritten == 0 && bootloader.pagesUnchanged == 3, "cached pages neither read nor written");
+	}
+
+	remove(fileName);
+}
+
+int main(int argc, char* argv[])
+{
+	testConcurrentFlash();
+	testSkipUnchanged();
+	testFailures();
+	testChecksumCache();
+	testChecksumCacheSeveralStreams();
+	testDifferentialWrite();
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
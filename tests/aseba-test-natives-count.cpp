@@ -1,4 +1,6 @@
 #include "../vm/natives.h"
+#include "../vm/natives-dsp.h"
+#include "../vm/natives-sort.h"
 
 // C++
 #include <iostream>
@@ -8,11 +10,27 @@ static AsebaNativeFunctionPointer nativeFunctions[] =
 	ASEBA_NATIVES_STD_FUNCTIONS,
 };
 
+static AsebaNativeFunctionPointer dspNativeFunctions[] =
+{
+	ASEBA_NATIVES_DSP_FUNCTIONS,
+};
+
+static AsebaNativeFunctionPointer sortNativeFunctions[] =
+{
+	ASEBA_NATIVES_SORT_FUNCTIONS,
+};
+
 int main(int argc, char*argv[])
 {
 	size_t nativesCount = (sizeof(nativeFunctions)/sizeof(AsebaNativeFunctionPointer));
+	size_t dspNativesCount = (sizeof(dspNativeFunctions)/sizeof(AsebaNativeFunctionPointer));
+	size_t sortNativesCount = (sizeof(sortNativeFunctions)/sizeof(AsebaNativeFunctionPointer));
 	if (nativesCount != ASEBA_NATIVES_STD_COUNT)
 		return 1;
+	else if (dspNativesCount != ASEBA_NATIVES_DSP_COUNT)
+		return 1;
+	else if (sortNativesCount != ASEBA_NATIVES_SORT_COUNT)
+		return 1;
 	else
 		return 0;
 }
@@ -0,0 +1,162 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../vm/vm.h"
+#include "../vm/natives.h"
+#include "../vm/natives-simd.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+// C
+#include <stdlib.h>
+
+// Check that the vectorized natives give the same results as the element-by-element ones,
+// on random vectors at random, possibly overlapping, positions
+
+#ifdef ASEBA_NATIVES_SIMD
+
+static const unsigned variablesCount = 512;
+static const unsigned casesCount = 2000;
+
+struct NativeUnderTest
+{
+	const char* name;
+	AsebaNativeFunctionPointer function;
+	unsigned argumentsCount; //!< number of addresses popped before the length
+};
+
+static const NativeUnderTest nativesUnderTest[] =
+{
+	{ "math.copy", AsebaNative_veccopy, 2 },
+	{ "math.fill", AsebaNative_vecfill, 2 },
+	{ "math.addscalar", AsebaNative_vecaddscalar, 3 },
+	{ "math.add", AsebaNative_vecadd, 3 },
+	{ "math.sub", AsebaNative_vecsub, 3 },
+	{ "math.mul", AsebaNative_vecmul, 3 },
+	{ "math.min", AsebaNative_vecmin, 3 },
+	{ "math.max", AsebaNative_vecmax, 3 },
+	{ "math.clamp", AsebaNative_vecclamp, 4 },
+	{ "math.dot", AsebaNative_vecdot, 4 },
+	{ "math.stat", AsebaNative_vecstat, 4 },
+};
+
+static const char* levelNames[] = { "none", "SSE2", "AVX2", "NEON" };
+
+static sint16 randomValue(unsigned kind)
+{
+	switch (kind)
+	{
+		case 0: return -32768; // worst case for the accumulations
+		case 1: return sint16((rand() % 65536) - 32768);
+		default: return sint16((rand() % 201) - 100);
+	}
+}
+
+// run a native on variables, with the given addresses and length
+static void runNative(const NativeUnderTest& native, std::vector<sint16>& variables, const uint16* addresses, uint16 length)
+{
+	sint16 stack[8];
+	AsebaVMState vm;
+	memset(&vm, 0, sizeof(vm));
+	vm.variables = &variables[0];
+	vm.variablesSize = variables.size();
+	vm.stack = stack;
+	vm.stackSize = sizeof(stack) / sizeof(stack[0]);
+
+	// arguments are popped first to last, the length being the last one
+	stack[0] = length;
+	for (unsigned i = 0; i < native.argumentsCount; ++i)
+		stack[native.argumentsCount - i] = addresses[i];
+	vm.sp = native.argumentsCount;
+
+	native.function(&vm);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+	unsigned failuresCount(0);
+
+	for (int level = ASEBA_SIMD_SSE2; level <= ASEBA_SIMD_NEON; ++level)
+	{
+		if (!AsebaSimdIsSupported(AsebaSimdLevel(level)))
+			continue;
+
+		for (size_t n = 0; n < sizeof(nativesUnderTest) / sizeof(nativesUnderTest[0]); ++n)
+		{
+			const NativeUnderTest& native(nativesUnderTest[n]);
+			for (unsigned c = 0; c < casesCount; ++c)
+			{
+				// random content
+				std::vector<sint16> variables(variablesCount);
+				const unsigned kind(rand() % 3);
+				for (size_t i = 0; i < variables.size(); ++i)
+					variables[i] = randomValue(kind);
+
+				// random length and addresses, half of the cases overlapping
+				const uint16 length(rand() % 100);
+				const uint16 window(c % 2 ? length + 16 : variablesCount - length);
+				const uint16 base(rand() % (variablesCount - window - length + 1));
+				uint16 addresses[4];
+				for (unsigned i = 0; i < native.argumentsCount; ++i)
+					addresses[i] = base + rand() % (window + 1);
+				// the shift of dot is a scalar variable, which must give a shift up to 33
+				if (native.function == AsebaNative_vecdot)
+					variables[addresses[3]] = rand() % 34;
+
+				std::vector<sint16> expected(variables);
+				AsebaSimdSetLevel(ASEBA_SIMD_NONE);
+				runNative(native, expected, addresses, length);
+
+				std::vector<sint16> result(variables);
+				AsebaSimdSetLevel(AsebaSimdLevel(level));
+				runNative(native, result, addresses, length);
+
+				if (result != expected)
+				{
+					std::cerr << native.name << " differs with " << levelNames[level] << " kernels, length " << length << ", addresses";
+					for (unsigned i = 0; i < native.argumentsCount; ++i)
+						std::cerr << " " << addresses[i];
+					std::cerr << std::endl;
+					++failuresCount;
+				}
+			}
+		}
+	}
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
+
+#else // ASEBA_NATIVES_SIMD
+
+int main(int argc, char* argv[])
+{
+	// nothing to compare with on this host
+	return 0;
+}
+
+#endif // ASEBA_NATIVES_SIMD
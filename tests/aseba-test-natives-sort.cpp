@@ -0,0 +1,128 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../vm/natives.h"
+#include "../vm/natives-sort.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+
+// Check the sorting natives against the standard library on random, sorted, reversed and constant vectors
+
+static std::vector<sint16> makeVector(unsigned kind, unsigned size)
+{
+	std::vector<sint16> values(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		switch (kind)
+		{
+			case 0: values[i] = sint16((rand() % 65536) - 32768); break;
+			case 1: values[i] = sint16((rand() % 7) - 3); break;
+			case 2: values[i] = sint16(i * 3 - 1000); break;
+			case 3: values[i] = sint16(1000 - i * 3); break;
+			case 4: values[i] = 42; break;
+			// organ pipe, a bad case for naive quick sorts
+			default: values[i] = sint16(i < size / 2 ? i : size - i); break;
+		}
+	}
+	return values;
+}
+
+static bool argLess(const std::vector<sint16>& values, sint16 a, sint16 b)
+{
+	return values[a] < values[b] || (values[a] == values[b] && a < b);
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+	unsigned failuresCount(0);
+	const unsigned sizes[] = { 0, 1, 2, 3, 16, 17, 100, 1024, 5000 };
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+	{
+		for (unsigned kind = 0; kind < 6; ++kind)
+		{
+			const std::vector<sint16> values(makeVector(kind, sizes[s]));
+			std::vector<sint16> expected(values);
+			std::sort(expected.begin(), expected.end());
+
+			std::vector<sint16> intro(values);
+			aseba_intro_sort(intro.empty() ? 0 : &intro[0], intro.size());
+			if (intro != expected)
+			{
+				std::cerr << "intro sort fails on size " << sizes[s] << ", kind " << kind << std::endl;
+				++failuresCount;
+			}
+
+			std::vector<sint16> heap(values);
+			aseba_heap_sort(heap.empty() ? 0 : &heap[0], heap.size());
+			if (heap != expected)
+			{
+				std::cerr << "heap sort fails on size " << sizes[s] << ", kind " << kind << std::endl;
+				++failuresCount;
+			}
+
+			if (values.empty())
+				continue;
+
+			std::vector<sint16> indices(values.size());
+			aseba_arg_sort(&indices[0], &values[0], values.size());
+			bool argSorted(true);
+			std::vector<bool> seen(values.size(), false);
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				if (indices[i] < 0 || size_t(indices[i]) >= values.size() || seen[indices[i]])
+				{
+					argSorted = false;
+					break;
+				}
+				seen[indices[i]] = true;
+				if (i > 0 && !argLess(values, indices[i - 1], indices[i]))
+					argSorted = false;
+			}
+			if (!argSorted)
+			{
+				std::cerr << "arg sort fails on size " << sizes[s] << ", kind " << kind << std::endl;
+				++failuresCount;
+			}
+
+			for (size_t k = 0; k < values.size(); k += 1 + values.size() / 10)
+			{
+				if (aseba_select(&values[0], values.size(), k) != expected[k])
+				{
+					std::cerr << "select fails on size " << sizes[s] << ", kind " << kind << ", k " << k << std::endl;
+					++failuresCount;
+				}
+			}
+		}
+	}
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
@@ -0,0 +1,129 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../common/utils/RingSeries.h"
+#include "test-helpers.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+
+// Check the capacity, the growth of the storage and the min/max decimation of the series plotted by the event viewers
+
+using namespace Aseba;
+
+static void testCapacity()
+{
+	RingSeries series(2, 100);
+	for (unsigned i = 0; i < 250; ++i)
+	{
+		const sint16 values[2] = { sint16(i), sint16(-int(i)) };
+		series.push(i, values, i % 2 ? 2 : 1);
+	}
+	check(series.size() == 100, "capacity not exceeded");
+	check(series.time(0) == 150 && series.value(0, 0) == 150 && series.time(99) == 249, "oldest samples overwritten");
+	check(series.value(1, 1) == -151 && series.value(1, 0) == 0, "missing channels set to 0");
+	series.dropBefore(200);
+	check(series.size() == 50 && series.time(0) == 200, "samples before a time dropped");
+	series.clear();
+	check(series.size() == 0, "cleared");
+}
+
+static void testGrowth()
+{
+	RingSeries series(2, 5000);
+	for (unsigned i = 0; i < 1000; ++i)
+	{
+		const sint16 values[2] = { sint16(i), sint16(-int(i)) };
+		series.push(i, values, 2);
+	}
+	// wrap the first samples around before the storage grows
+	series.dropBefore(500);
+	for (unsigned i = 1000; i < 4000; ++i)
+	{
+		const sint16 values[2] = { sint16(i), sint16(-int(i)) };
+		series.push(i, values, 2);
+	}
+	check(series.size() == 3500, "all samples kept while growing");
+	bool ordered(true);
+	for (size_t i = 0; i < series.size(); ++i)
+		ordered = ordered && series.time(i) == 500 + i && series.value(0, i) == sint16(500 + i) && series.value(1, i) == -sint16(500 + i);
+	check(ordered, "samples kept in order while growing");
+}
+
+static void testDecimation()
+{
+	const unsigned samplesCount(100000);
+	RingSeries series(1, samplesCount);
+	for (unsigned i = 0; i < samplesCount; ++i)
+	{
+		const sint16 value(sint16(rand() % 2000 - 1000 + (i == 54321 ? 20000 : 0)));
+		series.push(i * 0.01, &value, 1);
+	}
+
+	std::vector<double> x, y;
+	const unsigned columns(500);
+	series.decimate(0, 100, 900, columns, x, y);
+	check(x.size() <= columns * 4 + 2, "at most four points per column");
+	check(std::adjacent_find(x.begin(), x.end(), std::greater_equal<double>()) == x.end(), "points in time order");
+	check(x.front() < 100 && x.back() >= 900, "line reaches the borders");
+	check(*std::max_element(y.begin(), y.end()) >= 19000, "peak kept");
+
+	// each column keeps the minimum and maximum of its samples
+	std::vector<double> samplesMin(columns, 1e9), samplesMax(columns, -1e9), keptMin(samplesMin), keptMax(samplesMax);
+	for (size_t i = 0; i < series.size(); ++i)
+		if (series.time(i) >= 100 && series.time(i) < 900)
+		{
+			const unsigned column(unsigned((series.time(i) - 100) * columns / 800));
+			samplesMin[column] = std::min(samplesMin[column], double(series.value(0, i)));
+			samplesMax[column] = std::max(samplesMax[column], double(series.value(0, i)));
+		}
+	for (size_t i = 0; i < x.size(); ++i)
+		if (x[i] >= 100 && x[i] < 900)
+		{
+			const unsigned column(unsigned((x[i] - 100) * columns / 800));
+			keptMin[column] = std::min(keptMin[column], y[i]);
+			keptMax[column] = std::max(keptMax[column], y[i]);
+		}
+	check(samplesMin == keptMin && samplesMax == keptMax, "minimum and maximum of each column kept");
+
+	// few samples are kept as they are
+	series.decimate(0, 100, 101, columns, x, y);
+	check(x.size() == 102, "sparse samples not decimated");
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+
+	testCapacity();
+	testGrowth();
+	testDecimation();
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
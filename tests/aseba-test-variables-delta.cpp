@@ -0,0 +1,205 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../common/consts.h"
+#include "../common/msg/msg.h"
+#include "vm-buffer-test-glue.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// Check that variables sent as differences by vm-buffer are rebuilt by VariablesDelta on the client
+
+using namespace Aseba;
+
+static const uint16 nodeId(1);
+static const uint16 variablesSize(1000);
+static sint16 variables[variablesSize];
+static sint16 snapshotVariables[variablesSize];
+static AsebaVariablesSnapshot snapshot;
+
+static MemoryStream toNode;
+static MemoryStream fromNode;
+
+// glue
+
+static MemoryStream& streamToNode(AsebaVMState *vm) { return toNode; }
+static MemoryStream& streamFromNode(AsebaVMState *vm) { return fromNode; }
+
+// client
+
+struct Client
+{
+	uint16 version;
+	std::vector<sint16> copy;
+	unsigned messagesCount;
+	unsigned keyFramesCount;
+
+	Client() : version(0), messagesCount(0), keyFramesCount(0) {}
+
+	//! Ask some variables and process the answers, except the message number dropped
+	void refresh(AsebaVMState* vm, uint16 start, uint16 length, int dropped = -1)
+	{
+		GetVariablesDelta(nodeId, start, length, version).serialize(&toNode);
+		AsebaProcessIncomingEvents(vm);
+		for (int i = 0; !fromNode.data.empty(); ++i)
+		{
+			std::auto_ptr<Message> message(Message::receive(&fromNode));
+			VariablesDelta* delta(dynamic_cast<VariablesDelta*>(message.get()));
+			check(delta != 0 && delta->dest == ASEBA_DEST_DEBUG, "delta answer");
+			if (!delta || i == dropped)
+				continue;
+			++messagesCount;
+			const size_t end(size_t(delta->start) + delta->length);
+			if (delta->baseVersion == 0)
+			{
+				std::fill(copy.begin(), copy.end(), 0);
+				++keyFramesCount;
+			}
+			if (copy.size() < end)
+				copy.resize(end, 0);
+			if ((delta->baseVersion != 0 && delta->baseVersion != version) || !delta->apply(copy))
+			{
+				version = 0;
+				continue;
+			}
+			version = delta->version;
+		}
+	}
+
+	bool matches(uint16 start, uint16 length) const
+	{
+		return copy.size() >= size_t(start) + length && std::equal(variables + start, variables + start + length, copy.begin() + start);
+	}
+};
+
+static void testCapabilities(AsebaVMState* vm)
+{
+	GetDescription().serialize(&toNode);
+	AsebaProcessIncomingEvents(vm);
+	std::auto_ptr<Message> description(Message::receive(&fromNode));
+	check(dynamic_cast<Description*>(description.get()) != 0, "description first");
+	while (!fromNode.data.empty())
+		check(dynamic_cast<Capabilities*>(std::auto_ptr<Message>(Message::receive(&fromNode)).get()) == 0, "capabilities not sent with the description");
+	GetCapabilities(nodeId).serialize(&toNode);
+	AsebaProcessIncomingEvents(vm);
+	std::auto_ptr<Message> capabilities(Message::receive(&fromNode));
+	check(dynamic_cast<Capabilities*>(capabilities.get()) != 0 && (static_cast<Capabilities*>(capabilities.get())->capabilities & ASEBA_CAPABILITY_VARIABLES_DELTA), "capabilities sent on request");
+}
+
+static void testSparseChanges(AsebaVMState* vm)
+{
+	Client client;
+	for (unsigned round = 0; round < 100; ++round)
+	{
+		for (unsigned i = 0; i < 5; ++i)
+			variables[rand() % variablesSize] = sint16(rand());
+		client.refresh(vm, 0, variablesSize);
+		check(client.matches(0, variablesSize), "sparse changes rebuilt");
+	}
+	check(client.keyFramesCount == 1, "only the first answer is a difference to zero");
+}
+
+static void testFullChanges(AsebaVMState* vm)
+{
+	// every variable changes, the answer does not fit in one message
+	Client client;
+	for (unsigned round = 0; round < 10; ++round)
+	{
+		for (unsigned i = 0; i < variablesSize; ++i)
+			variables[i] = sint16(rand() | 1);
+		const unsigned messagesCount(client.messagesCount);
+		client.refresh(vm, 0, variablesSize);
+		check(client.matches(0, variablesSize), "full changes rebuilt");
+		check(client.messagesCount - messagesCount > 1, "full changes split in several messages");
+	}
+}
+
+static void testRanges(AsebaVMState* vm)
+{
+	// changing ranges, as when expanding variables in Studio
+	Client client;
+	for (unsigned round = 0; round < 100; ++round)
+	{
+		for (unsigned i = 0; i < 20; ++i)
+			variables[rand() % variablesSize] = sint16(rand());
+		const uint16 start(rand() % variablesSize);
+		const uint16 length(rand() % (variablesSize - start + 1));
+		client.refresh(vm, start, length);
+		check(client.matches(start, length), "range rebuilt");
+	}
+	check(client.keyFramesCount == 1, "ranges keep the same snapshot");
+}
+
+static void testLoss(AsebaVMState* vm)
+{
+	Client client;
+	for (unsigned i = 0; i < variablesSize; ++i)
+		variables[i] = sint16(rand());
+	client.refresh(vm, 0, variablesSize);
+
+	// a lost message makes the client start over from zero
+	for (unsigned i = 0; i < variablesSize; ++i)
+		variables[i] = sint16(rand());
+	client.refresh(vm, 0, variablesSize, 1);
+	check(client.version == 0, "lost message detected");
+	client.refresh(vm, 0, variablesSize);
+	check(client.matches(0, variablesSize) && client.keyFramesCount == 2, "recovered from loss");
+}
+
+int main(int argc, char* argv[])
+{
+	srand(0);
+
+	AsebaVMState vm;
+	std::vector<uint16> bytecode(64);
+	std::vector<sint16> stack(32);
+	memset(&vm, 0, sizeof(vm));
+	vm.nodeId = nodeId;
+	vm.bytecode = &bytecode[0];
+	vm.bytecodeSize = bytecode.size();
+	vm.stack = &stack[0];
+	vm.stackSize = stack.size();
+	vm.variables = variables;
+	vm.variablesSize = variablesSize;
+	AsebaVMInit(&vm);
+
+	snapshot.variables = snapshotVariables;
+	AsebaEnableVariablesDelta(&snapshot, 1);
+
+	testCapabilities(&vm);
+	testSparseChanges(&vm);
+	testFullChanges(&vm);
+	testRanges(&vm);
+	testLoss(&vm);
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
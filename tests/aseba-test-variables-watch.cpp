@@ -0,0 +1,335 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Aseba
+#include "../common/consts.h"
+#include "../common/msg/msg.h"
+#include "../common/msg/watches-manager.h"
+#include "vm-buffer-test-glue.h"
+
+// C++
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+#include <string.h>
+
+// Check that vm-buffer only sends watched variables when they change, and that
+// WatchesManager merges the watches of clients and handles them for nodes that do not
+
+using namespace Aseba;
+
+static const uint16 nodeId(1);
+static const uint16 variablesSize(100);
+static sint16 variables[variablesSize];
+static AsebaVariablesWatch watches[2];
+
+static MemoryStream toNode;
+static MemoryStream fromNode;
+
+// glue
+
+static MemoryStream& streamToNode(AsebaVMState *vm) { return toNode; }
+static MemoryStream& streamFromNode(AsebaVMState *vm) { return fromNode; }
+
+// node
+
+//! Send a watch request to the node
+static void watch(AsebaVMState* vm, uint16 start, uint16 length, uint16 period)
+{
+	WatchVariables(nodeId, start, length, period).serialize(&toNode);
+	AsebaProcessIncomingEvents(vm);
+}
+
+//! Return the number of variables messages sent by the node after time passed, checking that they match the variables
+static unsigned step(AsebaVMState* vm, uint16 elapsed)
+{
+	AsebaVariablesWatchesStep(vm, elapsed);
+	unsigned count(0);
+	while (!fromNode.data.empty())
+	{
+		std::auto_ptr<Message> message(Message::receive(&fromNode));
+		const Variables* received(dynamic_cast<Variables*>(message.get()));
+		check(received != 0, "variables sent");
+		if (!received)
+			continue;
+		check(std::equal(received->variables.begin(), received->variables.end(), variables + received->start), "variables sent match");
+		++count;
+	}
+	return count;
+}
+
+static void testCapabilities(AsebaVMState* vm)
+{
+	GetDescription().serialize(&toNode);
+	AsebaProcessIncomingEvents(vm);
+	bool capabilitiesSent(false);
+	while (!fromNode.data.empty())
+	{
+		std::auto_ptr<Message> message(Message::receive(&fromNode));
+		capabilitiesSent = capabilitiesSent || dynamic_cast<Capabilities*>(message.get()) != 0;
+	}
+	check(!capabilitiesSent, "capabilities not sent with the description");
+
+	GetCapabilities(nodeId).serialize(&toNode);
+	AsebaProcessIncomingEvents(vm);
+	std::auto_ptr<Message> capabilities(Message::receive(&fromNode));
+	const Capabilities* received(dynamic_cast<Capabilities*>(capabilities.get()));
+	check(received != 0 && received->capabilities == ASEBA_CAPABILITY_WATCH_VARIABLES, "capabilities sent on request");
+	check(fromNode.data.empty(), "nothing else sent");
+}
+
+static void testChanges(AsebaVMState* vm)
+{
+	watch(vm, 10, 5, 100);
+	check(step(vm, 0) == 1, "values sent when watched");
+	check(step(vm, 50) == 0 && step(vm, 100) == 0, "unchanged values not sent");
+	variables[12] = 1;
+	check(step(vm, 0) == 1, "changed values sent");
+	variables[12] = 2;
+	check(step(vm, 50) == 0, "changes wait for the period");
+	check(step(vm, 50) == 1, "changes sent after the period");
+	variables[20] = 1;
+	check(step(vm, 200) == 0, "changes outside the range not sent");
+}
+
+static void testSharing(AsebaVMState* vm)
+{
+	// a second client asks the same range faster, the watch is shared
+	watch(vm, 10, 5, 20);
+	check(step(vm, 200) == 1, "renewed watch sends the values");
+	watch(vm, 30, 5, 100);
+	check(step(vm, 0) == 1, "second range watched");
+	watch(vm, 50, 5, 100);
+	check(step(vm, 0) == 0, "third range ignored when all watches are used");
+	variables[12] = 3;
+	check(step(vm, 20) == 1, "faster period adopted");
+	variables[12] = 4;
+	variables[32] = 4;
+	check(step(vm, 100) == 2, "both ranges sent");
+}
+
+static void testLease(AsebaVMState* vm)
+{
+	check(step(vm, ASEBA_VARIABLES_WATCH_LEASE - 200) == 0, "nothing changed before the lease ends");
+	variables[12] = 5;
+	check(step(vm, 200) == 0, "watch expired");
+	watch(vm, 50, 5, 100);
+	check(step(vm, 0) == 1, "expired watch freed");
+}
+
+// switch
+
+//! Proxy that keeps the messages it sends
+class Proxy: public WatchesManager
+{
+public:
+	MemoryStream sent;
+
+	Proxy() : WatchesManager(true) {}
+
+	//! Return the next message sent, 0 if none
+	Message* next()
+	{
+		if (sent.data.empty())
+			return 0;
+		return Message::receive(&sent);
+	}
+
+protected:
+	virtual void sendWatchMessage(Message& message)
+	{
+		message.serialize(&sent);
+	}
+};
+
+//! Return a variables message as sent by a node
+static Variables* makeVariables(uint16 source, uint16 start, sint16 first, size_t count)
+{
+	Variables* variables(new Variables);
+	variables->source = source;
+	variables->start = start;
+	for (size_t i = 0; i < count; ++i)
+		variables->variables.push_back(first + sint16(i));
+	return variables;
+}
+
+//! Have proxy see the description of nodeId, and the answer to the request for capabilities of the switch
+static void describe(Proxy& proxy, uint16 nodeId, uint16 capabilities)
+{
+	Description description;
+	description.source = nodeId;
+	proxy.processMessage(&description);
+	Capabilities nodeCapabilities;
+	nodeCapabilities.source = nodeId;
+	nodeCapabilities.capabilities = capabilities;
+	proxy.processMessage(&nodeCapabilities);
+}
+
+static void testProxyCapabilities()
+{
+	Proxy proxy;
+
+	// node 1 has no capabilities, the proxy advertises watches for it to the client that asks
+	Description description;
+	description.source = 1;
+	check(proxy.processMessage(&description), "description forwarded");
+	check(proxy.next() == 0, "capabilities requested by the switch, not the proxy");
+	GetCapabilities clientRequest(1);
+	check(proxy.processMessage(&clientRequest), "client request forwarded");
+	proxy.stepWatches();
+	check(proxy.next() == 0, "capabilities awaited");
+	UnifiedTime(600).sleep();
+	proxy.stepWatches();
+	std::auto_ptr<Message> synthesized(proxy.next());
+	const Capabilities* capabilities(dynamic_cast<Capabilities*>(synthesized.get()));
+	check(capabilities && capabilities->source == 1 && capabilities->capabilities == ASEBA_CAPABILITY_WATCH_VARIABLES, "capabilities added for the node");
+	check(!proxy.processMessage(&clientRequest), "later request answered by the proxy");
+	synthesized.reset(proxy.next());
+	check(dynamic_cast<Capabilities*>(synthesized.get()) != 0, "later request answered");
+
+	// node 2 has some, watches are added to them, but only sent to clients that asked
+	description.source = 2;
+	proxy.processMessage(&description);
+	Capabilities nodeCapabilities;
+	nodeCapabilities.source = 2;
+	nodeCapabilities.capabilities = ASEBA_CAPABILITY_VARIABLES_DELTA;
+	check(!proxy.processMessage(&nodeCapabilities), "answer to the proxy dropped");
+	clientRequest.dest = 2;
+	check(!proxy.processMessage(&clientRequest), "client request answered by the proxy");
+	std::auto_ptr<Message> answer(proxy.next());
+	capabilities = dynamic_cast<Capabilities*>(answer.get());
+	check(capabilities && capabilities->source == 2 && capabilities->capabilities == (ASEBA_CAPABILITY_VARIABLES_DELTA | ASEBA_CAPABILITY_WATCH_VARIABLES), "capabilities completed");
+
+	// a client asking before the node answered gets its completed answer
+	description.source = 3;
+	proxy.processMessage(&description);
+	clientRequest.dest = 3;
+	check(proxy.processMessage(&clientRequest), "early client request forwarded");
+	nodeCapabilities.source = 3;
+	nodeCapabilities.capabilities = ASEBA_CAPABILITY_VARIABLES_DELTA;
+	check(proxy.processMessage(&nodeCapabilities), "answer to the client forwarded");
+	check(nodeCapabilities.capabilities == (ASEBA_CAPABILITY_VARIABLES_DELTA | ASEBA_CAPABILITY_WATCH_VARIABLES), "forwarded capabilities completed");
+	check(proxy.next() == 0, "no capabilities added");
+}
+
+static void testProxyPolling()
+{
+	Proxy proxy;
+	describe(proxy, 1, ASEBA_CAPABILITY_VARIABLES_DELTA);
+
+	// two clients watch the same range, the node is polled once
+	WatchVariables request(1, 10, 3, 0);
+	check(!proxy.processMessage(&request), "watch handled by the proxy");
+	check(!proxy.processMessage(&request), "second watch handled by the proxy");
+	proxy.stepWatches();
+	std::auto_ptr<Message> sent(proxy.next());
+	check(proxy.next() == 0, "one poll for both watches");
+	const GetVariables* poll(dynamic_cast<GetVariables*>(sent.get()));
+	check(poll && poll->dest == 1 && poll->start == 10 && poll->length == 3, "node polled");
+
+	std::auto_ptr<Variables> answer(makeVariables(1, 10, 7, 3));
+	check(proxy.processMessage(answer.get()), "first answer forwarded");
+	const WatchesManager::VariablesDataVector* cached(proxy.getWatchedValues(1, 10, 3));
+	check(cached && *cached == answer->variables, "values cached");
+
+	proxy.stepWatches();
+	delete proxy.next();
+	check(!proxy.processMessage(answer.get()), "unchanged answer dropped");
+	proxy.stepWatches();
+	delete proxy.next();
+	answer.reset(makeVariables(1, 10, 8, 3));
+	check(proxy.processMessage(answer.get()), "changed answer forwarded");
+
+	// the answer to a client is never dropped
+	GetVariables clientRequest(1, 10, 3);
+	check(proxy.processMessage(&clientRequest), "client request forwarded");
+	proxy.stepWatches();
+	delete proxy.next();
+	check(proxy.processMessage(answer.get()), "answer to client forwarded");
+
+	// a client joining gets the cached values
+	check(!proxy.processMessage(&request), "renewal handled by the proxy");
+	std::auto_ptr<Message> resent(proxy.next());
+	const Variables* values(dynamic_cast<Variables*>(resent.get()));
+	check(values && values->source == 1 && values->start == 10 && values->variables == answer->variables, "cached values sent");
+
+	Disconnected disconnected;
+	disconnected.source = 1;
+	proxy.processMessage(&disconnected);
+	check(proxy.getWatchedValues(1, 10, 3) == 0, "watches of disconnected node removed");
+}
+
+static void testProxyForwarding()
+{
+	Proxy proxy;
+	describe(proxy, 2, ASEBA_CAPABILITY_WATCH_VARIABLES);
+
+	// the node watches itself, the proxy only renews its own watch
+	WatchVariables request(2, 0, 4, 50);
+	proxy.processMessage(&request);
+	WatchVariables fasterRequest(2, 0, 4, 20);
+	proxy.processMessage(&fasterRequest);
+	proxy.stepWatches();
+	std::auto_ptr<Message> sent(proxy.next());
+	const WatchVariables* forwarded(dynamic_cast<WatchVariables*>(sent.get()));
+	check(forwarded && forwarded->dest == 2 && forwarded->length == 4 && forwarded->period == 20, "fastest watch forwarded to the node");
+	proxy.stepWatches();
+	check(proxy.next() == 0, "watch not renewed before half its lease");
+
+	std::auto_ptr<Variables> pushed(makeVariables(2, 0, 1, 4));
+	check(proxy.processMessage(pushed.get()), "pushed values forwarded");
+	check(proxy.processMessage(pushed.get()), "pushed values always forwarded");
+}
+
+int main(int argc, char* argv[])
+{
+	AsebaVMState vm;
+	std::vector<uint16> bytecode(64);
+	std::vector<sint16> stack(32);
+	memset(&vm, 0, sizeof(vm));
+	vm.nodeId = nodeId;
+	vm.bytecode = &bytecode[0];
+	vm.bytecodeSize = bytecode.size();
+	vm.stack = &stack[0];
+	vm.stackSize = stack.size();
+	vm.variables = variables;
+	vm.variablesSize = variablesSize;
+	AsebaVMInit(&vm);
+
+	AsebaEnableVariablesWatches(watches, 2);
+
+	testCapabilities(&vm);
+	testChanges(&vm);
+	testSharing(&vm);
+	testLease(&vm);
+
+	testProxyCapabilities();
+	testProxyPolling();
+	testProxyForwarding();
+
+	if (failuresCount)
+		return 1;
+	else
+		return 0;
+}
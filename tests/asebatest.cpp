@@ -2,6 +2,8 @@
 #include "../compiler/compiler.h"
 #include "../vm/vm.h"
 #include "../vm/natives.h"
+#include "../vm/natives-dsp.h"
+#include "../vm/natives-sort.h"
 #include "../common/consts.h"
 #include "../common/utils/utils.h"
 #include "../common/utils/FormatableString.h"
@@ -27,6 +29,8 @@ extern "C" bool AsebaExecutionErrorOccurred();
 static const AsebaNativeFunctionDescription* nativeFunctionsDescriptions[] =
 {
 	ASEBA_NATIVES_STD_DESCRIPTIONS,
+	ASEBA_NATIVES_DSP_DESCRIPTIONS,
+	ASEBA_NATIVES_SORT_DESCRIPTIONS,
 	0
 };
 
@@ -39,7 +43,7 @@ extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunction
 std::wstring read_source(const std::string& filename);
 void dump_source(const std::wstring& source);
 
-static const char short_options [] = "fcepnsdmi:";
+static const char short_options [] = "fcepnsdmi:rb";
 static const struct option long_options[] = { 
 	{ "fail",	no_argument,			NULL,	'f'},
 	{ "comp_fail",	no_argument,		NULL,	'c'},
@@ -51,6 +55,8 @@ static const struct option long_options[] = {
 	{ "memdump",	no_argument,		NULL,	'u'},
 	{ "memcmp", 	required_argument,	NULL,	'm'},
 	{ "steps", 		required_argument,	NULL,	'i'},
+	{ "recompile",	no_argument,		NULL,	'r'},
+	{ "batch",		no_argument,		NULL,	'b'},
 	{ 0, 0, 0, 0 } 
 };
 
@@ -67,7 +73,9 @@ static void usage (int argc, char** argv)
 			<< "    -d | --dump         Dump the compilation result (tokens, tree, bytecode)" << std::endl
 			<< "    -u | --memdump      Dump the memory content at the end of the execution" << std::endl
 			<< "    -m | --memcmp file  Compare result of the VM execution with file" << std::endl
-			<< "    -i | --steps        Number of VM execution steps (default: " << DEFAULT_STEPS << ")" << std::endl;
+			<< "    -i | --steps        Number of VM execution steps (default: " << DEFAULT_STEPS << ")" << std::endl
+			<< "    -r | --recompile    Check that incremental recompilation gives the same bytecode" << std::endl
+			<< "    -b | --batch        Check that compilation in a parallel batch gives the same bytecode" << std::endl;
 }
 
 
@@ -100,6 +108,7 @@ struct AsebaNode
 		vm.variables = reinterpret_cast<sint16 *>(&variables);
 		vm.variablesSize = sizeof(variables) / sizeof(sint16);
 		
+		AsebaVMSetRandomSeed(&vm, 0);
 		AsebaVMInit(&vm);
 		
 		// fill description accordingly
@@ -209,6 +218,8 @@ int main(int argc, char** argv)
 	bool memDump = false;
 	bool memCmp = false;
 	int stepCount = DEFAULT_STEPS;
+	bool recompile = false;
+	bool batch = false;
 	std::string memCmpFileName;
 	
 	std::locale::global(std::locale(""));
@@ -262,6 +273,12 @@ int main(int argc, char** argv)
 			case 'i':
 				stepCount = atoi(optarg);
 				break;
+			case 'r':
+				recompile = true;
+				break;
+			case 'b':
+				batch = true;
+				break;
 			default:
 				usage(argc, argv);
 				exit(EXIT_FAILURE);
@@ -318,6 +335,59 @@ int main(int argc, char** argv)
 	
 	checkForError("Compilation", should_compilation_fail, (outError.message != L"not defined"), outError.toWString());
 	
+	// recompile the source moved by one line, reusing the code of event handlers and
+	// subroutines, and compare with a compilation of the moved source from scratch
+	if (recompile)
+	{
+		const std::wstring movedSource(L"\n" + wSource);
+		Compiler incrementalCompiler;
+		incrementalCompiler.setTargetDescription(node.getTargetDescription());
+		incrementalCompiler.setCommonDefinitions(&definitions);
+		incrementalCompiler.setIncremental(true);
+		Compiler referenceCompiler;
+		referenceCompiler.setTargetDescription(node.getTargetDescription());
+		referenceCompiler.setCommonDefinitions(&definitions);
+		referenceCompiler.setIncremental(false);
+		
+		BytecodeVector incrementalBytecode;
+		BytecodeVector referenceBytecode;
+		std::wistringstream firstIs(wSource);
+		std::wistringstream secondIs(movedSource);
+		std::wistringstream referenceIs(movedSource);
+		bool success = incrementalCompiler.compile(firstIs, incrementalBytecode, varCount, outError);
+		success = success && incrementalCompiler.compile(secondIs, incrementalBytecode, varCount, outError);
+		success = success && referenceCompiler.compile(referenceIs, referenceBytecode, varCount, outError);
+		checkForError("Recompilation", false, !success, outError.toWString());
+		
+		bool same = incrementalBytecode.size() == referenceBytecode.size();
+		for (size_t i = 0; same && i < referenceBytecode.size(); ++i)
+			same = incrementalBytecode[i].bytecode == referenceBytecode[i].bytecode && incrementalBytecode[i].line == referenceBytecode[i].line;
+		checkForError("Recompilation comparison", false, !same, L"incremental recompilation differs from compilation from scratch");
+	}
+	
+	// compile the source several times in a batch, with identical programs compiled once,
+	// and compare with the compilation above
+	if (batch)
+	{
+		const CommonDefinitions sameDefinitions(definitions);
+		BatchCompiler::Programs programs;
+		programs.push_back(BatchCompiler::Program(wSource, node.getTargetDescription(), &definitions));
+		programs.push_back(BatchCompiler::Program(L"\n" + wSource, node.getTargetDescription(), &definitions));
+		programs.push_back(BatchCompiler::Program(wSource, node.getTargetDescription(), &sameDefinitions));
+		programs.push_back(BatchCompiler::Program(wSource, node.getTargetDescription(), &definitions));
+		const BatchCompiler::Results results(BatchCompiler(2).compile(programs));
+		
+		bool same = results.size() == programs.size();
+		for (size_t i = 0; same && i < results.size(); ++i)
+		{
+			const BatchCompiler::Result& result(results[i]);
+			same = result.success && result.bytecode.size() == bytecode.size() && result.allocatedVariablesCount == varCount;
+			for (size_t j = 0; same && j < bytecode.size(); ++j)
+				same = result.bytecode[j].bytecode == bytecode[j].bytecode;
+		}
+		checkForError("Batch compilation", false, !same, L"batch compilation differs from single compilation");
+	}
+	
 	// run
 	if (!node.loadBytecode(bytecode))
 	{
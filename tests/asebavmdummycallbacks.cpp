@@ -22,6 +22,8 @@
 #include "../transport/buffer/vm-buffer.h"
 #include "../vm/vm.h"
 #include "../vm/natives.h"
+#include "../vm/natives-dsp.h"
+#include "../vm/natives-sort.h"
 #include "../common/consts.h"
 
 // C++
@@ -79,6 +81,8 @@ extern "C" void AsebaPutVmToSleep(AsebaVMState *vm)
 static AsebaNativeFunctionPointer nativeFunctions[] =
 {
 	ASEBA_NATIVES_STD_FUNCTIONS,
+	ASEBA_NATIVES_DSP_FUNCTIONS,
+	ASEBA_NATIVES_SORT_FUNCTIONS
 };
 
 extern "C" void AsebaNativeFunction(AsebaVMState *vm, uint16 id)
@@ -0,0 +1,87 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_TEST_HELPERS_H
+#define ASEBA_TEST_HELPERS_H
+
+// Aseba
+#include "../common/types.h"
+
+// Dashel
+#include <dashel/dashel.h>
+
+// C++
+#include <iostream>
+#include <deque>
+#include <algorithm>
+
+// C
+#include <stdlib.h>
+
+// Helpers shared by the tests, notably those that exchange messages in memory
+
+//! Stream reading and writing to memory
+class MemoryStream: public Dashel::Stream
+{
+public:
+	std::deque<uint8> data;
+
+	MemoryStream() : Stream("memory") {}
+	virtual void write(const void *data, const size_t size)
+	{
+		const uint8* ptr(reinterpret_cast<const uint8*>(data));
+		this->data.insert(this->data.end(), ptr, ptr + size);
+	}
+	virtual void flush() {}
+	virtual void read(void *data, size_t size)
+	{
+		if (size > this->data.size())
+			abort();
+		std::copy(this->data.begin(), this->data.begin() + size, reinterpret_cast<uint8*>(data));
+		this->data.erase(this->data.begin(), this->data.begin() + size);
+	}
+};
+
+//! Stream reading from a memory stream and writing to another, one end of a loopback
+class LoopbackStream: public Dashel::Stream
+{
+public:
+	MemoryStream& in;
+	MemoryStream& out;
+
+	LoopbackStream(MemoryStream& in, MemoryStream& out) : Stream("loopback"), in(in), out(out) {}
+	virtual void write(const void *data, const size_t size) { out.write(data, size); }
+	virtual void flush() {}
+	virtual void read(void *data, size_t size) { in.read(data, size); }
+};
+
+static unsigned failuresCount(0);
+
+//! Report a failure if condition is false
+static void check(bool condition, const char* what)
+{
+	if (!condition)
+	{
+		std::cerr << "failure: " << what << std::endl;
+		++failuresCount;
+	}
+}
+
+#endif // ASEBA_TEST_HELPERS_H
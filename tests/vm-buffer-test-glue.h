@@ -0,0 +1,84 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_VM_BUFFER_TEST_GLUE_H
+#define ASEBA_VM_BUFFER_TEST_GLUE_H
+
+// Aseba
+#include "../transport/buffer/vm-buffer.h"
+#include "../vm/vm.h"
+#include "test-helpers.h"
+
+// Glue of vm-buffer for the tests that run nodes in memory: nodes send their messages
+// to streamFromNode(), and read theirs from streamToNode(), both defined by the test
+
+static MemoryStream& streamToNode(AsebaVMState *vm);
+static MemoryStream& streamFromNode(AsebaVMState *vm);
+
+//! Description of the nodes, a single array covering all their variables
+static AsebaVMDescription vmDescription = { "test", { { 0, "memory" }, { 0, 0 } } };
+static const AsebaLocalEventDescription localEvents[] = { { 0, 0 } };
+static const AsebaNativeFunctionDescription* nativeFunctions[] = { 0 };
+
+extern "C" void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 length)
+{
+	MemoryStream& fromNode(streamFromNode(vm));
+	uint16 temp;
+	temp = bswap16(uint16(length - 2));
+	fromNode.write(&temp, 2);
+	temp = bswap16(vm->nodeId);
+	fromNode.write(&temp, 2);
+	fromNode.write(data, length);
+}
+
+extern "C" uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* source)
+{
+	MemoryStream& toNode(streamToNode(vm));
+	if (toNode.data.empty())
+		return 0;
+	uint16 length, temp;
+	toNode.read(&length, 2);
+	length = bswap16(length) + 2;
+	toNode.read(&temp, 2);
+	*source = bswap16(temp);
+	toNode.read(data, length);
+	return length;
+}
+
+extern "C" const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm)
+{
+	vmDescription.variables[0].size = vm->variablesSize;
+	return &vmDescription;
+}
+extern "C" const AsebaLocalEventDescription * AsebaGetLocalEventsDescriptions(AsebaVMState *vm) { return localEvents; }
+extern "C" const AsebaNativeFunctionDescription * const * AsebaGetNativeFunctionsDescriptions(AsebaVMState *vm) { return nativeFunctions; }
+extern "C" void AsebaNativeFunction(AsebaVMState *vm, uint16 id) {}
+extern "C" void AsebaWriteBytecode(AsebaVMState *vm) {}
+extern "C" void AsebaResetIntoBootloader(AsebaVMState *vm) {}
+extern "C" void AsebaPutVmToSleep(AsebaVMState *vm) {}
+#ifdef ASEBA_ASSERT
+extern "C" void AsebaAssert(AsebaVMState *vm, AsebaAssertReason reason)
+{
+	std::cerr << "assert " << reason << std::endl;
+	++failuresCount;
+}
+#endif // ASEBA_ASSERT
+
+#endif // ASEBA_VM_BUFFER_TEST_GLUE_H
@@ -27,6 +27,21 @@
 static unsigned char buffer[ASEBA_MAX_INNER_PACKET_SIZE];
 static unsigned buffer_pos;
 
+#ifdef ASEBA_LIMITED_MESSAGE_SIZE
+#define VARIABLES_DELTA_MAX_SIZE (100 - 4)
+#else
+#define VARIABLES_DELTA_MAX_SIZE ASEBA_MAX_INNER_PACKET_SIZE
+#endif
+
+static AsebaVariablesSnapshot* variables_snapshots;
+static uint16 variables_snapshots_count;
+static uint16 variables_snapshots_clock;
+
+static AsebaVariablesWatch* variables_watches;
+static uint16 variables_watches_count;
+
+static uint16 bytecode_checksum_enabled;
+
 static void buffer_add(const uint8* data, const uint16 len)
 {
 	uint16 i = 0;
@@ -69,18 +84,33 @@ static void buffer_add_string(const char* s)
 
 /* implementation of vm hooks */
 
-void AsebaSendMessage(AsebaVMState *vm, uint16 type, const void *data, uint16 size)
+/* send a header of one or two words followed by a payload sent as is,
+   without copying the payload if the transport layer can gather */
+static void send_header_and_payload(AsebaVMState *vm, const uint16* header, uint16 headerCount, const uint8* payload, uint16 payloadSize)
 {
 	uint16 i;
-
+#ifndef DISABLE_WEAK_CALLBACKS
+	if (AsebaSendBufferGather)
+	{
+		uint16 temp[2];
+		for (i = 0; i < headerCount; i++)
+			temp[i] = bswap16(header[i]);
+		AsebaSendBufferGather(vm, (const uint8*)temp, headerCount * 2, payload, payloadSize);
+		return;
+	}
+#endif // DISABLE_WEAK_CALLBACKS
 	buffer_pos = 0;
-	buffer_add_uint16(type);
-	for (i = 0; i < size; i++)
-		buffer_add_uint8(((const unsigned char*)data)[i]);
-
+	for (i = 0; i < headerCount; i++)
+		buffer_add_uint16(header[i]);
+	buffer_add(payload, payloadSize);
 	AsebaSendBuffer(vm, buffer, buffer_pos);
 }
 
+void AsebaSendMessage(AsebaVMState *vm, uint16 type, const void *data, uint16 size)
+{
+	send_header_and_payload(vm, &type, 1, (const uint8*)data, size);
+}
+
 #ifdef __BIG_ENDIAN__
 void AsebaSendMessageWords(AsebaVMState *vm, uint16 type, const uint16* data, uint16 count)
 {
@@ -97,8 +127,15 @@ void AsebaSendMessageWords(AsebaVMState *vm, uint16 type, const uint16* data, ui
 
 void AsebaSendVariables(AsebaVMState *vm, uint16 start, uint16 length)
 {
-	uint16 i;
 #ifndef ASEBA_LIMITED_MESSAGE_SIZE  //This is usefull with device that cannot send big packets like Thymio Wireless module.
+#ifndef __BIG_ENDIAN__
+	// variables are already in the byte order of the network, send them from where they are
+	uint16 header[2];
+	header[0] = ASEBA_MESSAGE_VARIABLES;
+	header[1] = start;
+	send_header_and_payload(vm, header, 2, (const uint8*)(vm->variables + start), length * 2);
+#else
+	uint16 i;
 	buffer_pos = 0;
 	buffer_add_uint16(ASEBA_MESSAGE_VARIABLES);
 	buffer_add_uint16(start);
@@ -106,7 +143,9 @@ void AsebaSendVariables(AsebaVMState *vm, uint16 start, uint16 length)
 		buffer_add_uint16(vm->variables[i]);
 
 	AsebaSendBuffer(vm, buffer, buffer_pos);
+#endif
 #else
+	uint16 i;
 	const uint16 MAX_VARIABLES_SIZE = ((100 - 6)/2);
 	do {
 		uint16 size;
@@ -128,6 +167,235 @@ void AsebaSendVariables(AsebaVMState *vm, uint16 start, uint16 length)
 #endif
 }
 
+void AsebaEnableVariablesDelta(AsebaVariablesSnapshot* snapshots, uint16 count)
+{
+	uint16 i;
+	for (i = 0; i < count; i++)
+		snapshots[i].vm = 0;
+	variables_snapshots = snapshots;
+	variables_snapshots_count = count;
+}
+
+/* return the snapshot of a VM, taking a free or the oldest one if it has none */
+static AsebaVariablesSnapshot* get_variables_snapshot(AsebaVMState *vm)
+{
+	AsebaVariablesSnapshot* snapshot = 0;
+	uint16 i;
+	
+	variables_snapshots_clock++;
+	for (i = 0; i < variables_snapshots_count; i++)
+	{
+		if (variables_snapshots[i].vm == vm)
+		{
+			variables_snapshots[i].lastUse = variables_snapshots_clock;
+			return &variables_snapshots[i];
+		}
+	}
+	for (i = 0; i < variables_snapshots_count; i++)
+	{
+		if (!variables_snapshots[i].vm)
+		{
+			snapshot = &variables_snapshots[i];
+			break;
+		}
+		if (!snapshot || (uint16)(variables_snapshots_clock - variables_snapshots[i].lastUse) > (uint16)(variables_snapshots_clock - snapshot->lastUse))
+			snapshot = &variables_snapshots[i];
+	}
+	snapshot->vm = vm;
+	snapshot->version = 0;
+	snapshot->lastUse = variables_snapshots_clock;
+	return snapshot;
+}
+
+/* send the variables from start to start + length as runs of values xored with the snapshot of vm,
+   in as many messages as needed, each one being a difference to the previous one */
+static void send_variables_delta(AsebaVMState *vm, uint16 start, uint16 length, uint16 baseVersion)
+{
+	AsebaVariablesSnapshot* snapshot = get_variables_snapshot(vm);
+	const uint16 end = start + length;
+	uint16 pos = start;
+	
+	if (baseVersion == 0 || baseVersion != snapshot->version)
+	{
+		// the client does not have our snapshot, send the variables as a difference to zero
+		memset(snapshot->variables, 0, vm->variablesSize * sizeof(sint16));
+		baseVersion = 0;
+	}
+	
+	do
+	{
+		const uint16 messageStart = pos;
+		uint16 version = snapshot->version + 1;
+		uint16 runStart = pos;
+		unsigned lengthPos;
+		uint16 temp;
+		
+		if (version == 0)
+			version = 1;
+		
+		buffer_pos = 0;
+		buffer_add_uint16(ASEBA_MESSAGE_VARIABLES_DELTA);
+		buffer_add_uint16(ASEBA_DEST_DEBUG);
+		buffer_add_uint16(messageStart);
+		lengthPos = buffer_pos;
+		buffer_add_uint16(0);
+		buffer_add_uint16(baseVersion);
+		buffer_add_uint16(version);
+		
+		while (pos < end)
+		{
+			uint16 count = 0;
+			uint16 room;
+			uint16 i;
+			
+			// unchanged variables are skipped
+			while (pos < end && vm->variables[pos] == snapshot->variables[pos])
+				pos++;
+			if (pos == end)
+				break;
+			
+			// a run needs its skip and count, and at least one value
+			if (buffer_pos + 6 > VARIABLES_DELTA_MAX_SIZE)
+				break;
+			room = (VARIABLES_DELTA_MAX_SIZE - buffer_pos - 4) / 2;
+			
+			// a single unchanged variable is cheaper inside the run than as the skip of a new one
+			while (pos + count < end && count < room)
+			{
+				if (vm->variables[pos + count] != snapshot->variables[pos + count])
+					count++;
+				else if (pos + count + 1 < end && count + 1 < room && vm->variables[pos + count + 1] != snapshot->variables[pos + count + 1])
+					count += 2;
+				else
+					break;
+			}
+			
+			buffer_add_uint16(pos - runStart);
+			buffer_add_uint16(count);
+			for (i = 0; i < count; i++, pos++)
+			{
+				buffer_add_uint16((uint16)vm->variables[pos] ^ (uint16)snapshot->variables[pos]);
+				snapshot->variables[pos] = vm->variables[pos];
+			}
+			runStart = pos;
+		}
+		
+		// the message covers the variables up to where it stopped
+		temp = bswap16(pos - messageStart);
+		memcpy(buffer + lengthPos, &temp, 2);
+		snapshot->version = version;
+		baseVersion = version;
+		
+		AsebaSendBuffer(vm, buffer, buffer_pos);
+	} while (pos < end);
+}
+
+void AsebaEnableVariablesWatches(AsebaVariablesWatch* watches, uint16 count)
+{
+	uint16 i;
+	for (i = 0; i < count; i++)
+		watches[i].vm = 0;
+	variables_watches = watches;
+	variables_watches_count = count;
+}
+
+/* add or renew the watch of a range of variables; the fastest period wins,
+   a slower one is only adopted once the faster requester stopped renewing */
+static void watch_variables(AsebaVMState *vm, uint16 start, uint16 length, uint16 period)
+{
+	AsebaVariablesWatch* watch = 0;
+	uint16 i;
+	
+	for (i = 0; i < variables_watches_count; i++)
+	{
+		AsebaVariablesWatch* w = &variables_watches[i];
+		if (w->vm == vm && w->start == start && w->length == length)
+		{
+			if (period < w->period || w->lease < ASEBA_VARIABLES_WATCH_LEASE / 2)
+				w->period = period;
+			w->lease = ASEBA_VARIABLES_WATCH_LEASE;
+			// resend even if unchanged, the request may come from a new client
+			w->pending = 1;
+			return;
+		}
+		if (!w->vm && !watch)
+			watch = w;
+	}
+	// all watches are used, the request is ignored
+	if (!watch)
+		return;
+	watch->vm = vm;
+	watch->start = start;
+	watch->length = length;
+	watch->period = period;
+	watch->lease = ASEBA_VARIABLES_WATCH_LEASE;
+	watch->elapsed = period;
+	watch->pending = 1;
+}
+
+/* position-dependent hash of a range of variables, to detect changes without keeping a copy */
+static uint32 hash_variables(AsebaVMState *vm, uint16 start, uint16 length)
+{
+	uint32 hash = 2166136261u;
+	uint16 i;
+	for (i = start; i < start + length; i++)
+		hash = (hash ^ (uint16)vm->variables[i]) * 16777619u;
+	return hash;
+}
+
+void AsebaVariablesWatchesStep(AsebaVMState *vm, uint16 elapsed)
+{
+	uint16 i;
+	for (i = 0; i < variables_watches_count; i++)
+	{
+		AsebaVariablesWatch* w = &variables_watches[i];
+		uint32 hash;
+		if (w->vm != vm)
+			continue;
+		if (w->lease <= elapsed)
+		{
+			w->vm = 0;
+			continue;
+		}
+		w->lease -= elapsed;
+		w->elapsed = (w->elapsed < 0xffff - elapsed) ? w->elapsed + elapsed : 0xffff;
+		if (w->elapsed < w->period)
+			continue;
+		// only hash once the period is over, so that a fast VM does not pay for it at every step
+		hash = hash_variables(vm, w->start, w->length);
+		if (!w->pending && hash == w->hash)
+			continue;
+		AsebaSendVariables(vm, w->start, w->length);
+		w->hash = hash;
+		w->pending = 0;
+		w->elapsed = 0;
+	}
+}
+
+void AsebaEnableBytecodeChecksum(void)
+{
+	bytecode_checksum_enabled = 1;
+}
+
+/* XModem CRC (x^16 + x^12 + x^5 + 1) of a range of bytecode, each word taken low byte first */
+static uint16 crc_bytecode(AsebaVMState *vm, uint16 start, uint16 length)
+{
+	uint16 crc = 0;
+	uint16 i;
+	for (i = start; i < start + length; i++)
+	{
+		uint16 b;
+		for (b = 0; b < 2; b++)
+		{
+			uint16 j;
+			crc ^= (b ? (vm->bytecode[i] & 0xff00) : (vm->bytecode[i] << 8));
+			for (j = 0; j < 8; j++)
+				crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
 void AsebaSendDescription(AsebaVMState *vm)
 {
 	const AsebaVMDescription *vmDescription = AsebaGetVMDescription(vm);
@@ -248,6 +516,71 @@ void AsebaProcessIncomingEvents(AsebaVMState *vm)
 				AsebaVMSetupEvent(vm, type);
 			}
 		}
+		else if (type == ASEBA_MESSAGE_GET_VARIABLES_DELTA && variables_snapshots_count)
+		{
+			// answered here and not by the VM, which does not know the snapshot
+			if (payloadSize >= 4 && bswap16(payload[0]) == vm->nodeId)
+			{
+				uint16 start = bswap16(payload[1]);
+				uint16 length = bswap16(payload[2]);
+				if (start + length <= vm->variablesSize)
+					send_variables_delta(vm, start, length, bswap16(payload[3]));
+				#ifdef ASEBA_ASSERT
+				else
+					AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_VARIABLES_BOUNDS);
+				#endif
+			}
+		}
+		else if (type == ASEBA_MESSAGE_WATCH_VARIABLES && variables_watches_count)
+		{
+			if (payloadSize >= 4 && bswap16(payload[0]) == vm->nodeId)
+			{
+				uint16 start = bswap16(payload[1]);
+				uint16 length = bswap16(payload[2]);
+				if (start + length <= vm->variablesSize)
+					watch_variables(vm, start, length, bswap16(payload[3]));
+				#ifdef ASEBA_ASSERT
+				else
+					AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_VARIABLES_BOUNDS);
+				#endif
+			}
+		}
+		else if (type == ASEBA_MESSAGE_GET_CAPABILITIES && (variables_snapshots_count || variables_watches_count || bytecode_checksum_enabled))
+		{
+			// only sent on request, so that older clients never receive it
+			if (payloadSize >= 1 && bswap16(payload[0]) == vm->nodeId)
+			{
+				buffer_pos = 0;
+				buffer_add_uint16(ASEBA_MESSAGE_CAPABILITIES);
+				buffer_add_uint16(
+					(variables_snapshots_count ? ASEBA_CAPABILITY_VARIABLES_DELTA : 0) |
+					(variables_watches_count ? ASEBA_CAPABILITY_WATCH_VARIABLES : 0) |
+					(bytecode_checksum_enabled ? ASEBA_CAPABILITY_BYTECODE_CHECKSUM : 0)
+				);
+				AsebaSendBuffer(vm, buffer, buffer_pos);
+			}
+		}
+		else if (type == ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM && bytecode_checksum_enabled)
+		{
+			if (payloadSize >= 3 && bswap16(payload[0]) == vm->nodeId)
+			{
+				uint16 start = bswap16(payload[1]);
+				uint16 length = bswap16(payload[2]);
+				if (start + length <= vm->bytecodeSize)
+				{
+					buffer_pos = 0;
+					buffer_add_uint16(ASEBA_MESSAGE_BYTECODE_CHECKSUM);
+					buffer_add_uint16(start);
+					buffer_add_uint16(length);
+					buffer_add_uint16(crc_bytecode(vm, start, length));
+					AsebaSendBuffer(vm, buffer, buffer_pos);
+				}
+				#ifdef ASEBA_ASSERT
+				else
+					AsebaAssert(vm, ASEBA_ASSERT_OUT_OF_BYTECODE_BOUNDS);
+				#endif
+			}
+		}
 		else
 		{
 			// debug message
@@ -39,11 +39,17 @@ extern "C" {
 	
 	This helper provides to the glue code:
 	* AsebaProcessIncomingEvents()
+	* AsebaEnableVariablesDelta(), optionally
+	* AsebaEnableVariablesWatches() and AsebaVariablesWatchesStep(), optionally
+	* AsebaEnableBytecodeChecksum(), optionally
 	
 	This helper requires from the lower level transport layer:
 	* AsebaSendBuffer()
 	* AsebaGetBuffer()
 	
+	and optionally uses, if the transport layer provides it:
+	* AsebaSendBufferGather()
+	
 	This helper requires from the glue code:
 	* AsebaGetVMDescription()
 	* AsebaGetNativeFunctionsDescriptions()
@@ -59,10 +65,58 @@ extern "C" {
 /*! Read messages and process messages from transport layer, if any */
 void AsebaProcessIncomingEvents(AsebaVMState *vm);
 
+/*! Copy of the variables of a VM as last sent to clients, to send them only what changed since.
+	All clients send their requests with source ASEBA_DEST_DEBUG and receive all answers, so there is one snapshot per VM and network:
+	clients asking in turn with different versions make each other receive all variables again. */
+typedef struct
+{
+	AsebaVMState *vm;	/*!< VM whose variables are copied, 0 if the snapshot is unused */
+	uint16 version;		/*!< version of the copy, as acknowledged by the client in its next request */
+	uint16 lastUse;		/*!< age of the snapshot, to reuse the oldest one when all are used */
+	sint16* variables;	/*!< copy of the variables, must have room for vm->variablesSize values */
+} AsebaVariablesSnapshot;
+
+/*! Answer ASEBA_MESSAGE_GET_VARIABLES_DELTA using the given snapshots, one per VM, and advertise it in answer to ASEBA_MESSAGE_GET_CAPABILITIES.
+	Snapshots must stay valid as long as the VMs run; when there are more VMs than snapshots, the oldest is reused.
+	This costs a copy of the variables per snapshot, so it is only worth it for slow links. */
+void AsebaEnableVariablesDelta(AsebaVariablesSnapshot* snapshots, uint16 count);
+
+/*! Range of variables that clients asked to receive when it changes */
+typedef struct
+{
+	AsebaVMState *vm;	/*!< VM whose variables are watched, 0 if the watch is unused */
+	uint16 start;		/*!< first watched variable */
+	uint16 length;		/*!< number of watched variables */
+	uint16 period;		/*!< minimum interval between two sends, in ms */
+	uint16 lease;		/*!< time left before the watch expires if it is not renewed, in ms */
+	uint16 elapsed;		/*!< time since the variables were last sent, in ms */
+	uint16 pending;		/*!< 1 if the variables must be sent even if they did not change */
+	uint32 hash;		/*!< hash of the variables last sent */
+} AsebaVariablesWatch;
+
+/*! Answer ASEBA_MESSAGE_WATCH_VARIABLES using the given watches, and advertise it in answer to ASEBA_MESSAGE_GET_CAPABILITIES.
+	Identical requests from several clients share a watch; when all watches are used, new requests are ignored.
+	Watches must stay valid as long as the VM runs, and AsebaVariablesWatchesStep() must be called regularly. */
+void AsebaEnableVariablesWatches(AsebaVariablesWatch* watches, uint16 count);
+
+/*! Send the watched variables of vm that changed and whose period is over, elapsed being the time in ms since the last call */
+void AsebaVariablesWatchesStep(AsebaVMState *vm, uint16 elapsed);
+
+/*! Answer ASEBA_MESSAGE_GET_BYTECODE_CHECKSUM, and advertise it in answer to ASEBA_MESSAGE_GET_CAPABILITIES, so that clients can verify their uploads */
+void AsebaEnableBytecodeChecksum(void);
+
 // functions this helper needs
 
 extern void AsebaSendBuffer(AsebaVMState *vm, const uint8* data, uint16 length);
 
+/*! Send a message made of a header followed by a payload, as AsebaSendBuffer() would send them once concatenated.
+	The payload points into the memory of the VM, such as vm->variables, so that the transport layer
+	can write both parts without copying them; it is only valid during the call.
+	Optional: if the transport layer does not implement it, the message is copied and sent by AsebaSendBuffer() */
+#ifndef DISABLE_WEAK_CALLBACKS
+extern void __attribute__((weak)) AsebaSendBufferGather(AsebaVMState *vm, const uint8* header, uint16 headerLength, const uint8* payload, uint16 payloadLength);
+#endif // DISABLE_WEAK_CALLBACKS
+
 extern uint16 AsebaGetBuffer(AsebaVMState *vm, uint8* data, uint16 maxLength, uint16* source);
 
 extern const AsebaVMDescription* AsebaGetVMDescription(AsebaVMState *vm);
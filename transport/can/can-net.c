@@ -34,34 +34,6 @@
 #define ASEBA_MIN(a, b) (((a) < (b)) ? (a) : (b))
 
 
-/*!	This contains the state of the CAN implementation of Aseba network */
-static struct AsebaCan
-{
-	// data
-	uint16 id; /*!< identifier of this node on CAN */
-	
-	// pointer to physical layer functions
-	AsebaCanSendFrameFP sendFrameFP;
-	AsebaCanIntVoidFP isFrameRoomFP;
-	AsebaCanVoidVoidFP receivedPacketDroppedFP;
-	AsebaCanVoidVoidFP sentPacketDroppedFP;
-	
-	// send buffer
-	CanFrame* sendQueue;
-	size_t sendQueueSize;
-	uint16 sendQueueInsertPos;
-	uint16 sendQueueConsumePos;
-	
-	// reception buffer
-	CanFrame* recvQueue;
-	size_t recvQueueSize;
-	uint16 recvQueueInsertPos;
-	uint16 recvQueueConsumePos;
-
-	uint16 volatile sendQueueLock;
-	
-} asebaCan;
-
 /** \addtogroup can */
 /*@{*/
 
@@ -75,352 +47,499 @@ uint16 AsebaCanGetMinMultipleOfHeight(uint16 v)
 }
 
 /*! Returned the number of used frames in the send queue*/
-static uint16 AsebaCanSendQueueGetUsedFrames()
+static uint16 AsebaCanSendQueueGetUsedFrames(AsebaCan* can)
 {
 	uint16 ipos, cpos;
-	ipos = asebaCan.sendQueueInsertPos;
-	cpos =  asebaCan.sendQueueConsumePos;
+	ipos = can->sendQueueInsertPos;
+	cpos =  can->sendQueueConsumePos;
 	
 	if (ipos >= cpos)
 		return ipos - cpos;
 	else
-		return asebaCan.sendQueueSize - cpos + ipos;
+		return can->sendQueueSize - cpos + ipos;
 }
 
 /*! Returned the number of free frames in the send queue */
-static uint16 AsebaCanSendQueueGetFreeFrames()
+static uint16 AsebaCanSendQueueGetFreeFrames(AsebaCan* can)
 {
-	return asebaCan.sendQueueSize - AsebaCanSendQueueGetUsedFrames();
+	return can->sendQueueSize - AsebaCanSendQueueGetUsedFrames(can);
 }
 
 /*! Insert a frame in the send queue, do not check for overwrite */
-static void AsebaCanSendQueueInsert(uint16 canid, const uint8 *data, size_t size)
+static void AsebaCanSendQueueInsert(AsebaCan* can, uint16 canid, const uint8 *data, size_t size)
 {
 	uint16 temp;
-	memcpy(asebaCan.sendQueue[asebaCan.sendQueueInsertPos].data, data, size);
-	asebaCan.sendQueue[asebaCan.sendQueueInsertPos].id = canid;
-	asebaCan.sendQueue[asebaCan.sendQueueInsertPos].len = size;
+	memcpy(can->sendQueue[can->sendQueueInsertPos].data, data, size);
+	can->sendQueue[can->sendQueueInsertPos].id = canid;
+	can->sendQueue[can->sendQueueInsertPos].len = size;
 
 	
-	temp = asebaCan.sendQueueInsertPos + 1;
-	if (temp >= asebaCan.sendQueueSize)
+	temp = can->sendQueueInsertPos + 1;
+	if (temp >= can->sendQueueSize)
 		temp = 0;
-	asebaCan.sendQueueInsertPos = temp;
+	can->sendQueueInsertPos = temp;
 }
 
 /*! Send frames in send queue to physical layer until it is full */
-static void AsebaCanSendQueueToPhysicalLayer()
+static void AsebaCanSendQueueToPhysicalLayer(AsebaCan* can)
 {
 	uint16 temp;
 	
-	while (asebaCan.isFrameRoomFP() && (asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos))
+	while (can->isFrameRoomFP(can) && (can->sendQueueConsumePos != can->sendQueueInsertPos))
 	{
-		asebaCan.sendQueueLock = 1;
-		if(!(asebaCan.isFrameRoomFP() && (asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos))) 
+		can->sendQueueLock = 1;
+		if(!(can->isFrameRoomFP(can) && (can->sendQueueConsumePos != can->sendQueueInsertPos))) 
 		{
-			asebaCan.sendQueueLock = 0;
+			can->sendQueueLock = 0;
 			continue;
 		}
 		
-		asebaCan.sendFrameFP(asebaCan.sendQueue + asebaCan.sendQueueConsumePos);
+		can->sendFrameFP(can, can->sendQueue + can->sendQueueConsumePos);
 		
-		temp = asebaCan.sendQueueConsumePos + 1;
-		if (temp >= asebaCan.sendQueueSize)
+		temp = can->sendQueueConsumePos + 1;
+		if (temp >= can->sendQueueSize)
 			temp = 0;
-		asebaCan.sendQueueConsumePos = temp; 
-		asebaCan.sendQueueLock = 0;
+		can->sendQueueConsumePos = temp; 
+		can->sendQueueLock = 0;
 	}
 
 }
 
 /*! Returned the maximum number of used frames in the reception queue*/
-static uint16 AsebaCanRecvQueueGetMaxUsedFrames()
+static uint16 AsebaCanRecvQueueGetMaxUsedFrames(AsebaCan* can)
 {
 	uint16 ipos, cpos;
-	ipos = asebaCan.recvQueueInsertPos;
-	cpos = asebaCan.recvQueueConsumePos;
+	ipos = can->recvQueueInsertPos;
+	cpos = can->recvQueueConsumePos;
 	if (ipos >= cpos)
 		return ipos - cpos;
 	else
-		return asebaCan.recvQueueSize - cpos + ipos;
+		return can->recvQueueSize - cpos + ipos;
 }
 
 /*! Returned the minimum number of free frames in the reception queue */
-static uint16 AsebaCanRecvQueueGetMinFreeFrames()
+static uint16 AsebaCanRecvQueueGetMinFreeFrames(AsebaCan* can)
 {
-	return asebaCan.recvQueueSize - AsebaCanRecvQueueGetMaxUsedFrames();
+	return can->recvQueueSize - AsebaCanRecvQueueGetMaxUsedFrames(can);
 }
 
 /*! Readjust the fifo pointers */
-static void AsebaCanRecvQueueGarbageCollect()
+static void AsebaCanRecvQueueGarbageCollect(AsebaCan* can)
 {
 	uint16 temp;
-	while (asebaCan.recvQueueConsumePos != asebaCan.recvQueueInsertPos)
+	while (can->recvQueueConsumePos != can->recvQueueInsertPos)
 	{
-		if (asebaCan.recvQueue[asebaCan.recvQueueConsumePos].used)
+		if (can->recvQueue[can->recvQueueConsumePos].used)
 			break;
 		
-		temp = asebaCan.recvQueueConsumePos + 1;
-		if (temp >= asebaCan.recvQueueSize)
+		temp = can->recvQueueConsumePos + 1;
+		if (temp >= can->recvQueueSize)
 			temp = 0;
-		asebaCan.recvQueueConsumePos = temp;
+		can->recvQueueConsumePos = temp;
 	}
 }
 
-/*! Free frames associated with an id in the reception queue */
-static void AsebaCanRecvQueueFreeFrames(uint16 id)
+/*! Give back the frames freed at the end of the reception queue, called on reception only.
+	Frames freed after a used one, such as the sentinel, are otherwise never reclaimed.
+	The frame at the consumption position is left to the garbage collection, which might be stepping past it */
+static void AsebaCanRecvQueueReclaimTail(AsebaCan* can)
+{
+	uint16 temp;
+	while (1)
+	{
+		temp = can->recvQueueInsertPos;
+		if (temp == can->recvQueueConsumePos)
+			break;
+		if (temp == 0)
+			temp = can->recvQueueSize;
+		temp--;
+		if (temp == can->recvQueueConsumePos || can->recvQueue[temp].used)
+			break;
+		can->recvQueueInsertPos = temp;
+	}
+}
+
+/*! Store a frame at the insertion position of the reception queue, do not check for overwrite, return its position */
+static uint16 AsebaCanRecvQueueInsert(AsebaCan* can, const CanFrame *frame)
+{
+	uint16 pos = can->recvQueueInsertPos;
+	uint16 temp;
+	memcpy(&can->recvQueue[pos], frame, sizeof(*frame));
+	can->recvQueue[pos].used = 1;
+	temp = pos + 1;
+	if (temp >= can->recvQueueSize)
+		temp = 0;
+	can->recvQueueInsertPos = temp;
+	return pos;
+}
+
+/*! Return the reassembly slot whose source field is key, 0 to find a free slot */
+static AsebaCanReassemblySlot* AsebaCanRecvFindSlot(AsebaCan* can, uint16 key)
 {
 	uint16 i;
-	
-	// for all used frames...
-	for (i = asebaCan.recvQueueConsumePos; i != asebaCan.recvQueueInsertPos;)
+	for (i = 0; i < ASEBA_CAN_MAX_REASSEMBLED_SOURCES; i++)
 	{
-		// if frame is of a specific id, mark frame as unused
-		if (CANID_TO_ID(asebaCan.recvQueue[i].id) == id)
-			asebaCan.recvQueue[i].used = 0;
-		
-		i++;
-		if (i >= asebaCan.recvQueueSize)
-			i = 0;
+		if (can->recvSlots[i].source == key)
+			return &can->recvSlots[i];
 	}
+	return 0;
 }
 
+/*! Free the frames of a partially received packet and its reassembly slot */
+static void AsebaCanRecvFreeSlot(AsebaCan* can, AsebaCanReassemblySlot* slot)
+{
+	uint16 i = slot->first;
+	while (1)
+	{
+		can->recvQueue[i].used = 0;
+		if (i == slot->last)
+			break;
+		i = can->recvQueueLinks[i];
+	}
+	slot->source = 0;
+	AsebaCanRecvQueueGarbageCollect(can);
+}
 
-void AsebaCanInit(uint16 id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidFP isFrameRoomFP, AsebaCanVoidVoidFP receivedPacketDroppedFP, AsebaCanVoidVoidFP sentPacketDroppedFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize)
+/*! Append a packet whose frames are linked from first to last to the list of completed packets */
+static void AsebaCanRecvPacketCompleted(AsebaCan* can, uint16 first, uint16 last)
 {
-	asebaCan.id = id;
+	can->recvQueueLinks[can->recvCompletedTail] = first;
+	can->recvCompletedTail = last;
+	// publish the packet only once it is linked
+	can->recvCompletedCount++;
+}
+
+/*! Reset the reception queue and its index */
+static void AsebaCanRecvResetQueue(AsebaCan* can)
+{
+	uint16 i;
+	for (i = 0; i < can->recvQueueSize; i++)
+		can->recvQueue[i].used = 0;
+	can->recvQueueInsertPos = 0;
+	can->recvQueueConsumePos = 0;
 	
-	asebaCan.sendFrameFP = sendFrameFP;
-	asebaCan.isFrameRoomFP= isFrameRoomFP;
-	asebaCan.receivedPacketDroppedFP = receivedPacketDroppedFP;
-	asebaCan.sentPacketDroppedFP = sentPacketDroppedFP;
+	for (i = 0; i < ASEBA_CAN_MAX_REASSEMBLED_SOURCES; i++)
+		can->recvSlots[i].source = 0;
+	can->recvCompletedTail = can->recvQueueSize;
+	can->recvSentinel = can->recvQueueSize;
+	can->recvCompletedCount = 0;
+	can->recvConsumedCount = 0;
+}
+
+void AsebaCanInstanceInit(AsebaCan* can, uint16 id, AsebaCanInstanceSendFrameFP sendFrameFP, AsebaCanInstanceIntFP isFrameRoomFP, AsebaCanInstanceVoidFP receivedPacketDroppedFP, AsebaCanInstanceVoidFP sentPacketDroppedFP, AsebaCanInstanceShouldDropFP shouldDropPacketFP, AsebaCanInstanceVoidFP idleFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize, void* userData)
+{
+	can->id = id;
+	can->userData = userData;
 	
-	asebaCan.sendQueue = sendQueue;
-	asebaCan.sendQueueSize = sendQueueSize;
-	asebaCan.sendQueueInsertPos = 0;
-	asebaCan.sendQueueConsumePos = 0;
+	can->sendFrameFP = sendFrameFP;
+	can->isFrameRoomFP= isFrameRoomFP;
+	can->receivedPacketDroppedFP = receivedPacketDroppedFP;
+	can->sentPacketDroppedFP = sentPacketDroppedFP;
+	can->shouldDropPacketFP = shouldDropPacketFP;
+	can->idleFP = idleFP;
 	
-	asebaCan.recvQueue = recvQueue;
-	asebaCan.recvQueueSize = recvQueueSize;
-	asebaCan.recvQueueInsertPos = 0;
-	asebaCan.recvQueueConsumePos = 0;
+	can->sendQueue = sendQueue;
+	can->sendQueueSize = sendQueueSize;
+	can->sendQueueInsertPos = 0;
+	can->sendQueueConsumePos = 0;
 	
-	asebaCan.sendQueueLock = 0;
+	// the end of recvQueue holds the reassembly links, one per remaining frame plus the initial sentinel
+	if (recvQueueSize * sizeof(CanFrame) > sizeof(uint16))
+		recvQueueSize = (recvQueueSize * sizeof(CanFrame) - sizeof(uint16)) / (sizeof(CanFrame) + sizeof(uint16));
+	else
+		recvQueueSize = 0;
+	can->recvQueue = recvQueue;
+	can->recvQueueSize = recvQueueSize;
+	can->recvQueueLinks = (uint16*)(recvQueue + recvQueueSize);
+	AsebaCanRecvResetQueue(can);
+	
+	can->sendQueueLock = 0;
 }
 
-uint16 AsebaCanSend(const uint8 *data, size_t size)
+uint16 AsebaCanInstanceSend(AsebaCan* can, const uint8 *data, size_t size)
 {
-	return AsebaCanSendSpecificSource(data, size, asebaCan.id);
+	return AsebaCanInstanceSendSpecificSource(can, data, size, can->id);
 }
 
-uint16 AsebaCanSendSpecificSource(const uint8 *data, size_t size, uint16 source)
+uint16 AsebaCanInstanceSendSpecificSource(AsebaCan* can, const uint8 *data, size_t size, uint16 source)
 {
 	// send everything we can to maximize the space in the buffer
-	AsebaCanSendQueueToPhysicalLayer();
+	AsebaCanSendQueueToPhysicalLayer(can);
 	
 	// check free space
 	uint16 frameRequired = AsebaCanGetMinMultipleOfHeight(size);
-	if (AsebaCanSendQueueGetFreeFrames() <= frameRequired)
+	if (AsebaCanSendQueueGetFreeFrames(can) <= frameRequired)
 	{
-		asebaCan.sentPacketDroppedFP();
+		can->sentPacketDroppedFP(can);
 		return 0;
 	}
 		
 	// insert
 	if (size <= 8)
 	{
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_SMALL_PACKET, source), data, size);
+		AsebaCanSendQueueInsert(can, TO_CANID(TYPE_SMALL_PACKET, source), data, size);
 	}
 	else
 	{
 		size_t pos = 8;
 		
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_START, source), data, 8);
+		AsebaCanSendQueueInsert(can, TO_CANID(TYPE_PACKET_START, source), data, 8);
 		while (pos + 8 < size)
 		{
-			AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_NORMAL, source), data + pos, 8);
+			AsebaCanSendQueueInsert(can, TO_CANID(TYPE_PACKET_NORMAL, source), data + pos, 8);
 			pos += 8;
 		}
-		AsebaCanSendQueueInsert(TO_CANID(TYPE_PACKET_STOP, source), data + pos, size - pos);
+		AsebaCanSendQueueInsert(can, TO_CANID(TYPE_PACKET_STOP, source), data + pos, size - pos);
 	}
 	
 	// send everything we can to minimize the transmission delay
-	AsebaCanSendQueueToPhysicalLayer();
+	AsebaCanSendQueueToPhysicalLayer(can);
 	
 	return 1;
 }
 
 
-uint16 AsebaCanRecvBufferEmpty(void) 
+uint16 AsebaCanInstanceRecvBufferEmpty(AsebaCan* can)
 {
-	return asebaCan.recvQueueInsertPos == asebaCan.recvQueueConsumePos;
+	// frames of partial packets and frames freed behind the sentinel may remain, only completed packets matter
+	return can->recvConsumedCount == can->recvCompletedCount;
 }
 
-void AsebaCanFrameSent()
+void AsebaCanInstanceFrameSent(AsebaCan* can)
 {
 	// send everything we can if we are currently not sending
-	if (!asebaCan.sendQueueLock)
-		AsebaCanSendQueueToPhysicalLayer();
+	if (!can->sendQueueLock)
+		AsebaCanSendQueueToPhysicalLayer(can);
 }
 
-void AsebaCanFlushQueue(void)
+void AsebaCanInstanceFlushQueue(AsebaCan* can)
 {
-	while(asebaCan.sendQueueConsumePos != asebaCan.sendQueueInsertPos || !asebaCan.isFrameRoomFP())
-		AsebaIdle();
+	while(can->sendQueueConsumePos != can->sendQueueInsertPos || !can->isFrameRoomFP(can))
+	{
+		if (can->idleFP)
+			can->idleFP(can);
+	}
 }
 
-uint16 AsebaCanRecv(uint8 *data, size_t size, uint16 *source)
+uint16 AsebaCanInstanceRecv(AsebaCan* can, uint8 *data, size_t size, uint16 *source)
 {
-	int stopPos = -1;
-	uint16 stopId;
 	uint16 pos = 0;
 	uint16 i;
 	
-	// first scan for "short packets" and "stops"
-	for (i = asebaCan.recvQueueConsumePos; i != asebaCan.recvQueueInsertPos; )
-	{
-		if(asebaCan.recvQueue[i].used) {
-			
-			if (CANID_TO_TYPE(asebaCan.recvQueue[i].id) == TYPE_SMALL_PACKET)
-			{
-				// copy data
-				uint16 len = ASEBA_MIN(size, asebaCan.recvQueue[i].len);
-				memcpy(data, asebaCan.recvQueue[i].data, len);
-				*source = CANID_TO_ID(asebaCan.recvQueue[i].id);
-				asebaCan.recvQueue[i].used = 0;
-				
-				// garbage collect
-				AsebaCanRecvQueueGarbageCollect();
-				
-				return len;
-			}
-			// stop found, we thus must have seen start before
-			else if (CANID_TO_TYPE(asebaCan.recvQueue[i].id) == TYPE_PACKET_STOP)
-			{
-				stopPos = i;
-				stopId = CANID_TO_ID(asebaCan.recvQueue[i].id);
-				break;
-			}
-		}
-		i++;
-		if (i >= asebaCan.recvQueueSize)
-			i = 0;
-	}
-	
-	// if we haven't found anything
-	if (stopPos < 0)
+	// completed packets are linked in order of completion, starting after the sentinel
+	if (can->recvConsumedCount == can->recvCompletedCount)
 		return 0;
 	
 	// collect data
-	*source = CANID_TO_ID(stopId);
-	i = asebaCan.recvQueueConsumePos;
+	i = can->recvQueueLinks[can->recvSentinel];
+	*source = CANID_TO_ID(can->recvQueue[i].id);
 	while (1)
 	{
-		if(asebaCan.recvQueue[i].used) {
-
-			if (CANID_TO_ID(asebaCan.recvQueue[i].id) == stopId)
-			{
-			if (pos < size)
-					{
-					uint16 amount = ASEBA_MIN(asebaCan.recvQueue[i].len, size - pos);
-					memcpy(data + pos, asebaCan.recvQueue[i].data, amount);
-					pos += amount;
-				}
-				asebaCan.recvQueue[i].used = 0;
-			}
-			
-			if (i == stopPos)
-				break;
-	
+		uint16 type = CANID_TO_TYPE(can->recvQueue[i].id);
+		if (pos < size)
+		{
+			uint16 amount = ASEBA_MIN(can->recvQueue[i].len, size - pos);
+			memcpy(data + pos, can->recvQueue[i].data, amount);
+			pos += amount;
 		}
-		i++;
-		if (i >= asebaCan.recvQueueSize)
-			i = 0;
+		if (type == TYPE_SMALL_PACKET || type == TYPE_PACKET_STOP)
+			break;
+		can->recvQueue[i].used = 0;
+		i = can->recvQueueLinks[i];
 	}
-
+	
+	// the last frame becomes the sentinel, the previous one can go
+	if (can->recvSentinel != can->recvQueueSize)
+		can->recvQueue[can->recvSentinel].used = 0;
+	can->recvSentinel = i;
+	can->recvConsumedCount++;
+	
 	// garbage collect
-	AsebaCanRecvQueueGarbageCollect();
+	AsebaCanRecvQueueGarbageCollect(can);
 	
 	return pos;
 }
 
-#define MAX_DROPPING_SOURCE 20
-static uint16 dropping[MAX_DROPPING_SOURCE];
-
-void AsebaCanFrameReceived(const CanFrame *frame)
+void AsebaCanInstanceFrameReceived(AsebaCan* can, const CanFrame *frame)
 {
-	
 	uint16 source = CANID_TO_ID(frame->id);
+	uint16 type = CANID_TO_TYPE(frame->id);
+	AsebaCanReassemblySlot* slot;
+	uint16 pos;
 	
-	// check whether this packet should be filtered or not
-	if (CANID_TO_TYPE(frame->id) == TYPE_SMALL_PACKET)
+	AsebaCanRecvQueueReclaimTail(can);
+	
+	if (type == TYPE_SMALL_PACKET)
 	{
-		if (AsebaShouldDropPacket(source, frame->data))
+		// check whether this packet should be filtered or not
+		if (can->shouldDropPacketFP && can->shouldDropPacketFP(can, source, frame->data))
 			return;
-	}
-	else if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_START)
-	{
-		if (AsebaShouldDropPacket(source, frame->data))
+		if (AsebaCanRecvQueueGetMinFreeFrames(can) <= 1)
 		{
-			uint16 i;
-			for (i = 0; i < MAX_DROPPING_SOURCE; i++)
-			{
-				if (dropping[i] == 0)
-				{
-					dropping[i] = source + 1;
-					return;
-				}
-			}
+			can->receivedPacketDroppedFP(can);
+			return;
 		}
+		pos = AsebaCanRecvQueueInsert(can, frame);
+		AsebaCanRecvPacketCompleted(can, pos, pos);
+		return;
 	}
-	else
+	
+	slot = AsebaCanRecvFindSlot(can, source + 1);
+	if (type == TYPE_PACKET_START)
 	{
-		uint16 i;
-		for (i = 0; i < MAX_DROPPING_SOURCE; i++)
+		// the stop of the previous packet from this source was lost
+		if (slot)
 		{
-			if (dropping[i] == source + 1)
-			{
-				if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP)
-					dropping[i] = 0;
-				return;
-			}
+			AsebaCanRecvFreeSlot(can, slot);
+			can->receivedPacketDroppedFP(can);
 		}
+		
+		// a filtered packet gets no slot, so its other frames are ignored
+		if (can->shouldDropPacketFP && can->shouldDropPacketFP(can, source, frame->data))
+			return;
+		
+		slot = AsebaCanRecvFindSlot(can, 0);
+		if (!slot || AsebaCanRecvQueueGetMinFreeFrames(can) <= 1)
+		{
+			can->receivedPacketDroppedFP(can);
+			return;
+		}
+		pos = AsebaCanRecvQueueInsert(can, frame);
+		slot->first = pos;
+		slot->last = pos;
+		slot->source = source + 1;
+		return;
 	}
 	
-	if (AsebaCanRecvQueueGetMinFreeFrames() <= 1)
+	// frame of a filtered or dropped packet
+	if (!slot)
+		return;
+	
+	if (AsebaCanRecvQueueGetMinFreeFrames(can) <= 1)
 	{
-		// if packet is stop, free associated frames, otherwise this could lead to everlasting used frames
-		if (CANID_TO_TYPE(frame->id) == TYPE_PACKET_STOP) {
-			AsebaCanRecvQueueFreeFrames(source);
-			AsebaCanRecvQueueGarbageCollect();
-		}
+		// free the frames received so far, otherwise this could lead to everlasting used frames
+		AsebaCanRecvFreeSlot(can, slot);
 		
 		// notify user
-		asebaCan.receivedPacketDroppedFP();
+		can->receivedPacketDroppedFP(can);
+		return;
 	}
-	else
+	
+	pos = AsebaCanRecvQueueInsert(can, frame);
+	can->recvQueueLinks[slot->last] = pos;
+	slot->last = pos;
+	if (type == TYPE_PACKET_STOP)
 	{
-		uint16 temp;
-		// store and increment pos
-		memcpy(&asebaCan.recvQueue[asebaCan.recvQueueInsertPos], frame, sizeof(*frame));
-		asebaCan.recvQueue[asebaCan.recvQueueInsertPos].used = 1;
-		temp = asebaCan.recvQueueInsertPos + 1;
-		if (temp >= asebaCan.recvQueueSize)
-			temp = 0;
-		asebaCan.recvQueueInsertPos = temp;
+		AsebaCanRecvPacketCompleted(can, slot->first, pos);
+		slot->source = 0;
 	}
 }
 
-void AsebaCanRecvFreeQueue(void)
+void AsebaCanInstanceRecvFreeQueue(AsebaCan* can)
+{
+	AsebaCanRecvResetQueue(can);
+}
+
+#ifndef ASEBA_CAN_NO_DEFAULT_INSTANCE
+
+// default instance, used by the functions without context handle
+
+/*! The instance used by firmwares through AsebaCanInit() and friends */
+static AsebaCan asebaCan;
+
+/*! The physical layer functions given to AsebaCanInit() */
+static struct
+{
+	AsebaCanSendFrameFP sendFrameFP;
+	AsebaCanIntVoidFP isFrameRoomFP;
+	AsebaCanVoidVoidFP receivedPacketDroppedFP;
+	AsebaCanVoidVoidFP sentPacketDroppedFP;
+} asebaCanDefaultFP;
+
+static void AsebaCanDefaultSendFrame(AsebaCan* can, const CanFrame *frame)
+{
+	asebaCanDefaultFP.sendFrameFP(frame);
+}
+
+static int AsebaCanDefaultIsFrameRoom(AsebaCan* can)
+{
+	return asebaCanDefaultFP.isFrameRoomFP();
+}
+
+static void AsebaCanDefaultReceivedPacketDropped(AsebaCan* can)
+{
+	asebaCanDefaultFP.receivedPacketDroppedFP();
+}
+
+static void AsebaCanDefaultSentPacketDropped(AsebaCan* can)
+{
+	asebaCanDefaultFP.sentPacketDroppedFP();
+}
+
+static uint16 AsebaCanDefaultShouldDropPacket(AsebaCan* can, uint16 source, const uint8* data)
+{
+	return AsebaShouldDropPacket(source, data);
+}
+
+static void AsebaCanDefaultIdle(AsebaCan* can)
 {
-	int i;
-	for(i = 0; i < asebaCan.recvQueueSize; i++)
-		asebaCan.recvQueue[i].used = 0;
-	asebaCan.recvQueueInsertPos = 0;
-	asebaCan.recvQueueConsumePos = 0;
+	AsebaIdle();
+}
+
+void AsebaCanInit(uint16 id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidFP isFrameRoomFP, AsebaCanVoidVoidFP receivedPacketDroppedFP, AsebaCanVoidVoidFP sentPacketDroppedFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize)
+{
+	asebaCanDefaultFP.sendFrameFP = sendFrameFP;
+	asebaCanDefaultFP.isFrameRoomFP = isFrameRoomFP;
+	asebaCanDefaultFP.receivedPacketDroppedFP = receivedPacketDroppedFP;
+	asebaCanDefaultFP.sentPacketDroppedFP = sentPacketDroppedFP;
 	
-	for(i = 0; i < MAX_DROPPING_SOURCE; i++) 
-		dropping[i] = 0;
+	AsebaCanInstanceInit(&asebaCan, id,
+		AsebaCanDefaultSendFrame, AsebaCanDefaultIsFrameRoom,
+		AsebaCanDefaultReceivedPacketDropped, AsebaCanDefaultSentPacketDropped,
+		AsebaCanDefaultShouldDropPacket, AsebaCanDefaultIdle,
+		sendQueue, sendQueueSize, recvQueue, recvQueueSize, 0);
+}
+
+uint16 AsebaCanSend(const uint8 *data, size_t size)
+{
+	return AsebaCanInstanceSend(&asebaCan, data, size);
+}
+
+uint16 AsebaCanSendSpecificSource(const uint8 *data, size_t size, uint16 source)
+{
+	return AsebaCanInstanceSendSpecificSource(&asebaCan, data, size, source);
+}
+
+uint16 AsebaCanRecv(uint8 *data, size_t size, uint16 *source)
+{
+	return AsebaCanInstanceRecv(&asebaCan, data, size, source);
+}
+
+void AsebaCanFlushQueue(void)
+{
+	AsebaCanInstanceFlushQueue(&asebaCan);
+}
+
+void AsebaCanRecvFreeQueue(void)
+{
+	AsebaCanInstanceRecvFreeQueue(&asebaCan);
+}
+
+void AsebaCanFrameReceived(const CanFrame *frame)
+{
+	AsebaCanInstanceFrameReceived(&asebaCan, frame);
+}
+
+void AsebaCanFrameSent()
+{
+	AsebaCanInstanceFrameSent(&asebaCan);
 }
 
+uint16 AsebaCanRecvBufferEmpty(void)
+{
+	return AsebaCanInstanceRecvBufferEmpty(&asebaCan);
+}
+
+#endif // ASEBA_CAN_NO_DEFAULT_INSTANCE
+
 /*@}*/
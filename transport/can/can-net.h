@@ -55,6 +55,11 @@ typedef struct
 	unsigned used:1; /*!< when frame is in a circular buffer, tell if it frame is used */
 } CanFrame;
 
+#ifndef ASEBA_CAN_MAX_REASSEMBLED_SOURCES
+/*! Maximum number of sources whose multi-frame packets are reassembled at the same time; it sets the size of AsebaCan, so can-net.c and its users must agree on it */
+#define ASEBA_CAN_MAX_REASSEMBLED_SOURCES 20
+#endif
+
 /*! Pointer to a void function */
 typedef void (*AsebaCanVoidVoidFP)();
 
@@ -64,6 +69,117 @@ typedef int (*AsebaCanIntVoidFP)();
 /*! Pointer to a function that sends a CAN frame (max 8 bytes) */
 typedef void (*AsebaCanSendFrameFP)(const CanFrame *frame);
 
+struct AsebaCan;
+
+/*! Pointer to a void function of a CAN instance */
+typedef void (*AsebaCanInstanceVoidFP)(struct AsebaCan* can);
+
+/*! Pointer to a function of a CAN instance returning int */
+typedef int (*AsebaCanInstanceIntFP)(struct AsebaCan* can);
+
+/*! Pointer to a function of a CAN instance that sends a CAN frame (max 8 bytes) */
+typedef void (*AsebaCanInstanceSendFrameFP)(struct AsebaCan* can, const CanFrame *frame);
+
+/*! Pointer to a function of a CAN instance that returns true if the packet starting with data from source must be ignored */
+typedef uint16 (*AsebaCanInstanceShouldDropFP)(struct AsebaCan* can, uint16 source, const uint8* data);
+
+/*! A multi-frame packet being received from a given source */
+typedef struct
+{
+	uint16 source; /*!< source + 1, 0 if this slot is free */
+	uint16 first; /*!< position of the start frame in the reception queue */
+	uint16 last; /*!< position of the last frame received so far */
+} AsebaCanReassemblySlot;
+
+/*!	This contains the state of an instance of the CAN implementation of Aseba network, one per CAN bus.
+	Its fields are private, it is declared here so that instances can be allocated statically. */
+typedef struct AsebaCan
+{
+	// data
+	uint16 id; /*!< identifier of this node on CAN */
+	void* userData; /*!< pointer given to AsebaCanInstanceInit(), for the use of callbacks */
+	
+	// pointer to physical layer functions
+	AsebaCanInstanceSendFrameFP sendFrameFP;
+	AsebaCanInstanceIntFP isFrameRoomFP;
+	AsebaCanInstanceVoidFP receivedPacketDroppedFP;
+	AsebaCanInstanceVoidFP sentPacketDroppedFP;
+	
+	// pointer to glue functions
+	AsebaCanInstanceShouldDropFP shouldDropPacketFP;
+	AsebaCanInstanceVoidFP idleFP;
+	
+	// send buffer
+	CanFrame* sendQueue;
+	size_t sendQueueSize;
+	uint16 sendQueueInsertPos;
+	uint16 sendQueueConsumePos;
+	
+	// reception buffer
+	CanFrame* recvQueue;
+	size_t recvQueueSize;
+	uint16 recvQueueInsertPos;
+	uint16 recvQueueConsumePos;
+	
+	// reception index, written by AsebaCanInstanceFrameReceived except where noted
+	uint16* recvQueueLinks; /*!< for each frame, the next frame of its packet, or for a last frame the first frame of the next completed packet; entry recvQueueSize is the initial sentinel */
+	AsebaCanReassemblySlot recvSlots[ASEBA_CAN_MAX_REASSEMBLED_SOURCES]; /*!< packets being reassembled */
+	uint16 recvCompletedTail; /*!< last frame of the most recently completed packet */
+	uint16 volatile recvCompletedCount; /*!< number of completed packets, modulo 2^16 */
+	uint16 recvConsumedCount; /*!< number of packets returned by AsebaCanInstanceRecv, modulo 2^16, written by AsebaCanInstanceRecv */
+	uint16 recvSentinel; /*!< last frame of the last packet returned by AsebaCanInstanceRecv, kept used as it links to the next packet, written by AsebaCanInstanceRecv */
+
+	uint16 volatile sendQueueLock;
+	
+} AsebaCan;
+
+// Instances, each one can be driven from its own thread
+
+/*! Init an instance of the CAN connection.
+	@param can the instance to initialize
+	@param id the identifier of this node on the aseba CAN network
+	@param sendFrameFP pointer to a function that sends CAN frames to the data layer
+	@param isFrameRoomFP pointer to a function that returns if the data layer is ready to send frames
+	@param receivedPacketDroppedFP pointer to a function that is called when a received packet has been dropped, for various reasons but mostly related to insufficient memory
+	@param sentPacketDroppedFP pointer to a function that is called when a sent packet has been dropped (AsebaCanInstanceSend() returned 0), for various reasons but mostly related to insufficient memory
+	@param shouldDropPacketFP pointer to a function that returns true if a received packet must be ignored, 0 to keep all packets
+	@param idleFP pointer to a function called while waiting for the data layer in AsebaCanInstanceFlushQueue(), 0 to busy wait
+	@param sendQueue pointer to send queue data
+	@param sendQueueSize number of frame in sendQueue
+	@param recvQueue pointer to receive queue data; its end holds a 16-bit link per frame, used to reassemble packets without scanning the queue, so it stores somewhat fewer than recvQueueSize frames
+	@param recvQueueSize number of frame in recvQueue
+	@param userData pointer stored in the instance, for the use of callbacks
+*/
+void AsebaCanInstanceInit(AsebaCan* can, uint16 id, AsebaCanInstanceSendFrameFP sendFrameFP, AsebaCanInstanceIntFP isFrameRoomFP, AsebaCanInstanceVoidFP receivedPacketDroppedFP, AsebaCanInstanceVoidFP sentPacketDroppedFP, AsebaCanInstanceShouldDropFP shouldDropPacketFP, AsebaCanInstanceVoidFP idleFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize, void* userData);
+
+/*! Send data as an aseba packet on an instance, see AsebaCanSend() */
+uint16 AsebaCanInstanceSend(AsebaCan* can, const uint8 *data, size_t size);
+
+/*! Send data as an aseba packet with a given source on an instance, see AsebaCanSendSpecificSource() */
+uint16 AsebaCanInstanceSendSpecificSource(AsebaCan* can, const uint8 *data, size_t size, uint16 source);
+
+/*! Copy data from a received packet of an instance, see AsebaCanRecv() */
+uint16 AsebaCanInstanceRecv(AsebaCan* can, uint8 *data, size_t size, uint16 *source);
+
+/*! Wait until the send queue of an instance is empty */
+void AsebaCanInstanceFlushQueue(AsebaCan* can);
+
+/*! Free everything in the Rx queue of an instance, see AsebaCanRecvFreeQueue() */
+void AsebaCanInstanceRecvFreeQueue(AsebaCan* can);
+
+/*! Data layer should call this function when a new CAN frame is available for an instance, see AsebaCanFrameReceived() */
+void AsebaCanInstanceFrameReceived(AsebaCan* can, const CanFrame *frame);
+
+/*! Data layer should call this function when a CAN frame of an instance was sent successfully */
+void AsebaCanInstanceFrameSent(AsebaCan* can);
+
+/*! Return true if the recv buffer of an instance holds no completed packet, false otherwise */
+uint16 AsebaCanInstanceRecvBufferEmpty(AsebaCan* can);
+
+// Default instance, for firmwares with a single CAN bus.
+// Define ASEBA_CAN_NO_DEFAULT_INSTANCE when compiling can-net.c to leave it out,
+// together with its use of the glue functions AsebaIdle() and AsebaShouldDropPacket().
+
 /*! Init the CAN connection.
 	@param id the identifier of this node on the aseba CAN network
 	@param sendFrameFP pointer to a function that sends CAN frames to the data layer
@@ -72,7 +188,7 @@ typedef void (*AsebaCanSendFrameFP)(const CanFrame *frame);
 	@param sentPacketDroppedFP pointer to a function that is called when a sent packet has been dropped (AsebaCanSend() returned 0), for various reasons but mostly related to insufficient memory
 	@param sendQueue pointer to send queue data
 	@param sendQueueSize number of frame in sendQueue
-	@param recvQueue pointer to receive queue data
+	@param recvQueue pointer to receive queue data; its end holds a 16-bit link per frame, used to reassemble packets without scanning the queue, so it stores somewhat fewer than recvQueueSize frames
 	@param recvQueueSize number of frame in recvQueue
 */
 void AsebaCanInit(uint16 id, AsebaCanSendFrameFP sendFrameFP, AsebaCanIntVoidFP isFrameRoomFP, AsebaCanVoidVoidFP receivedPacketDroppedFP, AsebaCanVoidVoidFP sentPacketDroppedFP, CanFrame* sendQueue, size_t sendQueueSize, CanFrame* recvQueue, size_t recvQueueSize);
@@ -119,13 +235,15 @@ uint16 AsebaShouldDropPacket(uint16 source, const uint8* data);
 
 // to be called by data layer on interrupts
 
-/*! Data layer should call this function when a new CAN frame (max 8 bytes) is available */
+/*! Data layer should call this function when a new CAN frame (max 8 bytes) is available.
+	Frames are appended to per-source reassembly slots, so that AsebaCanRecv() takes time proportional to the size of the returned packet.
+	At most ASEBA_CAN_MAX_REASSEMBLED_SOURCES multi-frame packets are reassembled at the same time, a packet from another source is dropped. */
 void AsebaCanFrameReceived(const CanFrame *frame);
 
 /*! Data layer should call this function when the CAN frame (max 8 bytes) was sent successfully */
 void AsebaCanFrameSent();
 
-/*! Return true if the recv buffer is empty, false otherwise */
+/*! Return true if the recv buffer holds no completed packet, false otherwise */
 uint16 AsebaCanRecvBufferEmpty(void);
 
 /*@}*/
@@ -0,0 +1,337 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "can-sim.h"
+#include "can-net.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE_SMALL_PACKET 0x3
+#define TYPE_PACKET_STOP 0x2
+
+#define CANID_TO_TYPE(canid) ((canid) >> 8)
+
+/*! Bits of a standard CAN frame besides its data, including the interframe space */
+#define FRAME_OVERHEAD_BITS 47
+
+/*! A node of the virtual bus */
+typedef struct
+{
+	AsebaCan can; /*!< CAN layer of this node */
+	AsebaCanSim* sim; /*!< bus this node is connected to */
+
+	CanFrame* sendQueue; /*!< send queue of the CAN layer */
+	CanFrame* recvQueue; /*!< reception queue of the CAN layer */
+
+	CanFrame* txQueue; /*!< frames in the controller, waiting for the bus */
+	uint16 txConsumePos;
+	uint16 txCount;
+
+	uint64* sendTimes; /*!< times at which packets whose last frame is not transmitted yet were sent */
+	uint16 sendTimesSize;
+	uint16 sendTimesConsumePos;
+	uint16 sendTimesCount;
+
+	AsebaCanSimNodeStats stats;
+} AsebaCanSimNode;
+
+/*! A virtual CAN bus */
+struct AsebaCanSim
+{
+	AsebaCanSimConfig config;
+	AsebaCanSimNode* nodes;
+
+	uint64 now; /*!< current time, in ns */
+	int transmitting; /*!< index of the node whose frame is on the bus, -1 if the bus is free */
+	uint64 transmissionEnd; /*!< time at which the frame on the bus is complete */
+	uint32 randomState; /*!< state of the generator deciding which frames are lost */
+
+	AsebaCanSimBusStats stats;
+};
+
+/** \addtogroup cansim */
+/*@{*/
+
+static void AsebaCanSimSendFrame(AsebaCan* can, const CanFrame *frame)
+{
+	AsebaCanSimNode* node = (AsebaCanSimNode*)can->userData;
+	uint16 size = node->sim->config.txQueueSize;
+	uint16 pos = node->txConsumePos + node->txCount;
+	if (pos >= size)
+		pos -= size;
+	node->txQueue[pos] = *frame;
+	node->txCount++;
+}
+
+static int AsebaCanSimIsFrameRoom(AsebaCan* can)
+{
+	AsebaCanSimNode* node = (AsebaCanSimNode*)can->userData;
+	return node->txCount < node->sim->config.txQueueSize;
+}
+
+static void AsebaCanSimReceivedPacketDropped(AsebaCan* can)
+{
+	AsebaCanSimNode* node = (AsebaCanSimNode*)can->userData;
+	node->stats.receivedPacketsDropped++;
+}
+
+static void AsebaCanSimSentPacketDropped(AsebaCan* can)
+{
+	AsebaCanSimNode* node = (AsebaCanSimNode*)can->userData;
+	node->stats.sentPacketsDropped++;
+}
+
+/*! Return a pseudo-random number in [0,1), xorshift generator */
+static double AsebaCanSimRandom(AsebaCanSim* sim)
+{
+	uint32 x = sim->randomState;
+	x ^= (x << 13) & 0xffffffff;
+	x ^= x >> 17;
+	x ^= (x << 5) & 0xffffffff;
+	sim->randomState = x;
+	return (double)x / 4294967296.0;
+}
+
+AsebaCanSim* AsebaCanSimCreate(const AsebaCanSimConfig* config)
+{
+	AsebaCanSim* sim;
+	uint16 i;
+
+	if (config->bitrate == 0 || config->nodesCount == 0 || config->nodesCount > 255 ||
+		config->sendQueueSize == 0 || config->recvQueueSize == 0 || config->txQueueSize == 0)
+		return 0;
+
+	sim = (AsebaCanSim*)calloc(1, sizeof(AsebaCanSim));
+	if (!sim)
+		return 0;
+	sim->config = *config;
+	sim->transmitting = -1;
+	sim->randomState = config->seed ? config->seed : 1;
+	sim->nodes = (AsebaCanSimNode*)calloc(config->nodesCount, sizeof(AsebaCanSimNode));
+	if (!sim->nodes)
+	{
+		free(sim);
+		return 0;
+	}
+
+	for (i = 0; i < config->nodesCount; i++)
+	{
+		AsebaCanSimNode* node = &sim->nodes[i];
+		node->sim = sim;
+		node->sendQueue = (CanFrame*)calloc(config->sendQueueSize, sizeof(CanFrame));
+		node->recvQueue = (CanFrame*)calloc(config->recvQueueSize, sizeof(CanFrame));
+		node->txQueue = (CanFrame*)calloc(config->txQueueSize, sizeof(CanFrame));
+		// every packet in flight holds at least one frame in the send or in the controller queue
+		node->sendTimesSize = config->sendQueueSize + config->txQueueSize;
+		node->sendTimes = (uint64*)calloc(node->sendTimesSize, sizeof(uint64));
+		if (!node->sendQueue || !node->recvQueue || !node->txQueue || !node->sendTimes)
+		{
+			sim->config.nodesCount = i + 1;
+			AsebaCanSimDestroy(sim);
+			return 0;
+		}
+		AsebaCanInstanceInit(&node->can, i + 1,
+			AsebaCanSimSendFrame, AsebaCanSimIsFrameRoom,
+			AsebaCanSimReceivedPacketDropped, AsebaCanSimSentPacketDropped,
+			0, 0,
+			node->sendQueue, config->sendQueueSize, node->recvQueue, config->recvQueueSize, node);
+	}
+
+	return sim;
+}
+
+void AsebaCanSimDestroy(AsebaCanSim* sim)
+{
+	uint16 i;
+	for (i = 0; i < sim->config.nodesCount; i++)
+	{
+		free(sim->nodes[i].sendQueue);
+		free(sim->nodes[i].recvQueue);
+		free(sim->nodes[i].txQueue);
+		free(sim->nodes[i].sendTimes);
+	}
+	free(sim->nodes);
+	free(sim);
+}
+
+struct AsebaCan* AsebaCanSimGetNode(AsebaCanSim* sim, uint16 node)
+{
+	return &sim->nodes[node].can;
+}
+
+uint16 AsebaCanSimSend(AsebaCanSim* sim, uint16 node, const uint8* data, size_t size)
+{
+	AsebaCanSimNode* n = &sim->nodes[node];
+	uint16 pos;
+
+	if (!AsebaCanInstanceSend(&n->can, data, size))
+		return 0;
+
+	n->stats.packetsSent++;
+	pos = n->sendTimesConsumePos + n->sendTimesCount;
+	if (pos >= n->sendTimesSize)
+		pos -= n->sendTimesSize;
+	n->sendTimes[pos] = sim->now;
+	n->sendTimesCount++;
+	return 1;
+}
+
+uint16 AsebaCanSimRecv(AsebaCanSim* sim, uint16 node, uint8* data, size_t size, uint16* source)
+{
+	AsebaCanSimNode* n = &sim->nodes[node];
+	uint16 amount = AsebaCanInstanceRecv(&n->can, data, size, source);
+	if (amount)
+		n->stats.packetsReceived++;
+	return amount;
+}
+
+uint64 AsebaCanSimFrameDuration(const AsebaCanSim* sim, uint16 len)
+{
+	return ((uint64)(FRAME_OVERHEAD_BITS + 8 * len) * 1000000000ULL) / sim->config.bitrate;
+}
+
+/*! Put on the bus the head frame with the lowest identifier, return 0 if no node has a frame to send */
+static int AsebaCanSimArbitrate(AsebaCanSim* sim)
+{
+	int winner = -1;
+	unsigned winnerId = 0;
+	uint16 i;
+
+	for (i = 0; i < sim->config.nodesCount; i++)
+	{
+		const AsebaCanSimNode* node = &sim->nodes[i];
+		if (node->txCount && (winner < 0 || node->txQueue[node->txConsumePos].id < winnerId))
+		{
+			winner = i;
+			winnerId = node->txQueue[node->txConsumePos].id;
+		}
+	}
+	if (winner < 0)
+		return 0;
+
+	sim->transmitting = winner;
+	sim->transmissionEnd = sim->now + AsebaCanSimFrameDuration(sim, sim->nodes[winner].txQueue[sim->nodes[winner].txConsumePos].len);
+	return 1;
+}
+
+/*! Deliver the frame on the bus to the other nodes and let its sender queue the next ones */
+static void AsebaCanSimCompleteTransmission(AsebaCanSim* sim)
+{
+	AsebaCanSimNode* sender = &sim->nodes[sim->transmitting];
+	CanFrame frame = sender->txQueue[sender->txConsumePos];
+	uint16 i;
+
+	sim->stats.busyTime += AsebaCanSimFrameDuration(sim, frame.len);
+	sim->stats.framesCount++;
+	sim->now = sim->transmissionEnd;
+	sim->transmitting = -1;
+
+	// remove from the controller of the sender
+	sender->txConsumePos++;
+	if (sender->txConsumePos >= sim->config.txQueueSize)
+		sender->txConsumePos = 0;
+	sender->txCount--;
+	sender->stats.framesSent++;
+
+	// the last frame of a packet ends its latency
+	if (CANID_TO_TYPE(frame.id) == TYPE_SMALL_PACKET || CANID_TO_TYPE(frame.id) == TYPE_PACKET_STOP)
+	{
+		if (sender->sendTimesCount)
+		{
+			uint64 latency = sim->now - sender->sendTimes[sender->sendTimesConsumePos];
+			if (sender->stats.latencyCount == 0 || latency < sender->stats.latencyMin)
+				sender->stats.latencyMin = latency;
+			if (latency > sender->stats.latencyMax)
+				sender->stats.latencyMax = latency;
+			sender->stats.latencySum += latency;
+			sender->stats.latencyCount++;
+
+			sender->sendTimesConsumePos++;
+			if (sender->sendTimesConsumePos >= sender->sendTimesSize)
+				sender->sendTimesConsumePos = 0;
+			sender->sendTimesCount--;
+		}
+	}
+
+	// broadcast to the other nodes
+	for (i = 0; i < sim->config.nodesCount; i++)
+	{
+		if (&sim->nodes[i] == sender)
+			continue;
+		if (sim->config.lossProbability > 0 && AsebaCanSimRandom(sim) < sim->config.lossProbability)
+		{
+			sim->stats.framesLost++;
+			continue;
+		}
+		AsebaCanInstanceFrameReceived(&sim->nodes[i].can, &frame);
+	}
+
+	// the controller has room again
+	AsebaCanInstanceFrameSent(&sender->can);
+}
+
+/*! Transmit frames until the bus is idle or until time end, return 1 if the bus is idle */
+static uint16 AsebaCanSimRunUntil(AsebaCanSim* sim, uint64 end)
+{
+	while (1)
+	{
+		if (sim->transmitting < 0 && !AsebaCanSimArbitrate(sim))
+			return 1;
+		if (sim->transmissionEnd > end)
+			return 0;
+		AsebaCanSimCompleteTransmission(sim);
+	}
+}
+
+void AsebaCanSimRun(AsebaCanSim* sim, uint64 duration)
+{
+	uint64 end = sim->now + duration;
+	AsebaCanSimRunUntil(sim, end);
+	sim->now = end;
+}
+
+uint16 AsebaCanSimRunUntilIdle(AsebaCanSim* sim, uint64 maxDuration)
+{
+	uint64 end = sim->now + maxDuration;
+	if (AsebaCanSimRunUntil(sim, end))
+		return 1;
+	sim->now = end;
+	return 0;
+}
+
+void AsebaCanSimGetBusStats(const AsebaCanSim* sim, AsebaCanSimBusStats* stats)
+{
+	*stats = sim->stats;
+	stats->time = sim->now;
+}
+
+double AsebaCanSimGetBusUtilization(const AsebaCanSim* sim)
+{
+	if (sim->now == 0)
+		return 0;
+	return (double)sim->stats.busyTime / (double)sim->now;
+}
+
+void AsebaCanSimGetNodeStats(const AsebaCanSim* sim, uint16 node, AsebaCanSimNodeStats* stats)
+{
+	*stats = sim->nodes[node].stats;
+}
+
+/*@}*/
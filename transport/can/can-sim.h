@@ -0,0 +1,134 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ASEBA_CAN_SIM
+#define ASEBA_CAN_SIM
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../../common/types.h"
+
+/**
+	\defgroup cansim Virtual CAN bus
+
+	A user-space CAN bus connecting instances of the CAN transport layer,
+	to test and benchmark fragmentation and reassembly without hardware.
+
+	Time is simulated: it only advances in AsebaCanSimRun() and
+	AsebaCanSimRunUntilIdle(). When the bus is free, the pending frame
+	with the lowest CAN identifier wins the arbitration, as on a real bus;
+	each node transmits the frames of its controller queue in order.
+	The duration of a frame is computed without bit stuffing.
+	A frame on the bus reaches every other node, except that each
+	reception is lost with a given probability, as if the controller
+	of the receiver had overrun.
+*/
+/*@{*/
+
+struct AsebaCan;
+
+/*! A virtual CAN bus and its nodes */
+typedef struct AsebaCanSim AsebaCanSim;
+
+/*! Configuration of a virtual CAN bus */
+typedef struct
+{
+	uint32 bitrate; /*!< speed of the bus, in bit/s */
+	uint16 nodesCount; /*!< number of nodes, node i has CAN identifier i + 1, at most 255 */
+	uint16 sendQueueSize; /*!< number of frames in the send queue of the CAN layer of each node */
+	uint16 recvQueueSize; /*!< number of frames in the reception queue of the CAN layer of each node */
+	uint16 txQueueSize; /*!< number of frames the controller of each node can hold for transmission */
+	double lossProbability; /*!< probability that a node misses a frame sent by another node */
+	uint32 seed; /*!< seed of the generator deciding which frames are lost */
+} AsebaCanSimConfig;
+
+/*! Statistics of a virtual CAN bus */
+typedef struct
+{
+	uint64 time; /*!< simulated time, in ns */
+	uint64 busyTime; /*!< time during which the bus carried frames, in ns */
+	uint32 framesCount; /*!< number of frames transmitted */
+	uint32 framesLost; /*!< number of frame receptions lost */
+} AsebaCanSimBusStats;
+
+/*! Statistics of a node of a virtual CAN bus */
+typedef struct
+{
+	uint32 packetsSent; /*!< packets accepted by AsebaCanSimSend() */
+	uint32 sentPacketsDropped; /*!< packets refused by AsebaCanSimSend() because the send queue was full */
+	uint32 packetsReceived; /*!< packets returned by AsebaCanSimRecv() */
+	uint32 receivedPacketsDropped; /*!< packets dropped by the CAN layer of this node on reception */
+	uint32 framesSent; /*!< frames transmitted on the bus */
+	uint32 latencyCount; /*!< number of packets whose latency was measured */
+	uint64 latencyMin; /*!< minimum latency, in ns */
+	uint64 latencyMax; /*!< maximum latency, in ns */
+	uint64 latencySum; /*!< sum of latencies, in ns */
+} AsebaCanSimNodeStats;
+
+/*! Create a virtual CAN bus and its nodes.
+	The latency of a packet is the time between its AsebaCanSimSend() and the end of the transmission of its last frame;
+	packets must thus be sent through AsebaCanSimSend() for latencies to be correct.
+	@return the bus, or 0 if the configuration is invalid or memory is lacking
+*/
+AsebaCanSim* AsebaCanSimCreate(const AsebaCanSimConfig* config);
+
+/*! Destroy a virtual CAN bus and its nodes */
+void AsebaCanSimDestroy(AsebaCanSim* sim);
+
+/*! Return the CAN layer instance of a node, to call the AsebaCanInstance functions directly */
+struct AsebaCan* AsebaCanSimGetNode(AsebaCanSim* sim, uint16 node);
+
+/*! Send a packet from a node, see AsebaCanSend(). Its frames go on the bus when time advances.
+	@return 1 on success, 0 if the send queue of the node is full
+*/
+uint16 AsebaCanSimSend(AsebaCanSim* sim, uint16 node, const uint8* data, size_t size);
+
+/*! Receive a packet on a node, see AsebaCanRecv() */
+uint16 AsebaCanSimRecv(AsebaCanSim* sim, uint16 node, uint8* data, size_t size, uint16* source);
+
+/*! Advance the simulated time by duration ns, transmitting frames on the bus */
+void AsebaCanSimRun(AsebaCanSim* sim, uint64 duration);
+
+/*! Advance the simulated time until no frame is waiting for transmission, but not by more than maxDuration ns.
+	@return 1 if the bus became idle, 0 if maxDuration elapsed first
+*/
+uint16 AsebaCanSimRunUntilIdle(AsebaCanSim* sim, uint64 maxDuration);
+
+/*! Return the time taken by a frame of len bytes on the bus, in ns */
+uint64 AsebaCanSimFrameDuration(const AsebaCanSim* sim, uint16 len);
+
+/*! Copy the statistics of the bus to stats */
+void AsebaCanSimGetBusStats(const AsebaCanSim* sim, AsebaCanSimBusStats* stats);
+
+/*! Return the fraction of the simulated time during which the bus carried frames */
+double AsebaCanSimGetBusUtilization(const AsebaCanSim* sim);
+
+/*! Copy the statistics of a node to stats */
+void AsebaCanSimGetNodeStats(const AsebaCanSim* sim, uint16 node, AsebaCanSimNodeStats* stats);
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
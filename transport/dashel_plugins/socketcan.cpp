@@ -87,11 +87,15 @@ class CanStream: public SelectableStream
 		unsigned int rx_len;
 		unsigned int rx_p;
 
-		struct iovec iov;
-		struct msghdr msg;
 		struct sockaddr_can addr;
-		char ctrlmsg[CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(__u32))];
-		struct can_frame rframe;
+
+		// frames waiting to be written, sent in batches by sendmmsg
+#define TX_CAN_SIZE 256
+		struct can_frame tx_frames[TX_CAN_SIZE];
+		struct iovec tx_iov[TX_CAN_SIZE];
+		struct mmsghdr tx_msgs[TX_CAN_SIZE];
+		unsigned int tx_frames_count;
+		unsigned int tx_frames_sent;
 
 #define RX_CAN_SIZE 1000
 		struct {
@@ -100,6 +104,12 @@ class CanStream: public SelectableStream
 		} rx_fifo[RX_CAN_SIZE];
 		int rx_insert;
 		int rx_consume;
+
+		// frames are read by recvmmsg directly into rx_fifo, in batches
+#define RX_CAN_BATCH 64
+		struct iovec rx_iov[RX_CAN_BATCH];
+		struct mmsghdr rx_msgs[RX_CAN_BATCH];
+		char rx_ctrlmsg[RX_CAN_BATCH][CMSG_SPACE(sizeof(struct timeval)) + CMSG_SPACE(sizeof(__u32))];
 	public:
 		CanStream(const string &targetName) :
 			Stream("can"),
@@ -146,14 +156,38 @@ class CanStream: public SelectableStream
 			rx_len = 0;
 			rx_p = 0;
 			memset(rx_fifo, 0, sizeof(rx_fifo));
-			iov.iov_base = &rframe;
-			msg.msg_iov = &iov;
-			msg.msg_name = &addr;
-			msg.msg_namelen = sizeof(addr);
-			msg.msg_iovlen = 1;
-			msg.msg_control = ctrlmsg;
-			msg.msg_controllen = sizeof(ctrlmsg);
-			msg.msg_flags = 0;
+
+			tx_frames_count = 0;
+			tx_frames_sent = 0;
+			memset(tx_msgs, 0, sizeof(tx_msgs));
+			for(int i = 0; i < TX_CAN_SIZE; i++)
+			{
+				tx_iov[i].iov_base = &tx_frames[i];
+				tx_iov[i].iov_len = sizeof(tx_frames[i]);
+				tx_msgs[i].msg_hdr.msg_iov = &tx_iov[i];
+				tx_msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+
+			memset(rx_msgs, 0, sizeof(rx_msgs));
+			for(int i = 0; i < RX_CAN_BATCH; i++)
+			{
+				rx_iov[i].iov_len = sizeof(struct can_frame);
+				rx_msgs[i].msg_hdr.msg_iov = &rx_iov[i];
+				rx_msgs[i].msg_hdr.msg_iovlen = 1;
+				rx_msgs[i].msg_hdr.msg_control = rx_ctrlmsg[i];
+			}
+		}
+
+		virtual ~CanStream()
+		{
+			// frames not flushed yet, sent if the socket accepts them
+			try
+			{
+				write_frames(false);
+			}
+			catch (const DashelException&)
+			{
+			}
 		}
 	private:
 		int is_packet_tx(void)
@@ -167,27 +201,54 @@ class CanStream: public SelectableStream
 			return 0;
 		}
 
-		void can_write_frame(struct can_frame * f)
+		// Write queued frames, as many as possible per syscall.
+		// If wait is false, return as soon as the socket is not writable,
+		// otherwise wait for it until all frames are written.
+		void write_frames(bool wait)
 		{
-			ssize_t ret;
-
-			do {
-				ret = ::write(fd, f, sizeof(*f));
+			while(tx_frames_sent < tx_frames_count)
+			{
+				int ret = sendmmsg(fd, &tx_msgs[tx_frames_sent], tx_frames_count - tx_frames_sent, MSG_DONTWAIT);
+				if(ret > 0)
+				{
+					tx_frames_sent += ret;
+					continue;
+				}
 
-				if(ret == -1 && errno == ENOBUFS)
+				if(ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR))
 				{
-					struct pollfd pf;
-					pf.fd = fd;
-					pf.events = POLLOUT | POLLHUP;
-					pf.revents = 0;
-					if (poll(&pf, 1, 0) == -1)
-						perror("socketcan: can_write_frame: error while polling the socket");
+					if(!wait)
+						return;
+					if(errno == ENOBUFS)
+					{
+						// the queue of the interface is full, poll would not tell when it has room
+						poll(NULL, 0, 1);
+					}
+					else
+					{
+						struct pollfd pf;
+						pf.fd = fd;
+						pf.events = POLLOUT;
+						pf.revents = 0;
+						if (poll(&pf, 1, -1) == -1 && errno != EINTR)
+							throw DashelException(DashelException::IOError, errno, "Poll error", this);
+					}
 					continue;
 				}
 
-				if(ret != sizeof(*f))
-					throw DashelException(DashelException::IOError, 0, "Write error", this);
-			} while(0);
+				throw DashelException(DashelException::IOError, errno, "Write error", this);
+			}
+			tx_frames_count = 0;
+			tx_frames_sent = 0;
+		}
+
+		void can_write_frame(struct can_frame * f)
+		{
+			// make room by waiting for the socket
+			if(tx_frames_count == TX_CAN_SIZE)
+				write_frames(true);
+
+			tx_frames[tx_frames_count++] = *f;
 		}
 
 		void send_aseba_packet()
@@ -246,10 +307,13 @@ class CanStream: public SelectableStream
 				if(is_packet_tx())
 					send_aseba_packet();
 			}
+			// send what the socket accepts now, flush() sends the rest
+			write_frames(false);
 		}
 
 		virtual void flush() 
 		{
+			write_frames(true);
 		}
 	private:
 		void pack_fifo()
@@ -344,13 +408,6 @@ class CanStream: public SelectableStream
 				return 1;
 			}
 		}
-		int fifo_full() 
-		{
-			int i = rx_insert + 1;
-			if(i == RX_CAN_SIZE)
-				i = 0;
-			return i == rx_consume;
-		}
 
 		void read_iface(void)
 		{
@@ -361,32 +418,59 @@ class CanStream: public SelectableStream
 				if(def == 1)
 					break;
 
-				struct cmsghdr *cmsg;
-				iov.iov_len = sizeof(rframe);
-				msg.msg_flags = 0;
-				if(recvmsg(fd, &msg, 0) < (int) sizeof(rframe))
-					throw DashelException(DashelException::IOError, 0, "Read error", this);
+				// receive as many frames as are available, up to the free space of the fifo
+				int count = 0;
+				int pos = rx_insert;
+				while(count < RX_CAN_BATCH && !rx_fifo[pos].used)
+				{
+					int next = pos + 1;
+					if(next == RX_CAN_SIZE)
+						next = 0;
+					if(next == rx_consume)
+						break;
+					rx_iov[count].iov_base = &rx_fifo[pos].f;
+					rx_msgs[count].msg_hdr.msg_controllen = sizeof(rx_ctrlmsg[count]);
+					rx_msgs[count].msg_hdr.msg_flags = 0;
+					count++;
+					pos = next;
+				}
+				if(count == 0)
+					throw DashelException(DashelException::IOError, 0, "Fifo full", this);
+
+				// wait for the first frame only
+				int ret = recvmmsg(fd, rx_msgs, count, MSG_WAITFORONE, NULL);
+				if(ret <= 0)
+				{
+					if(ret == -1 && errno == EINTR)
+						continue;
+					throw DashelException(DashelException::IOError, errno, "Read error", this);
+				}
 
-				for(cmsg = CMSG_FIRSTHDR(&msg); 
-					cmsg && (cmsg->cmsg_level == SOL_SOCKET);
-					cmsg = CMSG_NXTHDR(&msg,cmsg))
+				for(int i = 0; i < ret; i++)
 				{
-					if(cmsg->cmsg_type == SO_RXQ_OVFL)
+					struct msghdr *msg = &rx_msgs[i].msg_hdr;
+					struct cmsghdr *cmsg;
+
+					if(rx_msgs[i].msg_len < sizeof(struct can_frame))
+						throw DashelException(DashelException::IOError, 0, "Read error", this);
+
+					for(cmsg = CMSG_FIRSTHDR(msg); 
+						cmsg && (cmsg->cmsg_level == SOL_SOCKET);
+						cmsg = CMSG_NXTHDR(msg,cmsg))
 					{
-						__u32 * dropcnt = (__u32 *) CMSG_DATA(cmsg);
-						if(*dropcnt)
-							throw DashelException(DashelException::IOError, 0, "Packet dropped", this);
+						if(cmsg->cmsg_type == SO_RXQ_OVFL)
+						{
+							__u32 * dropcnt = (__u32 *) CMSG_DATA(cmsg);
+							if(*dropcnt)
+								throw DashelException(DashelException::IOError, 0, "Packet dropped", this);
+						}
 					}
-				}
-			
-				if(fifo_full())
-					throw DashelException(DashelException::IOError, 0, "Fifo full", this);
 
-				// push to fifo ...
-				memcpy(&rx_fifo[rx_insert].f,&rframe,sizeof(rframe));
-				rx_fifo[rx_insert++].used = 1;
-				if(rx_insert == RX_CAN_SIZE)
-					rx_insert = 0;
+					// push to fifo ...
+					rx_fifo[rx_insert++].used = 1;
+					if(rx_insert == RX_CAN_SIZE)
+						rx_insert = 0;
+				}
 			}
 			pack_fifo();
 		}
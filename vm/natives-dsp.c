@@ -0,0 +1,378 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../common/consts.h"
+#include "../common/types.h"
+#include "natives-dsp.h"
+#include <string.h>
+
+#if defined(__dsPIC30F__)
+#include <p30Fxxxx.h>
+#define DSP_AVAILABLE
+#elif defined(__dsPIC33F__)
+#include <p33Fxxxx.h>
+#define DSP_AVAILABLE
+#elif defined(__PIC24H__)
+#include <p24Hxxxx.h>
+#endif
+
+/**
+	\file natives-dsp.c
+	Implementation of signal-processing natives functions for Aseba Virtual Machine
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+// defined in natives.c, 1.15 fixed point results of an "aseba" angle
+sint16 aseba_sin(sint16 angle);
+sint16 aseba_cos(sint16 angle);
+
+// multiply two 16 bits values into 32 bits
+#ifdef __C30__
+#define ASEBA_MUL(a, b) __builtin_mulss((a), (b))
+#else
+#define ASEBA_MUL(a, b) ((sint32)(a) * (sint32)(b))
+#endif
+
+// saturate a 32 bits value to 16 bits
+static sint16 aseba_saturate(sint32 value)
+{
+	if (value > 32767)
+		return 32767;
+	if (value < -32768)
+		return -32768;
+	return (sint16)value;
+}
+
+// shift right a sum, with shifts larger than the sum giving its sign
+static sint32 aseba_shift_right(sint32 value, sint16 shift)
+{
+	if (shift <= 0)
+		return value;
+	if (shift > 31)
+		shift = 31;
+	return value >> shift;
+}
+
+// dot product of two vectors
+static sint32 aseba_dot(const sint16* src1, const sint16* src2, uint16 length)
+{
+#ifdef DSP_AVAILABLE
+	if (length == 0)
+		return 0;
+	length--;
+
+	CORCONbits.US = 0; // Signed mode
+	CORCON |= 0b11110001; // 40 bits mode, saturation enable, integer mode.
+	// Do NOT save the accumulator values, so do NOT USE THIS FUNCTION IN INTERRUPT !
+	asm __volatile__ (
+	"push %[ptr1]		\r\n"
+	"push %[ptr2]		\r\n"
+	"clr A\r\n"									//	A = 0
+	"mov [%[ptr1]++], w4 \r\n"					// Preload ptr
+	"do %[loop_cnt], 1f	\r\n"					//	Iterate loop_cnt time the two following instructions
+	"mov [%[ptr2]++], w5 \r\n"					// 	Load w5
+	"1: mac w4*w5, A, [%[ptr1]]+=2, w4 \r\n"	//	A += w4 * w5, prefetch ptr1 into w4
+	"pop %[ptr2]		\r\n"
+	"pop %[ptr1]		\r\n"
+	: /* No output */
+	: [loop_cnt] "r" (length), [ptr1] "x" (src1), [ptr2] "r" (src2)
+	: "cc", "w4", "w5" );
+
+	// Get the low 32 bits of the accumulator
+	return ((sint32)ACCAH << 16) | (uint16)ACCAL;
+#else
+	sint32 res = 0;
+	uint16 i;
+	for (i = 0; i < length; i++)
+		res += ASEBA_MUL(src1[i], src2[i]);
+	return res;
+#endif
+}
+
+// push a new sample in a delay line, newest first, and return the sample that left
+static sint16 aseba_delay_line_push(sint16* line, uint16 length, sint16 sample)
+{
+	const sint16 oldest = line[length - 1];
+	memmove(line + 1, line, (length - 1) * sizeof(sint16));
+	line[0] = sample;
+	return oldest;
+}
+
+
+void AsebaNative_dspfir(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	uint16 coeffs = AsebaNativePopArg(vm);
+	uint16 state = AsebaNativePopArg(vm);
+	sint16 shift = vm->variables[AsebaNativePopArg(vm)];
+
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+	uint16 order = AsebaNativePopArg(vm);
+
+	uint16 i;
+	for (i = 0; i < length; i++)
+	{
+		// the delay line holds the current sample first, so that the sum is a plain dot product
+		sint32 acc;
+		aseba_delay_line_push(vm->variables + state, order, vm->variables[src + i]);
+		acc = aseba_dot(vm->variables + coeffs, vm->variables + state, order);
+		vm->variables[dest + i] = aseba_saturate(aseba_shift_right(acc, shift));
+	}
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_dspfir =
+{
+	"dsp.fir",
+	"filters src to dest with FIR coeffs, keeping the last samples in state, and shifts the results",
+	{
+		{ -1, "dest" },
+		{ -1, "src" },
+		{ -2, "coeffs" },
+		{ -2, "state" },
+		{ 1, "shift" },
+		{ 0, 0 }
+	}
+};
+
+
+void AsebaNative_dspbiquad(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	uint16 coeffs = AsebaNativePopArg(vm);
+	uint16 state = AsebaNativePopArg(vm);
+
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+
+	// coefficients b0, b1, b2, a1, a2 in Q14, state x[n-1], x[n-2], y[n-1], y[n-2]
+	const sint16 b0 = vm->variables[coeffs];
+	const sint16 b1 = vm->variables[coeffs + 1];
+	const sint16 b2 = vm->variables[coeffs + 2];
+	const sint16 a1 = vm->variables[coeffs + 3];
+	const sint16 a2 = vm->variables[coeffs + 4];
+	sint16 x1 = vm->variables[state];
+	sint16 x2 = vm->variables[state + 1];
+	sint16 y1 = vm->variables[state + 2];
+	sint16 y2 = vm->variables[state + 3];
+
+	uint16 i;
+	for (i = 0; i < length; i++)
+	{
+		const sint16 x = vm->variables[src + i];
+		const sint32 acc = ASEBA_MUL(b0, x) + ASEBA_MUL(b1, x1) + ASEBA_MUL(b2, x2) - ASEBA_MUL(a1, y1) - ASEBA_MUL(a2, y2);
+		const sint16 y = aseba_saturate(acc >> 14);
+		x2 = x1;
+		x1 = x;
+		y2 = y1;
+		y1 = y;
+		vm->variables[dest + i] = y;
+	}
+
+	vm->variables[state] = x1;
+	vm->variables[state + 1] = x2;
+	vm->variables[state + 2] = y1;
+	vm->variables[state + 3] = y2;
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_dspbiquad =
+{
+	"dsp.biquad",
+	"filters src to dest with biquad coeffs b0 b1 b2 a1 a2 in Q14, keeping x1 x2 y1 y2 in state",
+	{
+		{ -1, "dest" },
+		{ -1, "src" },
+		{ 5, "coeffs" },
+		{ 4, "state" },
+		{ 0, 0 }
+	}
+};
+
+
+void AsebaNative_dspconv(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	uint16 kernel = AsebaNativePopArg(vm);
+	sint16 shift = vm->variables[AsebaNativePopArg(vm)];
+
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+	uint16 kernelLength = AsebaNativePopArg(vm);
+
+	// dest[i] is the sum of kernel[k] * src[i + center - k], src being zero outside its bounds
+	const sint32 center = (kernelLength - 1) / 2;
+	sint32 i;
+	for (i = 0; i < (sint32)length; i++)
+	{
+		// bounds of k for which src is within its bounds
+		const sint32 kBegin = i + center - (sint32)length + 1 > 0 ? i + center - (sint32)length + 1 : 0;
+		const sint32 kEnd = i + center + 1 < (sint32)kernelLength ? i + center + 1 : (sint32)kernelLength;
+		sint32 acc = 0;
+		sint32 k;
+		for (k = kBegin; k < kEnd; k++)
+			acc += ASEBA_MUL(vm->variables[kernel + k], vm->variables[src + i + center - k]);
+		vm->variables[dest + i] = aseba_saturate(aseba_shift_right(acc, shift));
+	}
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_dspconv =
+{
+	"dsp.conv",
+	"convolves src with kernel centered on each element to dest, which must not overlap src, and shifts the results",
+	{
+		{ -1, "dest" },
+		{ -1, "src" },
+		{ -2, "kernel" },
+		{ 1, "shift" },
+		{ 0, 0 }
+	}
+};
+
+
+void AsebaNative_dspmovavg(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	uint16 state = AsebaNativePopArg(vm);
+
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+	uint16 window = AsebaNativePopArg(vm);
+
+	sint32 sum = 0;
+	uint16 i;
+	for (i = 0; i < window; i++)
+		sum += vm->variables[state + i];
+
+	for (i = 0; i < length; i++)
+	{
+		const sint16 sample = vm->variables[src + i];
+		sum += sample - aseba_delay_line_push(vm->variables + state, window, sample);
+		vm->variables[dest + i] = (sint16)(sum / (sint32)window);
+	}
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_dspmovavg =
+{
+	"dsp.movavg",
+	"averages src to dest over the last samples, kept in state",
+	{
+		{ -1, "dest" },
+		{ -1, "src" },
+		{ -2, "state" },
+		{ 0, 0 }
+	}
+};
+
+
+void AsebaNative_dspfft(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 real = AsebaNativePopArg(vm);
+	uint16 imag = AsebaNativePopArg(vm);
+	sint16 inverse = vm->variables[AsebaNativePopArg(vm)];
+
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+
+	sint16* re = vm->variables + real;
+	sint16* im = vm->variables + imag;
+	uint16 i, j, bit, stage;
+
+	// only powers of two are supported
+	if (length < 2 || (length & (length - 1)))
+		return;
+
+	// bit-reversal permutation
+	for (i = 0, j = 0; i < length; i++)
+	{
+		if (i < j)
+		{
+			sint16 swap = re[i];
+			re[i] = re[j];
+			re[j] = swap;
+			swap = im[i];
+			im[i] = im[j];
+			im[j] = swap;
+		}
+		for (bit = length >> 1; j & bit; bit >>= 1)
+			j ^= bit;
+		j |= bit;
+	}
+
+	// radix-2 butterflies, the forward transform halving the values at each stage so that it cannot overflow
+	for (stage = 1; stage < length; stage <<= 1)
+	{
+		// a full turn is 65536 in "aseba" angles
+		const uint16 angleStep = (uint16)(32768UL / stage);
+		uint16 k;
+		for (k = 0; k < stage; k++)
+		{
+			const sint16 angle = (sint16)(k * angleStep);
+			const sint16 wr = aseba_cos(angle);
+			const sint16 wi = inverse ? aseba_sin(angle) : -aseba_sin(angle);
+			for (i = k; i < length; i += 2 * stage)
+			{
+				const uint16 p = i + stage;
+				const sint32 tr = (ASEBA_MUL(wr, re[p]) - ASEBA_MUL(wi, im[p])) >> 15;
+				const sint32 ti = (ASEBA_MUL(wr, im[p]) + ASEBA_MUL(wi, re[p])) >> 15;
+				const sint32 ar = re[i];
+				const sint32 ai = im[i];
+				if (inverse)
+				{
+					re[i] = aseba_saturate(ar + tr);
+					im[i] = aseba_saturate(ai + ti);
+					re[p] = aseba_saturate(ar - tr);
+					im[p] = aseba_saturate(ai - ti);
+				}
+				else
+				{
+					re[i] = aseba_saturate((ar + tr) >> 1);
+					im[i] = aseba_saturate((ai + ti) >> 1);
+					re[p] = aseba_saturate((ar - tr) >> 1);
+					im[p] = aseba_saturate((ai - ti) >> 1);
+				}
+			}
+		}
+	}
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_dspfft =
+{
+	"dsp.fft",
+	"in-place FFT of real and imag, of a power-of-two size; the forward transform (inverse = 0) is divided by the size",
+	{
+		{ -1, "real" },
+		{ -1, "imag" },
+		{ 1, "inverse" },
+		{ 0, 0 }
+	}
+};
+
+/*@}*/
@@ -0,0 +1,93 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ASEBA_NATIVES_DSP_H
+#define __ASEBA_NATIVES_DSP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../common/types.h"
+#include "natives.h"
+
+/**
+	\file natives-dsp.h
+	Definition of signal-processing native functions for Aseba Virtual Machine.
+	They are optional: a target provides them by appending ASEBA_NATIVES_DSP_FUNCTIONS
+	and ASEBA_NATIVES_DSP_DESCRIPTIONS after the standard natives.
+	All computations are in fixed point, intermediate sums are on at least 32 bits
+	and results saturate to 16 bits.
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+/*! Function to filter src into dest with a FIR whose last input samples are kept in state, newest first */
+void AsebaNative_dspfir(AsebaVMState *vm);
+/*! Description of AsebaNative_dspfir */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_dspfir;
+
+/*! Function to filter src into dest with a biquad in Q14, direct form I */
+void AsebaNative_dspbiquad(AsebaVMState *vm);
+/*! Description of AsebaNative_dspbiquad */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_dspbiquad;
+
+/*! Function to convolve src with a kernel centered on each element, writing a result of the same size to dest */
+void AsebaNative_dspconv(AsebaVMState *vm);
+/*! Description of AsebaNative_dspconv */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_dspconv;
+
+/*! Function to perform a moving average of src into dest over the size of state */
+void AsebaNative_dspmovavg(AsebaVMState *vm);
+/*! Description of AsebaNative_dspmovavg */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_dspmovavg;
+
+/*! Function to perform an in-place radix-2 FFT on a power-of-two number of complex values */
+void AsebaNative_dspfft(AsebaVMState *vm);
+/*! Description of AsebaNative_dspfft */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_dspfft;
+
+/*! Embedded targets must know the size of ASEBA_NATIVES_DSP_FUNCTIONS without having to compute them by hand, please update this when adding a new function */
+#define ASEBA_NATIVES_DSP_COUNT 5
+
+/*! snippet to include signal-processing native functions */
+#define ASEBA_NATIVES_DSP_FUNCTIONS \
+	AsebaNative_dspfir, \
+	AsebaNative_dspbiquad, \
+	AsebaNative_dspconv, \
+	AsebaNative_dspmovavg, \
+	AsebaNative_dspfft
+
+/*! snippet to include descriptions of signal-processing native functions */
+#define ASEBA_NATIVES_DSP_DESCRIPTIONS \
+	&AsebaNativeDescription_dspfir, \
+	&AsebaNativeDescription_dspbiquad, \
+	&AsebaNativeDescription_dspconv, \
+	&AsebaNativeDescription_dspmovavg, \
+	&AsebaNativeDescription_dspfft
+
+/*@}*/
+
+#ifdef __cplusplus
+} /* closing brace for extern "C" */
+#endif
+
+#endif
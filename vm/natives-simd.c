@@ -0,0 +1,571 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "natives-simd.h"
+
+#ifdef ASEBA_NATIVES_SIMD
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASEBA_SIMD_NEON_AVAILABLE
+#include <arm_neon.h>
+#else
+#define ASEBA_SIMD_SSE2_AVAILABLE
+#include <emmintrin.h>
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define ASEBA_SIMD_AVX2_AVAILABLE
+#include <immintrin.h>
+#endif
+#endif
+
+/**
+	\file natives-simd.c
+	Vectorized kernels of the standard vector natives.
+	Each kernel processes as many elements as possible with vector instructions,
+	and the remaining ones with the same arithmetic as natives.c.
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+// element-by-element code, for the remaining elements
+
+static void scalar_add(sint16* dest, const sint16* src1, const sint16* src2, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src1[i] + src2[i];
+}
+
+static void scalar_sub(sint16* dest, const sint16* src1, const sint16* src2, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src1[i] - src2[i];
+}
+
+static void scalar_mul(sint16* dest, const sint16* src1, const sint16* src2, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src1[i] * src2[i];
+}
+
+static void scalar_min(sint16* dest, const sint16* src1, const sint16* src2, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src1[i] < src2[i] ? src1[i] : src2[i];
+}
+
+static void scalar_max(sint16* dest, const sint16* src1, const sint16* src2, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src1[i] > src2[i] ? src1[i] : src2[i];
+}
+
+static void scalar_addScalar(sint16* dest, const sint16* src, sint16 scalar, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = src[i] + scalar;
+}
+
+static void scalar_fill(sint16* dest, sint16 value, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+		dest[i] = value;
+}
+
+static void scalar_clamp(sint16* dest, const sint16* src, const sint16* low, const sint16* high, uint16 length)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+	{
+		const sint16 v = src[i];
+		dest[i] = v > high[i] ? high[i] : (v < low[i] ? low[i] : v);
+	}
+}
+
+static sint64 scalar_dot(const sint16* src1, const sint16* src2, uint16 length)
+{
+	sint64 res = 0;
+	uint16 i;
+	for (i = 0; i < length; i++)
+		res += (sint32)src1[i] * (sint32)src2[i];
+	return res;
+}
+
+static void scalar_stat(const sint16* src, uint16 length, sint16* min, sint16* max, sint32* sum)
+{
+	uint16 i;
+	for (i = 0; i < length; i++)
+	{
+		if (src[i] < *min)
+			*min = src[i];
+		if (src[i] > *max)
+			*max = src[i];
+		*sum += src[i];
+	}
+}
+
+#ifdef ASEBA_SIMD_SSE2_AVAILABLE
+
+// SSE2, 8 elements at a time
+
+#define SSE2_BINARY_KERNEL(name, op) \
+static void sse2_##name(sint16* dest, const sint16* src1, const sint16* src2, uint16 length) \
+{ \
+	uint16 i = 0; \
+	for (; i + 8 <= length; i += 8) \
+	{ \
+		const __m128i a = _mm_loadu_si128((const __m128i*)(src1 + i)); \
+		const __m128i b = _mm_loadu_si128((const __m128i*)(src2 + i)); \
+		_mm_storeu_si128((__m128i*)(dest + i), op(a, b)); \
+	} \
+	scalar_##name(dest + i, src1 + i, src2 + i, length - i); \
+}
+
+SSE2_BINARY_KERNEL(add, _mm_add_epi16)
+SSE2_BINARY_KERNEL(sub, _mm_sub_epi16)
+SSE2_BINARY_KERNEL(mul, _mm_mullo_epi16)
+SSE2_BINARY_KERNEL(min, _mm_min_epi16)
+SSE2_BINARY_KERNEL(max, _mm_max_epi16)
+
+static void sse2_addScalar(sint16* dest, const sint16* src, sint16 scalar, uint16 length)
+{
+	const __m128i s = _mm_set1_epi16(scalar);
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+		_mm_storeu_si128((__m128i*)(dest + i), _mm_add_epi16(_mm_loadu_si128((const __m128i*)(src + i)), s));
+	scalar_addScalar(dest + i, src + i, scalar, length - i);
+}
+
+static void sse2_fill(sint16* dest, sint16 value, uint16 length)
+{
+	const __m128i v = _mm_set1_epi16(value);
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+		_mm_storeu_si128((__m128i*)(dest + i), v);
+	scalar_fill(dest + i, value, length - i);
+}
+
+static void sse2_clamp(sint16* dest, const sint16* src, const sint16* low, const sint16* high, uint16 length)
+{
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i l = _mm_loadu_si128((const __m128i*)(low + i));
+		const __m128i h = _mm_loadu_si128((const __m128i*)(high + i));
+		// v > h ? h : max(v, l), so that high wins when low > high
+		const __m128i aboveHigh = _mm_cmpgt_epi16(v, h);
+		const __m128i res = _mm_or_si128(_mm_and_si128(aboveHigh, h), _mm_andnot_si128(aboveHigh, _mm_max_epi16(v, l)));
+		_mm_storeu_si128((__m128i*)(dest + i), res);
+	}
+	scalar_clamp(dest + i, src + i, low + i, high + i, length - i);
+}
+
+// widen the 32-bit sums of pairs of products to 64 bits and add them to acc;
+// a sum of pairs is at least -2^31 + 2^16, so INT_MIN can only be the wrapped value of 2^31
+static __m128i sse2_accumulatePairs(__m128i acc, __m128i pairs)
+{
+	const __m128i wrapped = _mm_cmpeq_epi32(pairs, _mm_set1_epi32((int)0x80000000));
+	const __m128i sign = _mm_andnot_si128(wrapped, _mm_srai_epi32(pairs, 31));
+	acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(pairs, sign));
+	return _mm_add_epi64(acc, _mm_unpackhi_epi32(pairs, sign));
+}
+
+static sint64 sse2_dot(const sint16* src1, const sint16* src2, uint16 length)
+{
+	__m128i acc = _mm_setzero_si128();
+	sint64 lanes[2];
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i*)(src1 + i));
+		const __m128i b = _mm_loadu_si128((const __m128i*)(src2 + i));
+		acc = sse2_accumulatePairs(acc, _mm_madd_epi16(a, b));
+	}
+	_mm_storeu_si128((__m128i*)lanes, acc);
+	return lanes[0] + lanes[1] + scalar_dot(src1 + i, src2 + i, length - i);
+}
+
+static void sse2_stat(const sint16* src, uint16 length, sint16* min, sint16* max, sint32* sum)
+{
+	uint16 i = 0;
+	*min = src[0];
+	*max = src[0];
+	*sum = 0;
+	if (length >= 8)
+	{
+		const __m128i ones = _mm_set1_epi16(1);
+		__m128i vmin = _mm_loadu_si128((const __m128i*)src);
+		__m128i vmax = vmin;
+		__m128i vsum = _mm_setzero_si128();
+		sint16 mins[8], maxs[8];
+		sint32 sums[4];
+		int j;
+		// the sum of all elements fits in 32 bits, and so do the partial sums of each lane
+		for (; i + 8 <= length; i += 8)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+			vmin = _mm_min_epi16(vmin, v);
+			vmax = _mm_max_epi16(vmax, v);
+			vsum = _mm_add_epi32(vsum, _mm_madd_epi16(v, ones));
+		}
+		_mm_storeu_si128((__m128i*)mins, vmin);
+		_mm_storeu_si128((__m128i*)maxs, vmax);
+		{
+			int lanes[4];
+			_mm_storeu_si128((__m128i*)lanes, vsum);
+			for (j = 0; j < 4; j++)
+				sums[j] = lanes[j];
+		}
+		for (j = 0; j < 8; j++)
+		{
+			if (mins[j] < *min)
+				*min = mins[j];
+			if (maxs[j] > *max)
+				*max = maxs[j];
+		}
+		*sum = sums[0] + sums[1] + sums[2] + sums[3];
+	}
+	scalar_stat(src + i, length - i, min, max, sum);
+}
+
+static const AsebaSimdKernels sse2Kernels =
+{
+	sse2_add, sse2_sub, sse2_mul, sse2_min, sse2_max,
+	sse2_addScalar, sse2_fill, sse2_clamp, sse2_dot, sse2_stat
+};
+
+#endif // ASEBA_SIMD_SSE2_AVAILABLE
+
+#ifdef ASEBA_SIMD_AVX2_AVAILABLE
+
+// AVX2, 16 elements at a time, compiled for AVX2 whatever the compilation flags
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+#define AVX2_BINARY_KERNEL(name, op) \
+AVX2_FUNCTION static void avx2_##name(sint16* dest, const sint16* src1, const sint16* src2, uint16 length) \
+{ \
+	uint16 i = 0; \
+	for (; i + 16 <= length; i += 16) \
+	{ \
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(src1 + i)); \
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(src2 + i)); \
+		_mm256_storeu_si256((__m256i*)(dest + i), op(a, b)); \
+	} \
+	scalar_##name(dest + i, src1 + i, src2 + i, length - i); \
+}
+
+AVX2_BINARY_KERNEL(add, _mm256_add_epi16)
+AVX2_BINARY_KERNEL(sub, _mm256_sub_epi16)
+AVX2_BINARY_KERNEL(mul, _mm256_mullo_epi16)
+AVX2_BINARY_KERNEL(min, _mm256_min_epi16)
+AVX2_BINARY_KERNEL(max, _mm256_max_epi16)
+
+AVX2_FUNCTION static void avx2_addScalar(sint16* dest, const sint16* src, sint16 scalar, uint16 length)
+{
+	const __m256i s = _mm256_set1_epi16(scalar);
+	uint16 i = 0;
+	for (; i + 16 <= length; i += 16)
+		_mm256_storeu_si256((__m256i*)(dest + i), _mm256_add_epi16(_mm256_loadu_si256((const __m256i*)(src + i)), s));
+	scalar_addScalar(dest + i, src + i, scalar, length - i);
+}
+
+AVX2_FUNCTION static void avx2_fill(sint16* dest, sint16 value, uint16 length)
+{
+	const __m256i v = _mm256_set1_epi16(value);
+	uint16 i = 0;
+	for (; i + 16 <= length; i += 16)
+		_mm256_storeu_si256((__m256i*)(dest + i), v);
+	scalar_fill(dest + i, value, length - i);
+}
+
+AVX2_FUNCTION static void avx2_clamp(sint16* dest, const sint16* src, const sint16* low, const sint16* high, uint16 length)
+{
+	uint16 i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+		const __m256i l = _mm256_loadu_si256((const __m256i*)(low + i));
+		const __m256i h = _mm256_loadu_si256((const __m256i*)(high + i));
+		const __m256i aboveHigh = _mm256_cmpgt_epi16(v, h);
+		_mm256_storeu_si256((__m256i*)(dest + i), _mm256_blendv_epi8(_mm256_max_epi16(v, l), h, aboveHigh));
+	}
+	scalar_clamp(dest + i, src + i, low + i, high + i, length - i);
+}
+
+AVX2_FUNCTION static sint64 avx2_dot(const sint16* src1, const sint16* src2, uint16 length)
+{
+	const __m256i intMin = _mm256_set1_epi32((int)0x80000000);
+	__m256i acc = _mm256_setzero_si256();
+	sint64 lanes[4];
+	uint16 i = 0;
+	for (; i + 16 <= length; i += 16)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i*)(src1 + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i*)(src2 + i));
+		const __m256i pairs = _mm256_madd_epi16(a, b);
+		// see sse2_accumulatePairs
+		const __m256i sign = _mm256_andnot_si256(_mm256_cmpeq_epi32(pairs, intMin), _mm256_srai_epi32(pairs, 31));
+		acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(pairs, sign));
+		acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(pairs, sign));
+	}
+	_mm256_storeu_si256((__m256i*)lanes, acc);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sse2_dot(src1 + i, src2 + i, length - i);
+}
+
+AVX2_FUNCTION static void avx2_stat(const sint16* src, uint16 length, sint16* min, sint16* max, sint32* sum)
+{
+	uint16 i = 0;
+	sint16 tailMin, tailMax;
+	sint32 tailSum;
+	*min = src[0];
+	*max = src[0];
+	*sum = 0;
+	if (length >= 16)
+	{
+		const __m256i ones = _mm256_set1_epi16(1);
+		__m256i vmin = _mm256_loadu_si256((const __m256i*)src);
+		__m256i vmax = vmin;
+		__m256i vsum = _mm256_setzero_si256();
+		sint16 mins[16], maxs[16];
+		int sums[8];
+		int j;
+		for (; i + 16 <= length; i += 16)
+		{
+			const __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+			vmin = _mm256_min_epi16(vmin, v);
+			vmax = _mm256_max_epi16(vmax, v);
+			vsum = _mm256_add_epi32(vsum, _mm256_madd_epi16(v, ones));
+		}
+		_mm256_storeu_si256((__m256i*)mins, vmin);
+		_mm256_storeu_si256((__m256i*)maxs, vmax);
+		_mm256_storeu_si256((__m256i*)sums, vsum);
+		for (j = 0; j < 16; j++)
+		{
+			if (mins[j] < *min)
+				*min = mins[j];
+			if (maxs[j] > *max)
+				*max = maxs[j];
+		}
+		for (j = 0; j < 8; j++)
+			*sum += sums[j];
+	}
+	if (i < length)
+	{
+		sse2_stat(src + i, length - i, &tailMin, &tailMax, &tailSum);
+		if (tailMin < *min)
+			*min = tailMin;
+		if (tailMax > *max)
+			*max = tailMax;
+		*sum += tailSum;
+	}
+}
+
+static const AsebaSimdKernels avx2Kernels =
+{
+	avx2_add, avx2_sub, avx2_mul, avx2_min, avx2_max,
+	avx2_addScalar, avx2_fill, avx2_clamp, avx2_dot, avx2_stat
+};
+
+#endif // ASEBA_SIMD_AVX2_AVAILABLE
+
+#ifdef ASEBA_SIMD_NEON_AVAILABLE
+
+// NEON, 8 elements at a time
+
+#define NEON_BINARY_KERNEL(name, op) \
+static void neon_##name(sint16* dest, const sint16* src1, const sint16* src2, uint16 length) \
+{ \
+	uint16 i = 0; \
+	for (; i + 8 <= length; i += 8) \
+		vst1q_s16(dest + i, op(vld1q_s16(src1 + i), vld1q_s16(src2 + i))); \
+	scalar_##name(dest + i, src1 + i, src2 + i, length - i); \
+}
+
+NEON_BINARY_KERNEL(add, vaddq_s16)
+NEON_BINARY_KERNEL(sub, vsubq_s16)
+NEON_BINARY_KERNEL(mul, vmulq_s16)
+NEON_BINARY_KERNEL(min, vminq_s16)
+NEON_BINARY_KERNEL(max, vmaxq_s16)
+
+static void neon_addScalar(sint16* dest, const sint16* src, sint16 scalar, uint16 length)
+{
+	const int16x8_t s = vdupq_n_s16(scalar);
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+		vst1q_s16(dest + i, vaddq_s16(vld1q_s16(src + i), s));
+	scalar_addScalar(dest + i, src + i, scalar, length - i);
+}
+
+static void neon_fill(sint16* dest, sint16 value, uint16 length)
+{
+	const int16x8_t v = vdupq_n_s16(value);
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+		vst1q_s16(dest + i, v);
+	scalar_fill(dest + i, value, length - i);
+}
+
+static void neon_clamp(sint16* dest, const sint16* src, const sint16* low, const sint16* high, uint16 length)
+{
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		const int16x8_t v = vld1q_s16(src + i);
+		const int16x8_t l = vld1q_s16(low + i);
+		const int16x8_t h = vld1q_s16(high + i);
+		vst1q_s16(dest + i, vbslq_s16(vcgtq_s16(v, h), h, vmaxq_s16(v, l)));
+	}
+	scalar_clamp(dest + i, src + i, low + i, high + i, length - i);
+}
+
+static sint64 neon_dot(const sint16* src1, const sint16* src2, uint16 length)
+{
+	int64x2_t acc = vdupq_n_s64(0);
+	uint16 i = 0;
+	for (; i + 8 <= length; i += 8)
+	{
+		const int16x8_t a = vld1q_s16(src1 + i);
+		const int16x8_t b = vld1q_s16(src2 + i);
+		// products fit in 32 bits, their pairwise sums are accumulated in 64 bits
+		acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(a), vget_low_s16(b)));
+		acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(a), vget_high_s16(b)));
+	}
+	return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1) + scalar_dot(src1 + i, src2 + i, length - i);
+}
+
+static void neon_stat(const sint16* src, uint16 length, sint16* min, sint16* max, sint32* sum)
+{
+	uint16 i = 0;
+	*min = src[0];
+	*max = src[0];
+	*sum = 0;
+	if (length >= 8)
+	{
+		int16x8_t vmin = vld1q_s16(src);
+		int16x8_t vmax = vmin;
+		int32x4_t vsum = vdupq_n_s32(0);
+		sint16 mins[8], maxs[8];
+		int32_t sums[4];
+		int j;
+		for (; i + 8 <= length; i += 8)
+		{
+			const int16x8_t v = vld1q_s16(src + i);
+			vmin = vminq_s16(vmin, v);
+			vmax = vmaxq_s16(vmax, v);
+			vsum = vpadalq_s16(vsum, v);
+		}
+		vst1q_s16(mins, vmin);
+		vst1q_s16(maxs, vmax);
+		vst1q_s32(sums, vsum);
+		for (j = 0; j < 8; j++)
+		{
+			if (mins[j] < *min)
+				*min = mins[j];
+			if (maxs[j] > *max)
+				*max = maxs[j];
+		}
+		*sum = (sint32)sums[0] + sums[1] + sums[2] + sums[3];
+	}
+	scalar_stat(src + i, length - i, min, max, sum);
+}
+
+static const AsebaSimdKernels neonKernels =
+{
+	neon_add, neon_sub, neon_mul, neon_min, neon_max,
+	neon_addScalar, neon_fill, neon_clamp, neon_dot, neon_stat
+};
+
+#endif // ASEBA_SIMD_NEON_AVAILABLE
+
+// selection of kernels
+
+//! Current level, -1 until first use; concurrent first uses all store the same value
+static int currentLevel = -1;
+
+int AsebaSimdIsSupported(AsebaSimdLevel level)
+{
+	switch (level)
+	{
+		case ASEBA_SIMD_NONE: return 1;
+		#ifdef ASEBA_SIMD_SSE2_AVAILABLE
+		case ASEBA_SIMD_SSE2: return 1;
+		#endif
+		#ifdef ASEBA_SIMD_AVX2_AVAILABLE
+		case ASEBA_SIMD_AVX2: return __builtin_cpu_supports("avx2") ? 1 : 0;
+		#endif
+		#ifdef ASEBA_SIMD_NEON_AVAILABLE
+		case ASEBA_SIMD_NEON: return 1;
+		#endif
+		default: return 0;
+	}
+}
+
+AsebaSimdLevel AsebaSimdGetLevel(void)
+{
+	if (currentLevel < 0)
+	{
+		if (AsebaSimdIsSupported(ASEBA_SIMD_AVX2))
+			currentLevel = ASEBA_SIMD_AVX2;
+		else if (AsebaSimdIsSupported(ASEBA_SIMD_SSE2))
+			currentLevel = ASEBA_SIMD_SSE2;
+		else if (AsebaSimdIsSupported(ASEBA_SIMD_NEON))
+			currentLevel = ASEBA_SIMD_NEON;
+		else
+			currentLevel = ASEBA_SIMD_NONE;
+	}
+	return (AsebaSimdLevel)currentLevel;
+}
+
+int AsebaSimdSetLevel(AsebaSimdLevel level)
+{
+	if (!AsebaSimdIsSupported(level))
+		return 0;
+	currentLevel = level;
+	return 1;
+}
+
+const AsebaSimdKernels* AsebaSimdGetKernels(void)
+{
+	switch (AsebaSimdGetLevel())
+	{
+		#ifdef ASEBA_SIMD_SSE2_AVAILABLE
+		case ASEBA_SIMD_SSE2: return &sse2Kernels;
+		#endif
+		#ifdef ASEBA_SIMD_AVX2_AVAILABLE
+		case ASEBA_SIMD_AVX2: return &avx2Kernels;
+		#endif
+		#ifdef ASEBA_SIMD_NEON_AVAILABLE
+		case ASEBA_SIMD_NEON: return &neonKernels;
+		#endif
+		default: return 0;
+	}
+}
+
+/*@}*/
+
+#endif // ASEBA_NATIVES_SIMD
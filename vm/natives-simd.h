@@ -0,0 +1,91 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ASEBA_NATIVES_SIMD_H
+#define __ASEBA_NATIVES_SIMD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../common/types.h"
+
+/**
+	\file natives-simd.h
+	Vectorized kernels of the standard vector natives, for hosts having SIMD instructions.
+	The kernels give exactly the same results as the element-by-element code of natives.c,
+	provided that writing dest does not modify a source before it is read.
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+/*! Defined if vectorized kernels are available on this host */
+#define ASEBA_NATIVES_SIMD
+#endif
+
+#ifdef ASEBA_NATIVES_SIMD
+
+/*! Instruction sets the kernels are implemented with */
+typedef enum
+{
+	ASEBA_SIMD_NONE = 0,	/*!< no kernels, natives use their element-by-element code */
+	ASEBA_SIMD_SSE2,		/*!< x86 SSE2, 8 elements at a time */
+	ASEBA_SIMD_AVX2,		/*!< x86 AVX2, 16 elements at a time */
+	ASEBA_SIMD_NEON			/*!< ARM NEON, 8 elements at a time */
+} AsebaSimdLevel;
+
+/*! Vectorized kernels */
+typedef struct
+{
+	void (*add)(sint16* dest, const sint16* src1, const sint16* src2, uint16 length);	/*!< wrapping addition */
+	void (*sub)(sint16* dest, const sint16* src1, const sint16* src2, uint16 length);	/*!< wrapping substraction */
+	void (*mul)(sint16* dest, const sint16* src1, const sint16* src2, uint16 length);	/*!< wrapping multiplication */
+	void (*min)(sint16* dest, const sint16* src1, const sint16* src2, uint16 length);	/*!< minimum */
+	void (*max)(sint16* dest, const sint16* src1, const sint16* src2, uint16 length);	/*!< maximum */
+	void (*addScalar)(sint16* dest, const sint16* src, sint16 scalar, uint16 length);	/*!< wrapping addition of a scalar */
+	void (*fill)(sint16* dest, sint16 value, uint16 length);	/*!< fill with a value */
+	void (*clamp)(sint16* dest, const sint16* src, const sint16* low, const sint16* high, uint16 length);	/*!< clamp, high having priority over low */
+	sint64 (*dot)(const sint16* src1, const sint16* src2, uint16 length);	/*!< exact dot product */
+	void (*stat)(const sint16* src, uint16 length, sint16* min, sint16* max, sint32* sum);	/*!< minimum, maximum and exact sum of a non-empty vector */
+} AsebaSimdKernels;
+
+/*! Return the kernels of the current level, or 0 if it is ASEBA_SIMD_NONE */
+const AsebaSimdKernels* AsebaSimdGetKernels(void);
+
+/*! Return the current level, by default the best one supported by the CPU */
+AsebaSimdLevel AsebaSimdGetLevel(void);
+
+/*! Set the current level for all virtual machines, return 0 if the CPU does not support it */
+int AsebaSimdSetLevel(AsebaSimdLevel level);
+
+/*! Return whether the CPU supports a given level */
+int AsebaSimdIsSupported(AsebaSimdLevel level);
+
+#endif // ASEBA_NATIVES_SIMD
+
+/*@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
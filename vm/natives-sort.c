@@ -0,0 +1,156 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "../common/consts.h"
+#include "../common/types.h"
+#include "natives-sort.h"
+
+/**
+	\file natives-sort.c
+	Implementation of order-statistics natives functions for Aseba Virtual Machine
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+// exchange two values
+static void aseba_swap(sint16* a, sint16* b)
+{
+	const sint16 swap = *a;
+	*a = *b;
+	*b = swap;
+}
+
+// whether the element at index a of values comes before the one at index b, ties being ordered by index
+#define ASEBA_ARG_LESS(values, a, b) ((values)[a] < (values)[b] || ((values)[a] == (values)[b] && (a) < (b)))
+
+// sift down the index at root of the max-heap of size indices into values
+static void aseba_arg_heap_sift_down(sint16* indices, const sint16* values, uint16 root, uint16 size)
+{
+	const sint16 index = indices[root];
+	uint16 child;
+	while ((child = 2 * root + 1) < size)
+	{
+		if (child + 1 < size && ASEBA_ARG_LESS(values, indices[child], indices[child + 1]))
+			child++;
+		if (!ASEBA_ARG_LESS(values, index, indices[child]))
+			break;
+		indices[root] = indices[child];
+		root = child;
+	}
+	indices[root] = index;
+}
+
+// fill indices with the indices of values in sorted order, equal values keeping their order
+void aseba_arg_sort(sint16* indices, const sint16* values, uint16 size)
+{
+	uint16 i;
+	for (i = 0; i < size; i++)
+		indices[i] = i;
+	if (size < 2)
+		return;
+	for (i = size / 2; i > 0; i--)
+		aseba_arg_heap_sift_down(indices, values, i - 1, size);
+	for (i = size - 1; i > 0; i--)
+	{
+		aseba_swap(&indices[0], &indices[i]);
+		aseba_arg_heap_sift_down(indices, values, 0, i);
+	}
+}
+
+// return the k-th smallest element of values, without modifying them, by bisection on the range of values
+sint16 aseba_select(const sint16* values, uint16 size, uint16 k)
+{
+	sint32 low = -32768;
+	sint32 high = 32767;
+	while (low < high)
+	{
+		const sint32 mid = low + ((high - low) >> 1);
+		uint16 count = 0;
+		uint16 i;
+		for (i = 0; i < size; i++)
+			if (values[i] <= mid)
+				count++;
+		if (count > k)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+	return (sint16)low;
+}
+
+
+// order-statistics natives functions
+
+void AsebaNative_vecargsort(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+	
+	aseba_arg_sort(&vm->variables[dest], &vm->variables[src], length);
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_vecargsort =
+{
+	"math.argsort",
+	"write to dest the indices that sort src, equal values keeping their order; dest must not overlap src",
+	{
+		{ -1, "dest" },
+		{ -1, "src" },
+		{ 0, 0 }
+	}
+};
+
+
+void AsebaNative_vecmedian(AsebaVMState *vm)
+{
+	// variable pos
+	uint16 dest = AsebaNativePopArg(vm);
+	uint16 src = AsebaNativePopArg(vm);
+	
+	// variable size
+	uint16 length = AsebaNativePopArg(vm);
+	
+	if (length)
+	{
+		const sint32 upper = aseba_select(&vm->variables[src], length, length / 2);
+		if (length & 1)
+			vm->variables[dest] = (sint16)upper;
+		else
+			vm->variables[dest] = (sint16)((aseba_select(&vm->variables[src], length, length / 2 - 1) + upper) / 2);
+	}
+}
+
+const AsebaNativeFunctionDescription AsebaNativeDescription_vecmedian =
+{
+	"math.median",
+	"write to dest the median of src, the mean of the two middle values if src has an even size",
+	{
+		{ 1, "dest" },
+		{ -1, "src" },
+		{ 0, 0 }
+	}
+};
+
+/*@}*/
@@ -0,0 +1,84 @@
+/*
+	Aseba - an event-based framework for distributed robot control
+	Copyright (C) 2007--2015:
+		Stephane Magnenat <stephane at magnenat dot net>
+		(http://stephane.magnenat.net)
+		and other contributors, see authors.txt for details
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published
+	by the Free Software Foundation, version 3 of the License.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __ASEBA_NATIVES_SORT_H
+#define __ASEBA_NATIVES_SORT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "../common/types.h"
+#include "natives.h"
+
+/**
+	\file natives-sort.h
+	Definition of order-statistics native functions for Aseba Virtual Machine.
+	They are optional: a target provides them by appending ASEBA_NATIVES_SORT_FUNCTIONS
+	and ASEBA_NATIVES_SORT_DESCRIPTIONS after the standard natives.
+	None of them needs memory beyond its arguments.
+*/
+
+/** \addtogroup vm */
+/*@{*/
+
+// sorting helpers, also used by math.sort
+
+/*! Sort size values of input in place with a heap sort, without recursion */
+void aseba_heap_sort(sint16* input, uint16 size);
+/*! Sort size values of input in place with an introspective sort */
+void aseba_intro_sort(sint16* input, uint16 size);
+/*! Fill indices with the indices of the size values in sorted order, equal values keeping their order */
+void aseba_arg_sort(sint16* indices, const sint16* values, uint16 size);
+/*! Return the k-th smallest of the size values, without modifying them */
+sint16 aseba_select(const sint16* values, uint16 size, uint16 k);
+
+// natives
+
+/*! Function to get the indices that sort a vector */
+void AsebaNative_vecargsort(AsebaVMState *vm);
+/*! Description of AsebaNative_vecargsort */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_vecargsort;
+
+/*! Function to get the median of a vector */
+void AsebaNative_vecmedian(AsebaVMState *vm);
+/*! Description of AsebaNative_vecmedian */
+extern const AsebaNativeFunctionDescription AsebaNativeDescription_vecmedian;
+
+/*! Embedded targets must know the size of ASEBA_NATIVES_SORT_FUNCTIONS without having to compute them by hand, please update this when adding a new function */
+#define ASEBA_NATIVES_SORT_COUNT 2
+
+/*! snippet to include order-statistics native functions */
+#define ASEBA_NATIVES_SORT_FUNCTIONS \
+	AsebaNative_vecargsort, \
+	AsebaNative_vecmedian
+
+/*! snippet to include descriptions of order-statistics native functions */
+#define ASEBA_NATIVES_SORT_DESCRIPTIONS \
+	&AsebaNativeDescription_vecargsort, \
+	&AsebaNativeDescription_vecmedian
+
+/*@}*/
+
+#ifdef __cplusplus
+} /* closing brace for extern "C" */
+#endif
+
+#endif
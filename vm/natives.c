@@ -21,6 +21,8 @@
 #include "../common/consts.h"
 #include "../common/types.h"
 #include "natives.h"
+#include "natives-simd.h"
+#include "natives-sort.h"
 #include <string.h>
 
 #include <assert.h>
@@ -249,42 +251,135 @@ sint16 aseba_sqrt(sint16 num)
 	return res;
 }
 
-// comb sort ( from Wikipedia )
-void aseba_comb_sort(sint16* input, uint16 size)
+// exchange two values
+static void aseba_swap(sint16* a, sint16* b)
+{
+	const sint16 swap = *a;
+	*a = *b;
+	*b = swap;
+}
+
+// sift down the element at root of the max-heap of size elements
+static void aseba_heap_sift_down(sint16* input, uint16 root, uint16 size)
+{
+	const sint16 value = input[root];
+	uint16 child;
+	while ((child = 2 * root + 1) < size)
+	{
+		if (child + 1 < size && input[child + 1] > input[child])
+			child++;
+		if (input[child] <= value)
+			break;
+		input[root] = input[child];
+		root = child;
+	}
+	input[root] = value;
+}
+
+// heap sort, in place, O(n log n) and without recursion, for memory-limited targets
+void aseba_heap_sort(sint16* input, uint16 size)
 {
-	uint16 gap = size;
-	uint16 swapped = 0;
 	uint16 i;
+	if (size < 2)
+		return;
+	for (i = size / 2; i > 0; i--)
+		aseba_heap_sift_down(input, i - 1, size);
+	for (i = size - 1; i > 0; i--)
+	{
+		aseba_swap(&input[0], &input[i]);
+		aseba_heap_sift_down(input, 0, i);
+	}
+}
 
-	while ((gap > 1) || swapped)
+// insertion sort, fast on small arrays
+static void aseba_insertion_sort(sint16* input, uint16 size)
+{
+	uint16 i, j;
+	for (i = 1; i < size; i++)
+	{
+		const sint16 value = input[i];
+		for (j = i; j > 0 && input[j - 1] > value; j--)
+			input[j] = input[j - 1];
+		input[j] = value;
+	}
+}
+
+// quick sort on median of three, falling back to heap sort when recursion gets too deep
+static void aseba_intro_sort_rec(sint16* input, uint16 size, uint16 depth)
+{
+	while (size > 16)
 	{
-		if (gap > 1)
+		const uint16 mid = (size - 1) / 2;
+		sint16 pivot;
+		sint32 i, j;
+
+		if (depth == 0)
 		{
-#ifdef __C30__
-			gap = __builtin_divud(__builtin_muluu(gap,4),5);
-#else
-			gap = (uint16)(((uint32)gap * 4) / 5);
-#endif
+			aseba_heap_sort(input, size);
+			return;
 		}
+		depth--;
 
-		swapped = 0;
+		// order first, middle and last elements, and take the middle one as pivot
+		if (input[mid] < input[0])
+			aseba_swap(&input[mid], &input[0]);
+		if (input[size - 1] < input[mid])
+		{
+			aseba_swap(&input[size - 1], &input[mid]);
+			if (input[mid] < input[0])
+				aseba_swap(&input[mid], &input[0]);
+		}
+		pivot = input[mid];
 
-		for (i = 0; gap + i < size; i++)
+		// Hoare partition, [0, j] <= pivot <= [j + 1, size)
+		i = -1;
+		j = size;
+		while (1)
 		{
-			if (input[i] - input[i + gap] > 0)
-			{
-				sint16 swap = input[i];
-				input[i] = input[i + gap];
-				input[i + gap] = swap;
-				swapped = 1;
-			}
+			do i++; while (input[i] < pivot);
+			do j--; while (input[j] > pivot);
+			if (i >= j)
+				break;
+			aseba_swap(&input[i], &input[j]);
+		}
+
+		// recurse on the smaller part, loop on the larger one
+		if (j + 1 < (sint32)size - (j + 1))
+		{
+			aseba_intro_sort_rec(input, (uint16)(j + 1), depth);
+			input += j + 1;
+			size -= (uint16)(j + 1);
+		}
+		else
+		{
+			aseba_intro_sort_rec(input + j + 1, (uint16)(size - (j + 1)), depth);
+			size = (uint16)(j + 1);
 		}
 	}
+	aseba_insertion_sort(input, size);
+}
+
+// introspective sort, in place and O(n log n)
+void aseba_intro_sort(sint16* input, uint16 size)
+{
+	uint16 depth = 0;
+	uint16 n;
+	for (n = size; n > 1; n >>= 1)
+		depth += 2;
+	aseba_intro_sort_rec(input, size, depth);
 }
 
 
 // standard natives functions
 
+#ifdef ASEBA_NATIVES_SIMD
+// return whether writing dest element by element modifies src before it is read
+static uint16 aseba_overwrites_source(uint16 dest, uint16 src, uint16 length)
+{
+	return (dest > src) && ((uint32)dest < (uint32)src + length);
+}
+#endif
+
 void AsebaNative_veccopy(AsebaVMState *vm)
 {
 	// variable pos
@@ -296,6 +391,14 @@ void AsebaNative_veccopy(AsebaVMState *vm)
 	
 	uint16 i;
 	
+#ifdef ASEBA_NATIVES_SIMD
+	if (!aseba_overwrites_source(dest, src, length))
+	{
+		memmove(vm->variables + dest, vm->variables + src, length * sizeof(sint16));
+		return;
+	}
+#endif
+	
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[src++];
@@ -325,6 +428,16 @@ void AsebaNative_vecfill(AsebaVMState *vm)
 	
 	uint16 i;
 	
+#ifdef ASEBA_NATIVES_SIMD
+	// value is constant even if it lies in dest
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels)
+	{
+		kernels->fill(vm->variables + dest, vm->variables[value], length);
+		return;
+	}
+#endif
+	
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[value];
@@ -355,6 +468,14 @@ void AsebaNative_vecaddscalar(AsebaVMState *vm)
 	
 	const sint16 scalarValue = vm->variables[scalar];
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src, length))
+	{
+		kernels->addScalar(vm->variables + dest, vm->variables + src, scalarValue, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[src++] + scalarValue;
@@ -385,6 +506,14 @@ void AsebaNative_vecadd(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src1, length) && !aseba_overwrites_source(dest, src2, length))
+	{
+		kernels->add(vm->variables + dest, vm->variables + src1, vm->variables + src2, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[src1++] + vm->variables[src2++];
@@ -415,6 +544,14 @@ void AsebaNative_vecsub(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src1, length) && !aseba_overwrites_source(dest, src2, length))
+	{
+		kernels->sub(vm->variables + dest, vm->variables + src1, vm->variables + src2, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[src1++] - vm->variables[src2++];
@@ -445,6 +582,14 @@ void AsebaNative_vecmul(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src1, length) && !aseba_overwrites_source(dest, src2, length))
+	{
+		kernels->mul(vm->variables + dest, vm->variables + src1, vm->variables + src2, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		vm->variables[dest++] = vm->variables[src1++] * vm->variables[src2++];
@@ -517,6 +662,14 @@ void AsebaNative_vecmin(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src1, length) && !aseba_overwrites_source(dest, src2, length))
+	{
+		kernels->min(vm->variables + dest, vm->variables + src1, vm->variables + src2, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		sint16 v1 = vm->variables[src1++];
@@ -550,6 +703,14 @@ void AsebaNative_vecmax(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src1, length) && !aseba_overwrites_source(dest, src2, length))
+	{
+		kernels->max(vm->variables + dest, vm->variables + src1, vm->variables + src2, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		sint16 v1 = vm->variables[src1++];
@@ -583,6 +744,14 @@ void AsebaNative_vecclamp(AsebaVMState *vm)
 	uint16 length = AsebaNativePopArg(vm);
 	
 	uint16 i;
+#ifdef ASEBA_NATIVES_SIMD
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && !aseba_overwrites_source(dest, src, length) && !aseba_overwrites_source(dest, low, length) && !aseba_overwrites_source(dest, high, length))
+	{
+		kernels->clamp(vm->variables + dest, vm->variables + src, vm->variables + low, vm->variables + high, length);
+		return;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		sint16 v = vm->variables[src++];
@@ -659,6 +828,16 @@ void AsebaNative_vecdot(AsebaVMState *vm)
 	res >>= shift;
 	vm->variables[dest] = (sint16) res;
 #else
+#ifdef ASEBA_NATIVES_SIMD
+	if (AsebaSimdGetKernels())
+	{
+		// the exact sum, wrapped like the accumulation below
+		res = (sint32)AsebaSimdGetKernels()->dot(vm->variables + src1, vm->variables + src2, length);
+		src1 += length;
+		src2 += length;
+		length = 0;
+	}
+#endif
 	for (i = 0; i < length; i++)
 	{
 		res += (sint32)vm->variables[src1++] * (sint32)vm->variables[src2++];
@@ -696,6 +875,20 @@ void AsebaNative_vecstat(AsebaVMState *vm)
 	sint32 acc;
 	uint16 i;
 	
+#ifdef ASEBA_NATIVES_SIMD
+	// the results are written progressively below, so they must not be read as sources
+	const AsebaSimdKernels* kernels = AsebaSimdGetKernels();
+	if (kernels && length && (min != max) && ((uint16)(min - src) >= length) && ((uint16)(max - src) >= length))
+	{
+		sint16 minValue, maxValue;
+		kernels->stat(vm->variables + src, length, &minValue, &maxValue, &acc);
+		vm->variables[min] = minValue;
+		vm->variables[max] = maxValue;
+		vm->variables[mean] = (sint16)(acc / (sint32)length);
+		return;
+	}
+#endif
+	
 	if (length)
 	{
 		val = vm->variables[src++];
@@ -785,7 +978,11 @@ void AsebaNative_vecsort(AsebaVMState *vm)
 	// variable size
 	uint16 length = AsebaNativePopArg(vm);
 	
-	aseba_comb_sort(&vm->variables[src], length);
+#ifdef __C30__
+	aseba_heap_sort(&vm->variables[src], length);
+#else
+	aseba_intro_sort(&vm->variables[src], length);
+#endif
 }
 
 const AsebaNativeFunctionDescription AsebaNativeDescription_vecsort =
@@ -1102,7 +1299,7 @@ const AsebaNativeFunctionDescription AsebaNativeDescription_vecnonzerosequence =
 
 static uint16 rnd_state;
 
-void AsebaSetRandomSeed(uint16 seed)
+void AsebaSetSharedRandomSeed(uint16 seed)
 {
 	rnd_state = seed;
 }
@@ -1113,6 +1310,17 @@ uint16 AsebaGetRandom()
 	return rnd_state;
 }
 
+void AsebaVMSetRandomSeed(AsebaVMState *vm, uint16 seed)
+{
+	vm->randomState = seed;
+}
+
+uint16 AsebaVMGetRandom(AsebaVMState *vm)
+{
+	vm->randomState = 25173 * vm->randomState + 13849;
+	return vm->randomState;
+}
+
 void AsebaNative_rand(AsebaVMState *vm)
 {
 	// variable pos
@@ -1124,7 +1332,7 @@ void AsebaNative_rand(AsebaVMState *vm)
 	uint16 i;
 	for (i = 0; i < length; i++)
 	{
-		vm->variables[destIndex++] = (sint16)AsebaGetRandom();
+		vm->variables[destIndex++] = (sint16)AsebaVMGetRandom(vm);
 	}
 }
 
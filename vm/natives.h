@@ -197,10 +197,14 @@ void AsebaNative_vecnonzerosequence(AsebaVMState *vm);
 /*! Description of AsebaNative_vecnonzerosequence */
 extern const AsebaNativeFunctionDescription AsebaNativeDescription_vecnonzerosequence;
 
-/*! Functon to set the seed of random generator */
-void AsebaSetRandomSeed(uint16 seed);
-/*! Functon to get a random number */
+/*! Function to set the seed of the random generator shared by the whole program, not thread safe; math.rand does not use it, see AsebaVMSetRandomSeed */
+void AsebaSetSharedRandomSeed(uint16 seed);
+/*! Function to get a random number from the random generator shared by the whole program, seeded by AsebaSetSharedRandomSeed */
 uint16 AsebaGetRandom();
+/*! Function to set the seed of the random generator of a VM, used by math.rand; VMs running in different threads do not interfere */
+void AsebaVMSetRandomSeed(AsebaVMState *vm, uint16 seed);
+/*! Function to get a random number from the random generator of a VM */
+uint16 AsebaVMGetRandom(AsebaVMState *vm);
 /*! Function to get a 16-bit signed random number */
 void AsebaNative_rand(AsebaVMState *vm);
 /*! Description of AsebaNative_rand */
@@ -91,6 +91,9 @@ typedef struct
 	// breakpoint
 	uint16 breakpoints[ASEBA_MAX_BREAKPOINTS];
 	uint16 breakpointsCount;
+	
+	// random generator
+	uint16 randomState; /*!< state of the generator of math.rand, set by AsebaVMSetRandomSeed and kept by AsebaVMInit */
 } AsebaVMState;
 
 // Macros to work with masks